@@ -0,0 +1,302 @@
+// Microbenchmarks of LibOS.
+//
+// Results are printed to stdout as a single JSON object:
+// {
+//   "library": "libos", "version": LIBOS_VERSION_STRING, "os": "linux",
+//   "os_version": "...", "kernel_version": "...",
+//   "benchmarks": [ { "name": "...", "iterations": 1024, "ns_per_op": 12.5 }, ... ]
+// }
+//
+// Usage: libos_bench [--filter <substring>] [--min-time-ms <ms>] [--inject]
+//
+// Injection is measured on os::keyboard::mock_backend by default.
+// Pass --inject to also press and release real keys through OS.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "os/clock.hpp"
+#include "os/info.hpp"
+#include "os/kernel.hpp"
+#include "os/keyboard.hpp"
+#include "os/memory.hpp"
+#include "os/process.hpp"
+#include "os/version.hpp"
+
+// Get library version
+#include "os/libos.hpp"
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+// Make compiler believe, that value is used
+template <class T>
+void keep(const T &value)
+{
+#if defined(_MSC_VER)
+    static const void *volatile sink;
+    sink = &value;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r"(&value) : "memory");
+#endif
+}
+
+// Result of single benchmark
+struct result
+{
+    std::string   name;
+    std::uint64_t iterations = 0;
+    double        ns_per_op = 0;
+};
+
+// Settings from command line
+struct settings
+{
+    std::string_view          filter;
+    std::chrono::milliseconds min_time{200};
+    bool                      inject = false;
+};
+
+settings options;
+std::vector<result> results;
+
+bool selected(std::string_view name)
+{
+    return options.filter.empty() || name.find(options.filter) != std::string_view::npos;
+}
+
+// Measure average time of a call, repeating it until min_time passes
+template <class F>
+void run(std::string_view name, F &&f)
+{
+    if (!selected(name)) { return; }
+
+    // Warm up
+    f();
+
+    std::uint64_t iterations = 1;
+    while (true)
+    {
+        const auto start = clock_type::now();
+        for (std::uint64_t i = 0; i < iterations; ++i) { f(); }
+        const auto elapsed = clock_type::now() - start;
+
+        if (elapsed >= options.min_time || iterations >= (std::uint64_t{1} << 40))
+        {
+            const auto ns = std::chrono::duration<double, std::nano>(elapsed).count();
+            results.push_back({std::string(name), iterations, ns / static_cast<double>(iterations)});
+            return;
+        }
+        iterations *= 2;
+    }
+}
+
+// Measure single call, that can't be repeated (e.g. first call of cached function)
+template <class F>
+void run_once(std::string_view name, F &&f)
+{
+    if (!selected(name)) { return; }
+
+    const auto start = clock_type::now();
+    f();
+    const auto elapsed = clock_type::now() - start;
+    results.push_back({std::string(name), 1, std::chrono::duration<double, std::nano>(elapsed).count()});
+}
+
+// Cold calls must be the first ones in the process
+void bench_info_cold()
+{
+    run_once("info.cold", [] { keep(os::info()); });
+    run_once("kernel.info.cold", [] { keep(os::kernel::info()); });
+}
+
+void bench_info_warm()
+{
+    run("info.warm", [] { keep(os::info()); });
+    run("info.name", [] { keep(os::name()); });
+    run("info.version", [] { keep(os::version()); });
+    run("kernel.info.warm", [] { keep(os::kernel::info()); });
+    run("kernel.info.version", [] { keep(os::kernel::version()); });
+    run("kernel.features", [] { keep(os::kernel::features().has(os::kernel::feature::io_uring)); });
+}
+
+void bench_clock()
+{
+    run("clock.steady_clock", [] { keep(clock_type::now()); });
+    run("clock.raw", [] { keep(os::clock::raw::now()); });
+    run("clock.fast", [] { keep(os::clock::fast::now()); });
+    run("clock.ticks", [] { keep(os::clock::ticks()); });
+}
+
+void bench_memory()
+{
+    run("memory.info", [] { keep(os::memory::info()); });
+    run("memory.snapshot", [] { keep(os::memory::snapshot()); });
+}
+
+void bench_process()
+{
+    run("process.usage", [] { keep(os::process::usage()); });
+}
+
+void bench_version()
+{
+    // Not constant, so parsing isn't done at compile time
+    std::string text = "10.15.7";
+    keep(text);
+
+    run("version.parse", [&text] { keep(::version{text}); });
+
+    const ::version versions[] = { {10, 15, 7}, {10, 16, 0}, {11, 0, 1}, {10, 15, 6} };
+    std::size_t i = 0;
+    run("version.compare", [&versions, &i]
+    {
+        const auto &lhs = versions[i % 4];
+        const auto &rhs = versions[(i + 1) % 4];
+        ++i;
+        keep(lhs < rhs);
+        keep(lhs == rhs);
+    });
+
+    run("version.str", [&versions] { keep(versions[0].str()); });
+}
+
+void bench_combination()
+{
+    using os::keyboard::vk;
+
+    // Not constant, so combinations aren't built at compile time
+    volatile vk lhs = vk::Shift;
+    volatile vk rhs = vk::A;
+
+    run("keyboard.combination.operator+", [&lhs, &rhs] { keep(lhs + rhs); });
+
+    const os::keyboard::combination combo = vk::Control + vk::Shift + vk::A;
+    run("keyboard.combination.contains", [&combo, &lhs] { keep(combo.contains(lhs)); });
+}
+
+// Measure keyboard functions on backend, installed on this thread
+void bench_keyboard(std::string_view prefix, bool inject)
+{
+    using os::keyboard::vk;
+
+    const std::string name(prefix);
+    const os::keyboard::combination combo = vk::Shift;
+
+    run(name + ".is_pressed", [&combo] { keep(os::keyboard::is_pressed(combo)); });
+    run(name + ".pressed_keys", [] { keep(os::keyboard::pressed_keys()); });
+    run(name + ".snapshot", [] { keep(os::keyboard::snapshot()); });
+
+    if (!inject) { return; }
+
+    run(name + ".press", [&combo] { os::keyboard::press(combo); });
+    run(name + ".release", [&combo] { os::keyboard::release(combo); });
+    run(name + ".click", [&combo] { os::keyboard::click(combo); });
+
+    const os::keyboard::key_event events[] = { {vk::Shift, true}, {vk::A, true}, {vk::A, false}, {vk::Shift, false} };
+    run(name + ".send", [&events] { os::keyboard::send(events); });
+}
+
+// Escape string for JSON
+std::string quoted(std::string_view str)
+{
+    std::string out = "\"";
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\') { out += '\\'; }
+        if (static_cast<unsigned char>(c) < 0x20) { continue; }
+        out += c;
+    }
+    return out + "\"";
+}
+
+const char * os_type()
+{
+    switch (os::type())
+    {
+    case os::linux:   return "linux";
+    case os::windows: return "windows";
+    case os::macos:   return "macos";
+    default:          return "undefined";
+    }
+}
+
+void print_results()
+{
+    std::printf("{\n");
+    std::printf("  \"library\": \"libos\",\n");
+    std::printf("  \"version\": %s,\n", quoted(libos::version_string).c_str());
+    std::printf("  \"os\": \"%s\",\n", os_type());
+    std::printf("  \"os_version\": %s,\n", quoted(os::version().str()).c_str());
+    std::printf("  \"kernel_version\": %s,\n", quoted(os::kernel::version().str()).c_str());
+    std::printf("  \"benchmarks\": [");
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const auto &r = results[i];
+        std::printf(
+            "%s\n    { \"name\": %s, \"iterations\": %llu, \"ns_per_op\": %.3f }",
+            i == 0 ? "" : ",",
+            quoted(r.name).c_str(),
+            static_cast<unsigned long long>(r.iterations),
+            r.ns_per_op
+        );
+    }
+    std::printf("\n  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            options.filter = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < argc)
+        {
+            options.min_time = std::chrono::milliseconds(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--inject") == 0)
+        {
+            options.inject = true;
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--filter <substring>] [--min-time-ms <ms>] [--inject]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench_info_cold();
+    bench_info_warm();
+    bench_clock();
+    bench_memory();
+    bench_process();
+    bench_version();
+    bench_combination();
+
+    bench_keyboard("keyboard.native", options.inject);
+    {
+        os::keyboard::mock_backend mock;
+        os::keyboard::backend_scope scope(mock);
+        bench_keyboard("keyboard.mock", true);
+    }
+
+    print_results();
+    return 0;
+}
\ No newline at end of file
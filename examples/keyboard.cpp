@@ -26,7 +26,7 @@ int main()
 
     os::keyboard::release(vk::Enter); // Protect from instant skipping
     std::cout << "Please, press Enter to start." << std::flush; // Flush to see the message
-    while (!os::keyboard::is_pressed(vk::Enter)) {} // vk::Control is the same
+    os::keyboard::wait_for(vk::Enter); // Sleeps until key is pressed (polls, if OS events are unavailable)
 
     std::cout << "\n";
 
@@ -45,6 +45,10 @@ int main()
     std::cout << "Here's F for you:" << std::endl;
     os::keyboard::click(vk::Shift + vk::F);
 
+    // Text is typed with keys of current layout instead
+    std::cout << "\nAnd some text:" << std::endl;
+    os::keyboard::type(U"Hello, world!");
+
     // Click Enter if you want to... you know... enter it
     // /* Same as click(vk::Enter) */
     // os::keyboard::press(vk::Enter);
@@ -1,106 +1,101 @@
-import enum
 from os import walk
 
+import re
+
 _, _, filenames = next(walk("include/os"), (None, None, []))
 
-from shutil import copy
+# Headers, that don't have .cpp files
+declarations_only = ["macros.h", "libos.hpp", "prefetch.hpp", "span.hpp", "version.hpp"]
 
-import re
+# Platform macro and directory of sources
+platforms = [("IS_OS_LINUX", "linux"), ("IS_OS_WINDOWS", "windows"), ("IS_OS_MACOS", "macos")]
 
-# Remove #include "..." lines
-def lines_without_user_includes(path: str):
-    with open(path) as f:
-        lines = f.readlines()
-        remove_indexes = []
-        for (i, line) in enumerate(lines):
-            if line.startswith("#include \""):
-                remove_indexes.append(i)
-        for i in reversed(remove_indexes):
-            lines.pop(i)
-    return lines
-
-# Get content of a header file without license and header guard
-def header_content(path: str, license_end_line: int = 29) -> str:
-    return ''.join(lines_without_user_includes(path)[license_end_line + 1:])
-
-# Get content of a source file without #include "..."
+# Replace #include "os/..." with include of header-only sibling
+def sibling_includes(lines: list) -> list:
+    return [re.sub("^#include \"os/", "#include \"", line) for line in lines]
+
+# Get name of macro without non-identifier characters
+def macro_name(filename: str) -> str:
+    return re.sub("\\W", "_", filename).upper()
+
+# Get content of a source file with includes of header-only siblings
 def source_content(path: str) -> str:
-    return ''.join(lines_without_user_includes(path))
+    with open(path) as f:
+        return ''.join(sibling_includes(f.readlines()))
+
+# Get implementation section of a header: sources of every platform,
+# compiled only in translation unit, that defines LIBOS_IMPLEMENTATION
+def implementation(filename: str) -> str:
+    src = filename.removesuffix("pp").removesuffix("h") + "cpp"
+    implemented = "LIBOS_" + macro_name(src) + "_IMPLEMENTED"
+
+    section = \
+        "\n" \
+        "// -------------------------\n" \
+        "// |    IMPLEMENTATION     |\n" \
+        "// -------------------------\n" \
+        "\n" \
+       f"#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined({implemented})\n" \
+       f"#define {implemented}\n" \
+        "\n" \
+        "#include \"macros.h\"\n" \
+        "\n"
+    for (i, (macro, platform)) in enumerate(platforms):
+        path = f"src/{platform}/{src}"
+        section += \
+            ("#if" if i == 0 else "#elif") + f" {macro}\n" \
+            f"// {path}\n" \
+             "// =========================\n" \
+            f"{source_content(path)}\n" \
+            f"// End of {path}\n" \
+             "// =========================\n" \
+             "\n"
+    section += \
+         "#endif // IS_OS_*\n" \
+         "\n" \
+        f"#endif // LIBOS_IMPLEMENTATION\n"
+    return section
+
+# Get includes of os.hpp twice: declarations of every header go first,
+# so platform headers of implementations can't break them
+def all_headers(lines: list) -> list:
+    includes = [line.rstrip("\n") + "\n" for line in lines if line.startswith("#include \"")]
+    return \
+        ["#define LIBOS_DEFER_IMPLEMENTATION\n"] + includes + \
+        ["#undef LIBOS_DEFER_IMPLEMENTATION\n",
+         "\n",
+         "#ifdef LIBOS_IMPLEMENTATION\n"] + includes + \
+        ["#endif // LIBOS_IMPLEMENTATION\n"]
 
 for filename in filenames:
     ho_path = "include/os/header-only/" + filename
-    copy("include/os/" + filename, ho_path)
-    with open(ho_path, "r+") as f:
-        lines = f.readlines()
-
-        # Update description
-        description = "{}. Header-only".format(lines[0].removeprefix("// ").rstrip())
-        lines[0] = f"// {description}\n"
-
-        # Update file info
-        for (i, line) in enumerate(lines):
-            if line.startswith("/** @file"):
-                lines[i] = "/** @file {}\n".format(ho_path.removeprefix("include/"))
-                lines[i + 1] = f" *  {description}\n"
-                break
-
-        dependencies = [filename]
-        # Substitute includes
-        for (i, line) in enumerate(lines):
-            if line.startswith("#include \""):
-                dependency = re.match("#include \"(.*)\"", line).group(1)
-                dependencies.append(dependency.removeprefix("os/"))
-                content = header_content("include/" + dependency)
-                lines[i] = \
-                f"// #include \"{dependency}\"\n" \
-                 "// =========================\n" \
-                f"{content}\n"                    \
-                f"// End of   \"{dependency}\"\n" \
-                 "// =========================\n" \
-                 "\n"
-
-
-        # don't have .cpp files
-        ignore = ["os.hpp", "libos.hpp", "macros.h", "version.hpp"]
-
-        # exclude header-only dependencies
-        dependencies = [d for d in dependencies if d not in ignore]
-        if len(dependencies) > 0:
-            lines.append(
-                "\n"                             \
-                "\n"                             \
-                "// -------------------------\n" \
-                "// |        SOURCES        |\n" \
-                "// -------------------------\n" \
-                "\n"
-            )
-            for dependency in dependencies:
-                src = dependency.removesuffix("pp").removesuffix("h") + "cpp"
-                linux_path = "src/linux/" + src
-                linux_content = source_content(linux_path)
-                windows_path = "src/windows/" + src
-                windows_content = source_content(windows_path)
-                lines.append(
-                     "#if IS_OS_LINUX\n"              \
-                    f"// {linux_path}\n"              \
-                     "// =========================\n" \
-                    f"{linux_content}\n"              \
-                    f"// End of {linux_path}\n"       \
-                     "// =========================\n" \
-                     "\n"                             \
-                     "#endif // IS_OS_LINUX\n"        \
-                     "\n"                             \
-                     "#if IS_OS_WINDOWS\n"            \
-                    f"// {windows_path}\n"            \
-                     "// =========================\n" \
-                    f"{windows_content}\n"            \
-                    f"// End of {windows_path}\n"     \
-                     "// =========================\n" \
-                     "\n"                             \
-                     "#endif // IS_OS_WINDOWS\n"
-                )
-
-
-        f.seek(0)
-        f.truncate()
-        f.writelines(lines)
\ No newline at end of file
+    with open("include/os/" + filename) as f:
+        lines = sibling_includes(f.readlines())
+
+    # Update description
+    description = "{}. Header-only".format(lines[0].removeprefix("// ").rstrip())
+    lines[0] = f"// {description}\n"
+
+    # Update file info
+    for (i, line) in enumerate(lines):
+        if line.startswith("/** @file"):
+            lines[i] = "/** @file {}\n".format(ho_path.removeprefix("include/"))
+            lines[i + 1] = f" *  {description}\n"
+            break
+
+    if filename == "os.hpp":
+        pragma = lines.index("#pragma once\n")
+        lines = lines[:pragma + 1] + ["\n"] + all_headers(lines[pragma + 1:])
+
+    # Guard instead of #pragma once, so implementation may follow declarations later
+    guard = "LIBOS_HEADER_ONLY_" + macro_name(filename)
+    pragma = lines.index("#pragma once\n")
+    lines[pragma] = f"#ifndef {guard}\n#define {guard}\n"
+    lines[-1] = lines[-1].rstrip("\n") + "\n"
+    lines.append(f"\n#endif // {guard}\n")
+
+    if filename != "os.hpp" and filename not in declarations_only:
+        lines.append(implementation(filename))
+
+    with open(ho_path, "w") as f:
+        f.writelines(lines)
@@ -0,0 +1,144 @@
+// Clocks
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/clock.hpp
+ *  Cheap monotonic clocks
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+#endif
+
+namespace os::clock
+{
+
+/**
+ * @brief Monotonic clock, that isn't adjusted by NTP
+ *
+ * @details
+ *  - Linux: `clock_gettime(CLOCK_MONOTONIC_RAW)`
+ *  - Windows: `QueryPerformanceCounter`
+ *  - MacOS: `mach_absolute_time` (doesn't count time of sleep)
+ */
+struct raw
+{
+    using duration   = std::chrono::nanoseconds;
+    using rep        = duration::rep;
+    using period     = duration::period;
+    using time_point = std::chrono::time_point<raw>;
+
+    static constexpr bool is_steady = true;
+
+    /// Get current time
+    static time_point now() noexcept;
+};
+
+/**
+ * @brief Read hardware counter of CPU
+ *
+ * @details
+ *  - x86: time stamp counter (`rdtsc`)
+ *  - ARM64: virtual counter (`cntvct_el0`)
+ *  - Other CPUs: nanoseconds of raw clock
+ *
+ * @warning Ticks may be converted to time only if calibration().tsc is true.
+ */
+inline std::uint64_t ticks() noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return static_cast<std::uint64_t>(raw::now().time_since_epoch().count());
+#endif
+}
+
+/// Relation between ticks() and raw clock
+struct calibration_t
+{
+    /// Ticks advance at constant rate on every CPU, so fast clock uses them
+    bool tsc = false;
+    /// Nanoseconds per tick
+    double ns_per_tick = 1.0;
+    /// Ticks at the moment of calibration
+    std::uint64_t base_ticks = 0;
+    /// Raw time at the moment of calibration
+    raw::time_point base_time;
+};
+
+/**
+ * @brief Get relation between ticks() and raw clock
+ *
+ * @details
+ *  Calibration happens once, even if several threads call it at the same time.
+ *  Counter is used only if kernel::feature::invariant_tsc is available:
+ *  - x86: rate is measured against raw clock for 10ms
+ *  - ARM64: rate is read from `cntfrq_el0`
+ */
+const calibration_t & calibration() noexcept;
+
+/// Convert difference of ticks() to time
+inline std::chrono::nanoseconds to_duration(std::int64_t ticks) noexcept
+{
+    return std::chrono::nanoseconds(static_cast<std::int64_t>(static_cast<double>(ticks) * calibration().ns_per_tick));
+}
+
+/**
+ * @brief Monotonic clock, that reads hardware counter without syscall
+ *
+ * @details
+ *  Time is converted from ticks() with calibration() and matches raw clock.
+ *  Falls back to raw clock, if counter isn't invariant.
+ */
+struct fast
+{
+    using duration   = std::chrono::nanoseconds;
+    using rep        = duration::rep;
+    using period     = duration::period;
+    using time_point = std::chrono::time_point<fast>;
+
+    static constexpr bool is_steady = true;
+
+    /// Get current time
+    static time_point now() noexcept
+    {
+        const calibration_t &c = calibration();
+        if (!c.tsc) { return time_point(raw::now().time_since_epoch()); }
+
+        const auto elapsed = static_cast<double>(static_cast<std::int64_t>(ticks() - c.base_ticks)) * c.ns_per_tick;
+        return time_point(c.base_time.time_since_epoch() + duration(static_cast<rep>(elapsed)));
+    }
+};
+
+} // namespace os::clock
\ No newline at end of file
@@ -0,0 +1,109 @@
+// Functions to get CPU topology
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/** @file os/cpu.hpp
+ *  Functions to get CPU topology
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace os::cpu
+{
+
+/// Indexes of logical CPUs, sorted in ascending order
+using cpu_set = std::vector<unsigned>;
+
+/// Cache of single level
+struct cache_t
+{
+    /// Size in bytes (0, if there is no such cache)
+    std::size_t size = 0;
+    /// Size of cache line in bytes
+    std::size_t line_size = 0;
+};
+
+/// NUMA node
+struct numa_node
+{
+    /// Number of node
+    unsigned id = 0;
+    /// Logical CPUs of node
+    cpu_set  cpus;
+};
+
+/// Full CPU topology
+struct info_t
+{
+    /// Number of logical CPUs (hardware threads)
+    unsigned logical_cores = 0;
+    /// Number of physical cores
+    unsigned physical_cores = 0;
+    /// Number of physical packages (sockets)
+    unsigned packages = 0;
+
+    /// Logical CPUs of every physical core (SMT siblings)
+    std::vector<cpu_set> siblings;
+
+    /// L1 data cache of single core
+    cache_t l1d;
+    /// L1 instruction cache of single core
+    cache_t l1i;
+    /// L2 cache
+    cache_t l2;
+    /// L3 cache
+    cache_t l3;
+
+    /// NUMA nodes. Single node with every CPU on systems without NUMA
+    std::vector<numa_node> numa_nodes;
+};
+
+/// Get number of logical CPUs (hardware threads)
+unsigned logical_cores();
+
+/// Get number of physical cores
+unsigned physical_cores();
+
+/// Get size of cache line in bytes
+std::size_t cache_line_size();
+
+/**
+ * @brief Get full CPU topology
+ *
+ * @details
+ *  Topology is read once, even if several threads call it at the same time:
+ *  - Linux: `/sys/devices/system/cpu` and `/sys/devices/system/node`
+ *  - Windows: `GetLogicalProcessorInformationEx`
+ *  - MacOS: `sysctl hw.*`. Siblings are assumed to be adjacent and there is a single NUMA node
+ *
+ * @note Topology of CPUs, that were offline at the first call, is missing.
+ *
+ * @return const info_t& Ref to CPU topology
+ */
+const info_t & info();
+
+} // namespace os::cpu
\ No newline at end of file
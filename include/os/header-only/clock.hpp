@@ -0,0 +1,461 @@
+// Clocks. Header-only
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/header-only/clock.hpp
+ *  Clocks. Header-only
+ */
+
+#ifndef LIBOS_HEADER_ONLY_CLOCK_HPP
+#define LIBOS_HEADER_ONLY_CLOCK_HPP
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+#endif
+
+namespace os::clock
+{
+
+/**
+ * @brief Monotonic clock, that isn't adjusted by NTP
+ *
+ * @details
+ *  - Linux: `clock_gettime(CLOCK_MONOTONIC_RAW)`
+ *  - Windows: `QueryPerformanceCounter`
+ *  - MacOS: `mach_absolute_time` (doesn't count time of sleep)
+ */
+struct raw
+{
+    using duration   = std::chrono::nanoseconds;
+    using rep        = duration::rep;
+    using period     = duration::period;
+    using time_point = std::chrono::time_point<raw>;
+
+    static constexpr bool is_steady = true;
+
+    /// Get current time
+    static time_point now() noexcept;
+};
+
+/**
+ * @brief Read hardware counter of CPU
+ *
+ * @details
+ *  - x86: time stamp counter (`rdtsc`)
+ *  - ARM64: virtual counter (`cntvct_el0`)
+ *  - Other CPUs: nanoseconds of raw clock
+ *
+ * @warning Ticks may be converted to time only if calibration().tsc is true.
+ */
+inline std::uint64_t ticks() noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return static_cast<std::uint64_t>(raw::now().time_since_epoch().count());
+#endif
+}
+
+/// Relation between ticks() and raw clock
+struct calibration_t
+{
+    /// Ticks advance at constant rate on every CPU, so fast clock uses them
+    bool tsc = false;
+    /// Nanoseconds per tick
+    double ns_per_tick = 1.0;
+    /// Ticks at the moment of calibration
+    std::uint64_t base_ticks = 0;
+    /// Raw time at the moment of calibration
+    raw::time_point base_time;
+};
+
+/**
+ * @brief Get relation between ticks() and raw clock
+ *
+ * @details
+ *  Calibration happens once, even if several threads call it at the same time.
+ *  Counter is used only if kernel::feature::invariant_tsc is available:
+ *  - x86: rate is measured against raw clock for 10ms
+ *  - ARM64: rate is read from `cntfrq_el0`
+ */
+const calibration_t & calibration() noexcept;
+
+/// Convert difference of ticks() to time
+inline std::chrono::nanoseconds to_duration(std::int64_t ticks) noexcept
+{
+    return std::chrono::nanoseconds(static_cast<std::int64_t>(static_cast<double>(ticks) * calibration().ns_per_tick));
+}
+
+/**
+ * @brief Monotonic clock, that reads hardware counter without syscall
+ *
+ * @details
+ *  Time is converted from ticks() with calibration() and matches raw clock.
+ *  Falls back to raw clock, if counter isn't invariant.
+ */
+struct fast
+{
+    using duration   = std::chrono::nanoseconds;
+    using rep        = duration::rep;
+    using period     = duration::period;
+    using time_point = std::chrono::time_point<fast>;
+
+    static constexpr bool is_steady = true;
+
+    /// Get current time
+    static time_point now() noexcept
+    {
+        const calibration_t &c = calibration();
+        if (!c.tsc) { return time_point(raw::now().time_since_epoch()); }
+
+        const auto elapsed = static_cast<double>(static_cast<std::int64_t>(ticks() - c.base_ticks)) * c.ns_per_tick;
+        return time_point(c.base_time.time_since_epoch() + duration(static_cast<rep>(elapsed)));
+    }
+};
+
+} // namespace os::clock
+
+#endif // LIBOS_HEADER_ONLY_CLOCK_HPP
+
+// -------------------------
+// |    IMPLEMENTATION     |
+// -------------------------
+
+#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined(LIBOS_CLOCK_CPP_IMPLEMENTED)
+#define LIBOS_CLOCK_CPP_IMPLEMENTED
+
+#include "macros.h"
+
+#if IS_OS_LINUX
+// src/linux/clock.cpp
+// =========================
+#include "clock.hpp"
+
+#include "macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <utility>
+
+#include <time.h>
+
+#include "kernel.hpp"
+
+namespace os::detail
+{
+
+#if defined(__x86_64__) || defined(__i386__)
+// Read ticks and raw time as close together as possible
+std::pair<std::uint64_t, clock::raw::time_point> sample_clock() noexcept
+{
+    std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+    std::pair<std::uint64_t, clock::raw::time_point> sample;
+    for (int i = 0; i < 8; ++i)
+    {
+        const std::uint64_t before = clock::ticks();
+        const auto now = clock::raw::now();
+        const std::uint64_t after = clock::ticks();
+        if (after - before < best)
+        {
+            best = after - before;
+            sample = { before + best / 2, now };
+        }
+    }
+    return sample;
+}
+#endif
+
+// Find relation between ticks and raw clock
+clock::calibration_t calibrate_clock() noexcept
+{
+    clock::calibration_t c;
+    if (!kernel::features().has(kernel::feature::invariant_tsc)) { return c; }
+
+#if defined(__x86_64__) || defined(__i386__)
+    const auto start = sample_clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const auto end = sample_clock();
+    if (end.first <= start.first) { return c; }
+
+    c.ns_per_tick = static_cast<double>((end.second - start.second).count()) /
+                    static_cast<double>(end.first - start.first);
+    c.base_ticks = end.first;
+    c.base_time = end.second;
+    c.tsc = true;
+#elif defined(__aarch64__)
+    std::uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    if (frequency == 0) { return c; }
+
+    c.ns_per_tick = 1e9 / static_cast<double>(frequency);
+    c.base_ticks = clock::ticks();
+    c.base_time = clock::raw::now();
+    c.tsc = true;
+#endif
+
+    return c;
+}
+
+} // namespace os::detail
+
+namespace os::clock
+{
+
+// Get current time of raw monotonic clock
+raw::time_point raw::now() noexcept
+{
+    timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return time_point(duration(static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec));
+}
+
+// Get relation between ticks and raw clock
+const calibration_t & calibration() noexcept
+{
+    // Init calibration only once.
+    static const calibration_t c = detail::calibrate_clock();
+    return c;
+}
+
+} // namespace os::clock
+// End of src/linux/clock.cpp
+// =========================
+
+#elif IS_OS_WINDOWS
+// src/windows/clock.cpp
+// =========================
+#include "clock.hpp"
+
+#include "macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <utility>
+
+#include <Windows.h>
+
+#include "kernel.hpp"
+
+namespace os::detail
+{
+#if defined(_M_X64) || defined(_M_IX86)
+    // Read ticks and raw time as close together as possible
+    std::pair<std::uint64_t, clock::raw::time_point> sample_clock() noexcept
+    {
+        std::uint64_t best = (std::numeric_limits<std::uint64_t>::max)();
+        std::pair<std::uint64_t, clock::raw::time_point> sample;
+        for (int i = 0; i < 8; ++i)
+        {
+            const std::uint64_t before = clock::ticks();
+            const auto now = clock::raw::now();
+            const std::uint64_t after = clock::ticks();
+            if (after - before < best)
+            {
+                best = after - before;
+                sample = { before + best / 2, now };
+            }
+        }
+        return sample;
+    }
+#endif
+
+    // Find relation between ticks and raw clock
+    clock::calibration_t calibrate_clock() noexcept
+    {
+        clock::calibration_t c;
+        if (!kernel::features().has(kernel::feature::invariant_tsc)) { return c; }
+
+#if defined(_M_X64) || defined(_M_IX86)
+        const auto start = sample_clock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        const auto end = sample_clock();
+        if (end.first <= start.first) { return c; }
+
+        c.ns_per_tick = static_cast<double>((end.second - start.second).count()) /
+                        static_cast<double>(end.first - start.first);
+        c.base_ticks = end.first;
+        c.base_time = end.second;
+        c.tsc = true;
+#endif
+
+        return c;
+    }
+}
+
+namespace os::clock
+{
+    // Get current time of raw monotonic clock
+    raw::time_point raw::now() noexcept
+    {
+        static const std::int64_t frequency = []
+        {
+            LARGE_INTEGER f;
+            QueryPerformanceFrequency(&f);
+            return f.QuadPart;
+        }();
+
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+
+        // Split to avoid overflow of counter * 10^9
+        const std::int64_t seconds = counter.QuadPart / frequency;
+        const std::int64_t rest = counter.QuadPart % frequency;
+        return time_point(duration(seconds * 1000000000 + rest * 1000000000 / frequency));
+    }
+
+    // Get relation between ticks and raw clock
+    const calibration_t & calibration() noexcept
+    {
+        // Init calibration only once.
+        static const calibration_t c = detail::calibrate_clock();
+        return c;
+    }
+}
+// End of src/windows/clock.cpp
+// =========================
+
+#elif IS_OS_MACOS
+// src/macos/clock.cpp
+// =========================
+#include "clock.hpp"
+
+#include "macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <utility>
+
+#include <mach/mach_time.h>
+
+#include "kernel.hpp"
+
+namespace os::detail
+{
+
+#if defined(__x86_64__)
+// Read ticks and raw time as close together as possible
+std::pair<std::uint64_t, clock::raw::time_point> sample_clock() noexcept
+{
+    std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+    std::pair<std::uint64_t, clock::raw::time_point> sample;
+    for (int i = 0; i < 8; ++i)
+    {
+        const std::uint64_t before = clock::ticks();
+        const auto now = clock::raw::now();
+        const std::uint64_t after = clock::ticks();
+        if (after - before < best)
+        {
+            best = after - before;
+            sample = { before + best / 2, now };
+        }
+    }
+    return sample;
+}
+#endif
+
+// Find relation between ticks and raw clock
+clock::calibration_t calibrate_clock() noexcept
+{
+    clock::calibration_t c;
+    if (!kernel::features().has(kernel::feature::invariant_tsc)) { return c; }
+
+#if defined(__x86_64__)
+    const auto start = sample_clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const auto end = sample_clock();
+    if (end.first <= start.first) { return c; }
+
+    c.ns_per_tick = static_cast<double>((end.second - start.second).count()) /
+                    static_cast<double>(end.first - start.first);
+    c.base_ticks = end.first;
+    c.base_time = end.second;
+    c.tsc = true;
+#elif defined(__aarch64__)
+    std::uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    if (frequency == 0) { return c; }
+
+    c.ns_per_tick = 1e9 / static_cast<double>(frequency);
+    c.base_ticks = clock::ticks();
+    c.base_time = clock::raw::now();
+    c.tsc = true;
+#endif
+
+    return c;
+}
+
+} // namespace os::detail
+
+namespace os::clock
+{
+
+// Get current time of raw monotonic clock
+raw::time_point raw::now() noexcept
+{
+    static const mach_timebase_info_data_t timebase = []
+    {
+        mach_timebase_info_data_t info;
+        mach_timebase_info(&info);
+        return info;
+    }();
+
+    const std::uint64_t ticks = mach_absolute_time();
+    return time_point(duration(static_cast<rep>(ticks * timebase.numer / timebase.denom)));
+}
+
+// Get relation between ticks and raw clock
+const calibration_t & calibration() noexcept
+{
+    // Init calibration only once.
+    static const calibration_t c = detail::calibrate_clock();
+    return c;
+}
+
+} // namespace os::clock
+// End of src/macos/clock.cpp
+// =========================
+
+#endif // IS_OS_*
+
+#endif // LIBOS_IMPLEMENTATION
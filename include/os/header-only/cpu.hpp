@@ -0,0 +1,559 @@
+// Functions to get CPU topology. Header-only
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/** @file os/header-only/cpu.hpp
+ *  Functions to get CPU topology. Header-only
+ */
+
+#ifndef LIBOS_HEADER_ONLY_CPU_HPP
+#define LIBOS_HEADER_ONLY_CPU_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace os::cpu
+{
+
+/// Indexes of logical CPUs, sorted in ascending order
+using cpu_set = std::vector<unsigned>;
+
+/// Cache of single level
+struct cache_t
+{
+    /// Size in bytes (0, if there is no such cache)
+    std::size_t size = 0;
+    /// Size of cache line in bytes
+    std::size_t line_size = 0;
+};
+
+/// NUMA node
+struct numa_node
+{
+    /// Number of node
+    unsigned id = 0;
+    /// Logical CPUs of node
+    cpu_set  cpus;
+};
+
+/// Full CPU topology
+struct info_t
+{
+    /// Number of logical CPUs (hardware threads)
+    unsigned logical_cores = 0;
+    /// Number of physical cores
+    unsigned physical_cores = 0;
+    /// Number of physical packages (sockets)
+    unsigned packages = 0;
+
+    /// Logical CPUs of every physical core (SMT siblings)
+    std::vector<cpu_set> siblings;
+
+    /// L1 data cache of single core
+    cache_t l1d;
+    /// L1 instruction cache of single core
+    cache_t l1i;
+    /// L2 cache
+    cache_t l2;
+    /// L3 cache
+    cache_t l3;
+
+    /// NUMA nodes. Single node with every CPU on systems without NUMA
+    std::vector<numa_node> numa_nodes;
+};
+
+/// Get number of logical CPUs (hardware threads)
+unsigned logical_cores();
+
+/// Get number of physical cores
+unsigned physical_cores();
+
+/// Get size of cache line in bytes
+std::size_t cache_line_size();
+
+/**
+ * @brief Get full CPU topology
+ *
+ * @details
+ *  Topology is read once, even if several threads call it at the same time:
+ *  - Linux: `/sys/devices/system/cpu` and `/sys/devices/system/node`
+ *  - Windows: `GetLogicalProcessorInformationEx`
+ *  - MacOS: `sysctl hw.*`. Siblings are assumed to be adjacent and there is a single NUMA node
+ *
+ * @note Topology of CPUs, that were offline at the first call, is missing.
+ *
+ * @return const info_t& Ref to CPU topology
+ */
+const info_t & info();
+
+} // namespace os::cpu
+
+#endif // LIBOS_HEADER_ONLY_CPU_HPP
+
+// -------------------------
+// |    IMPLEMENTATION     |
+// -------------------------
+
+#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined(LIBOS_CPU_CPP_IMPLEMENTED)
+#define LIBOS_CPU_CPP_IMPLEMENTED
+
+#include "macros.h"
+
+#if IS_OS_LINUX
+// src/linux/cpu.cpp
+// =========================
+#include "cpu.hpp"
+
+#include "macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <dirent.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Read first line of sysfs file ("" on error)
+std::string read_sysfs_line(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// Parse unsigned number at the start of text
+unsigned parse_sysfs_number(std::string_view &text)
+{
+    unsigned value = 0;
+    while (!text.empty() && '0' <= text.front() && text.front() <= '9')
+    {
+        value = value * 10 + static_cast<unsigned>(text.front() - '0');
+        text.remove_prefix(1);
+    }
+    return value;
+}
+
+// Parse list of CPUs in sysfs format (e.g. "0-3,8,10-11")
+cpu::cpu_set parse_cpu_list(std::string_view text)
+{
+    cpu::cpu_set cpus;
+    while (!text.empty() && '0' <= text.front() && text.front() <= '9')
+    {
+        const unsigned first = parse_sysfs_number(text);
+        unsigned last = first;
+        if (!text.empty() && text.front() == '-')
+        {
+            text.remove_prefix(1);
+            last = parse_sysfs_number(text);
+        }
+        for (unsigned c = first; c <= last; ++c) { cpus.push_back(c); }
+
+        if (text.empty() || text.front() != ',') { break; }
+        text.remove_prefix(1);
+    }
+    return cpus;
+}
+
+// Parse size of cache in sysfs format (e.g. "32K")
+std::size_t parse_cache_size(std::string_view text)
+{
+    std::size_t size = parse_sysfs_number(text);
+    if (!text.empty())
+    {
+        switch (text.front())
+        {
+        case 'K': size <<= 10; break;
+        case 'M': size <<= 20; break;
+        case 'G': size <<= 30; break;
+        }
+    }
+    return size;
+}
+
+// Read CPU topology
+cpu::info_t read_cpu_info()
+{
+    cpu::info_t i;
+
+    const std::string root = "/sys/devices/system/cpu/";
+
+    cpu::cpu_set online = parse_cpu_list(read_sysfs_line(root + "online"));
+    if (online.empty())
+    {
+        const long count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long c = 0; c < count; ++c) { online.push_back(static_cast<unsigned>(c)); }
+    }
+    i.logical_cores = static_cast<unsigned>(online.size());
+
+    std::vector<unsigned> packages;
+    for (unsigned c : online)
+    {
+        const std::string topology = root + "cpu" + std::to_string(c) + "/topology/";
+
+        cpu::cpu_set siblings = parse_cpu_list(read_sysfs_line(topology + "thread_siblings_list"));
+        if (siblings.empty()) { siblings.push_back(c); }
+        if (std::find(i.siblings.begin(), i.siblings.end(), siblings) == i.siblings.end())
+        {
+            i.siblings.push_back(std::move(siblings));
+        }
+
+        const std::string package = read_sysfs_line(topology + "physical_package_id");
+        std::string_view digits = package;
+        const unsigned id = parse_sysfs_number(digits);
+        if (std::find(packages.begin(), packages.end(), id) == packages.end()) { packages.push_back(id); }
+    }
+    i.physical_cores = static_cast<unsigned>(i.siblings.size());
+    i.packages = static_cast<unsigned>(packages.size());
+
+    // Caches of the first online CPU
+    if (!online.empty())
+    {
+        const std::string caches = root + "cpu" + std::to_string(online.front()) + "/cache/index";
+        for (unsigned index = 0; ; ++index)
+        {
+            const std::string cache = caches + std::to_string(index) + "/";
+            const std::string level = read_sysfs_line(cache + "level");
+            if (level.empty()) { break; }
+
+            const std::string type = read_sysfs_line(cache + "type");
+
+            cpu::cache_t *target = nullptr;
+            if (level == "1" && type == "Data") { target = &i.l1d; }
+            else if (level == "1" && type == "Instruction") { target = &i.l1i; }
+            else if (level == "2") { target = &i.l2; }
+            else if (level == "3") { target = &i.l3; }
+            if (!target) { continue; }
+
+            target->size = parse_cache_size(read_sysfs_line(cache + "size"));
+            const std::string line_size = read_sysfs_line(cache + "coherency_line_size");
+            std::string_view digits = line_size;
+            target->line_size = parse_sysfs_number(digits);
+        }
+    }
+
+    if (i.l1d.line_size == 0)
+    {
+        const long line_size = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+        i.l1d.line_size = line_size > 0 ? static_cast<std::size_t>(line_size) : 0;
+    }
+
+    // NUMA nodes are directories "node<N>"
+    if (DIR *nodes = opendir("/sys/devices/system/node"))
+    {
+        while (const dirent *entry = readdir(nodes))
+        {
+            std::string_view name = entry->d_name;
+            if (name.substr(0, 4) != "node" || name.size() == 4) { continue; }
+            name.remove_prefix(4);
+
+            cpu::numa_node node;
+            node.id = parse_sysfs_number(name);
+            if (!name.empty()) { continue; }
+
+            node.cpus = parse_cpu_list(
+                read_sysfs_line("/sys/devices/system/node/" + std::string(entry->d_name) + "/cpulist")
+            );
+            i.numa_nodes.push_back(std::move(node));
+        }
+        closedir(nodes);
+
+        std::sort(
+            i.numa_nodes.begin(), i.numa_nodes.end(),
+            [](const cpu::numa_node &lhs, const cpu::numa_node &rhs) { return lhs.id < rhs.id; }
+        );
+    }
+    if (i.numa_nodes.empty()) { i.numa_nodes.push_back(cpu::numa_node{0, online}); }
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os::cpu
+{
+
+// Number of logical CPUs
+unsigned logical_cores() { return info().logical_cores; }
+
+// Number of physical cores
+unsigned physical_cores() { return info().physical_cores; }
+
+// Size of cache line
+std::size_t cache_line_size() { return info().l1d.line_size; }
+
+// Get CPU topology
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_cpu_info();
+    return i;
+}
+
+} // namespace os::cpu
+// End of src/linux/cpu.cpp
+// =========================
+
+#elif IS_OS_WINDOWS
+// src/windows/cpu.cpp
+// =========================
+#include "cpu.hpp"
+
+#include "macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <algorithm>
+#include <memory>
+
+#include <Windows.h>
+
+namespace os::detail
+{
+    // Append logical CPUs of group affinity to set
+    void append_cpus(const GROUP_AFFINITY &affinity, cpu::cpu_set &cpus)
+    {
+        for (unsigned bit = 0; bit < 8 * sizeof(KAFFINITY); ++bit)
+        {
+            if (affinity.Mask & (KAFFINITY{ 1 } << bit))
+            {
+                cpus.push_back(affinity.Group * 64u + bit);
+            }
+        }
+    }
+
+    // Read CPU topology
+    cpu::info_t read_cpu_info()
+    {
+        cpu::info_t i;
+
+        DWORD length = 0;
+        GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+        if (length == 0) { return i; }
+
+        auto buffer = std::make_unique<BYTE[]>(length);
+        if (!GetLogicalProcessorInformationEx(
+                RelationAll,
+                reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.get()),
+                &length
+            ))
+        {
+            return i;
+        }
+
+        // Records have different sizes
+        for (DWORD offset = 0; offset < length;)
+        {
+            const auto &record = *reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.get() + offset);
+            offset += record.Size;
+
+            switch (record.Relationship)
+            {
+            case RelationProcessorCore:
+            {
+                cpu::cpu_set siblings;
+                for (WORD g = 0; g < record.Processor.GroupCount; ++g)
+                {
+                    append_cpus(record.Processor.GroupMask[g], siblings);
+                }
+                i.logical_cores += static_cast<unsigned>(siblings.size());
+                i.siblings.push_back(std::move(siblings));
+                break;
+            }
+            case RelationProcessorPackage:
+                ++i.packages;
+                break;
+            case RelationCache:
+            {
+                const CACHE_RELATIONSHIP &cache = record.Cache;
+
+                cpu::cache_t *target = nullptr;
+                if (cache.Level == 1 && cache.Type == CacheData) { target = &i.l1d; }
+                else if (cache.Level == 1 && cache.Type == CacheInstruction) { target = &i.l1i; }
+                else if (cache.Level == 2) { target = &i.l2; }
+                else if (cache.Level == 3) { target = &i.l3; }
+
+                // Every core has its own record of the same cache
+                if (target && target->size == 0)
+                {
+                    target->size = cache.CacheSize;
+                    target->line_size = cache.LineSize;
+                }
+                break;
+            }
+            case RelationNumaNode:
+            {
+                cpu::numa_node node;
+                node.id = record.NumaNode.NodeNumber;
+                append_cpus(record.NumaNode.GroupMask, node.cpus);
+                i.numa_nodes.push_back(std::move(node));
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        i.physical_cores = static_cast<unsigned>(i.siblings.size());
+
+        std::sort(i.siblings.begin(), i.siblings.end());
+        std::sort(
+            i.numa_nodes.begin(), i.numa_nodes.end(),
+            [](const cpu::numa_node &lhs, const cpu::numa_node &rhs) { return lhs.id < rhs.id; }
+        );
+        return i;
+    }
+}
+
+namespace os::cpu
+{
+
+    // Number of logical CPUs
+    unsigned logical_cores() { return info().logical_cores; }
+
+    // Number of physical cores
+    unsigned physical_cores() { return info().physical_cores; }
+
+    // Size of cache line
+    std::size_t cache_line_size() { return info().l1d.line_size; }
+
+    // Get CPU topology
+    const info_t& info()
+    {
+        // Init info only once.
+        static const info_t i = detail::read_cpu_info();
+        return i;
+    }
+
+}
+// End of src/windows/cpu.cpp
+// =========================
+
+#elif IS_OS_MACOS
+// src/macos/cpu.cpp
+// =========================
+#include "cpu.hpp"
+
+#include "macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+#include <sys/sysctl.h>
+#include <sys/types.h>
+
+namespace os::detail
+{
+
+// Read integer value of sysctl (0, if missing)
+std::uint64_t sysctl_number(const char *name)
+{
+    std::uint64_t value = 0;
+    std::size_t size = sizeof(value);
+    if (sysctlbyname(name, &value, &size, nullptr, 0) != 0) { return 0; }
+
+    // Some values are 32-bit
+    if (size == sizeof(std::uint32_t))
+    {
+        std::uint32_t narrow = 0;
+        std::memcpy(&narrow, &value, sizeof(narrow));
+        return narrow;
+    }
+    return value;
+}
+
+// Read CPU topology
+cpu::info_t read_cpu_info()
+{
+    cpu::info_t i;
+
+    i.logical_cores = static_cast<unsigned>(sysctl_number("hw.logicalcpu"));
+    i.physical_cores = static_cast<unsigned>(sysctl_number("hw.physicalcpu"));
+    i.packages = static_cast<unsigned>(sysctl_number("hw.packages"));
+    if (i.physical_cores == 0) { i.physical_cores = i.logical_cores; }
+
+    // There is no API for siblings. Threads of a core have adjacent numbers
+    const unsigned threads = i.physical_cores ? i.logical_cores / i.physical_cores : 1;
+    for (unsigned core = 0; core < i.physical_cores; ++core)
+    {
+        cpu::cpu_set siblings;
+        for (unsigned t = 0; t < threads; ++t) { siblings.push_back(core * threads + t); }
+        i.siblings.push_back(std::move(siblings));
+    }
+
+    const std::size_t line_size = sysctl_number("hw.cachelinesize");
+    i.l1d = cpu::cache_t{ sysctl_number("hw.l1dcachesize"), line_size };
+    i.l1i = cpu::cache_t{ sysctl_number("hw.l1icachesize"), line_size };
+    i.l2 = cpu::cache_t{ sysctl_number("hw.l2cachesize"), line_size };
+    i.l3 = cpu::cache_t{ sysctl_number("hw.l3cachesize"), line_size };
+    if (i.l3.size == 0) { i.l3.line_size = 0; }
+
+    // macOS has no NUMA
+    cpu::numa_node node;
+    for (unsigned c = 0; c < i.logical_cores; ++c) { node.cpus.push_back(c); }
+    i.numa_nodes.push_back(std::move(node));
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os::cpu
+{
+
+// Number of logical CPUs
+unsigned logical_cores() { return info().logical_cores; }
+
+// Number of physical cores
+unsigned physical_cores() { return info().physical_cores; }
+
+// Size of cache line
+std::size_t cache_line_size() { return info().l1d.line_size; }
+
+// Get CPU topology
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_cpu_info();
+    return i;
+}
+
+} // namespace os::cpu
+// End of src/macos/cpu.cpp
+// =========================
+
+#endif // IS_OS_*
+
+#endif // LIBOS_IMPLEMENTATION
@@ -26,136 +26,14 @@
  *  Functions to get OS info. Header-only
  */
 
-#pragma once
+#ifndef LIBOS_HEADER_ONLY_INFO_HPP
+#define LIBOS_HEADER_ONLY_INFO_HPP
 
-#include <string>
-
-// #include "os/macros.h"
-// =========================
-
-#if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
-/// Defined if OS is Unix-like
-#   define OS_UNIX 1
-/// Set to 1 if OS is Unix-like, 0 otherwise
-#   define IS_OS_UNIX 1
-#else
-#   define IS_OS_UNIX 0
-#endif
-
-#if defined(__linux__)
-/// Defined if OS is Linux
-#   define OS_LINUX 1
-/// Set to 1 if OS is Linux, 0 otherwise
-#	define IS_OS_LINUX 1
-#else
-#	define IS_OS_LINUX 0
-#endif
-
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-/// Defined if OS is Windows
-#   define OS_WINDOWS 1
-/// Set to 1 if OS is Windows, 0 otherwise
-#	define IS_OS_WINDOWS 1
-#else
-#	define IS_OS_WINDOWS 0
-#endif
-
-#if defined(__APPLE__) && defined(__MACH__)
-/// Defined if OS is MacOS
-#   define OS_MACOS 1
-/// Set to 1 if OS is MacOS, 0 otherwise
-#   define IS_OS_MACOS 1
-#else
-#   define IS_OS_MACOS 0
-#endif
-// End of   "os/macros.h"
-// =========================
-
-// #include "os/version.hpp"
-// =========================
 #include <string>
 #include <string_view>
 
-/// Struct to represent semantic versioning
-struct version
-{
-    /// Major version
-    unsigned major = 0;
-    /// Minor version
-    unsigned minor = 0;
-    /// Patch or build version
-    unsigned patch = 0;
-
-    /// Construct version from major, minor and patch numbers
-    constexpr version(unsigned major = 0, unsigned minor = 0, unsigned patch = 0) noexcept
-        : major(major), minor(minor), patch(patch) {}
-
-    /**
-     * @brief Construct version from string
-     *
-     * @param str String with format "major.minor.patch"
-     *
-     * @note
-     *  If string format is wrong, no exception is thrown.
-     *  All successfully read values will be saved.
-     */
-    explicit constexpr version(std::string_view str) noexcept
-    {
-        auto it = str.begin();
-        unsigned* fields[3] = { &major, &minor, &patch };
-        for (auto field : fields)
-        {
-            while (it != str.end() && '0' <= *it && *it <= '9')
-            {
-                *field *= 10;
-                *field += *it - '0';
-                it++;
-            }
-
-            // EOF or wrong delim
-            if (it == str.end() || *it != '.') { break; }
-
-            it++; // Skip delim
-        }
-    }
-
-    /// Check version for equality
-    constexpr bool operator==(const version &rhs) const noexcept
-    {
-        return (major == rhs.major) && (minor == rhs.minor) && (patch == rhs.patch);
-    }
-    /// Check if version is less
-    constexpr bool operator< (const version &rhs) const noexcept
-    {
-        if (major < rhs.major) { return true; }
-        if (minor < rhs.minor) { return true; }
-        if (patch < rhs.patch) { return true; }
-        return false;
-    }
-    /// Check if version is less or equal
-    constexpr bool operator<=(const version &rhs) const noexcept
-    {
-        return (*this < rhs) || (*this == rhs);
-    }
-    /// Check if version is greater
-    constexpr bool operator> (const version &rhs) const noexcept { return !(*this <= rhs); }
-    /// Check if version is greater or equal
-    constexpr bool operator>=(const version &rhs) const noexcept { return !(*this < rhs); }
-    /// Check if version is not equal
-    constexpr bool operator!=(const version &rhs) const noexcept { return !(*this == rhs); }
-
-
-    /// Get version string in format "major.minor.patch"
-    std::string str() const
-    {
-        return std::to_string(major) + "." +
-               std::to_string(minor) + "." +
-               std::to_string(patch);
-    }
-};
-// End of   "os/version.hpp"
-// =========================
-
+#include "macros.h"
+#include "version.hpp"
 
 // Protect from macro collision in std=gnu++17 extension
 #undef linux
@@ -193,14 +71,14 @@ constexpr type_t type() noexcept
  * @returns
  *  - Linux:
  *      - Distributive's name (e.g. `"Ubuntu"`)
- *      - `"Linux"`, if `/etc/os-release` not found
+ *      - `"Linux"`, if neither `/etc/os-release` nor `/usr/lib/os-release` has it
  *  - MacOS: `"macOS"`
  *  - Windows: `"Windows"`
  */
-std::string name();
+std::string_view name();
 
 /// Get OS name with version
-std::string pretty_name();
+std::string_view pretty_name();
 
 /**
  * @brief Get OS codename
@@ -210,13 +88,13 @@ std::string pretty_name();
  *  - MacOS: codename
  *  - Windows: `""`
  */
-std::string codename();
+std::string_view codename();
 
 /// Get OS major, minor and patch version as integers
 ::version version();
 
 /// Get OS version as string
-std::string version_string();
+std::string_view version_string();
 
 /// Full OS info
 struct info_t
@@ -239,7 +117,13 @@ struct info_t
  * @brief Get full OS info
  * @details
  *  Obtaining OS info is very expensive.
- *  Hence, it's statically allocated and read exactly once.
+ *  Hence, it's statically allocated and read exactly once,
+ *  even if several threads call it at the same time.
+ *  Other cached getters (e.g. os::kernel::info(), os::cpu::info(), os::clock::calibration())
+ *  are initialized the same way.
+ *
+ *  String accessors return views into this info, so they don't allocate.
+ *  Views stay valid until the end of program.
  *
  * @return const info_t& Ref to OS info
  */
@@ -247,102 +131,196 @@ const info_t & info();
 
 } // namespace os
 
+#endif // LIBOS_HEADER_ONLY_INFO_HPP
+
 // -------------------------
-// |        SOURCES        |
+// |    IMPLEMENTATION     |
 // -------------------------
 
+#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined(LIBOS_INFO_CPP_IMPLEMENTED)
+#define LIBOS_INFO_CPP_IMPLEMENTED
+
+#include "macros.h"
+
 #if IS_OS_LINUX
 // src/linux/info.cpp
 // =========================
+#include "info.hpp"
 
+#include "macros.h"
 #if !IS_OS_LINUX
     #error "This code is for Linux only!"
 #endif
 
-#include <fstream>
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <string_view>
 
+#include <fcntl.h>
 #include <sys/utsname.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Read file with a single read() into buffer. Returns number of bytes read
+std::size_t read_file(const char *path, char *buffer, std::size_t size)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { return 0; }
+
+    ssize_t count = 0;
+    while ((count = ::read(fd, buffer, size)) < 0 && errno == EINTR) {}
+    close(fd);
+
+    return count > 0 ? static_cast<std::size_t>(count) : 0;
+}
+
+// Decode shell-style value of os-release with quotes and backslash escapes
+void unquote(std::string_view raw, std::string &out)
+{
+    // Most values need no decoding
+    if (raw.find_first_of("\"'\\") == std::string_view::npos)
+    {
+        out.assign(raw);
+        return;
+    }
+
+    out.clear();
+    out.reserve(raw.size());
+
+    char quote = 0;
+    for (std::size_t k = 0; k < raw.size(); ++k)
+    {
+        const char c = raw[k];
+
+        // Everything is literal inside single quotes
+        if (quote == '\'')
+        {
+            if (c == '\'') { quote = 0; } else { out += c; }
+            continue;
+        }
+
+        if (c == '\\' && k + 1 < raw.size())
+        {
+            const char next = raw[k + 1];
+            // Inside double quotes backslash escapes only $ ` " and itself
+            if (quote == '"' && next != '$' && next != '`' && next != '"' && next != '\\')
+            {
+                out += c;
+                continue;
+            }
+            out += next;
+            ++k;
+            continue;
+        }
+
+        if (quote == '"')
+        {
+            if (c == '"') { quote = 0; } else { out += c; }
+        }
+        else if (c == '"' || c == '\'') { quote = c; }
+        else { out += c; }
+    }
+}
+
+// Parse os-release assignments, that are needed for info
+void parse_os_release(std::string_view text, os::info_t &i)
+{
+    std::string version_id;
+
+    while (!text.empty())
+    {
+        const std::size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+        // Skip indentation, trailing whitespace, empty lines and comments
+        const std::size_t first = line.find_first_not_of(" \t");
+        if (first == std::string_view::npos || line[first] == '#') { continue; }
+        line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+
+        const std::size_t eq = line.find('=');
+        if (eq == std::string_view::npos) { continue; }
+
+        const std::string_view key = line.substr(0, eq);
+        const std::string_view value = line.substr(eq + 1);
+
+        if (key == "NAME") { unquote(value, i.name); }
+        else if (key == "VERSION") { unquote(value, i.version_string); }
+        else if (key == "PRETTY_NAME") { unquote(value, i.pretty_name); }
+        else if (key == "VERSION_ID") { unquote(value, version_id); }
+        else if (key == "VERSION_CODENAME") { unquote(value, i.codename); }
+    }
+
+    i.version = ::version{version_id};
+
+    // Defaults of os-release specification
+    if (i.name.empty()) { i.name = "Linux"; }
+    if (i.pretty_name.empty()) { i.pretty_name = "Linux"; }
+}
+
+// Read OS info
+os::info_t read_info()
+{
+    os::info_t i;
+
+    i.type = type();
+
+    // os-release is small, so it fits into stack buffer and is read at once
+    char buffer[8192];
+    std::size_t size = read_file("/etc/os-release", buffer, sizeof(buffer));
+    if (size == 0) { size = read_file("/usr/lib/os-release", buffer, sizeof(buffer)); }
+
+    if (size > 0)
+    {
+        std::string_view text(buffer, size);
+        // Drop incomplete line of a file, that doesn't fit
+        if (size == sizeof(buffer)) { text = text.substr(0, text.rfind('\n') + 1); }
+
+        parse_os_release(text, i);
+    }
+    else
+    {
+        utsname utsname; uname(&utsname);
+        i.name = "Linux";
+        i.version = ::version{utsname.release};
+        i.version_string = utsname.release;
+
+        i.codename = "";
+        i.pretty_name = i.name + " " + i.version_string;
+    }
+
+    return i;
+}
+
+} // namespace os::detail
+
 namespace os
 {
 
 // Name of OS without version
-std::string name() { return info().name; }
+std::string_view name() { return info().name; }
 
 // Name of OS + version
-std::string pretty_name() { return info().pretty_name; }
+std::string_view pretty_name() { return info().pretty_name; }
 
 // Codename of OS (if present)
-std::string codename() { return info().codename; }
+std::string_view codename() { return info().codename; }
 
 // Major, minor and patch of OS
 ::version version() { return info().version; }
 
 // Version [+ some additional data]
-std::string version_string() { return info().version_string; }
+std::string_view version_string() { return info().version_string; }
 
 // Get whole OS info
 const info_t & info()
 {
-    static info_t i;
-
     // Reading from file is expensive.
     // Init info only once.
-    if (static bool init = true; init)
-    {
-        i.type = type();
-
-        std::ifstream os_release("/etc/os-release");
-        if (os_release)
-        {
-            std::string key, value;
-            auto get_entry = [&os_release, &key, &value]() -> bool
-            {
-                std::getline(os_release, key, '=');
-                std::getline(os_release, value, '\n');
-                return os_release.good();
-            };
-            while (get_entry())
-            {
-                if (key == "NAME")
-                {
-                    // Remove ""
-                    i.name = value.substr(1, value.size() - 2);
-                }
-                else if (key == "VERSION")
-                {
-                    // Remove ""
-                    i.version_string = value.substr(1, value.size() - 2);
-                }
-                else if (key == "PRETTY_NAME")
-                {
-                    // Remove ""
-                    i.pretty_name = value.substr(1, value.size() - 2);
-                }
-                else if (key == "VERSION_ID")
-                {
-                    // Remove ""
-                    i.version = ::version{value.substr(1, value.size() - 2)};
-                }
-                else if (key == "VERSION_CODENAME")
-                {
-                    i.codename = value;
-                }
-            }
-        }
-        else
-        {
-            utsname utsname; uname(&utsname);
-            i.name = "Linux";
-            i.version = ::version{utsname.release};
-            i.version_string = utsname.release;
-
-            i.codename = "";
-            i.pretty_name = i.name + " " + i.version_string;
-        }
-
-        init = false;
-    }
-
+    static const info_t i = detail::read_info();
     return i;
 }
 
@@ -350,104 +328,239 @@ const info_t & info()
 // End of src/linux/info.cpp
 // =========================
 
-#endif // IS_OS_LINUX
-
-#if IS_OS_WINDOWS
+#elif IS_OS_WINDOWS
 // src/windows/info.cpp
 // =========================
+#include "info.hpp"
 
+#include "macros.h"
 #if !IS_OS_WINDOWS
 	#error "This code is for Windows only!"
 #endif
 
+namespace os::detail
+{
+
+// Read OS info
+os::info_t read_info()
+{
+    os::info_t i;
+
+    i.type = type();
+    i.name = name();
+    i.pretty_name = "Windows"; // Will be updated
+    i.codename = codename();
+
+    // KUSER_SHARED_DATA address.
+    // Offsets are taken from http://terminus.rewolf.pl/terminus/structures/ntdll/_KUSER_SHARED_DATA_x64.html
+    constexpr uintptr_t data_adress = uintptr_t{ 0x7ffe0000 };
+    const uint32_t major = *reinterpret_cast<const uint32_t*>(data_adress + 0x26c);
+    const uint32_t minor = *reinterpret_cast<const uint32_t*>(data_adress + 0x270);
+    const uint32_t patch = *reinterpret_cast<const uint32_t*>(data_adress + 0x260);
+
+    i.version = ::version{ major, minor, patch };
+    i.version_string = i.version.str();
+
+    i.pretty_name += " ";
+    if (i.version >= ::version{ 10, 0 })
+    {
+        i.pretty_name += std::to_string(i.version.major);
+    }
+    else if (i.version >= ::version{ 6, 3 })
+    {
+        i.pretty_name += "8.1";
+    }
+    else if (i.version >= ::version{ 6, 2 })
+    {
+        i.pretty_name += "8";
+    }
+    else if (i.version >= ::version{ 6, 1 })
+    {
+        i.pretty_name += "7";
+    }
+    else if (i.version >= ::version{ 6, 0 })
+    {
+        i.pretty_name += "Vista";
+    }
+    else if (i.version >= ::version{ 5, 2 })
+    {
+        i.pretty_name += "XP 64-Bit Edition";
+    }
+    else if (i.version >= ::version{ 5, 1 })
+    {
+        i.pretty_name += "XP";
+    }
+    else if (i.version >= ::version{ 5, 0 })
+    {
+        i.pretty_name += "2000";
+    }
+    else
+    {
+        i.pretty_name.pop_back(); // remove space
+    }
+
+    return i;
+}
+
+} // namespace os::detail
+
 namespace os
 {
 
 // Name of OS without version
-std::string name() { return "Windows"; }
+std::string_view name() { return "Windows"; }
 
 // Name of OS + version
-std::string pretty_name() { return info().pretty_name; }
+std::string_view pretty_name() { return info().pretty_name; }
 
 // Codename of OS (if present)
-std::string codename() { return ""; }
+std::string_view codename() { return ""; }
 
 // Major, minor and patch of OS
 ::version version() { return info().version; }
 
 // Version [+ some additional data]
-std::string version_string() { return info().version_string; }
+std::string_view version_string() { return info().version_string; }
 
 // Get whole OS info
 const info_t& info()
 {
-    static info_t i;
-
     // Accessing WMI is expensive.
     // Init info only once.
-    if (static bool init = true; init)
+    static const info_t i = detail::read_info();
+    return i;
+}
+
+} // namespace os
+// End of src/windows/info.cpp
+// =========================
+
+#elif IS_OS_MACOS
+// src/macos/info.cpp
+// =========================
+#include "info.hpp"
+
+#include "macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <CoreFoundation/CoreFoundation.h>
+
+namespace os::detail
+{
+
+// Read OS info
+os::info_t read_info()
+{
+    os::info_t i;
+
+    i.type = type();
+    i.name = name();
+
+    CFURLRef fileURL = CFURLCreateWithFileSystemPath(
+        kCFAllocatorDefault, 
+        CFSTR("/System/Library/CoreServices/SystemVersion.plist"),
+        kCFURLPOSIXPathStyle,
+        false // not a directory
+    );
+    CFReadStreamRef stream = CFReadStreamCreateWithFile(kCFAllocatorDefault, fileURL);
+    CFRelease(fileURL);
+    if (CFReadStreamOpen(stream))
     {
-        i.type = type();
-        i.name = name();
-        i.pretty_name = "Windows"; // Will be updated
-        i.codename = codename();
-
-        // KUSER_SHARED_DATA address.
-        // Offsets are taken from http://terminus.rewolf.pl/terminus/structures/ntdll/_KUSER_SHARED_DATA_x64.html
-        constexpr uintptr_t data_adress = uintptr_t{ 0x7ffe0000 };
-        const uint32_t major = *reinterpret_cast<const uint32_t*>(data_adress + 0x26c);
-        const uint32_t minor = *reinterpret_cast<const uint32_t*>(data_adress + 0x270);
-        const uint32_t patch = *reinterpret_cast<const uint32_t*>(data_adress + 0x260);
-
-        i.version = ::version{ major, minor, patch };
-        i.version_string = i.version.str();
-
-        i.pretty_name += " ";
-        if (i.version >= ::version{ 10, 0 })
-        {
-            i.pretty_name += std::to_string(i.version.major);
-        }
-        else if (i.version >= ::version{ 6, 3 })
-        {
-            i.pretty_name += "8.1";
-        }
-        else if (i.version >= ::version{ 6, 2 })
-        {
-            i.pretty_name += "8";
-        }
-        else if (i.version >= ::version{ 6, 1 })
-        {
-            i.pretty_name += "7";
-        }
-        else if (i.version >= ::version{ 6, 0 })
-        {
-            i.pretty_name += "Vista";
-        }
-        else if (i.version >= ::version{ 5, 2 })
-        {
-            i.pretty_name += "XP 64-Bit Edition";
-        }
-        else if (i.version >= ::version{ 5, 1 })
-        {
-            i.pretty_name += "XP";
-        }
-        else if (i.version >= ::version{ 5, 0 })
+        constexpr CFIndex bufferLength = 1024;
+        UInt8 buffer[bufferLength] = {0};
+
+        CFIndex bytesNumber = CFReadStreamRead(stream, buffer, bufferLength);
+        CFReadStreamClose(stream);
+
+        if (bytesNumber > 0)
         {
-            i.pretty_name += "2000";
+            CFDataRef data = CFDataCreate(kCFAllocatorDefault, buffer, bytesNumber);
+            CFPropertyListRef plist = CFPropertyListCreateWithData(
+                kCFAllocatorDefault, 
+                data, 
+                kCFPropertyListImmutable, 
+                nullptr, 
+                nullptr
+            );
+            CFRelease(data);
+
+            CFDictionaryRef dict = static_cast<CFDictionaryRef>(plist);
+            CFStringRef productVersion = static_cast<CFStringRef>(CFDictionaryGetValue(dict, CFSTR("ProductVersion")));
+            CFStringRef productBuildVersion = static_cast<CFStringRef>(CFDictionaryGetValue(dict, CFSTR("ProductBuildVersion")));
+
+            std::string version(CFStringGetLength(productVersion), 'x');
+            CFStringGetCString(productVersion, version.data(), version.size() + 1, kCFStringEncodingUTF8);
+
+            std::string build(CFStringGetLength(productBuildVersion), 'x');
+            CFStringGetCString(productBuildVersion, build.data(), build.size() + 1, kCFStringEncodingUTF8);
+
+            CFRelease(plist);
+            
+            i.version = ::version(version);
+            i.version_string = version + " (" + build + ")";
         }
-        else
+    }
+    CFRelease(stream);
+
+    if (i.version.major == 12)
+    {
+        i.codename = "Monterey";
+    }
+    else if (i.version.major == 11)
+    {
+        i.codename = "Big Sur";
+    }
+    else if (i.version.major == 10)
+    {
+        switch (i.version.minor)
         {
-            i.pretty_name.pop_back(); // remove space
+        case 12: i.codename = "Sierra";      break;
+        case 13: i.codename = "High Sierra"; break;
+        case 14: i.codename = "Mojave";      break;
+        case 15: i.codename = "Catalina";    break;
         }
-
-        init = false;
     }
 
+    i.pretty_name = i.name + " " + i.codename;
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os
+{
+
+// Name of OS without version
+std::string_view name() { return "macOS"; }
+
+// Name of OS + version
+std::string_view pretty_name() { return info().pretty_name; }
+
+// Codename of OS (if present)
+std::string_view codename() { return info().codename; }
+
+// Major, minor and patch of OS
+::version version() { return info().version; }
+
+// Version [+ some additional data]
+std::string_view version_string() { return info().version_string; }
+
+// Get whole OS info
+const info_t & info()
+{
+    // Reading from file is expensive.
+    // Init info only once.
+    static const info_t i = detail::read_info();
     return i;
 }
 
 } // namespace os
-// End of src/windows/info.cpp
+// End of src/macos/info.cpp
 // =========================
 
-#endif // IS_OS_WINDOWS
+#endif // IS_OS_*
+
+#endif // LIBOS_IMPLEMENTATION
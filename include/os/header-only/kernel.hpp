@@ -26,95 +26,14 @@
  *  Functions to get OS Kernel info. Header-only
  */
 
-#pragma once
+#ifndef LIBOS_HEADER_ONLY_KERNEL_HPP
+#define LIBOS_HEADER_ONLY_KERNEL_HPP
 
-#include <string>
-
-// #include "os/version.hpp"
-// =========================
+#include <cstdint>
 #include <string>
 #include <string_view>
 
-/// Struct to represent semantic versioning
-struct version
-{
-    /// Major version
-    unsigned major = 0;
-    /// Minor version
-    unsigned minor = 0;
-    /// Patch or build version
-    unsigned patch = 0;
-
-    /// Construct version from major, minor and patch numbers
-    constexpr version(unsigned major = 0, unsigned minor = 0, unsigned patch = 0) noexcept
-        : major(major), minor(minor), patch(patch) {}
-
-    /**
-     * @brief Construct version from string
-     *
-     * @param str String with format "major.minor.patch"
-     *
-     * @note
-     *  If string format is wrong, no exception is thrown.
-     *  All successfully read values will be saved.
-     */
-    explicit constexpr version(std::string_view str) noexcept
-    {
-        auto it = str.begin();
-        unsigned* fields[3] = { &major, &minor, &patch };
-        for (auto field : fields)
-        {
-            while (it != str.end() && '0' <= *it && *it <= '9')
-            {
-                *field *= 10;
-                *field += *it - '0';
-                it++;
-            }
-
-            // EOF or wrong delim
-            if (it == str.end() || *it != '.') { break; }
-
-            it++; // Skip delim
-        }
-    }
-
-    /// Check version for equality
-    constexpr bool operator==(const version &rhs) const noexcept
-    {
-        return (major == rhs.major) && (minor == rhs.minor) && (patch == rhs.patch);
-    }
-    /// Check if version is less
-    constexpr bool operator< (const version &rhs) const noexcept
-    {
-        if (major < rhs.major) { return true; }
-        if (minor < rhs.minor) { return true; }
-        if (patch < rhs.patch) { return true; }
-        return false;
-    }
-    /// Check if version is less or equal
-    constexpr bool operator<=(const version &rhs) const noexcept
-    {
-        return (*this < rhs) || (*this == rhs);
-    }
-    /// Check if version is greater
-    constexpr bool operator> (const version &rhs) const noexcept { return !(*this <= rhs); }
-    /// Check if version is greater or equal
-    constexpr bool operator>=(const version &rhs) const noexcept { return !(*this < rhs); }
-    /// Check if version is not equal
-    constexpr bool operator!=(const version &rhs) const noexcept { return !(*this == rhs); }
-
-
-    /// Get version string in format "major.minor.patch"
-    std::string str() const
-    {
-        return std::to_string(major) + "." +
-               std::to_string(minor) + "." +
-               std::to_string(patch);
-    }
-};
-// End of   "os/version.hpp"
-// =========================
-
+#include "version.hpp"
 
 namespace os::kernel
 {
@@ -127,13 +46,13 @@ namespace os::kernel
  *  - MacOS: `"Darwin"`
  *  - Windows: `"Windows NT"`
  */
-std::string name();
+std::string_view name();
 
 /// Get OS Kernel major, minor and patch version as integers
 ::version version();
 
 /// Get OS Kernel version as string
-std::string version_string();
+std::string_view version_string();
 
 /// Full OS Kernel info
 struct info_t
@@ -150,111 +69,455 @@ struct info_t
  * @brief Get full OS Kernel info
  * @details
  *  Obtaining OS Kernel info is very expensive.
- *  Hence, it's statically allocated and read exactly once.
+ *  Hence, it's statically allocated and read exactly once,
+ *  even if several threads call it at the same time.
+ *
+ *  String accessors return views into this info, so they don't allocate.
+ *  Views stay valid until the end of program.
  *
  * @return const info_t& Ref to OS Kernel info
  */
 const info_t & info();
 
+/// Capability of OS Kernel, that can't be told reliably by version
+enum class feature : unsigned
+{
+    /// Linux: `io_uring_setup()` works (it may be disabled by sysctl or seccomp)
+    io_uring,
+    /// Linux: `EPOLLEXCLUSIVE` flag of `epoll_ctl()`
+    epoll_exclusive,
+    /// Linux: `futex_waitv()`
+    futex_waitv,
+    /// Linux: `memfd_create()`
+    memfd_create,
+    /// Linux: `pidfd_open()`
+    pidfd_open,
+    /// Windows: IoRing API (`CreateIoRing()`)
+    io_ring,
+    /// Windows: `WaitOnAddress()`. MacOS: `os_sync_wait_on_address()`
+    wait_on_address,
+    /// CPU counter ticks at constant rate, so it may be used as clock.
+    /// x86: `cpuid` reports invariant TSC (or Linux uses TSC as clocksource). ARM64: always
+    invariant_tsc
+};
+
+/// Set of OS Kernel features
+struct features_t
+{
+    /// Bit `1 << feature` is set for every available feature
+    std::uint64_t bits = 0;
+
+    /// Get bit of feature
+    static constexpr std::uint64_t bit(feature f) noexcept
+    {
+        return std::uint64_t{1} << static_cast<unsigned>(f);
+    }
+
+    /// Check if feature is available
+    constexpr bool has(feature f) const noexcept { return (bits & bit(f)) != 0; }
+
+    /// Mark feature as available
+    constexpr void add(feature f) noexcept { bits |= bit(f); }
+};
+
+/**
+ * @brief Get available OS Kernel features
+ *
+ * @details
+ *  Every feature is probed once with actual cheap call, not guessed by version,
+ *  even if several threads call it at the same time.
+ *  Then check is a single bit test:
+ *  @code{.cpp}
+ *  if (os::kernel::features().has(os::kernel::feature::io_uring)) { ... }
+ *  @endcode
+ *
+ *  Features of other OS are never available.
+ *
+ * @return const features_t& Ref to set of available features
+ */
+const features_t & features();
+
 } // namespace os::kernel
 
+#endif // LIBOS_HEADER_ONLY_KERNEL_HPP
+
 // -------------------------
-// |        SOURCES        |
+// |    IMPLEMENTATION     |
 // -------------------------
 
+#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined(LIBOS_KERNEL_CPP_IMPLEMENTED)
+#define LIBOS_KERNEL_CPP_IMPLEMENTED
+
+#include "macros.h"
+
 #if IS_OS_LINUX
 // src/linux/kernel.cpp
 // =========================
+#include "kernel.hpp"
 
+#include "macros.h"
 #if !IS_OS_LINUX
     #error "This code is for Linux only!"
 #endif
 
+#include <cerrno>
+#include <ctime>
+#include <fstream>
+#include <string>
+
+#include <linux/memfd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <sys/utsname.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+    #include <linux/io_uring.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <cpuid.h>
+#endif
+
+namespace os::detail
+{
+
+// Read OS kernel info
+os::kernel::info_t read_kernel_info()
+{
+    os::kernel::info_t i;
+
+    utsname utsname; uname(&utsname);
+    i.name = os::kernel::name();
+    i.version = ::version{utsname.release};
+    i.version_string = utsname.release;
+
+    return i;
+}
+
+// Check if syscall returned file descriptor and close it
+bool returned_fd(long fd)
+{
+    if (fd < 0) { return false; }
+    close(static_cast<int>(fd));
+    return true;
+}
+
+// Probe OS kernel features with actual calls
+os::kernel::features_t probe_kernel_features()
+{
+    using os::kernel::feature;
+
+    os::kernel::features_t f;
+
+#if defined(SYS_io_uring_setup) && __has_include(<linux/io_uring.h>)
+    io_uring_params params = {};
+    if (returned_fd(syscall(SYS_io_uring_setup, 1, &params))) { f.add(feature::io_uring); }
+#endif
+
+    // Kernels, that know EPOLLEXCLUSIVE, refuse it in EPOLL_CTL_MOD.
+    // Older ones silently ignore it
+    const int epoll = epoll_create1(EPOLL_CLOEXEC);
+    const int event = eventfd(0, EFD_CLOEXEC);
+    if (epoll >= 0 && event >= 0)
+    {
+        epoll_event e = {};
+        e.events = EPOLLIN;
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, event, &e) == 0)
+        {
+            e.events = EPOLLIN | EPOLLEXCLUSIVE;
+            if (epoll_ctl(epoll, EPOLL_CTL_MOD, event, &e) != 0 && errno == EINVAL) { f.add(feature::epoll_exclusive); }
+        }
+    }
+    if (event >= 0) { close(event); }
+    if (epoll >= 0) { close(epoll); }
+
+#if defined(SYS_futex_waitv)
+    // Empty list of futexes is invalid, missing syscall gives ENOSYS
+    if (syscall(SYS_futex_waitv, nullptr, 0, 0, nullptr, CLOCK_MONOTONIC) != 0 && errno == EINVAL)
+    {
+        f.add(feature::futex_waitv);
+    }
+#endif
+
+#if defined(SYS_memfd_create)
+    if (returned_fd(syscall(SYS_memfd_create, "libos", MFD_CLOEXEC))) { f.add(feature::memfd_create); }
+#endif
+
+#if defined(SYS_pidfd_open)
+    if (returned_fd(syscall(SYS_pidfd_open, getpid(), 0))) { f.add(feature::pidfd_open); }
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+    // Virtual machines often hide CPUID bit, while kernel has checked TSC itself
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    const bool invariant = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+
+    std::ifstream clocksource("/sys/devices/system/clocksource/clocksource0/current_clocksource");
+    std::string source;
+    clocksource >> source;
+
+    if (invariant || source == "tsc") { f.add(feature::invariant_tsc); }
+#elif defined(__aarch64__)
+    // Generic timer has fixed frequency
+    f.add(feature::invariant_tsc);
+#endif
+
+    return f;
+}
+
+} // namespace os::detail
 
 namespace os::kernel
 {
 
 // Get name of OS kernel
-std::string name() { return "Linux"; }
+std::string_view name() { return "Linux"; }
 
 // Get major, minor and patch of OS kernel
 ::version version() { return info().version; }
 
 // Get version [+ additional data] of OS kernel
-std::string version_string() { return info().version_string; }
+std::string_view version_string() { return info().version_string; }
 
 // Get OS kernel info
 const info_t & info()
 {
-    static info_t i;
-
-    if (static bool init = true; init)
-    {
-        utsname utsname; uname(&utsname);
-        i.name = os::kernel::name();
-        i.version = ::version{utsname.release};
-        i.version_string = utsname.release;
-
-        init = false;
-    }
-
+    // Init info only once.
+    static const info_t i = detail::read_kernel_info();
     return i;
 }
 
+// Get available OS kernel features
+const features_t & features()
+{
+    // Init features only once.
+    static const features_t f = detail::probe_kernel_features();
+    return f;
+}
+
 } // namespace os::kernel
 // End of src/linux/kernel.cpp
 // =========================
 
-#endif // IS_OS_LINUX
-
-#if IS_OS_WINDOWS
+#elif IS_OS_WINDOWS
 // src/windows/kernel.cpp
 // =========================
+#include "kernel.hpp"
 
+#include "macros.h"
 #if !IS_OS_WINDOWS
     #error "This code is for Windows only!"
 #endif
 
+#include <Windows.h>
+
+#if defined(_M_X64) || defined(_M_IX86)
+    #include <intrin.h>
+#endif
+
+namespace os::detail
+{
+
+// Read OS kernel info
+os::kernel::info_t read_kernel_info()
+{
+    os::kernel::info_t i;
+
+    i.name = name();
+
+    // KUSER_SHARED_DATA address.
+    // Offsets are taken from http://terminus.rewolf.pl/terminus/structures/ntdll/_KUSER_SHARED_DATA_x64.html
+    constexpr uintptr_t data_adress = uintptr_t{ 0x7ffe0000 };
+    const uint32_t major = *reinterpret_cast<const uint32_t*>(data_adress + 0x26c);
+    const uint32_t minor = *reinterpret_cast<const uint32_t*>(data_adress + 0x270);
+    const uint32_t patch = *reinterpret_cast<const uint32_t*>(data_adress + 0x260);
+
+    i.version = ::version{ major, minor, patch };
+    i.version_string = i.version.str();
+
+    return i;
+}
+
+// Probe OS kernel features with actual calls
+os::kernel::features_t probe_kernel_features()
+{
+    using os::kernel::feature;
+
+    os::kernel::features_t f;
+
+#if defined(_M_X64) || defined(_M_IX86)
+    int registers[4] = {};
+    __cpuid(registers, 0x80000000);
+    if (static_cast<unsigned>(registers[0]) >= 0x80000007u)
+    {
+        __cpuid(registers, 0x80000007);
+        if (registers[3] & (1 << 8)) { f.add(feature::invariant_tsc); }
+    }
+#elif defined(_M_ARM64)
+    // Generic timer has fixed frequency
+    f.add(feature::invariant_tsc);
+#endif
+
+    // Functions are looked up at runtime to load on older Windows
+    const HMODULE kernelbase = GetModuleHandleW(L"KernelBase.dll");
+    if (!kernelbase) { return f; }
+
+    // Windows 11+. Capabilities are 4 32-bit fields
+    using query_capabilities_t = HRESULT (WINAPI *)(void *);
+    if (const auto query = reinterpret_cast<query_capabilities_t>(GetProcAddress(kernelbase, "QueryIoRingCapabilities")))
+    {
+        UINT32 capabilities[4] = {};
+        if (SUCCEEDED(query(capabilities))) { f.add(feature::io_ring); }
+    }
+
+    // Windows 8+. Differing values make it return immediately
+    using wait_on_address_t = BOOL (WINAPI *)(volatile VOID *, PVOID, SIZE_T, DWORD);
+    if (const auto wait = reinterpret_cast<wait_on_address_t>(GetProcAddress(kernelbase, "WaitOnAddress")))
+    {
+        volatile LONG value = 0;
+        LONG compare = 1;
+        if (wait(&value, &compare, sizeof(value), 0)) { f.add(feature::wait_on_address); }
+    }
+
+    return f;
+}
+
+} // namespace os::detail
+
 namespace os::kernel
 {
 
 // Get name of OS kernel
-std::string name() { return "Windows NT"; }
+std::string_view name() { return "Windows NT"; }
 
 // Get major, minor and patch of OS kernel
 ::version version() { return info().version; }
 
 // Get version [+ additional data] of OS kernel
-std::string version_string() { return info().version_string; }
+std::string_view version_string() { return info().version_string; }
 
 // Get OS kernel info
 const info_t& info()
 {
-    static info_t i;
+    // Init info only once.
+    static const info_t i = detail::read_kernel_info();
+    return i;
+}
 
-    if (static bool init = true; init)
-    {
-        i.name = name();
+// Get available OS kernel features
+const features_t& features()
+{
+    // Init features only once.
+    static const features_t f = detail::probe_kernel_features();
+    return f;
+}
+
+} // namespace os::kernel
+// End of src/windows/kernel.cpp
+// =========================
+
+#elif IS_OS_MACOS
+// src/macos/kernel.cpp
+// =========================
+#include "kernel.hpp"
+
+#include "macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <cerrno>
+#include <cstdint>
 
-        // KUSER_SHARED_DATA address.
-        // Offsets are taken from http://terminus.rewolf.pl/terminus/structures/ntdll/_KUSER_SHARED_DATA_x64.html
-        constexpr uintptr_t data_adress = uintptr_t{ 0x7ffe0000 };
-        const uint32_t major = *reinterpret_cast<const uint32_t*>(data_adress + 0x26c);
-        const uint32_t minor = *reinterpret_cast<const uint32_t*>(data_adress + 0x270);
-        const uint32_t patch = *reinterpret_cast<const uint32_t*>(data_adress + 0x260);
+#include <dlfcn.h>
+#include <sys/utsname.h>
+
+#if defined(__x86_64__)
+    #include <cpuid.h>
+#endif
 
-        i.version = ::version{ major, minor, patch };
-        i.version_string = i.version.str();
+namespace os::detail
+{
+
+// Read OS kernel info
+os::kernel::info_t read_kernel_info()
+{
+    os::kernel::info_t i;
 
-        init = false;
+    utsname utsname; uname(&utsname);
+    i.name = name();
+    i.version = ::version{utsname.release};
+    i.version_string = utsname.release;
+
+    return i;
+}
+
+// Probe OS kernel features with actual calls
+os::kernel::features_t probe_kernel_features()
+{
+    using os::kernel::feature;
+
+    os::kernel::features_t f;
+
+    // macOS 14.4+. Looked up at runtime to load on older versions.
+    // Differing value makes it return immediately, unless kernel lacks support
+    using wait_on_address_t = int (*)(void *, std::uint64_t, std::size_t, std::uint32_t);
+    if (const auto wait = reinterpret_cast<wait_on_address_t>(dlsym(RTLD_DEFAULT, "os_sync_wait_on_address")))
+    {
+        std::uint32_t value = 0;
+        if (wait(&value, 1, sizeof(value), 0) >= 0 || (errno != ENOSYS && errno != ENOTSUP))
+        {
+            f.add(feature::wait_on_address);
+        }
     }
 
+#if defined(__x86_64__)
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8))) { f.add(feature::invariant_tsc); }
+#elif defined(__aarch64__)
+    // Generic timer has fixed frequency
+    f.add(feature::invariant_tsc);
+#endif
+
+    return f;
+}
+
+} // namespace os::detail
+
+namespace os::kernel
+{
+
+// Get name of OS kernel
+std::string_view name() { return "Darwin"; }
+
+// Get major, minor and patch of OS kernel
+::version version() { return info().version; }
+
+// Get version [+ additional data] of OS kernel
+std::string_view version_string() { return info().version_string; }
+
+// Get OS kernel info
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_kernel_info();
     return i;
 }
 
+// Get available OS kernel features
+const features_t & features()
+{
+    // Init features only once.
+    static const features_t f = detail::probe_kernel_features();
+    return f;
+}
+
 } // namespace os::kernel
-// End of src/windows/kernel.cpp
+// End of src/macos/kernel.cpp
 // =========================
 
-#endif // IS_OS_WINDOWS
+#endif // IS_OS_*
+
+#endif // LIBOS_IMPLEMENTATION
@@ -26,51 +26,30 @@
  *  Keyboard I/O manipulations. Header-only
  */
 
-#pragma once
+#ifndef LIBOS_HEADER_ONLY_KEYBOARD_HPP
+#define LIBOS_HEADER_ONLY_KEYBOARD_HPP
 
-#include <unordered_set>
-
-// #include "os/macros.h"
-// =========================
-
-#if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
-/// Defined if OS is Unix-like
-#   define OS_UNIX 1
-/// Set to 1 if OS is Unix-like, 0 otherwise
-#   define IS_OS_UNIX 1
-#else
-#   define IS_OS_UNIX 0
-#endif
-
-#if defined(__linux__)
-/// Defined if OS is Linux
-#   define OS_LINUX 1
-/// Set to 1 if OS is Linux, 0 otherwise
-#	define IS_OS_LINUX 1
-#else
-#	define IS_OS_LINUX 0
-#endif
-
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-/// Defined if OS is Windows
-#   define OS_WINDOWS 1
-/// Set to 1 if OS is Windows, 0 otherwise
-#	define IS_OS_WINDOWS 1
-#else
-#	define IS_OS_WINDOWS 0
-#endif
-
-#if defined(__APPLE__) && defined(__MACH__)
-/// Defined if OS is MacOS
-#   define OS_MACOS 1
-/// Set to 1 if OS is MacOS, 0 otherwise
-#   define IS_OS_MACOS 1
-#else
-#   define IS_OS_MACOS 0
-#endif
-// End of   "os/macros.h"
-// =========================
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "macros.h"
+#include "span.hpp"
+#include "thread.hpp"
 
 namespace os::keyboard
 {
@@ -380,257 +359,4983 @@ enum class vk
 #endif
 };
 
-/// Combination of keys
-struct combination
-{
-    /// Array of virtual keys
-    std::unordered_set<vk> keys;
-
-    /// Make combination from virtual keys
-    combination(vk key) : keys({key}) {}
-    /// Make combination from list of virtual keys
-    combination(std::initializer_list<vk> keys = {}) : keys(keys) {}
-
-    /// Append a combination
-    combination & operator+=(const combination &combo)
-    {
-        keys.insert(combo.keys.begin(), combo.keys.end());
-        return *this;
-    }
-
-    /// Concatinate 2 combinations
-    combination operator+(const combination &combo) const
-    {
-        combination res = *this;
-        return res += combo;
-    }
-};
-
-/// Make a combination from 2 virtual keys
-inline combination operator+(vk lhs, vk rhs) { return combination{{lhs, rhs}}; }
+} // namespace os::keyboard
 
-/// Check if every key in combination is pressed
-bool is_pressed(const combination &combo);
-/// Get combination of all pressed keys on a keyboard
-combination pressed_keys();
+namespace os::detail
+{
 
-/// Press combination of keys (until release())
-void press(const combination &combo);
-/// Release combination of keys
-void release(const combination &combo);
-/// press() and release() combination of keys
-inline void click(const combination &combo) { press(combo); release(combo); }
+/// Count set bits in a 64-bit word
+constexpr unsigned popcount(std::uint64_t word) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_popcountll(word));
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return static_cast<unsigned>((word * 0x0101010101010101ull) >> 56);
+#endif
+}
 
-} // namespace os::keyboard
+/// Count trailing zero bits in a non-zero 64-bit word
+constexpr unsigned countr_zero(std::uint64_t word) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(word));
+#else
+    return popcount((word & (~word + 1)) - 1);
+#endif
+}
 
+/**
+ * @brief Number of dense key indexes
+ *
+ * @details
+ *  - Linux: keysyms `0x0000-0x00FF` (Latin-1) and `0xFF00-0xFFFF` (function keys)
+ *  - Windows and macOS: virtual key codes `0x00-0xFF`
+ */
+constexpr std::size_t key_index_count = IS_OS_LINUX ? 512 : 256;
 
-// -------------------------
-// |        SOURCES        |
-// -------------------------
+/// Index, returned for virtual keys, that can't be represented densely
+constexpr std::size_t no_key_index = key_index_count;
 
+/// Get dense index of virtual key
+constexpr std::size_t key_index(keyboard::vk key) noexcept
+{
+    const auto value = static_cast<unsigned>(key);
+    if (value <= 0xFF) { return value; }
 #if IS_OS_LINUX
-// src/linux/keyboard.cpp
-// =========================
-
-#if !IS_OS_LINUX
-    #error "This code is for Linux only!"
+    if ((value >> 8) == 0xFF) { return 0x100 | (value & 0xFF); }
 #endif
+    return no_key_index;
+}
 
-#include <X11/Xlib.h>
-#include <X11/keysym.h>
-#include <X11/extensions/XTest.h>
+/// Get virtual key by its dense index
+constexpr keyboard::vk key_at(std::size_t index) noexcept
+{
+#if IS_OS_LINUX
+    if (index >= 0x100) { return static_cast<keyboard::vk>(0xFF00 | (index & 0xFF)); }
+#endif
+    return static_cast<keyboard::vk>(index);
+}
 
-namespace os::detail
+/// Key, that types character on current keyboard layout
+struct typed_key
 {
+    /// Platform-specific key code
+    std::uint16_t code = 0;
+    /// Platform-specific mask of modifiers to hold
+    std::uint16_t modifiers = 0;
+    /// `false` for characters, missing in layout
+    bool          found = false;
+};
 
-// RAII wrapper for X Server's Display
-class display_handler
+/**
+ * @brief Lookup table from character to key, that types it
+ *
+ * @details
+ *  First code points are stored densely, the rest are kept
+ *  in a sorted array.
+ */
+class char_table
 {
 public:
-    static display_handler & get()
+    /// Number of densely stored code points
+    static constexpr char32_t dense_size = 0x800;
+
+    /// Remove all characters
+    void clear()
     {
-        static display_handler handler { XOpenDisplay(nullptr) };
-        return handler;
+        std::fill(std::begin(dense), std::end(dense), typed_key{});
+        sparse.clear();
     }
 
-    Display * native() const { return display; }
+    /// Add key of character, unless it already has one
+    void insert(char32_t c, std::uint16_t code, std::uint16_t modifiers)
+    {
+        const typed_key key { code, modifiers, true };
+        if (c < dense_size)
+        {
+            if (!dense[c].found) { dense[c] = key; }
+            return;
+        }
 
-    display_handler(const display_handler &) = delete;
-    display_handler(display_handler &&) = delete;
-    void operator=(const display_handler &) = delete;
-    void operator=(display_handler &&) = delete;
+        auto it = lower_bound(sparse, c);
+        if (it == sparse.end() || it->first != c) { sparse.insert(it, { c, key }); }
+    }
+
+    /// Get key of character or `nullptr`, if it's missing in layout
+    const typed_key * find(char32_t c) const
+    {
+        if (c < dense_size) { return dense[c].found ? &dense[c] : nullptr; }
 
-    ~display_handler() { XCloseDisplay(display); }
+        auto it = lower_bound(sparse, c);
+        return it != sparse.end() && it->first == c ? &it->second : nullptr;
+    }
 
 private:
-    display_handler(Display *display) : display(display) {}
+    using sparse_entry = std::pair<char32_t, typed_key>;
 
-    Display *display = nullptr;
+    // First entry with code point not less than c
+    template <typename Entries>
+    static auto lower_bound(Entries &entries, char32_t c) -> decltype(entries.begin())
+    {
+        return std::lower_bound(
+            entries.begin(), entries.end(), c,
+            [](const sparse_entry &entry, char32_t c) { return entry.first < c; }
+        );
+    }
+
+    typed_key                 dense[dense_size] = {};
+    std::vector<sparse_entry> sparse;
 };
 
+/// Platform-specific builder of keyboard layout tables
+class layout_builder;
+
+/// Raise priority of current thread for time-critical work (if possible)
+void raise_thread_priority() noexcept;
+
+/// Sleep until deadline with the best precision available
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline) noexcept;
+
 } // namespace os::detail
 
 namespace os::keyboard
 {
 
-// Check if every key in combination is pressed
-bool is_pressed(const combination &combo)
+/**
+ * @brief Combination of keys
+ *
+ * @details
+ *  Keys are stored in a fixed-size bitset, indexed by detail::key_index().
+ *  Combinations never allocate and may be used in `constexpr` context.
+ *
+ * @note Virtual keys, that have no dense index, are ignored.
+ */
+class combination
 {
-    auto &&h = os::detail::display_handler::get();
-
-    char keys_return[32];
-    XQueryKeymap(h.native(), keys_return);
+public:
+    /// Max number of keys in combination
+    static constexpr std::size_t capacity = detail::key_index_count;
 
-    for (const auto &key : combo.keys)
+    /// Forward iterator over keys of combination
+    class iterator
     {
-        KeyCode kc = XKeysymToKeycode(h.native(), static_cast<KeySym>(key));
-        // Key not pressed
-        if (!(keys_return[kc / 8] & (1 << (kc % 8)))) { return false; }
-    }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = vk;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const vk *;
+        using reference         = vk;
 
-    return true;
-}
+        /// Get current key
+        constexpr vk operator*() const noexcept { return detail::key_at(index); }
 
-// Get combination of all pressed keys on a keyboard
-combination pressed_keys()
-{
-    combination combo;
+        /// Go to the next key
+        constexpr iterator & operator++() noexcept
+        {
+            index = combo->next_index(index + 1);
+            return *this;
+        }
+        /// Go to the next key
+        constexpr iterator operator++(int) noexcept
+        {
+            iterator it = *this;
+            ++*this;
+            return it;
+        }
+
+        /// Check iterators for equality
+        constexpr bool operator==(const iterator &rhs) const noexcept { return index == rhs.index; }
+        /// Check iterators for inequality
+        constexpr bool operator!=(const iterator &rhs) const noexcept { return index != rhs.index; }
 
-    auto &&h = os::detail::display_handler::get();
+    private:
+        friend class combination;
+
+        constexpr iterator(const combination *combo, std::size_t index) noexcept
+            : combo(combo), index(index) {}
+
+        const combination *combo = nullptr;
+        std::size_t        index = capacity;
+    };
+
+    /// Make empty combination
+    constexpr combination() noexcept = default;
+    /// Make combination from virtual key
+    constexpr combination(vk key) noexcept { insert(key); }
+    /// Make combination from list of virtual keys
+    constexpr combination(std::initializer_list<vk> keys) noexcept
+    {
+        for (vk key : keys) { insert(key); }
+    }
 
-    char keys_return[32];
-    XQueryKeymap(h.native(), keys_return);
+    /// Add key to combination
+    constexpr void insert(vk key) noexcept
+    {
+        const std::size_t i = detail::key_index(key);
+        if (i == detail::no_key_index) { return; }
+        words[i / 64] |= std::uint64_t{1} << (i % 64);
+    }
+    /// Remove key from combination
+    constexpr void erase(vk key) noexcept
+    {
+        const std::size_t i = detail::key_index(key);
+        if (i == detail::no_key_index) { return; }
+        words[i / 64] &= ~(std::uint64_t{1} << (i % 64));
+    }
+    /// Remove all keys from combination
+    constexpr void clear() noexcept
+    {
+        for (auto &word : words) { word = 0; }
+    }
 
-    /* Check all 256 virtual keys */
-    for (size_t m = 0; m < 32; ++m)
+    /// Check if key is in combination
+    constexpr bool contains(vk key) const noexcept
     {
-        // Check every bit
-        for (size_t n = 0; n < 8; ++n)
+        const std::size_t i = detail::key_index(key);
+        if (i == detail::no_key_index) { return false; }
+        return (words[i / 64] >> (i % 64)) & 1;
+    }
+    /// Check if every key of other combination is in this one
+    constexpr bool contains(const combination &combo) const noexcept
+    {
+        for (std::size_t i = 0; i < word_count; ++i)
+        {
+            if ((combo.words[i] & ~words[i]) != 0) { return false; }
+        }
+        return true;
+    }
+    /// Check if combinations have at least one common key
+    constexpr bool intersects(const combination &combo) const noexcept
+    {
+        for (std::size_t i = 0; i < word_count; ++i)
         {
-            // Key is pressed
-            if (keys_return[m] & (1 << n)) { combo += static_cast<vk>(8*m + n); }
+            if ((combo.words[i] & words[i]) != 0) { return true; }
         }
+        return false;
     }
 
-    return combo;
-}
+    /// Get number of keys in combination
+    constexpr std::size_t size() const noexcept
+    {
+        std::size_t n = 0;
+        for (auto word : words) { n += detail::popcount(word); }
+        return n;
+    }
+    /// Check if combination has no keys
+    constexpr bool empty() const noexcept
+    {
+        for (auto word : words)
+        {
+            if (word != 0) { return false; }
+        }
+        return true;
+    }
 
-// Press combination of keys (until release)
-void press(const combination &combo)
-{
-    auto &&h = os::detail::display_handler::get();
+    /// Get iterator to the first key
+    constexpr iterator begin() const noexcept { return iterator(this, next_index(0)); }
+    /// Get iterator past the last key
+    constexpr iterator end() const noexcept { return iterator(this, capacity); }
 
-    for (const auto &key : combo.keys)
+    /// Append a combination
+    constexpr combination & operator+=(const combination &combo) noexcept
     {
-        XTestFakeKeyEvent(
-            h.native(), // Display *
-            XKeysymToKeycode(
-                h.native(), // Display *
-                static_cast<KeySym>(key) // Our vk values same as KeySym for linux
-            ),
-            true, // is_press
-            0     // delay
-        );
+        for (std::size_t i = 0; i < word_count; ++i) { words[i] |= combo.words[i]; }
+        return *this;
+    }
+    /// Remove keys of other combination
+    constexpr combination & operator-=(const combination &combo) noexcept
+    {
+        for (std::size_t i = 0; i < word_count; ++i) { words[i] &= ~combo.words[i]; }
+        return *this;
     }
-}
 
-// Release combination of keys
-void release(const combination &combo)
-{
-    auto &&h = os::detail::display_handler::get();
+    /// Concatinate 2 combinations
+    friend constexpr combination operator+(combination lhs, const combination &rhs) noexcept
+    {
+        return lhs += rhs;
+    }
+    /// Get keys of first combination, that are not in the second one
+    friend constexpr combination operator-(combination lhs, const combination &rhs) noexcept
+    {
+        return lhs -= rhs;
+    }
 
-    for (const auto &key : combo.keys)
+    /// Check combinations for equality
+    friend constexpr bool operator==(const combination &lhs, const combination &rhs) noexcept
     {
-        XTestFakeKeyEvent(
-            h.native(), // Display *
-            XKeysymToKeycode(
-                h.native(), // Display *
-                static_cast<KeySym>(key) // Our vk values same as KeySym for linux
-            ),
-            false, // is_press
-            0     // delay
-        );
+        for (std::size_t i = 0; i < word_count; ++i)
+        {
+            if (lhs.words[i] != rhs.words[i]) { return false; }
+        }
+        return true;
+    }
+    /// Check combinations for inequality
+    friend constexpr bool operator!=(const combination &lhs, const combination &rhs) noexcept
+    {
+        return !(lhs == rhs);
     }
-}
 
-} // namespace os::keyboard
-// End of src/linux/keyboard.cpp
-// =========================
+private:
+    static constexpr std::size_t word_count = capacity / 64;
 
-#endif // IS_OS_LINUX
+    /// Get first index of key in combination, starting from @p from
+    constexpr std::size_t next_index(std::size_t from) const noexcept
+    {
+        for (std::size_t i = from / 64; i < word_count; ++i)
+        {
+            std::uint64_t word = words[i];
+            if (i == from / 64) { word &= ~std::uint64_t{0} << (from % 64); }
+            if (word != 0) { return i * 64 + detail::countr_zero(word); }
+        }
+        return capacity;
+    }
 
-#if IS_OS_WINDOWS
-// src/windows/keyboard.cpp
-// =========================
+    std::uint64_t words[word_count] = {};
+};
 
-#if !IS_OS_WINDOWS
-    #error "This code is for Windows only!"
-#endif
+/// Make a combination from 2 virtual keys
+constexpr combination operator+(vk lhs, vk rhs) noexcept { return combination{lhs, rhs}; }
 
-#include <Windows.h>
+/// Check if every key in combination is pressed
+bool is_pressed(const combination &combo);
+/// Get combination of all pressed keys on a keyboard
+combination pressed_keys();
 
-namespace os::detail
+/**
+ * @brief Snapshot of keyboard state
+ *
+ * @details
+ *  Captured once by snapshot().
+ *  All queries are answered from memory, without calls to OS.
+ */
+class state
 {
-    void send_inputs(const keyboard::combination &combo, bool is_down)
-    {
-        std::vector<INPUT> inputs(combo.keys.size());
-        size_t i = 0;
-        for (auto key : combo.keys)
-        {
-            auto& in = inputs[i];
+public:
+    /// Make state with no keys pressed
+    constexpr state() noexcept = default;
+    /// Make state with given keys pressed
+    constexpr explicit state(const combination &pressed) noexcept : keys(pressed) {}
 
-            in.type = INPUT_KEYBOARD;
-            in.ki.wVk = static_cast<int>(key);
-            if (!is_down) 
-            {
-                in.ki.dwFlags = KEYEVENTF_KEYUP;
-            }
+    /// Check if every key in combination was pressed
+    constexpr bool is_pressed(const combination &combo) const noexcept { return keys.contains(combo); }
+    /// Get combination of all pressed keys
+    constexpr const combination & pressed_keys() const noexcept { return keys; }
 
-            i++;
-        }
-        SendInput(inputs.size(), inputs.data(), sizeof(INPUT));
-    }
+    /// Get keys, that are pressed now, but weren't pressed in previous state
+    constexpr combination pressed_since(const state &prev) const noexcept { return keys - prev.keys; }
+    /// Get keys, that were pressed in previous state, but aren't pressed now
+    constexpr combination released_since(const state &prev) const noexcept { return prev.keys - keys; }
+
+    /// Check states for equality
+    constexpr bool operator==(const state &rhs) const noexcept { return keys == rhs.keys; }
+    /// Check states for inequality
+    constexpr bool operator!=(const state &rhs) const noexcept { return keys != rhs.keys; }
+
+private:
+    combination keys;
+};
+
+/**
+ * @brief Capture state of the whole keyboard at once
+ *
+ * @details
+ *  - Linux: single `XQueryKeymap`
+ *  - Windows: single `GetKeyboardState`
+ *  - MacOS: values of keyboard HID elements
+ */
+state snapshot();
+
+/// Press combination of keys (until release())
+void press(const combination &combo);
+/// Release combination of keys
+void release(const combination &combo);
+/// press() and release() combination of keys
+inline void click(const combination &combo) { press(combo); release(combo); }
+
+/// Single key press or release
+struct key_event
+{
+    /// Virtual key
+    vk   key;
+    /// `true` for press, `false` for release
+    bool is_down = true;
+};
+
+/**
+ * @brief Send sequence of key events at once
+ *
+ * @details
+ *  Events are submitted in order with a single OS call per batch:
+ *  - Linux: one `XFlush` after all `XTestFakeKeyEvent`
+ *  - Windows: one `SendInput`
+ *  - MacOS: one reused `CGEvent` for all keys
+ *
+ * @note On macOS modifiers are applied as flags to the keys, that follow them in the batch.
+ */
+void send(span<const key_event> events);
+/// Send list of key events at once
+inline void send(std::initializer_list<key_event> events)
+{
+    send(span<const key_event>(events.begin(), events.size()));
 }
 
-namespace os::keyboard
+/**
+ * @brief Type text, using current keyboard layout
+ *
+ * @details
+ *  Every character is mapped to a key and modifiers of the active layout
+ *  with a lookup table, built once per layout. The whole text is sent
+ *  as a single batch of key events.
+ *
+ * @note Characters, missing in layout, are sent as Unicode input on Windows and macOS
+ *  and skipped on Linux.
+ */
+void type(std::u32string_view text);
+
+/**
+ * @brief Cached tables of keyboard layout
+ *
+ * @details
+ *  Tables are built once per layout and rebuilt lazily, after OS reports a change:
+ *  - Linux: XKB `XkbNewKeyboardNotify`, `XkbMapNotify` and group changes
+ *  - Windows: change of `HKL`, used by foreground window
+ *  - macOS: `kTISNotifySelectedKeyboardInputSourceChanged`
+ *
+ *  Layout objects are immutable, so lookups are O(1), thread-safe and don't query OS.
+ *  Hold the returned pointer to keep using the same tables.
+ */
+class layout
 {
+public:
+    /// Get layout, that is active now
+    static std::shared_ptr<const layout> current();
 
-    // Check if every key in combination is pressed
-    bool is_pressed(const combination& combo)
+    /// Get platform key code of virtual key (0, if none)
+    std::uint16_t code_of(vk key) const noexcept
     {
-        for (const auto& key : combo.keys)
-        {
-            short state = GetAsyncKeyState(static_cast<int>(key));
-            // If the most significant bit of 2 bytes is not set, the key isn't pressed
-            if (!(state & (1 << 15))) { return false; };
-        }
-        return true;
+        const std::size_t i = detail::key_index(key);
+        return i == detail::no_key_index ? 0 : codes[i];
     }
 
-    // Get combination of all pressed keys on a keyboard
-    combination pressed_keys()
+    /// Get virtual key of platform key code
+    vk key_of(std::uint16_t code) const noexcept
     {
-        combination combo;
+        return code < std::size(keys) ? keys[code] : vk{};
+    }
 
-        // Go through every virtual key
-        for (int key = 0; key < 256; ++key)
-        {
-            short state = GetAsyncKeyState(key);
-            // If the most significant bit of 2 bytes set, the key is pressed
-            if (state & (1 << 15)) { combo += static_cast<vk>(key); };
-        }
+    /// Get key and modifiers, that type character (`nullptr`, if it's missing in layout)
+    const detail::typed_key * find(char32_t c) const { return chars.find(c); }
 
-        return combo;
+    /// Get key code, that holds modifier with index (0, if none)
+    std::uint16_t modifier_key(unsigned index) const noexcept
+    {
+        return index < std::size(modifier_keys) ? modifier_keys[index] : 0;
     }
 
-    // Press combination of keys (until release)
-    void press(const combination& combo) { detail::send_inputs(combo, true); }
+    /// Number of layouts, loaded before this one
+    std::uint64_t generation() const noexcept { return number; }
 
-    // Release combination of keys
-    void release(const combination& combo) { detail::send_inputs(combo, false); }
+private:
+    friend class detail::layout_builder;
 
-} // namespace os::keyboard
-// End of src/windows/keyboard.cpp
-// =========================
+    std::uint16_t      codes[detail::key_index_count] = {};
+    vk                 keys[256] = {};
+    detail::char_table chars;
+    std::uint16_t      modifier_keys[8] = {};
+    std::uint64_t      number = 0;
+};
+
+/**
+ * @brief Listener of keyboard events
+ *
+ * @details
+ *  Events are pushed by OS as soon as they happen, no polling is involved:
+ *  - Linux: XRecord extension of X server
+ *  - Windows: `WH_KEYBOARD_LL` hook
+ *  - MacOS: input value callback of HID manager
+ *
+ *  Events are either passed to callback on listener's own thread,
+ *  or queued until next_event() is called.
+ *
+ *  Events come from current_backend() of the thread, that makes listener.
+ *
+ * @note Events start to arrive when listener is constructed and stop when it's destroyed.
+ */
+class listener
+{
+public:
+    /// Key press or release with time when it happened
+    struct event : key_event
+    {
+        /// Time of event
+        std::chrono::steady_clock::time_point time;
+    };
+
+    /// Function to be called on each event
+    using callback = std::function<void(const event &)>;
+
+    /// Start listening and queue events for next_event()
+    listener();
+    /**
+     * @brief Start listening and pass events to callback
+     *
+     * @warning Callback is called on listener's thread.
+     */
+    explicit listener(callback on_event);
+
+    listener(const listener &) = delete;
+    listener(listener &&) = delete;
+    void operator=(const listener &) = delete;
+    void operator=(listener &&) = delete;
+
+    /// Stop listening
+    ~listener();
+
+    /**
+     * @brief Check if OS delivers events to this listener
+     *
+     * @note Listener may be inactive, if there is no access to keyboard events
+     *  (e.g. XRecord is not supported by X server).
+     */
+    bool active() const noexcept;
+
+    /**
+     * @brief Wait for next queued event
+     *
+     * @warning Blocks forever, if listener is not active() or has callback.
+     */
+    event next_event()
+    {
+        std::unique_lock lock(mutex);
+        ready.wait(lock, [this] { return !events.empty(); });
+        return pop();
+    }
+
+    /// Wait for next queued event no longer than timeout
+    template <class Rep, class Period>
+    std::optional<event> next_event(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock lock(mutex);
+        if (!ready.wait_for(lock, timeout, [this] { return !events.empty(); }))
+        {
+            return std::nullopt;
+        }
+        return pop();
+    }
+
+public:
+    /**
+     * @brief Source of listener's events
+     *
+     * @details Made by backend::listen() and owned by listener until it's destroyed.
+     */
+    class source
+    {
+    public:
+        /// Make source of events for listener
+        explicit source(listener &owner) noexcept : owner(owner) {}
+
+        source(const source &) = delete;
+        source(source &&) = delete;
+        void operator=(const source &) = delete;
+        void operator=(source &&) = delete;
+
+        /// Stop delivering events
+        virtual ~source() = default;
+
+        /// Check if events are delivered to listener
+        virtual bool active() const noexcept = 0;
+
+    protected:
+        /// Pass event to listener
+        void deliver(const event &e) { owner.push(e); }
+
+    private:
+        listener &owner;
+    };
+
+private:
+    // Called by source on each event
+    void push(const event &e)
+    {
+        if (on_event) { on_event(e); return; }
+
+        {
+            std::lock_guard lock(mutex);
+            events.push_back(e);
+        }
+        ready.notify_one();
+    }
+
+    event pop()
+    {
+        event e = events.front();
+        events.pop_front();
+        return e;
+    }
+
+    callback                on_event;
+    std::mutex              mutex;
+    std::condition_variable ready;
+    std::deque<event>       events;
+
+    std::unique_ptr<source> origin;
+};
+
+} // namespace os::keyboard
+
+namespace os::mouse
+{
+
+/// Mouse buttons
+enum class button : std::uint8_t
+{
+    left,
+    right,
+    middle,
+    /// Side button, that usually means "back" (X1)
+    back,
+    /// Side button, that usually means "forward" (X2)
+    forward
+};
+
+/// Number of mouse buttons
+constexpr std::size_t button_count = 5;
+
+/// Point on screen in pixels. Origin is the top left corner of the main screen
+struct point
+{
+    int x = 0;
+    int y = 0;
+
+    constexpr bool operator==(const point &rhs) const noexcept { return x == rhs.x && y == rhs.y; }
+    constexpr bool operator!=(const point &rhs) const noexcept { return !(*this == rhs); }
+};
+
+/// Kind of mouse event
+enum class action : std::uint8_t
+{
+    /// Move cursor to absolute position (x, y)
+    move_to,
+    /// Move cursor by offset (x, y)
+    move_by,
+    /// Press button
+    press,
+    /// Release button
+    release,
+    /// Scroll by (x, y) wheel clicks. Positive values scroll right and up
+    scroll
+};
+
+/// Single mouse event
+struct event
+{
+    /// Kind of event
+    action       kind = action::move_by;
+    /// Position, offset or scroll amount, depending on kind
+    int          x = 0;
+    /// Position, offset or scroll amount, depending on kind
+    int          y = 0;
+    /// Button to press or release
+    mouse::button button = mouse::button::left;
+
+    /// Make move to absolute position
+    static constexpr event moved_to(point p) noexcept { return event{action::move_to, p.x, p.y}; }
+    /// Make move by offset
+    static constexpr event moved_by(int dx, int dy) noexcept { return event{action::move_by, dx, dy}; }
+    /// Make press of button
+    static constexpr event pressed(mouse::button b) noexcept { return event{action::press, 0, 0, b}; }
+    /// Make release of button
+    static constexpr event released(mouse::button b) noexcept { return event{action::release, 0, 0, b}; }
+    /// Make scroll by wheel clicks
+    static constexpr event scrolled(int dx, int dy) noexcept { return event{action::scroll, dx, dy}; }
+};
+
+} // namespace os::mouse
+
+namespace os::keyboard
+{
+
+/**
+ * @brief Implementation of keyboard and mouse functions
+ *
+ * @details
+ *  Every function of os::keyboard and os::mouse, as well as listener, async_injector and players,
+ *  is forwarded to current_backend(). It's native_backend() by default:
+ *  - Linux: XTest and XRecord or uinput and evdev
+ *  - Windows: `SendInput` and `WH_KEYBOARD_LL` hook
+ *  - MacOS: `CGEvent` and HID manager
+ *
+ *  Implement this interface to run keyboard code without OS
+ *  and install it with backend_scope.
+ */
+class backend
+{
+public:
+    backend() = default;
+
+    backend(const backend &) = delete;
+    backend(backend &&) = delete;
+    void operator=(const backend &) = delete;
+    void operator=(backend &&) = delete;
+
+    virtual ~backend() = default;
+
+    /// Check if every key in combination is pressed
+    virtual bool is_pressed(const combination &combo) { return pressed_keys().contains(combo); }
+    /// Get combination of all pressed keys
+    virtual combination pressed_keys() = 0;
+    /// Capture state of the whole keyboard at once
+    virtual state snapshot() { return state(pressed_keys()); }
+
+    /// Press or release all keys of combination at once
+    virtual void send(const combination &combo, bool is_down) = 0;
+    /// Send sequence of key events at once
+    virtual void send(span<const key_event> events) = 0;
+    /// Type text, using current layout
+    virtual void type(std::u32string_view text) = 0;
+
+    /// Get layout, that is active now
+    virtual std::shared_ptr<const layout> current_layout() = 0;
+    /// Open connections and load layout tables ahead of first use (see os::prefetch())
+    virtual void warm_up() { current_layout(); }
+
+    /// Start delivering events to listener
+    virtual std::unique_ptr<listener::source> listen(listener &owner) = 0;
+
+    /// Get position of mouse cursor (backends without mouse return origin)
+    virtual mouse::point mouse_position() { return {}; }
+    /// Send sequence of mouse events at once (backends without mouse ignore them)
+    virtual void send_mouse(span<const mouse::event> events) { (void)events; }
+    /// Check if send_mouse() moves cursor to absolute position on mouse::action::move_to
+    virtual bool absolute_mouse_moves() const noexcept { return true; }
+};
+
+/// Get backend, that calls OS
+backend & native_backend();
+
+} // namespace os::keyboard
+
+namespace os::detail
+{
+
+/// Backend, installed on current thread (`nullptr` for native one)
+keyboard::backend *& thread_backend() noexcept;
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+/// Get backend, used by keyboard functions on current thread
+inline backend & current_backend()
+{
+    backend *installed = detail::thread_backend();
+    return installed ? *installed : native_backend();
+}
+
+/**
+ * @brief Use backend on current thread until the end of scope
+ *
+ * @details
+ *  Scopes may be nested. Other threads are not affected,
+ *  so tests with different backends may run in parallel.
+ *
+ * @warning Backend must outlive the scope.
+ */
+class backend_scope
+{
+public:
+    /// Install backend on current thread
+    explicit backend_scope(backend &installed) noexcept
+        : previous(std::exchange(detail::thread_backend(), &installed)) {}
+
+    backend_scope(const backend_scope &) = delete;
+    backend_scope(backend_scope &&) = delete;
+    void operator=(const backend_scope &) = delete;
+    void operator=(backend_scope &&) = delete;
+
+    /// Restore previous backend
+    ~backend_scope() { detail::thread_backend() = previous; }
+
+private:
+    backend *previous;
+};
+
+/**
+ * @brief Deterministic in-memory backend
+ *
+ * @details
+ *  Nothing is sent to OS:
+ *  - Key state is kept in lock-free bitmap
+ *  - Every event is recorded into ring of fixed capacity and passed to listeners of this mock
+ *  - Layout is empty, so type() sends US keys for ASCII letters, digits, spaces, tabs and newlines
+ *    and skips other characters
+ *  - Mouse position, buttons and total scroll are kept in atomics, mouse events are only counted
+ *
+ *  Injection doesn't allocate or lock, unless there are listeners.
+ *
+ * @warning Callbacks of listeners must not send events to the same mock.
+ */
+class mock_backend : public backend
+{
+public:
+    /**
+     * @brief Make mock with no keys pressed
+     *
+     * @param capacity Size of ring of recorded events (rounded up to power of 2)
+     */
+    explicit mock_backend(std::size_t capacity = 1024)
+    {
+        std::size_t size = 1;
+        while (size < capacity) { size *= 2; }
+
+        mask = size - 1;
+        ring = std::make_unique<std::atomic<std::uint64_t>[]>(size);
+    }
+
+    combination pressed_keys() override
+    {
+        combination combo;
+        for (std::size_t w = 0; w < std::size(bits); ++w)
+        {
+            // Visit only pressed keys
+            for (std::uint64_t word = bits[w].load(std::memory_order_acquire); word != 0; word &= word - 1)
+            {
+                combo.insert(detail::key_at(w * 64 + detail::countr_zero(word)));
+            }
+        }
+        return combo;
+    }
+
+    void send(const combination &combo, bool is_down) override
+    {
+        for (vk key : combo) { record(key_event{key, is_down}); }
+    }
+
+    void send(span<const key_event> events) override
+    {
+        for (const auto &event : events) { record(event); }
+    }
+
+    void type(std::u32string_view text) override
+    {
+        for (char32_t c : text)
+        {
+            vk key{};
+            bool shift = false;
+            if (!ascii_key(c, key, shift)) { continue; }
+
+            if (shift) { record(key_event{vk::Shift, true}); }
+            record(key_event{key, true});
+            record(key_event{key, false});
+            if (shift) { record(key_event{vk::Shift, false}); }
+        }
+    }
+
+    std::shared_ptr<const layout> current_layout() override { return empty; }
+
+    std::unique_ptr<listener::source> listen(listener &owner) override
+    {
+        return std::make_unique<mock_source>(*this, owner);
+    }
+
+    mouse::point mouse_position() override
+    {
+        return mouse::point{cursor_x.load(std::memory_order_acquire), cursor_y.load(std::memory_order_acquire)};
+    }
+
+    void send_mouse(span<const mouse::event> events) override
+    {
+        for (const auto &event : events)
+        {
+            const unsigned bit = 1u << static_cast<unsigned>(event.button);
+            switch (event.kind)
+            {
+            case mouse::action::move_to:
+                cursor_x.store(event.x, std::memory_order_release);
+                cursor_y.store(event.y, std::memory_order_release);
+                break;
+            case mouse::action::move_by:
+                cursor_x.fetch_add(event.x, std::memory_order_acq_rel);
+                cursor_y.fetch_add(event.y, std::memory_order_acq_rel);
+                break;
+            case mouse::action::press: buttons.fetch_or(bit, std::memory_order_acq_rel); break;
+            case mouse::action::release: buttons.fetch_and(~bit, std::memory_order_acq_rel); break;
+            case mouse::action::scroll:
+                scroll_x.fetch_add(event.x, std::memory_order_acq_rel);
+                scroll_y.fetch_add(event.y, std::memory_order_acq_rel);
+                break;
+            }
+        }
+        mouse_count.fetch_add(events.size(), std::memory_order_acq_rel);
+        mouse_batches.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    /// Get number of events, recorded since construction or clear()
+    std::uint64_t recorded_count() const noexcept { return count.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Get the last recorded events, oldest first
+     *
+     * @details Returns no more events, than capacity of ring.
+     *
+     * @note Call it, when no events are sent concurrently, to get consistent result.
+     */
+    std::vector<key_event> recorded() const
+    {
+        const std::uint64_t end = recorded_count();
+        const std::uint64_t begin = end > mask + 1 ? end - (mask + 1) : 0;
+
+        std::vector<key_event> events;
+        events.reserve(static_cast<std::size_t>(end - begin));
+        for (std::uint64_t i = begin; i < end; ++i)
+        {
+            const std::uint64_t packed = ring[i & mask].load(std::memory_order_relaxed);
+            events.push_back(key_event{static_cast<vk>(packed >> 1), (packed & 1) != 0});
+        }
+        return events;
+    }
+
+    /// Check if mouse button is pressed
+    bool button_pressed(mouse::button b) const noexcept
+    {
+        return (buttons.load(std::memory_order_acquire) >> static_cast<unsigned>(b)) & 1;
+    }
+
+    /// Get total scroll in wheel clicks
+    mouse::point scrolled() const noexcept
+    {
+        return mouse::point{scroll_x.load(std::memory_order_acquire), scroll_y.load(std::memory_order_acquire)};
+    }
+
+    /// Get number of mouse events, sent since construction or clear()
+    std::uint64_t mouse_recorded_count() const noexcept { return mouse_count.load(std::memory_order_acquire); }
+
+    /// Get number of send_mouse() calls since construction or clear() (one per flush of real backend)
+    std::uint64_t mouse_batch_count() const noexcept { return mouse_batches.load(std::memory_order_acquire); }
+
+    /// Release every key and button, move cursor to origin without events and forget recorded ones
+    void clear() noexcept
+    {
+        for (auto &word : bits) { word.store(0, std::memory_order_relaxed); }
+        count.store(0, std::memory_order_release);
+
+        cursor_x.store(0, std::memory_order_relaxed);
+        cursor_y.store(0, std::memory_order_relaxed);
+        buttons.store(0, std::memory_order_relaxed);
+        scroll_x.store(0, std::memory_order_relaxed);
+        scroll_y.store(0, std::memory_order_relaxed);
+        mouse_count.store(0, std::memory_order_relaxed);
+        mouse_batches.store(0, std::memory_order_release);
+    }
+
+private:
+    // Listener's source, fed by mock synchronously
+    class mock_source : public listener::source
+    {
+    public:
+        mock_source(mock_backend &mock, listener &owner) : source(owner), mock(mock)
+        {
+            std::lock_guard lock(mock.mutex);
+            mock.sources.push_back(this);
+            mock.listening.store(true);
+        }
+
+        ~mock_source() override
+        {
+            std::lock_guard lock(mock.mutex);
+            mock.sources.erase(std::find(mock.sources.begin(), mock.sources.end(), this));
+            mock.listening.store(!mock.sources.empty());
+        }
+
+        bool active() const noexcept override { return true; }
+
+        void push(const listener::event &e) { deliver(e); }
+
+    private:
+        mock_backend &mock;
+    };
+
+    // Get US key for ASCII character
+    static bool ascii_key(char32_t c, vk &key, bool &shift) noexcept
+    {
+        constexpr vk letters[] = {
+            vk::A, vk::B, vk::C, vk::D, vk::E, vk::F, vk::G, vk::H, vk::I, vk::J, vk::K, vk::L, vk::M,
+            vk::N, vk::O, vk::P, vk::Q, vk::R, vk::S, vk::T, vk::U, vk::V, vk::W, vk::X, vk::Y, vk::Z,
+        };
+        constexpr vk digits[] = {
+            vk::Key_0, vk::Key_1, vk::Key_2, vk::Key_3, vk::Key_4,
+            vk::Key_5, vk::Key_6, vk::Key_7, vk::Key_8, vk::Key_9,
+        };
+
+        shift = c >= U'A' && c <= U'Z';
+        if (c >= U'a' && c <= U'z') { key = letters[c - U'a']; return true; }
+        if (shift) { key = letters[c - U'A']; return true; }
+        if (c >= U'0' && c <= U'9') { key = digits[c - U'0']; return true; }
+        switch (c)
+        {
+        case U' ': key = vk::Space; return true;
+        case U'\t': key = vk::Tab; return true;
+        case U'\n': key = vk::Return; return true;
+        default: return false;
+        }
+    }
+
+    void record(const key_event &event)
+    {
+        const std::size_t i = detail::key_index(event.key);
+        if (i != detail::no_key_index)
+        {
+            const std::uint64_t bit = std::uint64_t{1} << (i % 64);
+            if (event.is_down) { bits[i / 64].fetch_or(bit, std::memory_order_acq_rel); }
+            else { bits[i / 64].fetch_and(~bit, std::memory_order_acq_rel); }
+        }
+
+        const std::uint64_t pos = count.fetch_add(1, std::memory_order_acq_rel);
+        ring[pos & mask].store(
+            (static_cast<std::uint64_t>(event.key) << 1) | (event.is_down ? 1 : 0),
+            std::memory_order_relaxed
+        );
+
+        if (!listening.load()) { return; }
+
+        listener::event e;
+        e.key = event.key;
+        e.is_down = event.is_down;
+        e.time = std::chrono::steady_clock::now();
+
+        std::lock_guard lock(mutex);
+        for (mock_source *s : sources) { s->push(e); }
+    }
+
+    std::atomic<std::uint64_t> bits[detail::key_index_count / 64] = {};
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> ring;
+    std::uint64_t                                 mask = 0;
+    std::atomic<std::uint64_t>                    count{0};
+
+    std::atomic<bool>          listening{false};
+    std::mutex                 mutex;
+    std::vector<mock_source *> sources;
+
+    std::atomic<int>           cursor_x{0};
+    std::atomic<int>           cursor_y{0};
+    std::atomic<unsigned>      buttons{0};
+    std::atomic<int>           scroll_x{0};
+    std::atomic<int>           scroll_y{0};
+    std::atomic<std::uint64_t> mouse_count{0};
+    std::atomic<std::uint64_t> mouse_batches{0};
+
+    std::shared_ptr<const layout> empty = std::make_shared<const layout>();
+};
+
+/**
+ * @brief Asynchronous injector of key events
+ *
+ * @details
+ *  Events are put into bounded lock-free multi-producer single-consumer ring
+ *  and sent by injector's own thread.
+ *  Everything, that has been accumulated since the last batch,
+ *  is sent at once with single send(), so bursts take fewer round trips to OS.
+ *
+ *  Every event gets a sequence number. Events of a single thread are sent in order.
+ *  Use wait() to make sure, that event was sent.
+ */
+class async_injector
+{
+public:
+    /// Sequence number of event (0 means no event)
+    using sequence = std::uint64_t;
+
+    /**
+     * @brief Start injector's thread
+     *
+     * @param capacity Size of ring (rounded up to power of 2)
+     * @param affinity CPUs for injector's thread (empty means any CPU)
+     *
+     * @note Events are sent to current_backend() of the thread, that makes injector.
+     */
+    explicit async_injector(std::size_t capacity = 1024, cpu::cpu_set affinity = {})
+        : target(current_backend()), affinity(std::move(affinity))
+    {
+        std::size_t size = 1;
+        while (size < capacity) { size *= 2; }
+
+        mask = size - 1;
+        slots = std::make_unique<slot[]>(size);
+        for (std::size_t i = 0; i < size; ++i) { slots[i].seq.store(i, std::memory_order_relaxed); }
+        batch.reserve(size);
+
+        worker = std::thread([this] { run(); });
+    }
+
+    async_injector(const async_injector &) = delete;
+    async_injector(async_injector &&) = delete;
+    void operator=(const async_injector &) = delete;
+    void operator=(async_injector &&) = delete;
+
+    /// Send remaining events and stop injector's thread
+    ~async_injector()
+    {
+        stopping.store(true);
+        wake();
+        worker.join();
+    }
+
+    /**
+     * @brief Queue single event
+     *
+     * @details Doesn't block, unless ring is full.
+     *
+     * @return Sequence number of event
+     */
+    sequence submit(const key_event &event)
+    {
+        std::uint64_t pos = tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            slot &s = slots[pos & mask];
+            const std::uint64_t seq = s.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::int64_t>(seq - pos);
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            }
+            else if (diff < 0)
+            {
+                // Ring is full. Wait for injector's thread
+                std::this_thread::yield();
+                pos = tail.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot &s = slots[pos & mask];
+        s.event = event;
+        // Sequentially consistent with the check of injector's thread before sleep
+        s.seq.store(pos + 1);
+        if (sleeping.load()) { wake(); }
+        return pos + 1;
+    }
+
+    /// Queue events. Returns sequence number of the last one
+    sequence submit(span<const key_event> events)
+    {
+        sequence last = 0;
+        for (const auto &event : events) { last = submit(event); }
+        return last;
+    }
+
+    /// Queue press of combination (until release()). Returns sequence number of the last event
+    sequence press(const combination &combo)
+    {
+        sequence last = 0;
+        for (vk key : combo) { last = submit(key_event{key, true}); }
+        return last;
+    }
+    /// Queue release of combination. Returns sequence number of the last event
+    sequence release(const combination &combo)
+    {
+        sequence last = 0;
+        for (vk key : combo) { last = submit(key_event{key, false}); }
+        return last;
+    }
+    /// Queue press() and release() of combination. Returns sequence number of the last event
+    sequence click(const combination &combo)
+    {
+        press(combo);
+        return release(combo);
+    }
+
+    /// Block until event with given sequence number (and every event before) is sent
+    void wait(sequence seq)
+    {
+        if (sent.load(std::memory_order_acquire) >= seq) { return; }
+
+        std::unique_lock lock(mutex);
+        done.wait(lock, [this, seq] { return sent.load(std::memory_order_acquire) >= seq; });
+    }
+
+    /// Block until every queued event is sent
+    void flush() { wait(tail.load()); }
+
+private:
+    struct slot
+    {
+        std::atomic<std::uint64_t> seq{0};
+        key_event                  event{};
+    };
+
+    void wake()
+    {
+        // Lock guarantees, that injector's thread is either awake or waiting
+        { std::lock_guard lock(mutex); }
+        ready.notify_one();
+    }
+
+    // Take every published event from the ring
+    void drain()
+    {
+        batch.clear();
+        while (true)
+        {
+            slot &s = slots[head & mask];
+            if (s.seq.load(std::memory_order_acquire) != head + 1) { break; }
+
+            batch.push_back(s.event);
+            s.seq.store(head + mask + 1, std::memory_order_release);
+            ++head;
+        }
+    }
+
+    void run()
+    {
+        if (!affinity.empty()) { thread::pin(affinity); }
+
+        while (true)
+        {
+            drain();
+            if (!batch.empty())
+            {
+                target.send(span<const key_event>(batch.data(), batch.size()));
+                sent.store(head, std::memory_order_release);
+                { std::lock_guard lock(mutex); }
+                done.notify_all();
+                continue;
+            }
+
+            if (stopping.load()) { break; }
+
+            std::unique_lock lock(mutex);
+            sleeping.store(true);
+            ready.wait(lock, [this]
+            {
+                return stopping.load() || slots[head & mask].seq.load() == head + 1;
+            });
+            sleeping.store(false);
+        }
+    }
+
+    std::unique_ptr<slot[]> slots;
+    std::uint64_t           mask = 0;
+
+    alignas(64) std::atomic<std::uint64_t> tail{0}; // Next position for producers
+    alignas(64) std::uint64_t              head = 0; // Next position for injector's thread
+    alignas(64) std::atomic<std::uint64_t> sent{0};  // Sequence number of the last sent event
+
+    std::atomic<bool>       sleeping{false};
+    std::atomic<bool>       stopping{false};
+    std::mutex              mutex;
+    std::condition_variable ready;
+    std::condition_variable done;
+
+    backend               &target;
+    cpu::cpu_set           affinity;
+    std::vector<key_event> batch;
+    std::thread            worker;
+};
+
+/**
+ * @brief Player of timed key events
+ *
+ * @details
+ *  Events are sent on player's own thread with raised priority.
+ *  Thread sleeps until absolute deadline of each event
+ *  and spins for the last moment to reduce jitter.
+ *  Events with the same time are sent as a single batch.
+ *
+ *  Difference between actual and scheduled time is measured for every event,
+ *  so bad runs may be rejected.
+ */
+class player
+{
+public:
+    /// Key event with time since start of playback
+    struct event : key_event
+    {
+        /// Time since start of playback
+        std::chrono::nanoseconds time{0};
+    };
+
+    /**
+     * @brief Prepare playback of events
+     *
+     * @param events Events, sorted by time
+     * @param spin     Time to spin before each deadline instead of sleeping
+     * @param affinity CPUs for player's thread (empty means any CPU)
+     *
+     * @note Events are sent to current_backend() of the thread, that makes player.
+     */
+    explicit player(
+        span<const event> events,
+        std::chrono::nanoseconds spin = std::chrono::microseconds(500),
+        cpu::cpu_set affinity = {}
+    )
+        : events(events.begin(), events.end()), spin(spin), scheduling_errors(events.size()),
+          target(current_backend()), affinity(std::move(affinity)) {}
+
+    player(const player &) = delete;
+    player(player &&) = delete;
+    void operator=(const player &) = delete;
+    void operator=(player &&) = delete;
+
+    /// Wait for the end of playback
+    ~player() { wait(); }
+
+    /// Start playback on player's own thread. Time is counted from the moment thread is ready
+    void start()
+    {
+        if (worker.joinable()) { return; }
+        done.store(false);
+        worker = std::thread([this] { run(); });
+    }
+
+    /// Block until every event is sent
+    void wait()
+    {
+        if (worker.joinable()) { worker.join(); }
+    }
+
+    /// Check if every event was sent
+    bool finished() const noexcept { return done.load(); }
+
+    /**
+     * @brief Get scheduling error of every event
+     *
+     * @details Positive error means, that event was sent late.
+     *
+     * @warning Valid only after playback is finished().
+     */
+    const std::vector<std::chrono::nanoseconds> & errors() const noexcept { return scheduling_errors; }
+
+    /// Get max absolute scheduling error
+    std::chrono::nanoseconds max_error() const noexcept
+    {
+        std::chrono::nanoseconds max{0};
+        for (auto error : scheduling_errors)
+        {
+            if (error < -max || error > max) { max = error < error.zero() ? -error : error; }
+        }
+        return max;
+    }
+
+private:
+    void run()
+    {
+        if (!affinity.empty()) { thread::pin(affinity); }
+        detail::raise_thread_priority();
+
+        std::vector<key_event> batch;
+        batch.reserve(events.size());
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < events.size();)
+        {
+            const auto deadline = start + events[i].time;
+
+            // Collect events with the same time
+            std::size_t end = i;
+            batch.clear();
+            while (end < events.size() && events[end].time == events[i].time)
+            {
+                batch.push_back(events[end]);
+                ++end;
+            }
+
+            detail::precise_sleep_until(deadline - spin);
+            auto now = std::chrono::steady_clock::now();
+            while (now < deadline) { now = std::chrono::steady_clock::now(); }
+
+            target.send(span<const key_event>(batch.data(), batch.size()));
+
+            for (; i < end; ++i) { scheduling_errors[i] = now - deadline; }
+        }
+
+        done.store(true);
+    }
+
+    std::vector<event>                    events;
+    std::chrono::nanoseconds              spin;
+    std::vector<std::chrono::nanoseconds> scheduling_errors;
+    backend                              &target;
+    cpu::cpu_set                          affinity;
+
+    std::atomic<bool> done{false};
+    std::thread       worker;
+};
+
+} // namespace os::keyboard
+
+namespace os::detail
+{
+
+/**
+ * @brief Listener, that passes its events to every subscribed wait
+ *
+ * @details Listener of native backend is made on first wait and kept until exit,
+ *  so waiting in a loop doesn't connect to OS each time.
+ */
+class shared_listener
+{
+public:
+    /// Events, queued for one wait
+    struct subscription
+    {
+        std::deque<keyboard::listener::event> events;
+    };
+
+    /// Start listening with current_backend()
+    shared_listener() : events([this](const keyboard::listener::event &e) { push(e); }) {}
+
+    /// Get listener of native backend
+    static shared_listener & native()
+    {
+        static shared_listener l;
+        return l;
+    }
+
+    /// Check if OS delivers events to listener
+    bool active() const noexcept { return events.active(); }
+
+    /// Start queueing events for subscription
+    void subscribe(subscription &s)
+    {
+        std::lock_guard lock(mutex);
+        subscriptions.push_back(&s);
+    }
+
+    /// Stop queueing events for subscription
+    void unsubscribe(subscription &s)
+    {
+        std::lock_guard lock(mutex);
+        subscriptions.erase(std::find(subscriptions.begin(), subscriptions.end(), &s));
+    }
+
+    /**
+     * @brief Wait for next event of subscription
+     *
+     * @param deadline Time to stop waiting at (nullptr to wait forever)
+     *
+     * @return Event or `std::nullopt` on timeout
+     */
+    std::optional<keyboard::listener::event> next_event(
+        subscription &s,
+        const std::chrono::steady_clock::time_point *deadline
+    )
+    {
+        std::unique_lock lock(mutex);
+        auto queued = [&s] { return !s.events.empty(); };
+        if (!deadline) { ready.wait(lock, queued); }
+        else if (!ready.wait_until(lock, *deadline, queued)) { return std::nullopt; }
+
+        keyboard::listener::event e = s.events.front();
+        s.events.pop_front();
+        return e;
+    }
+
+private:
+    // Called on listener's thread
+    void push(const keyboard::listener::event &e)
+    {
+        {
+            std::lock_guard lock(mutex);
+            for (auto *s : subscriptions) { s->events.push_back(e); }
+        }
+        ready.notify_all();
+    }
+
+    std::mutex                  mutex;
+    std::condition_variable     ready;
+    std::vector<subscription *> subscriptions;
+
+    // Last, so it stops before other members are destroyed
+    keyboard::listener events;
+};
+
+/**
+ * @brief Wait until any of combinations is fully pressed or released
+ *
+ * @details Sleeps on listener, shared with other waits on the same backend.
+ *  If listener isn't active (e.g. XRecord is missing or evdev is unreadable),
+ *  keys are polled with pressed_keys() every 10ms instead.
+ *
+ * @param combos Combinations to wait for
+ * @param released Wait for release instead of press
+ * @param deadline Time to stop waiting at (nullptr to wait forever)
+ *
+ * @return Index of the first matching combination or `std::nullopt` on timeout
+ */
+inline std::optional<std::size_t> wait_for_keys(
+    span<const keyboard::combination> combos,
+    bool released,
+    const std::chrono::steady_clock::time_point *deadline
+)
+{
+    auto match = [&](const keyboard::combination &held) -> std::optional<std::size_t>
+    {
+        for (std::size_t i = 0; i < combos.size(); ++i)
+        {
+            if (released ? !held.intersects(combos[i]) : held.contains(combos[i])) { return i; }
+        }
+        return std::nullopt;
+    };
+
+    // Other backends (e.g. mock) get listener just for this wait
+    std::optional<shared_listener> own;
+    shared_listener &events = &keyboard::current_backend() == &keyboard::native_backend()
+        ? shared_listener::native()
+        : own.emplace();
+
+    if (!events.active())
+    {
+        while (true)
+        {
+            if (auto i = match(keyboard::pressed_keys())) { return i; }
+            if (deadline && std::chrono::steady_clock::now() >= *deadline) { return std::nullopt; }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    // Subscribe before snapshot, so no event is lost
+    shared_listener::subscription queue;
+    events.subscribe(queue);
+    struct unsubscribe_on_exit
+    {
+        shared_listener &events;
+        shared_listener::subscription &queue;
+        ~unsubscribe_on_exit() { events.unsubscribe(queue); }
+    } guard { events, queue };
+
+    const auto since = std::chrono::steady_clock::now();
+    keyboard::combination held = keyboard::snapshot().pressed_keys();
+
+    while (true)
+    {
+        if (auto i = match(held)) { return i; }
+
+        const auto e = events.next_event(queue, deadline);
+        if (!e) { return std::nullopt; }
+
+        // Already taken into account by snapshot
+        if (e->time < since) { continue; }
+
+        if (e->is_down) { held.insert(e->key); } else { held.erase(e->key); }
+    }
+}
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+/**
+ * @brief Sleep until every key in combination is pressed
+ *
+ * @details Uses listener, shared by waits of the process, so no CPU time is spent while waiting.
+ *  The first wait on native backend connects to OS (e.g. XRecord on X11) and keeps the connection.
+ *  If listener is not active(), keys are polled every 10ms instead.
+ *
+ * @return `true`, when keys are pressed
+ */
+inline bool wait_for(const combination &combo)
+{
+    return detail::wait_for_keys(span<const combination>(&combo, 1), false, nullptr).has_value();
+}
+
+/**
+ * @brief Sleep until every key in combination is pressed, but no longer than timeout
+ *
+ * @details Keys are polled every 10ms, if listener is not active().
+ *
+ * @return `false` on timeout
+ */
+template <class Rep, class Period>
+bool wait_for(const combination &combo, const std::chrono::duration<Rep, Period> &timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    return detail::wait_for_keys(span<const combination>(&combo, 1), false, &deadline).has_value();
+}
+
+/**
+ * @brief Sleep until no key in combination is pressed, but no longer than timeout
+ *
+ * @details Keys are polled every 10ms, if listener is not active().
+ *
+ * @return `false` on timeout
+ */
+template <class Rep, class Period>
+bool wait_for_release(const combination &combo, const std::chrono::duration<Rep, Period> &timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    return detail::wait_for_keys(span<const combination>(&combo, 1), true, &deadline).has_value();
+}
+
+/// Sleep until no key in combination is pressed (always returns `true`)
+inline bool wait_for_release(const combination &combo)
+{
+    return detail::wait_for_keys(span<const combination>(&combo, 1), true, nullptr).has_value();
+}
+
+/**
+ * @brief Sleep until any of combinations is fully pressed
+ *
+ * @return Index of pressed combination
+ */
+inline std::optional<std::size_t> wait_for_any(span<const combination> combos)
+{
+    return detail::wait_for_keys(combos, false, nullptr);
+}
+
+/**
+ * @brief Sleep until any of combinations is fully pressed, but no longer than timeout
+ *
+ * @return Index of pressed combination or `std::nullopt` on timeout
+ */
+template <class Rep, class Period>
+std::optional<std::size_t> wait_for_any(span<const combination> combos, const std::chrono::duration<Rep, Period> &timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    return detail::wait_for_keys(combos, false, &deadline);
+}
+
+/// Operation of native backend, measured by stats()
+enum class operation
+{
+    /// Read state of keys (`XQueryKeymap`, `EVIOCGKEY`, `GetAsyncKeyState`, `GetKeyboardState`)
+    query_keymap,
+    /// Pass single key event to OS (`XTestFakeKeyEvent`, `CGEventPost`). uinput events are written at flush
+    fake_key_event,
+    /// Submit buffered events (`XFlush`, `write` to uinput, `SendInput`)
+    flush,
+    /// Fetch value of HID element or input event (`IOHIDDeviceGetValue`, evdev `read`)
+    hid_value_fetch,
+};
+
+/// Number of measured operations
+constexpr std::size_t operation_count = 4;
+
+/**
+ * @brief Counters of single operation
+ *
+ * @details
+ *  Latencies are put into log-scaled buckets:
+ *  bucket `0` counts calls shorter than 1 ns and bucket `i` counts calls
+ *  of `[2^(i-1), 2^i)` ns. The last bucket also counts longer calls.
+ */
+struct operation_stats
+{
+    /// Number of latency buckets
+    static constexpr std::size_t bucket_count = 40;
+
+    /// Number of calls
+    std::uint64_t calls = 0;
+    /// Total time of calls in nanoseconds
+    std::uint64_t total_ns = 0;
+    /// Longest call in nanoseconds
+    std::uint64_t max_ns = 0;
+    /// Histogram of latencies
+    std::uint64_t buckets[bucket_count] = {};
+};
+
+/// Counters of every operation
+struct stats_t
+{
+    /// Counters, indexed by operation
+    operation_stats operations[operation_count] = {};
+
+    /// Get counters of operation
+    constexpr const operation_stats & operator[](operation op) const noexcept
+    {
+        return operations[static_cast<std::size_t>(op)];
+    }
+};
+
+/// Check if library was built with `LIBOS_KEYBOARD_STATS`
+constexpr bool stats_enabled() noexcept
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Get counters of native backend, summed over all threads
+ *
+ * @details
+ *  Every thread counts its own calls with relaxed atomics,
+ *  so measuring doesn't add contention between threads.
+ *
+ * @note Without `LIBOS_KEYBOARD_STATS` nothing is measured and counters are always zero.
+ */
+stats_t stats();
+
+/// Reset counters of every thread
+void reset_stats();
+
+} // namespace os::keyboard
+
+namespace os::detail
+{
+
+/// Get number of bits, needed to represent value
+constexpr unsigned bit_width(std::uint64_t word) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return word == 0 ? 0 : 64 - static_cast<unsigned>(__builtin_clzll(word));
+#else
+    unsigned width = 0;
+    while (word != 0) { word >>= 1; ++width; }
+    return width;
+#endif
+}
+
+#ifdef LIBOS_KEYBOARD_STATS
+/// Counters of single thread
+struct stats_block
+{
+    /// Counters of single operation
+    struct counters
+    {
+        std::atomic<std::uint64_t> calls{0};
+        std::atomic<std::uint64_t> total_ns{0};
+        std::atomic<std::uint64_t> max_ns{0};
+        std::atomic<std::uint64_t> buckets[keyboard::operation_stats::bucket_count] = {};
+    };
+
+    counters operations[keyboard::operation_count];
+
+    /**
+     * @brief Count call of operation
+     *
+     * @note Counters are updated atomically, because clear() may zero them from another thread.
+     *  Only owning thread writes otherwise, so they aren't contended
+     */
+    void record(keyboard::operation op, std::uint64_t ns) noexcept
+    {
+        auto &c = operations[static_cast<std::size_t>(op)];
+        const std::size_t bucket = std::min<std::size_t>(bit_width(ns), std::size(c.buckets) - 1);
+
+        c.calls.fetch_add(1, std::memory_order_relaxed);
+        c.total_ns.fetch_add(ns, std::memory_order_relaxed);
+        std::uint64_t max = c.max_ns.load(std::memory_order_relaxed);
+        while (ns > max && !c.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+        c.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Add counters to result
+    void add_to(keyboard::stats_t &result) const noexcept
+    {
+        for (std::size_t op = 0; op < keyboard::operation_count; ++op)
+        {
+            const auto &c = operations[op];
+            auto &r = result.operations[op];
+            r.calls += c.calls.load(std::memory_order_relaxed);
+            r.total_ns += c.total_ns.load(std::memory_order_relaxed);
+            r.max_ns = std::max(r.max_ns, c.max_ns.load(std::memory_order_relaxed));
+            for (std::size_t b = 0; b < std::size(c.buckets); ++b)
+            {
+                r.buckets[b] += c.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Set every counter to zero
+    void clear() noexcept
+    {
+        for (auto &c : operations)
+        {
+            c.calls.store(0, std::memory_order_relaxed);
+            c.total_ns.store(0, std::memory_order_relaxed);
+            c.max_ns.store(0, std::memory_order_relaxed);
+            for (auto &bucket : c.buckets) { bucket.store(0, std::memory_order_relaxed); }
+        }
+    }
+};
+
+/// Counters of every thread
+class stats_registry
+{
+public:
+    /// Get registry of the library
+    static stats_registry & get()
+    {
+        static stats_registry registry;
+        return registry;
+    }
+
+    /// Get counters of current thread
+    static stats_block & local()
+    {
+        // Counters are registered on the first call of thread and merged on its exit
+        thread_local const attached block(get());
+        return *block.counters;
+    }
+
+    /// Sum counters of every thread
+    keyboard::stats_t collect()
+    {
+        std::lock_guard lock(mutex);
+        keyboard::stats_t result = retired;
+        for (const auto &block : blocks) { block->add_to(result); }
+        return result;
+    }
+
+    /// Reset counters of every thread
+    void clear()
+    {
+        std::lock_guard lock(mutex);
+        retired = {};
+        for (auto &block : blocks) { block->clear(); }
+    }
+
+private:
+    // Registration of thread's counters
+    struct attached
+    {
+        explicit attached(stats_registry &registry) : registry(registry), counters(registry.attach()) {}
+        ~attached() { registry.detach(counters); }
+
+        stats_registry &registry;
+        stats_block    *counters;
+    };
+
+    stats_block * attach()
+    {
+        std::lock_guard lock(mutex);
+        blocks.push_back(std::make_unique<stats_block>());
+        return blocks.back().get();
+    }
+
+    void detach(stats_block *block)
+    {
+        std::lock_guard lock(mutex);
+        block->add_to(retired);
+        blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](const auto &b) { return b.get() == block; }));
+    }
+
+    std::mutex                                mutex;
+    std::vector<std::unique_ptr<stats_block>> blocks;
+    keyboard::stats_t                         retired; // Counters of exited threads
+};
+
+/// Measure operation until the end of scope
+class stats_timer
+{
+public:
+    /// Start measuring
+    explicit stats_timer(keyboard::operation op) noexcept
+        : op(op), start(std::chrono::steady_clock::now()) {}
+
+    stats_timer(const stats_timer &) = delete;
+    stats_timer(stats_timer &&) = delete;
+    void operator=(const stats_timer &) = delete;
+    void operator=(stats_timer &&) = delete;
+
+    /// Count operation
+    ~stats_timer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        stats_registry::local().record(
+            op, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+        );
+    }
+
+private:
+    keyboard::operation                   op;
+    std::chrono::steady_clock::time_point start;
+};
+#else
+/// Does nothing without `LIBOS_KEYBOARD_STATS`
+class stats_timer
+{
+public:
+    constexpr explicit stats_timer(keyboard::operation) noexcept {}
+};
+#endif // LIBOS_KEYBOARD_STATS
+
+} // namespace os::detail
+
+#endif // LIBOS_HEADER_ONLY_KEYBOARD_HPP
+
+// -------------------------
+// |    IMPLEMENTATION     |
+// -------------------------
+
+#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined(LIBOS_KEYBOARD_CPP_IMPLEMENTED)
+#define LIBOS_KEYBOARD_CPP_IMPLEMENTED
+
+#include "macros.h"
+
+#if IS_OS_LINUX
+// src/linux/keyboard.cpp
+// =========================
+#include "keyboard.hpp"
+
+#include "macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#ifndef LIBOS_NO_X11
+    #include <X11/Xlib.h>
+    #include <X11/XKBlib.h>
+    #include <X11/Xutil.h>
+    #include <X11/keysym.h>
+    #include <X11/extensions/XTest.h>
+    #include <X11/extensions/record.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+// Number of X connections, shared by threads
+#ifndef LIBOS_X11_CONNECTIONS
+    #define LIBOS_X11_CONNECTIONS 8
+#endif
+
+namespace os::detail
+{
+
+// Raise priority of current thread for time-critical work (if possible)
+void raise_thread_priority() noexcept
+{
+    // Lowest real-time priority is still above any normal thread.
+    // Fails without CAP_SYS_NICE, then priority stays the same
+    sched_param param = {};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+// Sleep until deadline with the best precision available
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline) noexcept
+{
+    // steady_clock is CLOCK_MONOTONIC, so deadline may be used as is
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    if (ns <= 0) { return; }
+
+    timespec ts;
+    ts.tv_sec  = ns / 1'000'000'000;
+    ts.tv_nsec = ns % 1'000'000'000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+}
+
+#ifndef LIBOS_NO_X11
+// Get character, typed by keysym (0, if none)
+constexpr char32_t keysym_to_char32(KeySym sym) noexcept
+{
+    // Latin-1 keysyms are the same as code points
+    if ((sym >= 0x20 && sym <= 0x7E) || (sym >= 0xA0 && sym <= 0xFF)) { return static_cast<char32_t>(sym); }
+    // Directly encoded Unicode keysyms
+    if ((sym & 0xFF000000) == 0x01000000) { return static_cast<char32_t>(sym & 0x00FFFFFF); }
+
+    switch (sym)
+    {
+        case XK_Return:                 return U'\n';
+        case XK_Tab:                    return U'\t';
+        case XK_KP_Space:               return U' ';
+        // Cyrillic letters, missing in KOI8 order below
+        case XK_Cyrillic_io:            return 0x0451;
+        case XK_Cyrillic_IO:            return 0x0401;
+        case XK_Ukrainian_ghe_with_upturn: return 0x0491;
+        case XK_Ukrainian_GHE_WITH_UPTURN: return 0x0490;
+        case XK_numerosign:             return 0x2116;
+        // Greek sigma and final sigma are swapped relative to Unicode
+        case XK_Greek_SIGMA:            return 0x03A3;
+        case XK_Greek_sigma:            return 0x03C3;
+        case XK_Greek_finalsmallsigma:  return 0x03C2;
+        default: break;
+    }
+
+    // Serbian, Macedonian, Ukrainian and Belarusian letters
+    if (sym >= 0x6A1 && sym <= 0x6AF) { return static_cast<char32_t>((sym <= 0x6A2 ? 0x0451 : 0x0450) + (sym - 0x6A0)); }
+    if (sym >= 0x6B1 && sym <= 0x6BF) { return static_cast<char32_t>((sym <= 0x6B2 ? 0x0401 : 0x0400) + (sym - 0x6B0)); }
+    // Russian letters in KOI8 order
+    if (sym >= 0x6C0 && sym <= 0x6FF)
+    {
+        constexpr char16_t koi8[] = u"юабцдефгхийклмнопярстужвьызшэщчъ";
+        const char32_t lower = koi8[(sym - 0x6C0) % 32];
+        return sym < 0x6E0 ? lower : lower - 0x20;
+    }
+    // Greek letters
+    if (sym >= 0x7C1 && sym <= 0x7D9) { return static_cast<char32_t>(0x0391 + (sym - 0x7C1)); }
+    if (sym >= 0x7E1 && sym <= 0x7F9) { return static_cast<char32_t>(0x03B1 + (sym - 0x7E1)); }
+    return 0;
+}
+#endif
+
+// Get evdev key code of keysym on US keyboard (0, if none)
+constexpr std::uint16_t evdev_code(unsigned sym) noexcept
+{
+    constexpr std::uint16_t letters[] =
+    {
+        KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I,
+        KEY_J, KEY_K, KEY_L, KEY_M, KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R,
+        KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+    };
+    constexpr std::uint16_t keypad[] =
+    {
+        KEY_KP0, KEY_KP1, KEY_KP2, KEY_KP3, KEY_KP4,
+        KEY_KP5, KEY_KP6, KEY_KP7, KEY_KP8, KEY_KP9
+    };
+
+    if (sym >= 'A' && sym <= 'Z') { return letters[sym - 'A']; }
+    if (sym >= 'a' && sym <= 'z') { return letters[sym - 'a']; }
+    if (sym >= '1' && sym <= '9') { return static_cast<std::uint16_t>(KEY_1 + (sym - '1')); }
+    if (sym >= 0xFFB0 && sym <= 0xFFB9) { return keypad[sym - 0xFFB0]; }
+    // F1-F10 are consecutive
+    if (sym >= 0xFFBE && sym <= 0xFFC7) { return static_cast<std::uint16_t>(KEY_F1 + (sym - 0xFFBE)); }
+
+    switch (sym)
+    {
+        case '0':    return KEY_0;
+        case ' ':    return KEY_SPACE;
+        case '-':    return KEY_MINUS;
+        case '=':    return KEY_EQUAL;
+        case '[':    return KEY_LEFTBRACE;
+        case ']':    return KEY_RIGHTBRACE;
+        case '\\':   return KEY_BACKSLASH;
+        case ';':    return KEY_SEMICOLON;
+        case '\'':   return KEY_APOSTROPHE;
+        case '`':    return KEY_GRAVE;
+        case ',':    return KEY_COMMA;
+        case '.':    return KEY_DOT;
+        case '/':    return KEY_SLASH;
+
+        case 0xFF08: return KEY_BACKSPACE;
+        case 0xFF09: return KEY_TAB;
+        case 0xFF0D: return KEY_ENTER;
+        case 0xFF13: return KEY_PAUSE;
+        case 0xFF14: return KEY_SCROLLLOCK;
+        case 0xFF1B: return KEY_ESC;
+        case 0xFF50: return KEY_HOME;
+        case 0xFF51: return KEY_LEFT;
+        case 0xFF52: return KEY_UP;
+        case 0xFF53: return KEY_RIGHT;
+        case 0xFF54: return KEY_DOWN;
+        case 0xFF55: return KEY_PAGEUP;
+        case 0xFF56: return KEY_PAGEDOWN;
+        case 0xFF57: return KEY_END;
+        case 0xFF61: return KEY_SYSRQ;
+        case 0xFF63: return KEY_INSERT;
+        case 0xFF67: return KEY_COMPOSE;
+        case 0xFF7F: return KEY_NUMLOCK;
+        case 0xFF8D: return KEY_KPENTER;
+        case 0xFFAA: return KEY_KPASTERISK;
+        case 0xFFAB: return KEY_KPPLUS;
+        case 0xFFAD: return KEY_KPMINUS;
+        case 0xFFAE: return KEY_KPDOT;
+        case 0xFFAF: return KEY_KPSLASH;
+        case 0xFFC8: return KEY_F11;
+        case 0xFFC9: return KEY_F12;
+        case 0xFFE1: return KEY_LEFTSHIFT;
+        case 0xFFE2: return KEY_RIGHTSHIFT;
+        case 0xFFE3: return KEY_LEFTCTRL;
+        case 0xFFE4: return KEY_RIGHTCTRL;
+        case 0xFFE5: return KEY_CAPSLOCK;
+        case 0xFFE9: return KEY_LEFTALT;
+        case 0xFFEA: return KEY_RIGHTALT;
+        case 0xFFEB: return KEY_LEFTMETA;
+        case 0xFFEC: return KEY_RIGHTMETA;
+        case 0xFFFF: return KEY_DELETE;
+        default:     return 0;
+    }
+}
+
+// Get unshifted character of US keyboard, that types c with Shift (0, if none)
+constexpr char32_t us_unshifted(char32_t c) noexcept
+{
+    constexpr char pairs[][2] =
+    {
+        { '!', '1' }, { '@', '2' }, { '#', '3' }, { '$', '4' }, { '%', '5' },
+        { '^', '6' }, { '&', '7' }, { '*', '8' }, { '(', '9' }, { ')', '0' },
+        { '_', '-' }, { '+', '=' }, { '{', '[' }, { '}', ']' }, { '|', '\\' },
+        { ':', ';' }, { '"', '\'' }, { '~', '`' }, { '<', ',' }, { '>', '.' },
+        { '?', '/' }
+    };
+
+    if (c >= 'A' && c <= 'Z') { return c; }
+    for (const auto &pair : pairs)
+    {
+        if (c == static_cast<char32_t>(pair[0])) { return static_cast<char32_t>(pair[1]); }
+    }
+    return 0;
+}
+
+// Builds layout tables
+class layout_builder
+{
+public:
+    // Build tables of US keyboard for evdev key codes.
+    // Modifier 1 is Shift, like ShiftMask of X
+    static std::shared_ptr<keyboard::layout> build_evdev()
+    {
+        auto result = make();
+
+        for (std::size_t i = 0; i < key_index_count; ++i)
+        {
+            const keyboard::vk key = key_at(i);
+            const std::uint16_t code = evdev_code(static_cast<unsigned>(key));
+            if (code == 0) { continue; }
+
+            result->codes[i] = code;
+            // Uppercase letters come first, like keysyms from X
+            if (code < std::size(result->keys) && result->keys[code] == keyboard::vk{})
+            {
+                result->keys[code] = key;
+            }
+        }
+
+        result->modifier_keys[0] = KEY_LEFTSHIFT;
+
+        result->chars.insert(U'\n', KEY_ENTER, 0);
+        result->chars.insert(U'\t', KEY_TAB, 0);
+        for (char32_t c = 0x20; c < 0x7F; ++c)
+        {
+            if (const char32_t base = us_unshifted(c))
+            {
+                result->chars.insert(c, evdev_code(base), 1);
+            }
+            else if (const std::uint16_t code = evdev_code(c))
+            {
+                result->chars.insert(c, code, 0);
+            }
+        }
+        return result;
+    }
+
+#ifndef LIBOS_NO_X11
+    // Build tables with a few requests to X server
+    static std::shared_ptr<keyboard::layout> build(Display *display)
+    {
+        auto result = make();
+        if (!display) { return result; }
+
+        load_keys(display, *result);
+        load_chars(display, *result);
+        return result;
+    }
+#endif
+
+private:
+    // Create empty layout with next generation number
+    static std::shared_ptr<keyboard::layout> make()
+    {
+        static std::atomic<std::uint64_t> loaded { 0 };
+
+        auto result = std::make_shared<keyboard::layout>();
+        result->number = loaded++;
+        return result;
+    }
+
+#ifndef LIBOS_NO_X11
+    // Build keysym -> keycode and keycode -> keysym tables
+    // with a single request to X server
+    static void load_keys(Display *display, keyboard::layout &result)
+    {
+        int min_keycode = 0, max_keycode = 0;
+        XDisplayKeycodes(display, &min_keycode, &max_keycode);
+
+        int per_keycode = 0;
+        KeySym *mapping = XGetKeyboardMapping(
+            display,
+            min_keycode,
+            max_keycode - min_keycode + 1,
+            &per_keycode
+        );
+        if (!mapping) { return; }
+
+        auto at = [&](int code, int column) -> KeySym
+        {
+            KeySym sym = mapping[(code - min_keycode) * per_keycode + column];
+            // Lowercase-only entry means the same key for uppercase
+            if (sym == NoSymbol && column == 1 && per_keycode > 1)
+            {
+                KeySym lower, upper;
+                XConvertCase(mapping[(code - min_keycode) * per_keycode], &lower, &upper);
+                sym = upper;
+            }
+            return sym;
+        };
+
+        // Same order as XKeysymToKeycode: lower columns first, then lower keycodes
+        for (int column = 0; column < per_keycode; ++column)
+        {
+            for (int code = min_keycode; code <= max_keycode; ++code)
+            {
+                const std::size_t i = key_index(static_cast<keyboard::vk>(at(code, column)));
+                if (i != no_key_index && result.codes[i] == 0)
+                {
+                    result.codes[i] = static_cast<KeyCode>(code);
+                }
+            }
+        }
+
+        for (int code = min_keycode; code <= max_keycode; ++code)
+        {
+            // Our letters are uppercase keysyms
+            KeySym lower, upper;
+            XConvertCase(at(code, 0), &lower, &upper);
+            result.keys[code] = static_cast<keyboard::vk>(upper);
+        }
+
+        XFree(mapping);
+    }
+
+    // Get modifiers, that select level of key type (nullopt if none)
+    static std::optional<unsigned> level_modifiers(const XkbKeyTypeRec &type, int level)
+    {
+        if (level == 0) { return 0u; }
+
+        std::optional<unsigned> modifiers;
+        for (int i = 0; i < type.map_count; ++i)
+        {
+            const XkbKTMapEntryRec &entry = type.map[i];
+            if (!entry.active || entry.level != level) { continue; }
+            // Prefer entries without Caps Lock
+            if (!(entry.mods.mask & LockMask)) { return entry.mods.mask; }
+            if (!modifiers) { modifiers = entry.mods.mask; }
+        }
+        return modifiers;
+    }
+
+    // Build character -> (keycode, modifiers) table for active group
+    // of XKB keyboard map
+    static void load_chars(Display *display, keyboard::layout &result)
+    {
+        XkbDescPtr xkb = XkbGetMap(
+            display,
+            XkbKeyTypesMask | XkbKeySymsMask | XkbModifierMapMask,
+            XkbUseCoreKbd
+        );
+        if (!xkb) { return; }
+
+        XkbStateRec state;
+        const unsigned group = XkbGetState(display, XkbUseCoreKbd, &state) == Success ? state.group : 0;
+
+        // First key of every real modifier
+        int max_levels = 0;
+        for (int code = xkb->min_key_code; code <= xkb->max_key_code; ++code)
+        {
+            for (unsigned index = 0; index < 8; ++index)
+            {
+                if ((xkb->map->modmap[code] & (1u << index)) && result.modifier_keys[index] == 0)
+                {
+                    result.modifier_keys[index] = static_cast<KeyCode>(code);
+                }
+            }
+            max_levels = std::max(max_levels, static_cast<int>(XkbKeyGroupsWidth(xkb, code)));
+        }
+
+        // Lower levels first, then lower keycodes
+        for (int level = 0; level < max_levels; ++level)
+        {
+            for (int code = xkb->min_key_code; code <= xkb->max_key_code; ++code)
+            {
+                const int groups = XkbKeyNumGroups(xkb, code);
+                if (groups == 0) { continue; }
+
+                const unsigned g = group % groups;
+                const XkbKeyTypeRec &type = *XkbKeyKeyType(xkb, code, g);
+                if (level >= type.num_levels) { continue; }
+
+                const auto modifiers = level_modifiers(type, level);
+                if (!modifiers) { continue; }
+
+                // Every modifier must have a key to hold
+                bool holdable = true;
+                for (unsigned index = 0; index < 8; ++index)
+                {
+                    holdable = holdable && (!(*modifiers & (1u << index)) || result.modifier_keys[index] != 0);
+                }
+                if (!holdable) { continue; }
+
+                const char32_t c = keysym_to_char32(XkbKeySymEntry(xkb, code, level, g));
+                if (c != 0) { result.chars.insert(c, static_cast<std::uint16_t>(code), *modifiers); }
+            }
+        }
+
+        XkbFreeKeyboard(xkb, 0, True);
+    }
+#endif
+};
+
+// Type text with layout, passing key codes of presses and releases to emit
+template <typename Emit>
+void type_codes(const keyboard::layout &layout, std::u32string_view text, Emit &&emit)
+{
+    // Press and release modifiers only when they change between characters
+    unsigned held = 0;
+    auto hold = [&](unsigned modifiers)
+    {
+        for (unsigned index = 0; index < 8; ++index)
+        {
+            const unsigned mask = 1u << index;
+            if ((held ^ modifiers) & mask)
+            {
+                emit(layout.modifier_key(index), (modifiers & mask) != 0);
+            }
+        }
+        held = modifiers;
+    };
+
+    for (char32_t c : text)
+    {
+        const auto *key = layout.find(c == U'\r' ? U'\n' : c);
+        if (!key) { continue; }
+
+        hold(key->modifiers);
+        emit(key->code, true);
+        emit(key->code, false);
+    }
+    hold(0);
+}
+
+#ifndef LIBOS_NO_X11
+class display_handler;
+
+// Exclusive access to display connection, that is bound to current thread
+class display_lock
+{
+public:
+    display_lock(std::unique_lock<std::mutex> lock, display_handler &handler)
+        : lock(std::move(lock)), handler(handler) {}
+
+    display_handler * operator->() const { return &handler; }
+    display_handler & operator*() const { return handler; }
+
+private:
+    std::unique_lock<std::mutex> lock;
+    display_handler             &handler;
+};
+
+// RAII wrapper for X Server's Display
+class display_handler
+{
+public:
+    // Get connection of current thread.
+    //
+    // Xlib connections are not thread-safe without XInitThreads,
+    // so threads are bound round-robin to a small pool of connections,
+    // each guarded by its own mutex. Threads share a connection only
+    // when there are more of them, than connections.
+    static display_lock get()
+    {
+        thread_local slot &bound = pool()[next().fetch_add(1, std::memory_order_relaxed) % LIBOS_X11_CONNECTIONS];
+        return bound.open();
+    }
+
+    // Open connection, that the next thread will be bound to, and load its layout.
+    // Other connections are opened only by threads, that use them
+    static void warm_next()
+    {
+        pool()[next().load(std::memory_order_relaxed) % LIBOS_X11_CONNECTIONS].open();
+    }
+
+    Display * native() const { return display; }
+
+    // Get tables of current layout
+    const keyboard::layout & mapping() const { return *loaded; }
+
+    // Get tables of current layout, that stay alive after layout change
+    std::shared_ptr<const keyboard::layout> shared_mapping() const { return loaded; }
+
+    // Get keycode of virtual key
+    KeyCode keycode(keyboard::vk key) const
+    {
+        // Not in table. Fallback to linear search in Xlib
+        if (key_index(key) == no_key_index)
+        {
+            return XKeysymToKeycode(display, static_cast<KeySym>(key));
+        }
+        return static_cast<KeyCode>(loaded->code_of(key));
+    }
+
+    // Get virtual key of keycode (NoSymbol if none)
+    KeySym keysym(KeyCode code) const { return static_cast<KeySym>(loaded->key_of(code)); }
+
+    // Get combination of keys, pressed in keymap from XQueryKeymap
+    keyboard::combination keys_of(const char (&keymap)[32]) const
+    {
+        keyboard::combination combo;
+        for (std::size_t w = 0; w < 4; ++w)
+        {
+            std::uint64_t word = 0;
+            for (std::size_t b = 0; b < 8; ++b)
+            {
+                word |= std::uint64_t{static_cast<unsigned char>(keymap[8*w + b])} << (8*b);
+            }
+
+            // Visit only pressed keys
+            for (; word != 0; word &= word - 1)
+            {
+                KeySym sym = keysym(static_cast<KeyCode>(64*w + countr_zero(word)));
+                if (sym != NoSymbol) { combo.insert(static_cast<keyboard::vk>(sym)); }
+            }
+        }
+        return combo;
+    }
+
+    // Reload layout, if keyboard mapping or XKB group has changed.
+    //
+    // Doesn't make any requests to X server:
+    // notifications are delivered to every client, that selected them,
+    // and read along with replies to other requests or from the socket,
+    // if it has data.
+    void update_mapping()
+    {
+        if (!display) { return; }
+
+        bool changed = false;
+        while (XEventsQueued(display, QueuedAfterReading) > 0)
+        {
+            XEvent event;
+            XNextEvent(display, &event);
+            if (event.type == MappingNotify)
+            {
+                XRefreshKeyboardMapping(&event.xmapping);
+                changed = changed || event.xmapping.request == MappingKeyboard;
+            }
+            else if (xkb_event != 0 && event.type == xkb_event)
+            {
+                const auto &xkb = reinterpret_cast<const XkbEvent &>(event);
+                changed = changed
+                    || xkb.any.xkb_type == XkbNewKeyboardNotify
+                    || xkb.any.xkb_type == XkbMapNotify
+                    || (xkb.any.xkb_type == XkbStateNotify && (xkb.state.changed & XkbGroupStateMask));
+            }
+        }
+        if (changed) { loaded = layout_builder::build(display); }
+    }
+
+    display_handler(const display_handler &) = delete;
+    display_handler(display_handler &&) = delete;
+    void operator=(const display_handler &) = delete;
+    void operator=(display_handler &&) = delete;
+
+    ~display_handler() { if (display) { XCloseDisplay(display); } }
+
+private:
+    // Owns connection, that tracks layout of its events
+    friend class xrecord_listener;
+
+    // Connection of the pool, guarded by its own mutex
+    struct slot
+    {
+        std::mutex                       mutex;
+        std::unique_ptr<display_handler> handler;
+
+        // Lock connection. It's opened on first use
+        display_lock open()
+        {
+            std::unique_lock lock(mutex);
+            if (!handler) { handler.reset(new display_handler(XOpenDisplay(nullptr))); }
+            return display_lock(std::move(lock), *handler);
+        }
+    };
+
+    // Index of slot for the next thread to bind to
+    static std::atomic<unsigned> & next()
+    {
+        static std::atomic<unsigned> index { 0 };
+        return index;
+    }
+
+    static slot (&pool())[LIBOS_X11_CONNECTIONS]
+    {
+        static slot slots[LIBOS_X11_CONNECTIONS];
+        return slots;
+    }
+
+    display_handler(Display *display) : display(display)
+    {
+        select_layout_events();
+        loaded = layout_builder::build(display);
+    }
+
+    // Ask X server to notify about keyboard and layout group changes
+    void select_layout_events()
+    {
+        int opcode = 0, error = 0;
+        int major = XkbMajorVersion, minor = XkbMinorVersion;
+        if (!display || !XkbQueryExtension(display, &opcode, &xkb_event, &error, &major, &minor))
+        {
+            xkb_event = 0;
+            return;
+        }
+
+        XkbSelectEvents(
+            display, XkbUseCoreKbd,
+            XkbNewKeyboardNotifyMask | XkbMapNotifyMask,
+            XkbNewKeyboardNotifyMask | XkbMapNotifyMask
+        );
+        XkbSelectEventDetails(
+            display, XkbUseCoreKbd, XkbStateNotify,
+            XkbGroupStateMask, XkbGroupStateMask
+        );
+    }
+
+    Display *display = nullptr;
+    // Type of XKB events (0 if extension is missing)
+    int      xkb_event = 0;
+
+    std::shared_ptr<const keyboard::layout> loaded;
+};
+
+// Listener, based on XRecord extension
+class xrecord_listener : public keyboard::listener::source
+{
+public:
+    xrecord_listener(keyboard::listener &owner) : source(owner)
+    {
+        // Control connection tracks layout of the listener, so events don't lock pool
+        control = XOpenDisplay(nullptr);
+        if (!control) { return; }
+        layout.reset(new display_handler(control));
+
+        data = XOpenDisplay(nullptr);
+        if (!data) { return; }
+
+        int major = 0, minor = 0;
+        if (!XRecordQueryVersion(control, &major, &minor)) { return; }
+
+        XRecordRange *range = XRecordAllocRange();
+        if (!range) { return; }
+        range->device_events.first = KeyPress;
+        range->device_events.last  = KeyRelease;
+
+        XRecordClientSpec clients = XRecordAllClients;
+        context = XRecordCreateContext(control, 0, &clients, 1, &range, 1);
+        XFree(range);
+        if (!context) { return; }
+
+        // Context must exist on server before data connection uses it
+        XSync(control, False);
+
+        thread = std::thread(
+            [this] { XRecordEnableContext(data, context, &xrecord_listener::intercept, reinterpret_cast<XPointer>(this)); }
+        );
+    }
+
+    bool active() const noexcept override { return thread.joinable(); }
+
+    ~xrecord_listener() override
+    {
+        if (thread.joinable())
+        {
+            {
+                std::lock_guard lock(control_mutex);
+                XRecordDisableContext(control, context);
+                XSync(control, False);
+            }
+            thread.join();
+        }
+        if (context) { XRecordFreeContext(control, context); }
+        if (data) { XCloseDisplay(data); }
+        // Closes control connection
+        layout.reset();
+    }
+
+private:
+    static void intercept(XPointer closure, XRecordInterceptData *recorded)
+    {
+        auto *self = reinterpret_cast<xrecord_listener *>(closure);
+
+        if (recorded->category == XRecordFromServer && recorded->data_len > 0)
+        {
+            // Raw xEvent: type, then keycode
+            const int     type = recorded->data[0] & 0x7F;
+            const KeyCode code = recorded->data[1];
+            const KeySym  sym  = self->keysym(code);
+            if ((type == KeyPress || type == KeyRelease) && sym != NoSymbol)
+            {
+                keyboard::listener::event e;
+                e.key = static_cast<keyboard::vk>(sym);
+                e.is_down = type == KeyPress;
+                e.time = std::chrono::steady_clock::now();
+                self->deliver(e);
+            }
+        }
+
+        XRecordFreeData(recorded);
+    }
+
+    // Translate keycode with layout, reloaded if it has changed
+    KeySym keysym(KeyCode code)
+    {
+        std::lock_guard lock(control_mutex);
+        layout->update_mapping();
+        return layout->keysym(code);
+    }
+
+    Display                         *control = nullptr;
+    Display                         *data    = nullptr;
+    XRecordContext                   context = 0;
+    std::unique_ptr<display_handler> layout;
+    // Guards control connection, used by listener's thread and destructor
+    std::mutex                       control_mutex;
+    std::thread                      thread;
+};
+
+// Read state of keys from X server
+void query_keymap(Display *display, char keys[32])
+{
+    stats_timer timer(keyboard::operation::query_keymap);
+    XQueryKeymap(display, keys);
+}
+
+// Buffer fake key event of XTest
+void fake_key_event(Display *display, KeyCode code, bool is_down)
+{
+    stats_timer timer(keyboard::operation::fake_key_event);
+    XTestFakeKeyEvent(display, code, is_down, 0);
+}
+
+// Send buffered requests to X server
+void flush(Display *display)
+{
+    stats_timer timer(keyboard::operation::flush);
+    XFlush(display);
+}
+
+// Buffer fake click of X button (wheel is buttons 4-7)
+void fake_button_click(Display *display, unsigned button, int clicks)
+{
+    for (int i = 0; i < clicks; ++i)
+    {
+        XTestFakeButtonEvent(display, button, True, 0);
+        XTestFakeButtonEvent(display, button, False, 0);
+    }
+}
+
+// Get X button of mouse button
+constexpr unsigned x11_button(mouse::button b)
+{
+    constexpr unsigned buttons[mouse::button_count] = { Button1, Button3, Button2, 8, 9 };
+    return buttons[static_cast<std::size_t>(b)];
+}
+
+// Keyboard and mouse functions, implemented with XTest
+class x11_backend : public keyboard::backend
+{
+public:
+    bool is_pressed(const keyboard::combination &combo) override
+    {
+        auto h = display_handler::get();
+
+        char keys_return[32];
+        query_keymap(h->native(), keys_return);
+        h->update_mapping();
+
+        for (const auto &key : combo)
+        {
+            KeyCode kc = h->keycode(key);
+            // Key not pressed
+            if (!(keys_return[kc / 8] & (1 << (kc % 8)))) { return false; }
+        }
+
+        return true;
+    }
+
+    keyboard::combination pressed_keys() override
+    {
+        auto h = display_handler::get();
+
+        char keys_return[32];
+        query_keymap(h->native(), keys_return);
+        h->update_mapping();
+
+        // Keycodes are translated to keysyms, so result is comparable with vk
+        return h->keys_of(keys_return);
+    }
+
+    void send(const keyboard::combination &combo, bool is_down) override
+    {
+        auto h = display_handler::get();
+        h->update_mapping();
+
+        // Our vk values same as KeySym for linux
+        for (const auto &key : combo) { fake_key_event(h->native(), h->keycode(key), is_down); }
+        flush(h->native());
+    }
+
+    void send(span<const keyboard::key_event> events) override
+    {
+        auto h = display_handler::get();
+        h->update_mapping();
+
+        // Requests are buffered by Xlib until flush
+        for (const auto &event : events) { fake_key_event(h->native(), h->keycode(event.key), event.is_down); }
+        flush(h->native());
+    }
+
+    void type(std::u32string_view text) override
+    {
+        auto h = display_handler::get();
+        h->update_mapping();
+
+        Display *display = h->native();
+        if (!display) { return; }
+
+        // Requests are buffered by Xlib until flush
+        type_codes(h->mapping(), text, [display](std::uint16_t code, bool is_down)
+        {
+            fake_key_event(display, code, is_down);
+        });
+        flush(display);
+    }
+
+    std::shared_ptr<const keyboard::layout> current_layout() override
+    {
+        auto h = display_handler::get();
+        h->update_mapping();
+        return h->shared_mapping();
+    }
+
+    void warm_up() override { display_handler::warm_next(); }
+
+    std::unique_ptr<keyboard::listener::source> listen(keyboard::listener &owner) override
+    {
+        return std::make_unique<xrecord_listener>(owner);
+    }
+
+    mouse::point mouse_position() override
+    {
+        auto h = display_handler::get();
+        Display *display = h->native();
+        if (!display) { return {}; }
+
+        Window root, child;
+        int root_x = 0, root_y = 0, x = 0, y = 0;
+        unsigned mask = 0;
+        XQueryPointer(display, DefaultRootWindow(display), &root, &child, &root_x, &root_y, &x, &y, &mask);
+        return mouse::point{root_x, root_y};
+    }
+
+    void send_mouse(span<const mouse::event> events) override
+    {
+        auto h = display_handler::get();
+        Display *display = h->native();
+        if (!display) { return; }
+
+        // Requests are buffered by Xlib until flush
+        for (const auto &event : events)
+        {
+            switch (event.kind)
+            {
+            case mouse::action::move_to: XTestFakeMotionEvent(display, -1, event.x, event.y, 0); break;
+            case mouse::action::move_by: XTestFakeRelativeMotionEvent(display, event.x, event.y, 0); break;
+            case mouse::action::press: XTestFakeButtonEvent(display, x11_button(event.button), True, 0); break;
+            case mouse::action::release: XTestFakeButtonEvent(display, x11_button(event.button), False, 0); break;
+            case mouse::action::scroll:
+                fake_button_click(display, event.y > 0 ? Button4 : Button5, event.y > 0 ? event.y : -event.y);
+                fake_button_click(display, event.x > 0 ? 7 : 6, event.x > 0 ? event.x : -event.x);
+                break;
+            }
+        }
+        flush(display);
+    }
+};
+#endif // LIBOS_NO_X11
+
+// Open every evdev device, that looks like a keyboard, except one named `skip` (e.g. "event3")
+std::vector<int> open_keyboards(std::string_view skip = {})
+{
+    std::vector<int> fds;
+
+    DIR *dir = opendir("/dev/input");
+    if (!dir) { return fds; }
+
+    while (const dirent *entry = readdir(dir))
+    {
+        if (std::strncmp(entry->d_name, "event", 5) != 0 || entry->d_name == skip) { continue; }
+
+        const std::string path = std::string("/dev/input/") + entry->d_name;
+        const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) { continue; }
+
+        // Keyboards have at least letters and space
+        unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1] = {};
+        auto has = [&keys](unsigned code)
+        {
+            return (keys[code / (8 * sizeof(unsigned long))] >> (code % (8 * sizeof(unsigned long)))) & 1;
+        };
+        if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0 || !has(KEY_A) || !has(KEY_SPACE))
+        {
+            close(fd);
+            continue;
+        }
+        fds.push_back(fd);
+    }
+
+    closedir(dir);
+    return fds;
+}
+
+// Virtual keyboard, created with uinput
+class uinput_device
+{
+public:
+    static uinput_device & get()
+    {
+        static uinput_device device;
+        return device;
+    }
+
+    // Check if device was created
+    bool valid() const noexcept { return fd >= 0; }
+
+    // Get name of evdev node of device (e.g. "event3") or "" if it's unknown
+    std::string node() const
+    {
+        char sysname[64] = {};
+        if (!valid() || ioctl(fd, UI_GET_SYSNAME(sizeof(sysname) - 1), sysname) < 0) { return {}; }
+
+        // Node is registered synchronously, only its permissions are set by udev later
+        std::string name;
+        if (DIR *dir = opendir((std::string("/sys/devices/virtual/input/") + sysname).c_str()))
+        {
+            while (const dirent *entry = readdir(dir))
+            {
+                if (std::strncmp(entry->d_name, "event", 5) == 0) { name = entry->d_name; break; }
+            }
+            closedir(dir);
+        }
+        return name;
+    }
+
+    // Add key event to group of current thread
+    void key(std::uint16_t code, bool is_down)
+    {
+        if (code == 0) { return; }
+
+        add(make_event(EV_KEY, code, is_down ? 1 : 0));
+    }
+
+    // Add relative motion event to group of current thread
+    void motion(std::uint16_t code, std::int32_t value)
+    {
+        if (value == 0) { return; }
+
+        add(make_event(EV_REL, code, value));
+    }
+
+    // Terminate current report of group, so next events are applied after it
+    void separate()
+    {
+        auto &group = events();
+        if (!group.empty() && group.back().type != EV_SYN) { group.push_back(make_event(EV_SYN, SYN_REPORT, 0)); }
+    }
+
+    // Terminate group of current thread with SYN_REPORT and write all its reports at once
+    void report()
+    {
+        separate();
+        auto &group = events();
+        if (group.empty()) { return; }
+
+        if (valid())
+        {
+            stats_timer timer(keyboard::operation::flush);
+            // uinput processes whole write under its own lock
+            while (::write(fd, group.data(), group.size() * sizeof(input_event)) < 0 && errno == EINTR) {}
+        }
+        group.clear();
+    }
+
+    uinput_device(const uinput_device &) = delete;
+    uinput_device(uinput_device &&) = delete;
+    void operator=(const uinput_device &) = delete;
+    void operator=(uinput_device &&) = delete;
+
+    ~uinput_device()
+    {
+        if (!valid()) { return; }
+        ioctl(fd, UI_DEV_DESTROY);
+        close(fd);
+    }
+
+private:
+    uinput_device()
+    {
+        fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) { return; }
+
+        ioctl(fd, UI_SET_EVBIT, EV_KEY);
+        ioctl(fd, UI_SET_EVBIT, EV_SYN);
+        // Every key of a regular keyboard
+        for (int code = KEY_ESC; code <= KEY_MICMUTE; ++code) { ioctl(fd, UI_SET_KEYBIT, code); }
+
+        // Buttons and wheels of a regular mouse
+        for (int code = BTN_LEFT; code <= BTN_EXTRA; ++code) { ioctl(fd, UI_SET_KEYBIT, code); }
+        ioctl(fd, UI_SET_EVBIT, EV_REL);
+        for (int code : { REL_X, REL_Y, REL_WHEEL, REL_HWHEEL }) { ioctl(fd, UI_SET_RELBIT, code); }
+
+        uinput_setup setup = {};
+        setup.id.bustype = BUS_VIRTUAL;
+        std::strncpy(setup.name, "LibOS virtual keyboard", UINPUT_MAX_NAME_SIZE - 1);
+
+        if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    // Add event to group. Reports are applied at once,
+    // so code, that already changed in the current report, starts a new one (e.g. press and release)
+    void add(const input_event &event)
+    {
+        auto &group = events();
+        for (auto it = group.rbegin(); it != group.rend() && it->type != EV_SYN; ++it)
+        {
+            if (it->type == event.type && it->code == event.code)
+            {
+                group.push_back(make_event(EV_SYN, SYN_REPORT, 0));
+                break;
+            }
+        }
+        group.push_back(event);
+    }
+
+    static input_event make_event(std::uint16_t type, std::uint16_t code, std::int32_t value)
+    {
+        input_event event = {};
+        event.type = type;
+        event.code = code;
+        event.value = value;
+        return event;
+    }
+
+    // Reusable group, so injection doesn't allocate after warm up
+    static std::vector<input_event> & events()
+    {
+        thread_local std::vector<input_event> group;
+        return group;
+    }
+
+    int fd = -1;
+};
+
+// Listener, reading keyboards from evdev
+class evdev_listener : public keyboard::listener::source
+{
+public:
+    evdev_listener(keyboard::listener &owner, std::shared_ptr<const keyboard::layout> layout)
+        : source(owner), layout(std::move(layout)), fds(open_keyboards())
+    {
+        if (fds.empty() || pipe2(stop, O_CLOEXEC) != 0) { return; }
+        thread = std::thread([this] { run(); });
+    }
+
+    bool active() const noexcept override { return thread.joinable(); }
+
+    ~evdev_listener() override
+    {
+        if (thread.joinable())
+        {
+            const char wake = 0;
+            while (::write(stop[1], &wake, 1) < 0 && errno == EINTR) {}
+            thread.join();
+        }
+        for (int fd : stop) { if (fd >= 0) { close(fd); } }
+        for (int fd : fds) { close(fd); }
+    }
+
+private:
+    void run()
+    {
+        std::vector<pollfd> polls;
+        polls.push_back({ stop[0], POLLIN, 0 });
+        for (int fd : fds) { polls.push_back({ fd, POLLIN, 0 }); }
+
+        input_event events[64];
+        while (true)
+        {
+            if (poll(polls.data(), polls.size(), -1) < 0)
+            {
+                if (errno == EINTR) { continue; }
+                return;
+            }
+            if (polls[0].revents) { return; }
+
+            for (std::size_t i = 1; i < polls.size(); ++i)
+            {
+                if (!(polls[i].revents & POLLIN)) { continue; }
+
+                ssize_t size = 0;
+                {
+                    stats_timer timer(keyboard::operation::hid_value_fetch);
+                    size = read(polls[i].fd, events, sizeof(events));
+                }
+                if (size <= 0) { continue; }
+
+                for (std::size_t j = 0; j < size / sizeof(input_event); ++j)
+                {
+                    // Value 2 is autorepeat
+                    const input_event &event = events[j];
+                    if (event.type != EV_KEY || event.value > 1) { continue; }
+
+                    const keyboard::vk key = layout->key_of(event.code);
+                    if (key == keyboard::vk{}) { continue; }
+
+                    keyboard::listener::event e;
+                    e.key = key;
+                    e.is_down = event.value == 1;
+                    e.time = std::chrono::steady_clock::now();
+                    deliver(e);
+                }
+            }
+        }
+    }
+
+    std::shared_ptr<const keyboard::layout> layout;
+    std::vector<int>                        fds;
+    int                                     stop[2] = { -1, -1 };
+    std::thread                             thread;
+};
+
+// Keyboard functions, implemented with uinput and evdev.
+// Works without X server, e.g. headless or under Wayland.
+//
+// Requires write access to /dev/uinput and read access to /dev/input/event*
+// (e.g. membership in "input" group), otherwise keys are neither injected nor seen
+class uinput_backend : public keyboard::backend
+{
+public:
+    uinput_backend()
+        : mapping(layout_builder::build_evdev()),
+          virtual_node(uinput_device::get().node()),
+          keyboards(open_keyboards(virtual_node))
+    {
+        // udev sets permissions of new node asynchronously, so give it a moment
+        for (int attempt = 0; attempt < 50 && !virtual_node.empty() && !open_virtual_keyboard(); ++attempt)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    keyboard::combination pressed_keys() override
+    {
+        unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1] = {};
+        {
+            std::lock_guard lock(mutex);
+            stats_timer timer(keyboard::operation::query_keymap);
+
+            // Injected keys are seen only on virtual keyboard
+            const auto now = std::chrono::steady_clock::now();
+            if (virtual_keyboard < 0 && now >= next_attempt)
+            {
+                next_attempt = now + std::chrono::milliseconds(100);
+                open_virtual_keyboard();
+            }
+            auto read_state = [&keys](int fd)
+            {
+                unsigned long state[std::size(keys)] = {};
+                if (ioctl(fd, EVIOCGKEY(sizeof(state)), state) < 0) { return; }
+                for (std::size_t i = 0; i < std::size(keys); ++i) { keys[i] |= state[i]; }
+            };
+            for (int fd : keyboards) { read_state(fd); }
+            if (virtual_keyboard >= 0) { read_state(virtual_keyboard); }
+        }
+
+        keyboard::combination combo;
+        constexpr std::size_t bits = 8 * sizeof(unsigned long);
+        for (std::size_t w = 0; w < std::size(keys); ++w)
+        {
+            // Visit only pressed keys
+            for (unsigned long word = keys[w]; word != 0; word &= word - 1)
+            {
+                const auto code = static_cast<std::uint16_t>(w * bits + countr_zero(word));
+                const keyboard::vk key = mapping->key_of(code);
+                if (key != keyboard::vk{}) { combo.insert(key); }
+            }
+        }
+        return combo;
+    }
+
+    void send(const keyboard::combination &combo, bool is_down) override
+    {
+        auto &device = uinput_device::get();
+        for (const auto &key : combo) { device.key(mapping->code_of(key), is_down); }
+        device.report();
+    }
+
+    void send(span<const keyboard::key_event> events) override
+    {
+        // Whole sequence is a single write(), split into reports only when key repeats
+        auto &device = uinput_device::get();
+        for (const auto &event : events) { device.key(mapping->code_of(event.key), event.is_down); }
+        device.report();
+    }
+
+    void type(std::u32string_view text) override
+    {
+        auto &device = uinput_device::get();
+        type_codes(*mapping, text, [&device](std::uint16_t code, bool is_down) { device.key(code, is_down); });
+        device.report();
+    }
+
+    std::shared_ptr<const keyboard::layout> current_layout() override { return mapping; }
+
+    std::unique_ptr<keyboard::listener::source> listen(keyboard::listener &owner) override
+    {
+        return std::make_unique<evdev_listener>(owner, mapping);
+    }
+
+    // Virtual device has relative axes only, so move_to is skipped
+    bool absolute_mouse_moves() const noexcept override { return false; }
+
+    void send_mouse(span<const mouse::event> events) override
+    {
+        constexpr std::uint16_t buttons[mouse::button_count] = { BTN_LEFT, BTN_RIGHT, BTN_MIDDLE, BTN_SIDE, BTN_EXTRA };
+
+        // Whole sequence is a single write(). Buttons and motion go to separate reports,
+        // so a click lands where the cursor was moved to before it
+        auto &device = uinput_device::get();
+        bool button_report = false;
+        for (const auto &event : events)
+        {
+            if (event.kind == mouse::action::move_to) { continue; }
+
+            const bool is_button = event.kind == mouse::action::press || event.kind == mouse::action::release;
+            if (is_button != button_report) { device.separate(); }
+            button_report = is_button;
+
+            const std::uint16_t button = buttons[static_cast<std::size_t>(event.button)];
+            switch (event.kind)
+            {
+            case mouse::action::move_to: break;
+            case mouse::action::move_by: device.motion(REL_X, event.x); device.motion(REL_Y, event.y); break;
+            case mouse::action::press: device.key(button, true); break;
+            case mouse::action::release: device.key(button, false); break;
+            case mouse::action::scroll: device.motion(REL_HWHEEL, event.x); device.motion(REL_WHEEL, event.y); break;
+            }
+        }
+        device.report();
+    }
+
+    ~uinput_backend() override
+    {
+        for (int fd : keyboards) { close(fd); }
+        if (virtual_keyboard >= 0) { close(virtual_keyboard); }
+    }
+
+private:
+    // Try to open evdev node of virtual keyboard
+    bool open_virtual_keyboard()
+    {
+        if (virtual_keyboard < 0 && !virtual_node.empty())
+        {
+            virtual_keyboard = open(("/dev/input/" + virtual_node).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        }
+        return virtual_keyboard >= 0;
+    }
+
+    std::shared_ptr<const keyboard::layout> mapping;
+    std::mutex                              mutex;
+    std::string                             virtual_node;
+    std::vector<int>                        keyboards;
+    int                                     virtual_keyboard = -1;
+    std::chrono::steady_clock::time_point   next_attempt;
+};
+
+// Check if uinput backend should be used.
+//
+// LIBOS_KEYBOARD_BACKEND environment variable selects "uinput" or "x11".
+// Otherwise X11 is used, when there is an X display (including XWayland)
+bool use_uinput()
+{
+#ifdef LIBOS_NO_X11
+    return true;
+#else
+    static const bool selected = []
+    {
+        if (const char *name = std::getenv("LIBOS_KEYBOARD_BACKEND"))
+        {
+            if (std::strcmp(name, "uinput") == 0) { return true; }
+            if (std::strcmp(name, "x11") == 0) { return false; }
+        }
+        return !std::getenv("DISPLAY");
+    }();
+    return selected;
+#endif
+}
+
+// Backend, installed on current thread
+keyboard::backend *& thread_backend() noexcept
+{
+    thread_local keyboard::backend *installed = nullptr;
+    return installed;
+}
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+// Get backend, that calls OS. Selected once per process
+backend & native_backend()
+{
+    static const std::unique_ptr<backend> selected = []() -> std::unique_ptr<backend>
+    {
+#ifndef LIBOS_NO_X11
+        // Without access to /dev/uinput fall back to XTest, if there is an X display
+        if (!detail::use_uinput() || (!detail::uinput_device::get().valid() && std::getenv("DISPLAY")))
+        {
+            return std::make_unique<detail::x11_backend>();
+        }
+#endif
+        return std::make_unique<detail::uinput_backend>();
+    }();
+    return *selected;
+}
+
+// Check if every key in combination is pressed
+bool is_pressed(const combination &combo) { return current_backend().is_pressed(combo); }
+
+// Get combination of all pressed keys on a keyboard
+combination pressed_keys() { return current_backend().pressed_keys(); }
+
+// Capture state of the whole keyboard at once
+state snapshot() { return current_backend().snapshot(); }
+
+// Press combination of keys (until release)
+void press(const combination &combo) { current_backend().send(combo, true); }
+
+// Release combination of keys
+void release(const combination &combo) { current_backend().send(combo, false); }
+
+// Send sequence of key events at once
+void send(span<const key_event> events) { current_backend().send(events); }
+
+// Get layout, that is active now
+std::shared_ptr<const layout> layout::current() { return current_backend().current_layout(); }
+
+// Type text, using current keyboard layout
+void type(std::u32string_view text) { current_backend().type(text); }
+
+// Start listening and queue events
+listener::listener() : origin(current_backend().listen(*this)) {}
+
+// Start listening and pass events to callback
+listener::listener(callback on_event)
+    : on_event(std::move(on_event)), origin(current_backend().listen(*this)) {}
+
+// Stop listening
+listener::~listener() { origin.reset(); }
+
+// Check if OS delivers events to listener
+bool listener::active() const noexcept { return origin->active(); }
+
+// Get counters of native backend
+stats_t stats()
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    return detail::stats_registry::get().collect();
+#else
+    return {};
+#endif
+}
+
+// Reset counters of every thread
+void reset_stats()
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    detail::stats_registry::get().clear();
+#endif
+}
+
+} // namespace os::keyboard
+// End of src/linux/keyboard.cpp
+// =========================
+
+#elif IS_OS_WINDOWS
+// src/windows/keyboard.cpp
+// =========================
+#include "keyboard.hpp"
+
+#include "macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Windows.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+    #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace os::detail
+{
+    // Raise priority of current thread for time-critical work (if possible)
+    void raise_thread_priority() noexcept
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    }
+
+    // Sleep until deadline with the best precision available
+    void precise_sleep_until(std::chrono::steady_clock::time_point deadline) noexcept
+    {
+        // High resolution timers are available since Windows 10, version 1803
+        thread_local HANDLE timer = CreateWaitableTimerExW(
+            nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS
+        );
+
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= remaining.zero()) { return; }
+
+        if (!timer)
+        {
+            std::this_thread::sleep_until(deadline);
+            return;
+        }
+
+        // Negative value means relative time in 100 nanoseconds intervals
+        LARGE_INTEGER due;
+        due.QuadPart = -std::chrono::duration_cast<std::chrono::duration<LONGLONG, std::ratio<1, 10'000'000>>>(remaining).count();
+        if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE))
+        {
+            WaitForSingleObject(timer, INFINITE);
+        }
+    }
+
+    // Reusable buffer of inputs, so injection doesn't allocate after warm up
+    std::vector<INPUT> & input_buffer()
+    {
+        thread_local std::vector<INPUT> inputs;
+        inputs.clear();
+        return inputs;
+    }
+
+    INPUT make_input(keyboard::vk key, bool is_down)
+    {
+        INPUT in = {};
+        in.type = INPUT_KEYBOARD;
+        in.ki.wVk = static_cast<int>(key);
+        if (!is_down)
+        {
+            in.ki.dwFlags = KEYEVENTF_KEYUP;
+        }
+        return in;
+    }
+
+    // Input of mouse with raw fields
+    INPUT make_mouse_input(DWORD flags, LONG dx = 0, LONG dy = 0, DWORD data = 0)
+    {
+        INPUT in = {};
+        in.type = INPUT_MOUSE;
+        in.mi.dx = dx;
+        in.mi.dy = dy;
+        in.mi.mouseData = data;
+        in.mi.dwFlags = flags;
+        return in;
+    }
+
+    // Get input of mouse event
+    INPUT make_mouse_input(const mouse::event &event)
+    {
+        // Flags of press and release of every button
+        constexpr DWORD downs[mouse::button_count] = {
+            MOUSEEVENTF_LEFTDOWN, MOUSEEVENTF_RIGHTDOWN, MOUSEEVENTF_MIDDLEDOWN, MOUSEEVENTF_XDOWN, MOUSEEVENTF_XDOWN
+        };
+        constexpr DWORD ups[mouse::button_count] = {
+            MOUSEEVENTF_LEFTUP, MOUSEEVENTF_RIGHTUP, MOUSEEVENTF_MIDDLEUP, MOUSEEVENTF_XUP, MOUSEEVENTF_XUP
+        };
+
+        const auto b = static_cast<std::size_t>(event.button);
+        const DWORD x_button = event.button == mouse::button::back ? XBUTTON1 :
+                               event.button == mouse::button::forward ? XBUTTON2 : 0;
+
+        switch (event.kind)
+        {
+        case mouse::action::move_to:
+        {
+            // Absolute coordinates are normalized to 0..65535 over the whole virtual desktop
+            const int left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+            const int top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+            const int width = (std::max)(GetSystemMetrics(SM_CXVIRTUALSCREEN) - 1, 1);
+            const int height = (std::max)(GetSystemMetrics(SM_CYVIRTUALSCREEN) - 1, 1);
+            return make_mouse_input(
+                MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK,
+                static_cast<LONG>((event.x - left) * 65535LL / width),
+                static_cast<LONG>((event.y - top) * 65535LL / height)
+            );
+        }
+        case mouse::action::move_by: return make_mouse_input(MOUSEEVENTF_MOVE, event.x, event.y);
+        case mouse::action::press: return make_mouse_input(downs[b], 0, 0, x_button);
+        case mouse::action::release: return make_mouse_input(ups[b], 0, 0, x_button);
+        case mouse::action::scroll: break;
+        }
+        return INPUT{};
+    }
+
+    // Send every buffered input with a single call
+    void submit_inputs(std::vector<INPUT> &inputs)
+    {
+        stats_timer timer(keyboard::operation::flush);
+        SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+    }
+
+    // Input of UTF-16 code unit, that doesn't need a key on layout
+    INPUT make_unicode_input(wchar_t unit, bool is_down)
+    {
+        INPUT in = {};
+        in.type = INPUT_KEYBOARD;
+        in.ki.wScan = unit;
+        in.ki.dwFlags = KEYEVENTF_UNICODE;
+        if (!is_down)
+        {
+            in.ki.dwFlags |= KEYEVENTF_KEYUP;
+        }
+        return in;
+    }
+
+    // Builds layout tables with VkKeyScanExW
+    class layout_builder
+    {
+    public:
+        // Build tables of keyboard layout
+        static std::shared_ptr<keyboard::layout> build(HKL hkl)
+        {
+            static std::uint64_t loaded = 0;
+
+            auto result = std::make_shared<keyboard::layout>();
+            result->number = loaded++;
+
+            // Virtual keys are the same as key codes
+            for (std::size_t i = 0; i < key_index_count; ++i)
+            {
+                result->codes[i] = static_cast<std::uint16_t>(i);
+            }
+            for (unsigned code = 0; code < 256; ++code)
+            {
+                result->keys[code] = static_cast<keyboard::vk>(code);
+            }
+
+            // Modifiers are bits of VkKeyScanExW shift state
+            result->modifier_keys[0] = VK_SHIFT;
+            result->modifier_keys[1] = VK_CONTROL;
+            result->modifier_keys[2] = VK_MENU;
+
+            insert(*result, hkl, U'\t');
+            insert(*result, hkl, U'\r');
+            for (char32_t c = 0x20; c < char_table::dense_size; ++c)
+            {
+                insert(*result, hkl, c);
+            }
+            // General punctuation and currency symbols (e.g. euro sign)
+            for (char32_t c = 0x2000; c < 0x20D0; ++c)
+            {
+                insert(*result, hkl, c);
+            }
+            return result;
+        }
+
+    private:
+        static void insert(keyboard::layout &result, HKL hkl, char32_t c)
+        {
+            const SHORT scan = VkKeyScanExW(static_cast<WCHAR>(c), hkl);
+            if (scan == -1) { return; }
+
+            // Only Shift, Ctrl and Alt states may be held
+            const unsigned shift_state = HIBYTE(scan);
+            if (shift_state & ~7u) { return; }
+
+            result.chars.insert(c, LOBYTE(scan), static_cast<std::uint16_t>(shift_state));
+        }
+    };
+
+    // Source of listener's events, based on low-level keyboard hook.
+    //
+    // Hook procedure is called on the thread, that installed the hook,
+    // so every listener has its own thread with message loop.
+    class hook_listener : public keyboard::listener::source
+    {
+    public:
+        hook_listener(keyboard::listener& owner) : source(owner)
+        {
+            std::promise<bool> installed;
+            auto result = installed.get_future();
+            thread = std::thread(
+                [this, &installed]()
+                {
+                    current = this;
+                    thread_id = GetCurrentThreadId();
+
+                    // Force creation of message queue before anyone can post WM_QUIT
+                    MSG msg;
+                    PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+
+                    HHOOK hook = SetWindowsHookExW(WH_KEYBOARD_LL, &hook_listener::hook_proc, GetModuleHandleW(nullptr), 0);
+                    installed.set_value(hook != nullptr);
+                    if (!hook) { return; }
+
+                    while (GetMessageW(&msg, nullptr, 0, 0) > 0) {}
+
+                    UnhookWindowsHookEx(hook);
+                }
+            );
+            hooked = result.get();
+        }
+
+        bool active() const noexcept override { return hooked; }
+
+        ~hook_listener() override
+        {
+            if (hooked) { PostThreadMessageW(thread_id, WM_QUIT, 0, 0); }
+            thread.join();
+        }
+
+    private:
+        static LRESULT CALLBACK hook_proc(int code, WPARAM wparam, LPARAM lparam)
+        {
+            if (code == HC_ACTION)
+            {
+                const auto* info = reinterpret_cast<const KBDLLHOOKSTRUCT*>(lparam);
+
+                keyboard::listener::event e;
+                e.key = static_cast<keyboard::vk>(info->vkCode);
+                e.is_down = (wparam == WM_KEYDOWN || wparam == WM_SYSKEYDOWN);
+                e.time = std::chrono::steady_clock::now();
+                current->deliver(e);
+            }
+            return CallNextHookEx(nullptr, code, wparam, lparam);
+        }
+
+        // Listener of hook's thread
+        static thread_local hook_listener* current;
+
+        std::thread thread;
+        DWORD       thread_id = 0;
+        bool        hooked = false;
+    };
+
+    thread_local hook_listener* hook_listener::current = nullptr;
+
+    // Keyboard functions, implemented with SendInput and low-level hook
+    class win32_backend : public keyboard::backend
+    {
+    public:
+        bool is_pressed(const keyboard::combination& combo) override
+        {
+            stats_timer timer(keyboard::operation::query_keymap);
+            for (const auto& key : combo)
+            {
+                short state = GetAsyncKeyState(static_cast<int>(key));
+                // If the most significant bit of 2 bytes is not set, the key isn't pressed
+                if (!(state & (1 << 15))) { return false; };
+            }
+            return true;
+        }
+
+        keyboard::combination pressed_keys() override
+        {
+            keyboard::combination combo;
+            stats_timer timer(keyboard::operation::query_keymap);
+
+            // Go through every virtual key
+            for (int key = 0; key < 256; ++key)
+            {
+                short state = GetAsyncKeyState(key);
+                // If the most significant bit of 2 bytes set, the key is pressed
+                if (state & (1 << 15)) { combo.insert(static_cast<keyboard::vk>(key)); };
+            }
+
+            return combo;
+        }
+
+        keyboard::state snapshot() override
+        {
+            // Synchronize thread's keyboard state with the async one,
+            // otherwise it's updated only by thread's message loop
+            GetKeyState(0);
+
+            BYTE keys[256];
+            bool queried = false;
+            {
+                stats_timer timer(keyboard::operation::query_keymap);
+                queried = GetKeyboardState(keys) != FALSE;
+            }
+            if (!queried) { return keyboard::state(pressed_keys()); }
+
+            keyboard::combination combo;
+            for (int key = 0; key < 256; ++key)
+            {
+                // If the high-order bit is set, the key is pressed
+                if (keys[key] & 0x80) { combo.insert(static_cast<keyboard::vk>(key)); }
+            }
+            return keyboard::state(combo);
+        }
+
+        void send(const keyboard::combination& combo, bool is_down) override
+        {
+            auto &inputs = input_buffer();
+            for (auto key : combo)
+            {
+                inputs.push_back(make_input(key, is_down));
+            }
+            submit_inputs(inputs);
+        }
+
+        void send(span<const keyboard::key_event> events) override
+        {
+            auto &inputs = input_buffer();
+            for (const auto& event : events)
+            {
+                inputs.push_back(make_input(event.key, event.is_down));
+            }
+            submit_inputs(inputs);
+        }
+
+        // Layout is per-thread on Windows and WM_INPUTLANGCHANGE is only sent
+        // to windows of that thread, so foreground window's HKL is compared instead.
+        std::shared_ptr<const keyboard::layout> current_layout() override
+        {
+            HKL hkl = GetKeyboardLayout(GetWindowThreadProcessId(GetForegroundWindow(), nullptr));
+
+            std::lock_guard lock(mutex);
+            if (!cached || hkl != loaded)
+            {
+                cached = layout_builder::build(hkl);
+                loaded = hkl;
+            }
+            return cached;
+        }
+
+        void type(std::u32string_view text) override
+        {
+            const auto mapping = current_layout();
+
+            auto &inputs = input_buffer();
+
+            // Press and release modifiers only when they change between characters
+            unsigned held = 0;
+            auto hold = [&](unsigned state)
+            {
+                for (unsigned index = 0; index < 3; ++index)
+                {
+                    const unsigned mask = 1u << index;
+                    if ((held ^ state) & mask)
+                    {
+                        inputs.push_back(make_input(static_cast<keyboard::vk>(mapping->modifier_key(index)), (state & mask) != 0));
+                    }
+                }
+                held = state;
+            };
+
+            for (char32_t c : text)
+            {
+                if (c == U'\n') { c = U'\r'; }
+
+                if (const auto *key = mapping->find(c))
+                {
+                    hold(key->modifiers);
+                    inputs.push_back(make_input(static_cast<keyboard::vk>(key->code), true));
+                    inputs.push_back(make_input(static_cast<keyboard::vk>(key->code), false));
+                    continue;
+                }
+
+                // Missing in layout: send as UTF-16 code units
+                hold(0);
+                wchar_t units[2];
+                std::size_t count = 1;
+                if (c > 0xFFFF)
+                {
+                    units[0] = static_cast<wchar_t>(0xD800 + ((c - 0x10000) >> 10));
+                    units[1] = static_cast<wchar_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+                    count = 2;
+                }
+                else
+                {
+                    units[0] = static_cast<wchar_t>(c);
+                }
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    inputs.push_back(make_unicode_input(units[i], true));
+                    inputs.push_back(make_unicode_input(units[i], false));
+                }
+            }
+            hold(0);
+
+            submit_inputs(inputs);
+        }
+
+        std::unique_ptr<keyboard::listener::source> listen(keyboard::listener& owner) override
+        {
+            return std::make_unique<hook_listener>(owner);
+        }
+
+        mouse::point mouse_position() override
+        {
+            POINT p = {};
+            if (!GetCursorPos(&p)) { return {}; }
+            return mouse::point{ p.x, p.y };
+        }
+
+        void send_mouse(span<const mouse::event> events) override
+        {
+            auto &inputs = input_buffer();
+            for (const auto& event : events)
+            {
+                if (event.kind != mouse::action::scroll)
+                {
+                    inputs.push_back(make_mouse_input(event));
+                    continue;
+                }
+
+                // Wheel data is signed, one click is WHEEL_DELTA
+                if (event.y != 0)
+                {
+                    inputs.push_back(make_mouse_input(MOUSEEVENTF_WHEEL, 0, 0, static_cast<DWORD>(event.y * WHEEL_DELTA)));
+                }
+                if (event.x != 0)
+                {
+                    inputs.push_back(make_mouse_input(MOUSEEVENTF_HWHEEL, 0, 0, static_cast<DWORD>(event.x * WHEEL_DELTA)));
+                }
+            }
+            submit_inputs(inputs);
+        }
+
+    private:
+        std::mutex                              mutex;
+        HKL                                     loaded = nullptr;
+        std::shared_ptr<const keyboard::layout> cached;
+    };
+
+    // Backend, installed on current thread
+    keyboard::backend *& thread_backend() noexcept
+    {
+        thread_local keyboard::backend *installed = nullptr;
+        return installed;
+    }
+}
+
+namespace os::keyboard
+{
+
+    // Get backend, that calls OS
+    backend & native_backend()
+    {
+        static detail::win32_backend native;
+        return native;
+    }
+
+    // Check if every key in combination is pressed
+    bool is_pressed(const combination& combo) { return current_backend().is_pressed(combo); }
+
+    // Get combination of all pressed keys on a keyboard
+    combination pressed_keys() { return current_backend().pressed_keys(); }
+
+    // Capture state of the whole keyboard at once
+    state snapshot() { return current_backend().snapshot(); }
+
+    // Press combination of keys (until release)
+    void press(const combination& combo) { current_backend().send(combo, true); }
+
+    // Release combination of keys
+    void release(const combination& combo) { current_backend().send(combo, false); }
+
+    // Send sequence of key events at once
+    void send(span<const key_event> events) { current_backend().send(events); }
+
+    // Get layout, that is active now
+    std::shared_ptr<const layout> layout::current() { return current_backend().current_layout(); }
+
+    // Type text, using current keyboard layout
+    void type(std::u32string_view text) { current_backend().type(text); }
+
+    // Start listening and queue events
+    listener::listener() : origin(current_backend().listen(*this)) {}
+
+    // Start listening and pass events to callback
+    listener::listener(callback on_event)
+        : on_event(std::move(on_event)), origin(current_backend().listen(*this)) {}
+
+    // Stop listening
+    listener::~listener() { origin.reset(); }
+
+    // Check if OS delivers events to listener
+    bool listener::active() const noexcept { return origin->active(); }
+
+    // Get counters of native backend
+    stats_t stats()
+    {
+#ifdef LIBOS_KEYBOARD_STATS
+        return detail::stats_registry::get().collect();
+#else
+        return {};
+#endif
+    }
+
+    // Reset counters of every thread
+    void reset_stats()
+    {
+#ifdef LIBOS_KEYBOARD_STATS
+        detail::stats_registry::get().clear();
+#endif
+    }
+
+} // namespace os::keyboard
+// End of src/windows/keyboard.cpp
+// =========================
+
+#elif IS_OS_MACOS
+// src/macos/keyboard.cpp
+// =========================
+#include "keyboard.hpp"
+
+#include "macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Carbon/Carbon.h>
+#include <IOKit/hid/IOHIDDevice.h>
+#include <IOKit/hid/IOHIDManager.h>
+#include <mach/mach_time.h>
+#include <pthread.h>
+#include <pthread/qos.h>
+
+namespace os::detail
+{
+
+// Raise priority of current thread for time-critical work (if possible)
+void raise_thread_priority() noexcept
+{
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+}
+
+// Sleep until deadline with the best precision available
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline) noexcept
+{
+    const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        deadline - std::chrono::steady_clock::now()
+    ).count();
+    if (remaining <= 0) { return; }
+
+    static const mach_timebase_info_data_t timebase = []
+    {
+        mach_timebase_info_data_t info;
+        mach_timebase_info(&info);
+        return info;
+    }();
+
+    const uint64_t ticks = static_cast<uint64_t>(remaining) * timebase.denom / timebase.numer;
+    mach_wait_until(mach_absolute_time() + ticks);
+}
+
+// Get event flag of modifier key or 0, if key is not a modifier
+constexpr CGEventFlags modifier_flag(os::keyboard::vk key)
+{
+    using os::keyboard::vk;
+
+    switch (key)
+    {
+        case vk::Function:  return kCGEventFlagMaskSecondaryFn;
+        case vk::Shift_L:
+        case vk::Shift_R:   return kCGEventFlagMaskShift;
+        case vk::Option_L:
+        case vk::Option_R:  return kCGEventFlagMaskAlternate;
+        case vk::Command_L:
+        case vk::Command_R: return kCGEventFlagMaskCommand;
+        case vk::Control_L:
+        case vk::Control_R: return kCGEventFlagMaskControl;
+        default:            return 0;
+    }
+}
+
+// Event flag of every key, indexed by key_index()
+constexpr auto modifier_masks = []
+{
+    std::array<CGEventFlags, key_index_count> masks{};
+    for (std::size_t index = 0; index < key_index_count; ++index)
+    {
+        masks[index] = modifier_flag(key_at(index));
+    }
+    return masks;
+}();
+
+// Get event flag of modifier key or 0, if key is not a modifier (table lookup)
+constexpr CGEventFlags modifier_mask(os::keyboard::vk key)
+{
+    std::size_t index = key_index(key);
+    return index == no_key_index ? 0 : modifier_masks[index];
+}
+
+// Keyboard events created once per keycode and reused for every post
+class event_cache
+{
+public:
+    static event_cache & get()
+    {
+        static event_cache cache;
+        return cache;
+    }
+
+    // Post keyboard event for key with modifier flags and flags of held modifiers
+    void post(CGKeyCode key, bool is_down, CGEventFlags flags)
+    {
+        if (key >= std::size(events)) { return; }
+
+        std::lock_guard lock(mutex);
+
+        CGEventRef &event = events[key];
+        if (!event) { event = CGEventCreateKeyboardEvent(source, key, true); }
+        if (!event) { return; }
+
+        CGEventSetType(event, is_down ? kCGEventKeyDown : kCGEventKeyUp);
+        CGEventSetFlags(event, flags | held);
+
+        stats_timer timer(keyboard::operation::fake_key_event);
+        CGEventPost(kCGHIDEventTap, event);
+    }
+
+    // Press or release modifier key with flag.
+    // It stays held between calls, so its flag is applied to every following event
+    void post_modifier(CGKeyCode key, bool is_down, CGEventFlags flag)
+    {
+        if (key >= std::size(events)) { return; }
+
+        std::lock_guard lock(mutex);
+
+        held_flags[key] = is_down ? flag : 0;
+        held = 0;
+        for (CGEventFlags f : held_flags) { held |= f; }
+
+        CGEventRef &event = events[key];
+        if (!event) { event = CGEventCreateKeyboardEvent(source, key, true); }
+        if (!event) { return; }
+
+        CGEventSetType(event, kCGEventFlagsChanged);
+        CGEventSetFlags(event, held);
+
+        stats_timer timer(keyboard::operation::fake_key_event);
+        CGEventPost(kCGHIDEventTap, event);
+    }
+
+    // Post press and release of text, that has no key on layout
+    void post_unicode(const UniChar *units, UniCharCount count)
+    {
+        std::lock_guard lock(mutex);
+
+        if (!unicode_event) { unicode_event = CGEventCreateKeyboardEvent(source, 0, true); }
+        if (!unicode_event) { return; }
+
+        CGEventSetFlags(unicode_event, held);
+        CGEventKeyboardSetUnicodeString(unicode_event, count, units);
+        CGEventSetType(unicode_event, kCGEventKeyDown);
+        {
+            stats_timer timer(keyboard::operation::fake_key_event);
+            CGEventPost(kCGHIDEventTap, unicode_event);
+        }
+        CGEventSetType(unicode_event, kCGEventKeyUp);
+        {
+            stats_timer timer(keyboard::operation::fake_key_event);
+            CGEventPost(kCGHIDEventTap, unicode_event);
+        }
+    }
+
+    event_cache(const event_cache &) = delete;
+    event_cache(event_cache &&) = delete;
+    event_cache & operator=(const event_cache &) = delete;
+    event_cache & operator=(event_cache &&) = delete;
+
+private:
+    CGEventSourceRef source = nullptr;
+    CGEventRef       events[256] = {};
+    CGEventRef       unicode_event = nullptr;
+    // Flags of modifiers, held by injected events, indexed by keycode
+    CGEventFlags     held_flags[256] = {};
+    CGEventFlags     held = 0;
+    std::mutex       mutex;
+
+    event_cache() : source(CGEventSourceCreate(kCGEventSourceStateHIDSystemState)) {}
+
+    ~event_cache()
+    {
+        for (CGEventRef event : events)
+        {
+            if (event) { CFRelease(event); }
+        }
+        if (unicode_event) { CFRelease(unicode_event); }
+        if (source) { CFRelease(source); }
+    }
+};
+
+// Get virtual key of letter, that depends on keyboard localization
+bool localizedKeys(UniChar c, keyboard::vk &vk)
+{
+    if ('a' <= c && c <= 'z')
+    {
+        c = std::toupper(c);
+    }
+
+    #define CASE_LETTER(LETTER)        \
+        case #LETTER[0]:               \
+            vk = keyboard::vk::LETTER; \
+            break; 
+
+    switch (c)
+    {
+        CASE_LETTER(A);
+        CASE_LETTER(B);
+        CASE_LETTER(C);
+        CASE_LETTER(D);
+        CASE_LETTER(E);
+        CASE_LETTER(F);
+        CASE_LETTER(G);
+        CASE_LETTER(H);
+        CASE_LETTER(I);
+        CASE_LETTER(J);
+        CASE_LETTER(K);
+        CASE_LETTER(L);
+        CASE_LETTER(M);
+        CASE_LETTER(N);
+        CASE_LETTER(O);
+        CASE_LETTER(P);
+        CASE_LETTER(Q);
+        CASE_LETTER(R);
+        CASE_LETTER(S);
+        CASE_LETTER(T);
+        CASE_LETTER(U);
+        CASE_LETTER(V);
+        CASE_LETTER(W);
+        CASE_LETTER(X);
+        CASE_LETTER(Y);
+        CASE_LETTER(Z);
+
+        default: return false;
+    }
+
+    return true;
+}
+
+// Builds layout tables with UCKeyTranslate
+class layout_builder
+{
+public:
+    // Build tables of current keyboard input source
+    static std::shared_ptr<keyboard::layout> build()
+    {
+        static std::uint64_t loaded = 0;
+
+        auto result = std::make_shared<keyboard::layout>();
+        result->number = loaded++;
+
+        // Virtual keys are the same as virtual codes, unless localized
+        for (std::size_t i = 0; i < key_index_count; ++i)
+        {
+            result->codes[i] = static_cast<std::uint16_t>(i);
+        }
+        for (unsigned code = 0; code < 256; ++code)
+        {
+            result->keys[code] = static_cast<keyboard::vk>(code);
+        }
+
+        // Modifiers are applied as flags, but keys are kept for completeness
+        result->modifier_keys[0] = kVK_Shift;
+        result->modifier_keys[1] = kVK_Option;
+
+        TISInputSourceRef tis = TISCopyCurrentKeyboardLayoutInputSource();
+        if (!tis) { return result; }
+
+        CFDataRef layout_data = static_cast<CFDataRef>(
+            TISGetInputSourceProperty(tis, kTISPropertyUnicodeKeyLayoutData)
+        );
+        if (layout_data)
+        {
+            const auto *layout = reinterpret_cast<const UCKeyboardLayout *>(CFDataGetBytePtr(layout_data));
+            load_keys(layout, *result);
+            load_chars(layout, *result);
+        }
+
+        // Layout data is owned by input source
+        CFRelease(tis);
+        return result;
+    }
+
+private:
+    // Resolve localized virtual keys of letters
+    static void load_keys(const UCKeyboardLayout *layout, keyboard::layout &result)
+    {
+        for (UInt16 code = 0; code < 128; ++code)
+        {
+            UInt32       dead_key_state = 0;
+            UniCharCount length = 0;
+            UniChar      units[4];
+
+            // Command selects letters, used for shortcuts on non-latin layouts
+            OSStatus error = UCKeyTranslate(
+                layout, code, kUCKeyActionDown, cmdKey >> 8, LMGetKbdType(),
+                kUCKeyTranslateNoDeadKeysBit, &dead_key_state, std::size(units), &length, units
+            );
+
+            keyboard::vk vk;
+            if (error != noErr || length == 0 || !localizedKeys(units[0], vk)) { continue; }
+
+            result.keys[code] = vk;
+            result.codes[key_index(vk)] = code;
+        }
+    }
+
+    // Build character -> (virtual code, modifiers) table.
+    // Modifiers are 1 for Shift and 2 for Option
+    static void load_chars(const UCKeyboardLayout *layout, keyboard::layout &result)
+    {
+        // Lower levels first: none, Shift, Option, Shift + Option
+        for (std::uint16_t modifiers = 0; modifiers < 4; ++modifiers)
+        {
+            const UInt32 state = (
+                ((modifiers & 1) ? shiftKey : 0) | ((modifiers & 2) ? optionKey : 0)
+            ) >> 8;
+
+            for (UInt16 code = 0; code < 128; ++code)
+            {
+                UInt32       dead_key_state = 0;
+                UniCharCount length = 0;
+                UniChar      units[4];
+
+                OSStatus error = UCKeyTranslate(
+                    layout, code, kUCKeyActionDown, state, LMGetKbdType(),
+                    0, &dead_key_state, std::size(units), &length, units
+                );
+                // Dead keys type nothing by themselves
+                if (error != noErr || dead_key_state != 0) { continue; }
+
+                char32_t c = 0;
+                if (length == 1) { c = units[0]; }
+                else if (length == 2 && (units[0] & 0xFC00) == 0xD800 && (units[1] & 0xFC00) == 0xDC00)
+                {
+                    c = 0x10000 + ((char32_t(units[0]) - 0xD800) << 10) + (char32_t(units[1]) - 0xDC00);
+                }
+                if (c < 0x20 && c != U'\t' && c != U'\r') { continue; }
+
+                result.chars.insert(c, code, modifiers);
+            }
+        }
+    }
+};
+
+class hid_listener;
+
+class HIDInputManager
+{
+public:
+    static HIDInputManager & get() 
+    {
+        static HIDInputManager input; 
+        return input;
+    }
+
+    // Check if every key in combination is pressed (reads cached state only)
+    bool is_pressed(const os::keyboard::combination &combo)
+    {
+        return pressed_keys().contains(combo);
+    }
+
+    // Combination of all pressed keys (reads cached state only).
+    // Keycodes are translated with current layout, so keys, held across layout switch, are reported correctly
+    os::keyboard::combination pressed_keys()
+    {
+        const auto mapping = current_layout();
+
+        keyboard::combination combo;
+        for (std::size_t w = 0; w < std::size(pressed); ++w)
+        {
+            std::uint64_t bits = pressed[w].load(std::memory_order_acquire);
+            while (bits != 0)
+            {
+                const auto code = static_cast<std::uint16_t>(w * 64 + detail::countr_zero(bits));
+                const keyboard::vk key = mapping->key_of(code);
+                if (key != keyboard::vk{}) { combo.insert(key); }
+                bits &= bits - 1;
+            }
+        }
+        return combo;
+    }
+
+    // Check if HID manager was opened
+    bool active() const noexcept { return opened; }
+
+    // Get tables of current layout, rebuilding them after layout change
+    std::shared_ptr<const keyboard::layout> current_layout()
+    {
+        std::lock_guard lock(layout_mutex);
+        if (layout_changed.exchange(false)) { loaded = layout_builder::build(); }
+        return loaded;
+    }
+
+    // Start delivering input values to listener
+    void subscribe(hid_listener *listener)
+    {
+        std::lock_guard lock(listeners_mutex);
+        listeners.push_back(listener);
+    }
+
+    // Stop delivering input values to listener.
+    // Waits for delivery in progress, unless called from listener's callback
+    void unsubscribe(hid_listener *listener)
+    {
+        std::lock_guard delivery(delivery_mutex);
+        std::lock_guard lock(listeners_mutex);
+        listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+    }
+
+private:
+    IOHIDManagerRef         manager = nullptr;
+    bool                    opened = false;
+
+    std::unordered_map<keyboard::vk, IOHIDElementRef> keys;
+
+    // Tables of current layout. Marked as changed by input source notification
+    std::mutex                              layout_mutex;
+    std::atomic<bool>                       layout_changed { false };
+    std::shared_ptr<const keyboard::layout> loaded;
+
+    // Thread to receive input values
+    std::thread                     run_loop_thread;
+    CFRunLoopRef                    run_loop = nullptr;
+    std::mutex                  listeners_mutex;
+    std::vector<hid_listener *> listeners;
+    // Held while events are delivered. Recursive, so callbacks may make and destroy listeners
+    std::recursive_mutex        delivery_mutex;
+    std::vector<hid_listener *> delivering;
+
+    // Pressed keys, indexed by virtual keycode and updated on run loop thread
+    std::atomic<std::uint64_t> pressed[2] = {};
+
+    HIDInputManager() : loaded(layout_builder::build())
+    {
+        // Create an HID Manager reference
+        manager = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
+        // Open the HID Manager reference
+        IOReturn openStatus = IOHIDManagerOpen(manager, kIOHIDOptionsTypeNone);
+        opened = openStatus == kIOReturnSuccess;
+
+        if (opened)
+        {
+            // Initialize the keyboard
+            init_keyboard();
+            // Take keys that are already held, then keep them up to date
+            load_pressed();
+        }
+        // Layout notifications are delivered even without HID access
+        start_run_loop();
+    }
+
+    // Read current value of every key once
+    void load_pressed()
+    {
+        for (const auto &[vk, key] : keys)
+        {
+            IOHIDValueRef value = nullptr;
+            IOHIDDeviceRef device = IOHIDElementGetDevice(key);
+            IOReturn fetched = kIOReturnError;
+            {
+                stats_timer timer(keyboard::operation::hid_value_fetch);
+                fetched = IOHIDDeviceGetValue(device, key, &value);
+            }
+            if (fetched != kIOReturnSuccess || !value) { continue; }
+            set_pressed(usage_to_virtual_code(IOHIDElementGetUsage(key)), IOHIDValueGetIntegerValue(value) != 0);
+        }
+    }
+
+    // Update cached state of single key
+    void set_pressed(UInt8 virtual_code, bool is_down) noexcept
+    {
+        const std::size_t index = virtual_code;
+        if (index >= 64 * std::size(pressed)) { return; }
+
+        std::uint64_t bit = std::uint64_t(1) << (index % 64);
+        if (is_down) { pressed[index / 64].fetch_or(bit, std::memory_order_release); }
+        else         { pressed[index / 64].fetch_and(~bit, std::memory_order_release); }
+    }
+
+    // Schedule HID manager and layout notifications on their own run loop (only once)
+    void start_run_loop()
+    {
+        if (run_loop_thread.joinable()) { return; }
+
+        std::promise<CFRunLoopRef> started;
+        auto result = started.get_future();
+        run_loop_thread = std::thread(
+            [this, &started]()
+            {
+                CFRunLoopRef loop = CFRunLoopGetCurrent();
+
+                // Run loop exits immediately without sources
+                CFRunLoopSourceContext context = {};
+                context.perform = [](void *) {};
+                CFRunLoopSourceRef keep_alive = CFRunLoopSourceCreate(kCFAllocatorDefault, 0, &context);
+                CFRunLoopAddSource(loop, keep_alive, kCFRunLoopDefaultMode);
+
+                CFNotificationCenterAddObserver(
+                    CFNotificationCenterGetDistributedCenter(),
+                    this,
+                    &HIDInputManager::on_layout_changed,
+                    kTISNotifySelectedKeyboardInputSourceChanged,
+                    nullptr,
+                    CFNotificationSuspensionBehaviorDeliverImmediately
+                );
+
+                if (opened)
+                {
+                    IOHIDManagerRegisterInputValueCallback(manager, &HIDInputManager::on_value, this);
+                    IOHIDManagerScheduleWithRunLoop(manager, loop, kCFRunLoopDefaultMode);
+                }
+                started.set_value(loop);
+
+                CFRunLoopRun();
+
+                if (opened)
+                {
+                    IOHIDManagerUnscheduleFromRunLoop(manager, loop, kCFRunLoopDefaultMode);
+                }
+                CFNotificationCenterRemoveEveryObserver(CFNotificationCenterGetDistributedCenter(), this);
+                CFRunLoopRemoveSource(loop, keep_alive, kCFRunLoopDefaultMode);
+                CFRelease(keep_alive);
+            }
+        );
+        run_loop = result.get();
+    }
+
+    // Called on run loop thread for every changed HID element
+    static void on_value(void *context, IOReturn result, void *sender, IOHIDValueRef value);
+
+    // Called when user selects another keyboard input source
+    static void on_layout_changed(
+        CFNotificationCenterRef, void *observer, CFNotificationName, const void *, CFDictionaryRef
+    )
+    {
+        static_cast<HIDInputManager *>(observer)->layout_changed.store(true);
+    }
+
+    CFDictionaryRef copy_devices_mask(UInt32 page, UInt32 usage)
+    {
+        // Create the dictionary.
+        CFMutableDictionaryRef dict = 
+            CFDictionaryCreateMutable(
+                kCFAllocatorDefault, 
+                2, // capacity
+                &kCFTypeDictionaryKeyCallBacks,
+                &kCFTypeDictionaryValueCallBacks
+            );
+
+        // Add the page value.
+        CFNumberRef value = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &page);
+        CFDictionarySetValue(dict, CFSTR(kIOHIDDeviceUsagePageKey), value);
+        CFRelease(value);
+
+        // Add the usage value (which is only valid if page value exists).
+        value = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &usage);
+        CFDictionarySetValue(dict, CFSTR(kIOHIDDeviceUsageKey), value);
+        CFRelease(value);
+
+        return dict;
+    }
+
+    CFSetRef copy_devices(UInt32 page, UInt32 usage)
+    {
+        // Filter and keep only the requested devices
+        CFDictionaryRef mask = copy_devices_mask(page, usage);
+
+        IOHIDManagerSetDeviceMatching(manager, mask);
+
+        CFRelease(mask);
+        mask = nullptr;
+
+        CFSetRef devices = IOHIDManagerCopyDevices(manager);
+        if (devices == nullptr) { return nullptr; }
+
+        // Is there at least one device?
+        CFIndex device_count = CFSetGetCount(devices);
+        if (device_count == 0)
+        {
+            CFRelease(devices);
+            return nullptr;
+        }
+
+        return devices;
+    }
+
+    void init_keyboard()
+    {
+        ////////////////////////////////////////////////////////////
+        // The purpose of this function is to initialize keys so we can get
+        // the associate IOHIDElementRef with a vk in ~constant~ time.
+
+        // Get only keyboards
+        CFSetRef keyboards = copy_devices(kHIDPage_GenericDesktop, kHIDUsage_GD_Keyboard);
+        if (keyboards == nullptr) { return; }
+
+        CFIndex keyboard_count = CFSetGetCount(keyboards); // >= 1 (asserted by copyDevices)
+
+        // Get an iterable array
+        CFTypeRef devices_array[keyboard_count];
+        CFSetGetValues(keyboards, devices_array);
+
+        for (CFIndex i = 0; i < keyboard_count; ++i)
+        {
+            IOHIDDeviceRef keyboard = static_cast<IOHIDDeviceRef>(
+                const_cast<void *>(devices_array[i])
+            );
+            load_keyboard(keyboard);
+        }
+
+        // Release unused stuff
+        CFRelease(keyboards);
+    }
+
+
+    void load_keyboard(IOHIDDeviceRef keyboard)
+    {
+        CFArrayRef keys = 
+            IOHIDDeviceCopyMatchingElements(
+                keyboard,
+                nullptr, // match all
+                kIOHIDOptionsTypeNone
+            );
+        if (keys == nullptr) { return; }
+
+        // How many elements are there?
+        CFIndex keys_count = CFArrayGetCount(keys);
+        if (keys_count == 0) { return; }
+
+        // Go through all connected elements.
+        for (CFIndex i = 0; i < keys_count; ++i)
+        {
+            IOHIDElementRef key = static_cast<IOHIDElementRef>(
+                const_cast<void *>(CFArrayGetValueAtIndex(keys, i))
+            );
+            // Skip non-matching keys elements
+            if (IOHIDElementGetUsagePage(key) != kHIDPage_KeyboardOrKeypad) { continue; }
+            load_key(key);
+        }
+
+        // Release unused stuff
+        CFRelease(keys);
+    }
+
+    void load_key(IOHIDElementRef key)
+    {
+        // Get its virtual code
+        UInt32 usage = IOHIDElementGetUsage(key);
+        UInt8  virtual_code = usage_to_virtual_code(usage);
+
+        if (virtual_code == 0xff) { return; }
+
+        // Localized virtual key according to the current keyboard layout
+        keyboard::vk vk = loaded->key_of(virtual_code);
+
+        // Keep the reference alive for our usage
+        if (keys.count(vk)) { CFRelease(keys[vk]); }
+        keys[vk] = key;
+        CFRetain(key);
+    }
+
+    UInt8 usage_to_virtual_code(UInt32 usage)
+    {
+        switch (usage)
+        {
+            case kHIDUsage_KeyboardA:                   return 0x00;
+            case kHIDUsage_KeyboardB:                   return 0x0B;
+            case kHIDUsage_KeyboardC:                   return 0x08;
+            case kHIDUsage_KeyboardD:                   return 0x02;
+            case kHIDUsage_KeyboardE:                   return 0x0e;
+            case kHIDUsage_KeyboardF:                   return 0x03;
+            case kHIDUsage_KeyboardG:                   return 0x05;
+            case kHIDUsage_KeyboardH:                   return 0x04;
+            case kHIDUsage_KeyboardI:                   return 0x22;
+            case kHIDUsage_KeyboardJ:                   return 0x26;
+            case kHIDUsage_KeyboardK:                   return 0x28;
+            case kHIDUsage_KeyboardL:                   return 0x25;
+            case kHIDUsage_KeyboardM:                   return 0x2e;
+            case kHIDUsage_KeyboardN:                   return 0x2d;
+            case kHIDUsage_KeyboardO:                   return 0x1f;
+            case kHIDUsage_KeyboardP:                   return 0x23;
+            case kHIDUsage_KeyboardQ:                   return 0x0c;
+            case kHIDUsage_KeyboardR:                   return 0x0f;
+            case kHIDUsage_KeyboardS:                   return 0x01;
+            case kHIDUsage_KeyboardT:                   return 0x11;
+            case kHIDUsage_KeyboardU:                   return 0x20;
+            case kHIDUsage_KeyboardV:                   return 0x09;
+            case kHIDUsage_KeyboardW:                   return 0x0d;
+            case kHIDUsage_KeyboardX:                   return 0x07;
+            case kHIDUsage_KeyboardY:                   return 0x10;
+            case kHIDUsage_KeyboardZ:                   return 0x06;
+
+            case kHIDUsage_Keyboard1:                   return 0x12;
+            case kHIDUsage_Keyboard2:                   return 0x13;
+            case kHIDUsage_Keyboard3:                   return 0x14;
+            case kHIDUsage_Keyboard4:                   return 0x15;
+            case kHIDUsage_Keyboard5:                   return 0x17;
+            case kHIDUsage_Keyboard6:                   return 0x16;
+            case kHIDUsage_Keyboard7:                   return 0x1a;
+            case kHIDUsage_Keyboard8:                   return 0x1c;
+            case kHIDUsage_Keyboard9:                   return 0x19;
+            case kHIDUsage_Keyboard0:                   return 0x1d;
+
+            case kHIDUsage_KeyboardReturnOrEnter:       return 0x24;
+            case kHIDUsage_KeyboardEscape:              return 0x35;
+            case kHIDUsage_KeyboardDeleteOrBackspace:   return 0x33;
+            case kHIDUsage_KeyboardTab:                 return 0x30;
+            case kHIDUsage_KeyboardSpacebar:            return 0x31;
+            case kHIDUsage_KeyboardHyphen:              return 0x1b;
+            case kHIDUsage_KeyboardEqualSign:           return 0x18;
+            case kHIDUsage_KeyboardOpenBracket:         return 0x21;
+            case kHIDUsage_KeyboardCloseBracket:        return 0x1e;
+            case kHIDUsage_KeyboardBackslash:           return 0x2a;
+            case kHIDUsage_KeyboardSemicolon:           return 0x29;
+            case kHIDUsage_KeyboardQuote:               return 0x27;
+            case kHIDUsage_KeyboardGraveAccentAndTilde: return 0x32;
+            case kHIDUsage_KeyboardComma:               return 0x2b;
+            case kHIDUsage_KeyboardPeriod:              return 0x2F;
+            case kHIDUsage_KeyboardSlash:               return 0x2c;
+            case kHIDUsage_KeyboardCapsLock:            return 0x39;
+
+            case kHIDUsage_KeyboardF1:                  return 0x7a;
+            case kHIDUsage_KeyboardF2:                  return 0x78;
+            case kHIDUsage_KeyboardF3:                  return 0x63;
+            case kHIDUsage_KeyboardF4:                  return 0x76;
+            case kHIDUsage_KeyboardF5:                  return 0x60;
+            case kHIDUsage_KeyboardF6:                  return 0x61;
+            case kHIDUsage_KeyboardF7:                  return 0x62;
+            case kHIDUsage_KeyboardF8:                  return 0x64;
+            case kHIDUsage_KeyboardF9:                  return 0x65;
+            case kHIDUsage_KeyboardF10:                 return 0x6d;
+            case kHIDUsage_KeyboardF11:                 return 0x67;
+            case kHIDUsage_KeyboardF12:                 return 0x6f;
+
+            case kHIDUsage_KeyboardInsert:              return 0x72;
+            case kHIDUsage_KeyboardHome:                return 0x73;
+            case kHIDUsage_KeyboardPageUp:              return 0x74;
+            case kHIDUsage_KeyboardDeleteForward:       return 0x75;
+            case kHIDUsage_KeyboardEnd:                 return 0x77;
+            case kHIDUsage_KeyboardPageDown:            return 0x79;
+
+            case kHIDUsage_KeyboardRightArrow:          return 0x7c;
+            case kHIDUsage_KeyboardLeftArrow:           return 0x7b;
+            case kHIDUsage_KeyboardDownArrow:           return 0x7d;
+            case kHIDUsage_KeyboardUpArrow:             return 0x7e;
+
+            case kHIDUsage_KeypadNumLock:               return 0x47;
+            case kHIDUsage_KeypadSlash:                 return 0x4b;
+            case kHIDUsage_KeypadAsterisk:              return 0x43;
+            case kHIDUsage_KeypadHyphen:                return 0x4e;
+            case kHIDUsage_KeypadPlus:                  return 0x45;
+            case kHIDUsage_KeypadEnter:                 return 0x4c;
+
+            case kHIDUsage_Keypad1:                     return 0x53;
+            case kHIDUsage_Keypad2:                     return 0x54;
+            case kHIDUsage_Keypad3:                     return 0x55;
+            case kHIDUsage_Keypad4:                     return 0x56;
+            case kHIDUsage_Keypad5:                     return 0x57;
+            case kHIDUsage_Keypad6:                     return 0x58;
+            case kHIDUsage_Keypad7:                     return 0x59;
+            case kHIDUsage_Keypad8:                     return 0x5b;
+            case kHIDUsage_Keypad9:                     return 0x5c;
+            case kHIDUsage_Keypad0:                     return 0x52;
+
+            case kHIDUsage_KeypadPeriod:                return 0x41;
+            case kHIDUsage_KeyboardApplication:         return 0x6e;
+            case kHIDUsage_KeypadEqualSign:             return 0x51;
+
+            case kHIDUsage_KeyboardLeftControl:         return 0x3b;
+            case kHIDUsage_KeyboardLeftShift:           return 0x38;
+            case kHIDUsage_KeyboardLeftAlt:             return 0x3a;
+            case kHIDUsage_KeyboardLeftGUI:             return 0x37;
+            case kHIDUsage_KeyboardRightControl:        return 0x3e;
+            case kHIDUsage_KeyboardRightShift:          return 0x3c;
+            case kHIDUsage_KeyboardRightAlt:            return 0x3d;
+            case kHIDUsage_KeyboardRightGUI:            return 0x36;
+
+            default:                                    return 0xff;
+        }
+    }
+
+    ~HIDInputManager()
+    {
+        if (run_loop_thread.joinable())
+        {
+            CFRunLoopStop(run_loop);
+            run_loop_thread.join();
+        }
+
+        if (manager)
+        {
+            CFRelease(manager);
+        }
+
+        for (auto &[vk, key] : keys)
+        {
+            CFRelease(key);
+        }
+    }
+};
+
+// Source of listener's events, based on HID manager's input value callback
+class hid_listener : public keyboard::listener::source
+{
+public:
+    hid_listener(keyboard::listener &owner) : source(owner)
+    {
+        HIDInputManager::get().subscribe(this);
+    }
+
+    bool active() const noexcept override { return HIDInputManager::get().active(); }
+
+    // Pass event to listener
+    void push(const keyboard::listener::event &e) { deliver(e); }
+
+    ~hid_listener() override { HIDInputManager::get().unsubscribe(this); }
+};
+
+void HIDInputManager::on_value(void *context, IOReturn result, void *sender, IOHIDValueRef value)
+{
+    auto *self = static_cast<HIDInputManager *>(context);
+
+    IOHIDElementRef element = IOHIDValueGetElement(value);
+    if (IOHIDElementGetUsagePage(element) != kHIDPage_KeyboardOrKeypad) { return; }
+
+    UInt8 virtual_code = self->usage_to_virtual_code(IOHIDElementGetUsage(element));
+    if (virtual_code == 0xff) { return; }
+
+    keyboard::listener::event e;
+    e.key = self->current_layout()->key_of(virtual_code);
+    e.is_down = IOHIDValueGetIntegerValue(value) != 0;
+    e.time = std::chrono::steady_clock::now();
+
+    self->set_pressed(virtual_code, e.is_down);
+
+    // Callbacks are called outside listeners_mutex, so they may subscribe and unsubscribe
+    std::lock_guard delivery(self->delivery_mutex);
+    {
+        std::lock_guard lock(self->listeners_mutex);
+        self->delivering = self->listeners;
+    }
+    for (auto *listener : self->delivering)
+    {
+        {
+            // Skip listeners, destroyed by previous callbacks
+            std::lock_guard lock(self->listeners_mutex);
+            if (std::find(self->listeners.begin(), self->listeners.end(), listener) == self->listeners.end()) { continue; }
+        }
+        listener->push(e);
+    }
+}
+
+// Post mouse event and release it
+void post_mouse_event(CGEventRef event)
+{
+    if (!event) { return; }
+    {
+        stats_timer timer(keyboard::operation::fake_key_event);
+        CGEventPost(kCGHIDEventTap, event);
+    }
+    CFRelease(event);
+}
+
+// Get current location of cursor
+CGPoint cursor_location()
+{
+    CGPoint location = {};
+    if (CGEventRef event = CGEventCreate(nullptr))
+    {
+        location = CGEventGetLocation(event);
+        CFRelease(event);
+    }
+    return location;
+}
+
+// Keyboard functions, implemented with CGEvent and HID manager
+class quartz_backend : public keyboard::backend
+{
+public:
+    bool is_pressed(const keyboard::combination &combo) override { return HIDInputManager::get().is_pressed(combo); }
+
+    keyboard::combination pressed_keys() override { return HIDInputManager::get().pressed_keys(); }
+
+    // Modifiers are pressed before and released after other keys of combination
+    void send(const keyboard::combination &combo, bool is_down) override
+    {
+        const auto mapping = current_layout();
+        auto &events = event_cache::get();
+
+        auto post_modifiers = [&]
+        {
+            for (auto key : combo)
+            {
+                if (CGEventFlags flag = modifier_mask(key); flag != 0) { events.post_modifier(mapping->code_of(key), is_down, flag); }
+            }
+        };
+
+        if (is_down) { post_modifiers(); }
+        for (auto key : combo)
+        {
+            if (modifier_mask(key) == 0) { events.post(mapping->code_of(key), is_down, 0); }
+        }
+        if (!is_down) { post_modifiers(); }
+    }
+
+    // Modifiers stay held across calls, so sequence may be split into several batches
+    void send(span<const keyboard::key_event> events) override
+    {
+        const auto mapping = current_layout();
+        auto &cache = event_cache::get();
+
+        for (const auto &event : events)
+        {
+            const CGKeyCode code = mapping->code_of(event.key);
+            if (CGEventFlags flag = modifier_mask(event.key); flag != 0) { cache.post_modifier(code, event.is_down, flag); }
+            else { cache.post(code, event.is_down, 0); }
+        }
+    }
+
+    void type(std::u32string_view text) override
+    {
+        const auto mapping = current_layout();
+        auto &events = event_cache::get();
+
+        for (char32_t c : text)
+        {
+            if (c == U'\n') { c = U'\r'; }
+
+            if (const auto *key = mapping->find(c))
+            {
+                CGEventFlags flags = 0;
+                if (key->modifiers & 1) { flags |= kCGEventFlagMaskShift; }
+                if (key->modifiers & 2) { flags |= kCGEventFlagMaskAlternate; }
+
+                events.post(key->code, true, flags);
+                events.post(key->code, false, flags);
+                continue;
+            }
+
+            // Missing in layout: send as UTF-16 code units
+            UniChar units[2] = { static_cast<UniChar>(c), 0 };
+            UniCharCount count = 1;
+            if (c > 0xFFFF)
+            {
+                units[0] = static_cast<UniChar>(0xD800 + ((c - 0x10000) >> 10));
+                units[1] = static_cast<UniChar>(0xDC00 + ((c - 0x10000) & 0x3FF));
+                count = 2;
+            }
+            events.post_unicode(units, count);
+        }
+    }
+
+    std::shared_ptr<const keyboard::layout> current_layout() override { return HIDInputManager::get().current_layout(); }
+
+    std::unique_ptr<keyboard::listener::source> listen(keyboard::listener &owner) override
+    {
+        return std::make_unique<hid_listener>(owner);
+    }
+
+    mouse::point mouse_position() override
+    {
+        const CGPoint location = cursor_location();
+        return mouse::point{ static_cast<int>(location.x), static_cast<int>(location.y) };
+    }
+
+    void send_mouse(span<const mouse::event> events) override
+    {
+        constexpr CGMouseButton buttons[mouse::button_count] = {
+            kCGMouseButtonLeft, kCGMouseButtonRight, kCGMouseButtonCenter,
+            static_cast<CGMouseButton>(3), static_cast<CGMouseButton>(4)
+        };
+
+        // Quartz has no relative moves, so position is tracked through the batch
+        CGPoint location = cursor_location();
+        for (const auto &event : events)
+        {
+            const auto b = static_cast<std::size_t>(event.button);
+            switch (event.kind)
+            {
+            case mouse::action::move_to:
+            case mouse::action::move_by:
+            {
+                const CGFloat dx = event.kind == mouse::action::move_by ? event.x : event.x - location.x;
+                const CGFloat dy = event.kind == mouse::action::move_by ? event.y : event.y - location.y;
+                location.x += dx;
+                location.y += dy;
+
+                // Motion with held button is a drag
+                const unsigned held = buttons_down.load();
+                CGEventType type = kCGEventMouseMoved;
+                CGMouseButton button = kCGMouseButtonLeft;
+                if (held & 1) { type = kCGEventLeftMouseDragged; }
+                else if (held & 2) { type = kCGEventRightMouseDragged; button = kCGMouseButtonRight; }
+                else if (held != 0) { type = kCGEventOtherMouseDragged; button = kCGMouseButtonCenter; }
+
+                CGEventRef motion = CGEventCreateMouseEvent(nullptr, type, location, button);
+                if (motion)
+                {
+                    CGEventSetIntegerValueField(motion, kCGMouseEventDeltaX, static_cast<int64_t>(dx));
+                    CGEventSetIntegerValueField(motion, kCGMouseEventDeltaY, static_cast<int64_t>(dy));
+                }
+                post_mouse_event(motion);
+                break;
+            }
+            case mouse::action::press:
+            case mouse::action::release:
+            {
+                const bool is_down = event.kind == mouse::action::press;
+                if (is_down) { buttons_down.fetch_or(1u << b); } else { buttons_down.fetch_and(~(1u << b)); }
+
+                CGEventType type = is_down ? kCGEventOtherMouseDown : kCGEventOtherMouseUp;
+                if (event.button == mouse::button::left) { type = is_down ? kCGEventLeftMouseDown : kCGEventLeftMouseUp; }
+                if (event.button == mouse::button::right) { type = is_down ? kCGEventRightMouseDown : kCGEventRightMouseUp; }
+
+                CGEventRef click = CGEventCreateMouseEvent(nullptr, type, location, buttons[b]);
+                if (click) { CGEventSetIntegerValueField(click, kCGMouseEventClickState, 1); }
+                post_mouse_event(click);
+                break;
+            }
+            case mouse::action::scroll:
+                post_mouse_event(CGEventCreateScrollWheelEvent(nullptr, kCGScrollEventUnitLine, 2, event.y, event.x));
+                break;
+            }
+        }
+    }
+
+private:
+    // Buttons, pressed through this backend, so motion is sent as drag
+    std::atomic<unsigned> buttons_down{0};
+};
+
+// Backend, installed on current thread
+keyboard::backend *& thread_backend() noexcept
+{
+    thread_local keyboard::backend *installed = nullptr;
+    return installed;
+}
+
+} // namespace os::detail
+
+
+namespace os::keyboard
+{
+
+// Get backend, that calls OS
+backend & native_backend()
+{
+    static detail::quartz_backend native;
+    return native;
+}
+
+// Check if every key in combination is pressed
+bool is_pressed(const combination &combo) { return current_backend().is_pressed(combo); }
+
+// Get combination of all pressed keys on a keyboard
+combination pressed_keys() { return current_backend().pressed_keys(); }
+
+// Capture state of the whole keyboard at once
+state snapshot() { return current_backend().snapshot(); }
+
+// Press combination of keys (until release)
+void press(const combination &combo) { current_backend().send(combo, true); }
+
+// Release combination of keys
+void release(const combination &combo) { current_backend().send(combo, false); }
+
+// Send sequence of key events at once
+void send(span<const key_event> events) { current_backend().send(events); }
+
+// Get layout, that is active now
+std::shared_ptr<const layout> layout::current() { return current_backend().current_layout(); }
+
+// Type text, using current keyboard layout
+void type(std::u32string_view text) { current_backend().type(text); }
+
+// Start listening and queue events
+listener::listener() : origin(current_backend().listen(*this)) {}
+
+// Start listening and pass events to callback
+listener::listener(callback on_event)
+    : on_event(std::move(on_event)), origin(current_backend().listen(*this)) {}
+
+// Stop listening
+listener::~listener() { origin.reset(); }
+
+// Check if OS delivers events to listener
+bool listener::active() const noexcept { return origin->active(); }
+
+// Get counters of native backend
+stats_t stats()
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    return detail::stats_registry::get().collect();
+#else
+    return {};
+#endif
+}
+
+// Reset counters of every thread
+void reset_stats()
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    detail::stats_registry::get().clear();
+#endif
+}
+
+} // namespace os::keyboard
+// End of src/macos/keyboard.cpp
+// =========================
+
+#endif // IS_OS_*
 
-#endif // IS_OS_WINDOWS
+#endif // LIBOS_IMPLEMENTATION
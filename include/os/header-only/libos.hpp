@@ -26,7 +26,8 @@
  *  Library information. Header-only
  */
 
-#pragma once
+#ifndef LIBOS_HEADER_ONLY_LIBOS_HPP
+#define LIBOS_HEADER_ONLY_LIBOS_HPP
 
 #include <string_view>
 
@@ -40,4 +41,6 @@ namespace libos
 /// LibOS version string
 constexpr std::string_view version_string = LIBOS_VERSION_STRING;
 
-} // namespace libos
\ No newline at end of file
+} // namespace libos
+
+#endif // LIBOS_HEADER_ONLY_LIBOS_HPP
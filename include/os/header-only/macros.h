@@ -26,7 +26,8 @@
  *  Macros for OS-specific code. Header-only
  */
 
-#pragma once
+#ifndef LIBOS_HEADER_ONLY_MACROS_H
+#define LIBOS_HEADER_ONLY_MACROS_H
 
 
 #if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
@@ -63,4 +64,6 @@
 #   define IS_OS_MACOS 1
 #else
 #   define IS_OS_MACOS 0
-#endif
\ No newline at end of file
+#endif
+
+#endif // LIBOS_HEADER_ONLY_MACROS_H
@@ -0,0 +1,466 @@
+// Memory info. Header-only
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/header-only/memory.hpp
+ *  Memory info. Header-only
+ */
+
+#ifndef LIBOS_HEADER_ONLY_MEMORY_HPP
+#define LIBOS_HEADER_ONLY_MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace os::memory
+{
+
+/// Facts about memory, that don't change while program runs
+struct info_t
+{
+    /// Size of regular page in bytes
+    std::size_t page_size = 0;
+
+    /// Supported sizes of huge (large) pages in bytes, in ascending order
+    std::vector<std::size_t> huge_page_sizes;
+    /// Program may allocate huge pages explicitly
+    bool huge_pages_available = false;
+    /// OS backs suitable allocations with huge pages automatically (Linux THP)
+    bool transparent_huge_pages = false;
+
+    /// Total physical memory in bytes
+    std::uint64_t total = 0;
+};
+
+/// Memory figures, that change all the time. Fields are 0, if OS didn't report them
+struct snapshot_t
+{
+    /// Physical memory in bytes, that may be given to programs without swapping
+    std::uint64_t available = 0;
+    /// Physical memory of this process in bytes (resident set size)
+    std::uint64_t resident = 0;
+    /// Max resident set size of this process in bytes
+    std::uint64_t peak_resident = 0;
+};
+
+/// Get size of regular page in bytes
+std::size_t page_size();
+
+/// Get total physical memory in bytes
+std::uint64_t total();
+
+/**
+ * @brief Get facts about memory
+ *
+ * @details
+ *  Facts are read once, even if several threads call it at the same time:
+ *  - Linux: `sysconf`, `sysinfo` and `/sys/kernel/mm`.
+ *    Huge pages are available, if pool of `/sys/kernel/mm/hugepages` isn't empty
+ *  - Windows: `GetSystemInfo`, `GetLargePageMinimum` and `GlobalMemoryStatusEx`.
+ *    Large pages are available, if process has `SeLockMemoryPrivilege`
+ *  - MacOS: `sysctl hw.memsize`. 2MB superpages are available on x86_64 only
+ *
+ * @return const info_t& Ref to memory facts
+ */
+const info_t & info();
+
+/**
+ * @brief Sample current memory figures
+ *
+ * @details
+ *  Doesn't allocate, so it may be called at high rate (e.g. 1 kHz):
+ *  - Linux: `MemAvailable` of `/proc/meminfo` (`sysinfo` on old kernels),
+ *    `/proc/self/statm` and `getrusage`
+ *  - Windows: `GlobalMemoryStatusEx` and `GetProcessMemoryInfo`
+ *  - MacOS: `host_statistics64` and `task_info`
+ */
+snapshot_t snapshot() noexcept;
+
+} // namespace os::memory
+
+#endif // LIBOS_HEADER_ONLY_MEMORY_HPP
+
+// -------------------------
+// |    IMPLEMENTATION     |
+// -------------------------
+
+#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined(LIBOS_MEMORY_CPP_IMPLEMENTED)
+#define LIBOS_MEMORY_CPP_IMPLEMENTED
+
+#include "macros.h"
+
+#if IS_OS_LINUX
+// src/linux/memory.cpp
+// =========================
+#include "memory.hpp"
+
+#include "macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Parse unsigned number after leading spaces
+std::uint64_t parse_memory_number(std::string_view &text)
+{
+    while (!text.empty() && text.front() == ' ') { text.remove_prefix(1); }
+
+    std::uint64_t value = 0;
+    while (!text.empty() && '0' <= text.front() && text.front() <= '9')
+    {
+        value = value * 10 + static_cast<std::uint64_t>(text.front() - '0');
+        text.remove_prefix(1);
+    }
+    return value;
+}
+
+// Read start of procfs file into buffer without allocations (empty on error)
+std::string_view read_proc_prefix(int fd, char *buffer, std::size_t size)
+{
+    if (fd < 0) { return {}; }
+
+    const ssize_t length = pread(fd, buffer, size, 0);
+    return length > 0 ? std::string_view(buffer, static_cast<std::size_t>(length)) : std::string_view{};
+}
+
+// Read facts about memory
+memory::info_t read_memory_info()
+{
+    memory::info_t i;
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    i.page_size = page_size > 0 ? static_cast<std::size_t>(page_size) : 0;
+
+    struct sysinfo system = {};
+    if (sysinfo(&system) == 0) { i.total = std::uint64_t{system.totalram} * system.mem_unit; }
+
+    // Pools of huge pages are directories "hugepages-<size>kB"
+    const std::string root = "/sys/kernel/mm/hugepages/";
+    if (DIR *pools = opendir(root.c_str()))
+    {
+        while (const dirent *entry = readdir(pools))
+        {
+            std::string_view name = entry->d_name;
+            if (name.substr(0, 10) != "hugepages-") { continue; }
+            name.remove_prefix(10);
+
+            const std::uint64_t size = parse_memory_number(name);
+            if (size == 0 || name != "kB") { continue; }
+            i.huge_page_sizes.push_back(static_cast<std::size_t>(size << 10));
+
+            std::ifstream pages(root + entry->d_name + "/nr_hugepages");
+            std::uint64_t count = 0;
+            if (pages >> count && count > 0) { i.huge_pages_available = true; }
+        }
+        closedir(pools);
+
+        std::sort(i.huge_page_sizes.begin(), i.huge_page_sizes.end());
+    }
+
+    // Mode in use is in brackets, e.g. "always [madvise] never"
+    std::ifstream thp("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string modes;
+    std::getline(thp, modes);
+    i.transparent_huge_pages = !modes.empty() && modes.find("[never]") == std::string::npos;
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os::memory
+{
+
+// Get size of regular page in bytes
+std::size_t page_size() { return info().page_size; }
+
+// Get total physical memory in bytes
+std::uint64_t total() { return info().total; }
+
+// Get facts about memory
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_memory_info();
+    return i;
+}
+
+// Sample current memory figures
+snapshot_t snapshot() noexcept
+{
+    snapshot_t s;
+
+    // File is generated anew on every read, so it's opened only once.
+    // MemAvailable is near the start of it
+    static const int meminfo = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    char buffer[512];
+    std::string_view text = detail::read_proc_prefix(meminfo, buffer, sizeof(buffer));
+    if (const auto pos = text.find("MemAvailable:"); pos != std::string_view::npos)
+    {
+        text.remove_prefix(pos + 13);
+        s.available = detail::parse_memory_number(text) << 10;
+    }
+    else
+    {
+        // Kernels before 3.14 don't estimate available memory
+        struct sysinfo system = {};
+        if (sysinfo(&system) == 0)
+        {
+            s.available = (std::uint64_t{system.freeram} + system.bufferram) * system.mem_unit;
+        }
+    }
+
+    // Opened per call: cached descriptor would point to parent after fork()
+    const int statm = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    text = detail::read_proc_prefix(statm, buffer, sizeof(buffer));
+    if (statm >= 0) { close(statm); }
+
+    // Resident pages are the second number
+    detail::parse_memory_number(text);
+    s.resident = detail::parse_memory_number(text) * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) { s.peak_resident = static_cast<std::uint64_t>(usage.ru_maxrss) << 10; }
+
+    return s;
+}
+
+} // namespace os::memory
+// End of src/linux/memory.cpp
+// =========================
+
+#elif IS_OS_WINDOWS
+// src/windows/memory.cpp
+// =========================
+#include "memory.hpp"
+
+#include "macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <memory>
+
+#include <Windows.h>
+#include <Psapi.h>
+
+namespace os::detail
+{
+    // Check if process token has privilege, required for large pages
+    bool has_lock_memory_privilege()
+    {
+        LUID lock_memory = {};
+        if (!LookupPrivilegeValueW(nullptr, L"SeLockMemoryPrivilege", &lock_memory)) { return false; }
+
+        HANDLE token = nullptr;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) { return false; }
+
+        bool found = false;
+        DWORD length = 0;
+        GetTokenInformation(token, TokenPrivileges, nullptr, 0, &length);
+        if (length > 0)
+        {
+            auto buffer = std::make_unique<BYTE[]>(length);
+            if (GetTokenInformation(token, TokenPrivileges, buffer.get(), length, &length))
+            {
+                const auto &privileges = *reinterpret_cast<const TOKEN_PRIVILEGES *>(buffer.get());
+                for (DWORD p = 0; p < privileges.PrivilegeCount; ++p)
+                {
+                    const LUID &luid = privileges.Privileges[p].Luid;
+                    if (luid.LowPart == lock_memory.LowPart && luid.HighPart == lock_memory.HighPart) { found = true; }
+                }
+            }
+        }
+
+        CloseHandle(token);
+        return found;
+    }
+
+    // Read facts about memory
+    memory::info_t read_memory_info()
+    {
+        memory::info_t i;
+
+        SYSTEM_INFO system = {};
+        GetSystemInfo(&system);
+        i.page_size = system.dwPageSize;
+
+        if (const SIZE_T large = GetLargePageMinimum())
+        {
+            i.huge_page_sizes.push_back(large);
+            i.huge_pages_available = has_lock_memory_privilege();
+        }
+
+        MEMORYSTATUSEX status = {};
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status)) { i.total = status.ullTotalPhys; }
+
+        return i;
+    }
+}
+
+namespace os::memory
+{
+    // Get size of regular page in bytes
+    std::size_t page_size() { return info().page_size; }
+
+    // Get total physical memory in bytes
+    std::uint64_t total() { return info().total; }
+
+    // Get facts about memory
+    const info_t & info()
+    {
+        // Init info only once.
+        static const info_t i = detail::read_memory_info();
+        return i;
+    }
+
+    // Sample current memory figures
+    snapshot_t snapshot() noexcept
+    {
+        snapshot_t s;
+
+        MEMORYSTATUSEX status = {};
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status)) { s.available = status.ullAvailPhys; }
+
+        // K32 version is in kernel32, so there is no need to link psapi
+        PROCESS_MEMORY_COUNTERS counters = {};
+        counters.cb = sizeof(counters);
+        if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            s.resident = counters.WorkingSetSize;
+            s.peak_resident = counters.PeakWorkingSetSize;
+        }
+
+        return s;
+    }
+}
+// End of src/windows/memory.cpp
+// =========================
+
+#elif IS_OS_MACOS
+// src/macos/memory.cpp
+// =========================
+#include "memory.hpp"
+
+#include "macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <mach/mach.h>
+#include <sys/sysctl.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Read facts about memory
+memory::info_t read_memory_info()
+{
+    memory::info_t i;
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    i.page_size = page_size > 0 ? static_cast<std::size_t>(page_size) : 0;
+
+#if defined(__x86_64__)
+    // Allocated with VM_FLAGS_SUPERPAGE_SIZE_2MB
+    i.huge_page_sizes.push_back(std::size_t{2} << 20);
+    i.huge_pages_available = true;
+#endif
+
+    std::uint64_t total = 0;
+    std::size_t size = sizeof(total);
+    if (sysctlbyname("hw.memsize", &total, &size, nullptr, 0) == 0) { i.total = total; }
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os::memory
+{
+
+// Get size of regular page in bytes
+std::size_t page_size() { return info().page_size; }
+
+// Get total physical memory in bytes
+std::uint64_t total() { return info().total; }
+
+// Get facts about memory
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_memory_info();
+    return i;
+}
+
+// Sample current memory figures
+snapshot_t snapshot() noexcept
+{
+    snapshot_t s;
+
+    // mach_host_self() adds reference to port on every call
+    static const mach_port_t host = mach_host_self();
+
+    vm_statistics64_data_t vm = {};
+    mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+    if (host_statistics64(host, HOST_VM_INFO64, reinterpret_cast<host_info64_t>(&vm), &count) == KERN_SUCCESS)
+    {
+        // Inactive pages are reclaimed without swapping
+        s.available = (std::uint64_t{vm.free_count} + vm.inactive_count) * vm_page_size;
+    }
+
+    mach_task_basic_info_data_t task = {};
+    count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&task), &count) == KERN_SUCCESS)
+    {
+        s.resident = task.resident_size;
+        s.peak_resident = task.resident_size_max;
+    }
+
+    return s;
+}
+
+} // namespace os::memory
+// End of src/macos/memory.cpp
+// =========================
+
+#endif // IS_OS_*
+
+#endif // LIBOS_IMPLEMENTATION
@@ -0,0 +1,338 @@
+// Process usage. Header-only
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/header-only/process.hpp
+ *  Process usage. Header-only
+ */
+
+#ifndef LIBOS_HEADER_ONLY_PROCESS_HPP
+#define LIBOS_HEADER_ONLY_PROCESS_HPP
+
+#include <chrono>
+#include <cstdint>
+
+namespace os::process
+{
+
+/// Resource usage of process since its start. Fields are 0, if OS doesn't report them
+struct usage_t
+{
+    /// CPU time in user mode
+    std::chrono::nanoseconds user_time{0};
+    /// CPU time in kernel mode
+    std::chrono::nanoseconds system_time{0};
+
+    /// Context switches, because process waited (e.g. for I/O)
+    std::uint64_t voluntary_switches = 0;
+    /// Context switches, because scheduler preempted process
+    std::uint64_t involuntary_switches = 0;
+
+    /// Page faults, that required I/O
+    std::uint64_t major_faults = 0;
+    /// Page faults, that were served without I/O
+    std::uint64_t minor_faults = 0;
+
+    /// Bytes read
+    std::uint64_t read_bytes = 0;
+    /// Bytes written
+    std::uint64_t write_bytes = 0;
+
+    /// Get total CPU time
+    constexpr std::chrono::nanoseconds cpu_time() const noexcept { return user_time + system_time; }
+
+    /// Get usage between two samples
+    constexpr usage_t operator-(const usage_t &rhs) const noexcept
+    {
+        usage_t delta;
+        delta.user_time = user_time - rhs.user_time;
+        delta.system_time = system_time - rhs.system_time;
+        delta.voluntary_switches = voluntary_switches - rhs.voluntary_switches;
+        delta.involuntary_switches = involuntary_switches - rhs.involuntary_switches;
+        delta.major_faults = major_faults - rhs.major_faults;
+        delta.minor_faults = minor_faults - rhs.minor_faults;
+        delta.read_bytes = read_bytes - rhs.read_bytes;
+        delta.write_bytes = write_bytes - rhs.write_bytes;
+        return delta;
+    }
+
+    /// Add usage of another period (e.g. to sum up deltas)
+    constexpr usage_t & operator+=(const usage_t &rhs) noexcept
+    {
+        user_time += rhs.user_time;
+        system_time += rhs.system_time;
+        voluntary_switches += rhs.voluntary_switches;
+        involuntary_switches += rhs.involuntary_switches;
+        major_faults += rhs.major_faults;
+        minor_faults += rhs.minor_faults;
+        read_bytes += rhs.read_bytes;
+        write_bytes += rhs.write_bytes;
+        return *this;
+    }
+};
+
+/**
+ * @brief Sample resource usage of current process
+ *
+ * @details
+ *  Doesn't allocate, so it may be called for every request:
+ *  - Linux: `getrusage` and `rchar`/`wchar` of `/proc/self/io` (bytes of every read and write call)
+ *  - Windows: `GetProcessTimes`, `GetProcessMemoryInfo` and `GetProcessIoCounters`
+ *    (bytes of every read and write call). There are no context switches or major faults,
+ *    every page fault is counted as minor
+ *  - MacOS: `getrusage` and `proc_pid_rusage` (bytes of disk I/O)
+ *
+ * @code{.cpp}
+ * const auto start = os::process::usage();
+ * handle(request);
+ * const auto cost = os::process::usage() - start;
+ * @endcode
+ */
+usage_t usage() noexcept;
+
+/// Get sum of usages
+constexpr usage_t operator+(usage_t lhs, const usage_t &rhs) noexcept { return lhs += rhs; }
+
+} // namespace os::process
+
+#endif // LIBOS_HEADER_ONLY_PROCESS_HPP
+
+// -------------------------
+// |    IMPLEMENTATION     |
+// -------------------------
+
+#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined(LIBOS_PROCESS_CPP_IMPLEMENTED)
+#define LIBOS_PROCESS_CPP_IMPLEMENTED
+
+#include "macros.h"
+
+#if IS_OS_LINUX
+// src/linux/process.cpp
+// =========================
+#include "process.hpp"
+
+#include "macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Get value of "<name>: <number>" line of /proc file (0, if missing)
+std::uint64_t parse_proc_field(std::string_view text, std::string_view name)
+{
+    const auto pos = text.find(name);
+    if (pos == std::string_view::npos) { return 0; }
+    text.remove_prefix(pos + name.size());
+
+    while (!text.empty() && (text.front() == ':' || text.front() == ' ')) { text.remove_prefix(1); }
+
+    std::uint64_t value = 0;
+    while (!text.empty() && '0' <= text.front() && text.front() <= '9')
+    {
+        value = value * 10 + static_cast<std::uint64_t>(text.front() - '0');
+        text.remove_prefix(1);
+    }
+    return value;
+}
+
+// Convert timeval to nanoseconds
+std::chrono::nanoseconds to_nanoseconds(const timeval &time)
+{
+    return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+}
+
+} // namespace os::detail
+
+namespace os::process
+{
+
+// Sample resource usage of current process
+usage_t usage() noexcept
+{
+    usage_t u;
+
+    rusage r = {};
+    if (getrusage(RUSAGE_SELF, &r) == 0)
+    {
+        u.user_time = detail::to_nanoseconds(r.ru_utime);
+        u.system_time = detail::to_nanoseconds(r.ru_stime);
+        u.voluntary_switches = static_cast<std::uint64_t>(r.ru_nvcsw);
+        u.involuntary_switches = static_cast<std::uint64_t>(r.ru_nivcsw);
+        u.major_faults = static_cast<std::uint64_t>(r.ru_majflt);
+        u.minor_faults = static_cast<std::uint64_t>(r.ru_minflt);
+    }
+
+    // Read at once without iostreams: file is less than 200 bytes
+    const int io = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    if (io >= 0)
+    {
+        char buffer[256];
+        const ssize_t length = read(io, buffer, sizeof(buffer));
+        close(io);
+
+        if (length > 0)
+        {
+            const std::string_view text(buffer, static_cast<std::size_t>(length));
+            u.read_bytes = detail::parse_proc_field(text, "rchar");
+            u.write_bytes = detail::parse_proc_field(text, "wchar");
+        }
+    }
+
+    return u;
+}
+
+} // namespace os::process
+// End of src/linux/process.cpp
+// =========================
+
+#elif IS_OS_WINDOWS
+// src/windows/process.cpp
+// =========================
+#include "process.hpp"
+
+#include "macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <Windows.h>
+#include <Psapi.h>
+
+namespace os::detail
+{
+    // Convert FILETIME interval to nanoseconds
+    std::chrono::nanoseconds to_nanoseconds(const FILETIME &time)
+    {
+        // FILETIME counts 100ns intervals
+        const std::uint64_t intervals = (std::uint64_t{ time.dwHighDateTime } << 32) | time.dwLowDateTime;
+        return std::chrono::nanoseconds(static_cast<std::int64_t>(intervals * 100));
+    }
+}
+
+namespace os::process
+{
+    // Sample resource usage of current process
+    usage_t usage() noexcept
+    {
+        usage_t u;
+
+        const HANDLE process = GetCurrentProcess();
+
+        FILETIME creation, exit, kernel, user;
+        if (GetProcessTimes(process, &creation, &exit, &kernel, &user))
+        {
+            u.user_time = detail::to_nanoseconds(user);
+            u.system_time = detail::to_nanoseconds(kernel);
+        }
+
+        // K32 version is in kernel32, so there is no need to link psapi
+        PROCESS_MEMORY_COUNTERS counters = {};
+        counters.cb = sizeof(counters);
+        if (K32GetProcessMemoryInfo(process, &counters, sizeof(counters)))
+        {
+            u.minor_faults = counters.PageFaultCount;
+        }
+
+        IO_COUNTERS io = {};
+        if (GetProcessIoCounters(process, &io))
+        {
+            u.read_bytes = io.ReadTransferCount;
+            u.write_bytes = io.WriteTransferCount;
+        }
+
+        return u;
+    }
+}
+// End of src/windows/process.cpp
+// =========================
+
+#elif IS_OS_MACOS
+// src/macos/process.cpp
+// =========================
+#include "process.hpp"
+
+#include "macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <libproc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Convert timeval to nanoseconds
+std::chrono::nanoseconds to_nanoseconds(const timeval &time)
+{
+    return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+}
+
+} // namespace os::detail
+
+namespace os::process
+{
+
+// Sample resource usage of current process
+usage_t usage() noexcept
+{
+    usage_t u;
+
+    // Times of proc_pid_rusage are in Mach ticks on Apple Silicon, so they're taken from here
+    rusage r = {};
+    if (getrusage(RUSAGE_SELF, &r) == 0)
+    {
+        u.user_time = detail::to_nanoseconds(r.ru_utime);
+        u.system_time = detail::to_nanoseconds(r.ru_stime);
+        u.voluntary_switches = static_cast<std::uint64_t>(r.ru_nvcsw);
+        u.involuntary_switches = static_cast<std::uint64_t>(r.ru_nivcsw);
+        u.major_faults = static_cast<std::uint64_t>(r.ru_majflt);
+        u.minor_faults = static_cast<std::uint64_t>(r.ru_minflt);
+    }
+
+    rusage_info_v2 info = {};
+    if (proc_pid_rusage(getpid(), RUSAGE_INFO_V2, reinterpret_cast<rusage_info_t *>(&info)) == 0)
+    {
+        u.read_bytes = info.ri_diskio_bytesread;
+        u.write_bytes = info.ri_diskio_byteswritten;
+    }
+
+    return u;
+}
+
+} // namespace os::process
+// End of src/macos/process.cpp
+// =========================
+
+#endif // IS_OS_*
+
+#endif // LIBOS_IMPLEMENTATION
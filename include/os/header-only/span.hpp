@@ -0,0 +1,99 @@
+// Non-owning view over contiguous sequence. Header-only
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/header-only/span.hpp
+ *  Non-owning view over contiguous sequence. Header-only
+ */
+
+#ifndef LIBOS_HEADER_ONLY_SPAN_HPP
+#define LIBOS_HEADER_ONLY_SPAN_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace os
+{
+
+/**
+ * @brief Non-owning view over contiguous sequence of objects
+ *
+ * @details
+ *  Minimal C++17 replacement for `std::span`.
+ *  Constructible from arrays and containers with `data()` and `size()`.
+ *
+ * @warning Span doesn't extend lifetime of viewed objects.
+ */
+template <class T>
+class span
+{
+public:
+    using element_type = T;
+    using value_type   = std::remove_cv_t<T>;
+    using size_type    = std::size_t;
+    using pointer      = T *;
+    using reference    = T &;
+    using iterator     = T *;
+
+    /// Make empty span
+    constexpr span() noexcept = default;
+    /// Make span from pointer and number of elements
+    constexpr span(pointer data, size_type size) noexcept : ptr(data), count(size) {}
+    /// Make span from array
+    template <std::size_t N>
+    constexpr span(T (&array)[N]) noexcept : ptr(array), count(N) {}
+    /// Make span from container with contiguous storage
+    template <
+        class Container,
+        class = std::enable_if_t<
+            !std::is_array_v<std::remove_reference_t<Container>> &&
+            std::is_convertible_v<decltype(std::declval<Container &>().data()), pointer>
+        >
+    >
+    constexpr span(Container &container) noexcept
+        : ptr(container.data()), count(container.size()) {}
+
+    /// Get pointer to the first element
+    constexpr pointer data() const noexcept { return ptr; }
+    /// Get number of elements
+    constexpr size_type size() const noexcept { return count; }
+    /// Check if span is empty
+    constexpr bool empty() const noexcept { return count == 0; }
+
+    /// Get element by index
+    constexpr reference operator[](size_type i) const noexcept { return ptr[i]; }
+
+    /// Get iterator to the first element
+    constexpr iterator begin() const noexcept { return ptr; }
+    /// Get iterator past the last element
+    constexpr iterator end() const noexcept { return ptr + count; }
+
+private:
+    pointer   ptr   = nullptr;
+    size_type count = 0;
+};
+
+} // namespace os
+
+#endif // LIBOS_HEADER_ONLY_SPAN_HPP
@@ -0,0 +1,332 @@
+// Thread scheduling. Header-only
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/header-only/thread.hpp
+ *  Thread scheduling. Header-only
+ */
+
+#ifndef LIBOS_HEADER_ONLY_THREAD_HPP
+#define LIBOS_HEADER_ONLY_THREAD_HPP
+
+#include "cpu.hpp"
+
+namespace os::thread
+{
+
+/// Scheduling class of thread
+enum class priority
+{
+    /// Runs only when CPU has nothing else to do
+    idle,
+    /// Below normal threads
+    low,
+    /// Default priority
+    normal,
+    /// Above normal threads
+    high,
+    /// Time-critical work. Preempts normal threads
+    realtime
+};
+
+/**
+ * @brief Allow current thread to run only on specified CPUs
+ *
+ * @details
+ *  - Linux: `pthread_setaffinity_np`
+ *  - Windows: `SetThreadGroupAffinity`. Every CPU must be in the same processor group
+ *  - MacOS: `thread_policy_set` with `THREAD_AFFINITY_POLICY`.
+ *    Affinity is only a hint: threads with the same first CPU share a tag
+ *    and are scheduled on cores with shared L2 cache.
+ *    Not supported on Apple Silicon
+ *
+ * @param cpus Indexes of logical CPUs, as in cpu::info()
+ *
+ * @return true on success, false if set is empty or OS refused it
+ */
+bool pin(const cpu::cpu_set &cpus);
+
+/**
+ * @brief Change scheduling class of current thread
+ *
+ * @details
+ *  - Linux: `sched_setscheduler` with `SCHED_IDLE`, `SCHED_OTHER` or `SCHED_FIFO`.
+ *    Nice value of `SCHED_OTHER` is 10 for low, 0 for normal and -10 for high
+ *  - Windows: `SetThreadPriority` from `THREAD_PRIORITY_IDLE` to `THREAD_PRIORITY_TIME_CRITICAL`
+ *  - MacOS: QoS class from `QOS_CLASS_BACKGROUND` to `QOS_CLASS_USER_INTERACTIVE`
+ *
+ * @note On Linux high and realtime require `CAP_SYS_NICE` (or `RLIMIT_NICE`/`RLIMIT_RTPRIO`).
+ *
+ * @return true on success, false if OS refused it
+ */
+bool set_priority(priority p);
+
+/**
+ * @brief Prefer memory and CPUs of NUMA node for current thread
+ *
+ * @details
+ *  - Linux: `set_mempolicy` with `MPOL_PREFERRED`. Memory is allocated on node, while it has free pages
+ *  - Windows: `SetThreadIdealProcessorEx` to the first CPU of node,
+ *    so scheduler and allocator prefer the node
+ *  - MacOS: there is only node 0, so there is nothing to do
+ *
+ * @note Preference doesn't restrict CPUs.
+ *       Use `pin(cpu::info().numa_nodes[i].cpus)` to keep thread on the node.
+ *
+ * @param node Id of node, as in cpu::info().numa_nodes
+ *
+ * @return true on success, false if there is no such node or OS refused it
+ */
+bool set_numa_preferred(unsigned node);
+
+} // namespace os::thread
+
+#endif // LIBOS_HEADER_ONLY_THREAD_HPP
+
+// -------------------------
+// |    IMPLEMENTATION     |
+// -------------------------
+
+#if defined(LIBOS_IMPLEMENTATION) && !defined(LIBOS_DEFER_IMPLEMENTATION) && !defined(LIBOS_THREAD_CPP_IMPLEMENTED)
+#define LIBOS_THREAD_CPP_IMPLEMENTED
+
+#include "macros.h"
+
+#if IS_OS_LINUX
+// src/linux/thread.cpp
+// =========================
+#include "thread.hpp"
+
+#include "macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace os::thread
+{
+
+// Allow current thread to run only on specified CPUs
+bool pin(const cpu::cpu_set &cpus)
+{
+    if (cpus.empty()) { return false; }
+
+    // Set is allocated dynamically to support more than CPU_SETSIZE CPUs
+    const unsigned count = *std::max_element(cpus.begin(), cpus.end()) + 1;
+    cpu_set_t *set = CPU_ALLOC(count);
+    if (!set) { return false; }
+
+    const std::size_t size = CPU_ALLOC_SIZE(count);
+    CPU_ZERO_S(size, set);
+    for (unsigned c : cpus) { CPU_SET_S(c, size, set); }
+
+    const bool pinned = pthread_setaffinity_np(pthread_self(), size, set) == 0;
+    CPU_FREE(set);
+    return pinned;
+}
+
+// Change scheduling class of current thread
+bool set_priority(priority p)
+{
+    // Pid 0 means calling thread
+    sched_param param = {};
+    switch (p)
+    {
+    case priority::idle:
+        return sched_setscheduler(0, SCHED_IDLE, &param) == 0;
+    case priority::realtime:
+        // Lowest real-time priority is still above any normal thread
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        return sched_setscheduler(0, SCHED_FIFO, &param) == 0;
+    default:
+        break;
+    }
+
+    if (sched_setscheduler(0, SCHED_OTHER, &param) != 0) { return false; }
+
+    // Nice value is per thread on Linux
+    const int nice = p == priority::low ? 10 : p == priority::high ? -10 : 0;
+    return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) == 0;
+}
+
+// Prefer memory of NUMA node for current thread
+bool set_numa_preferred(unsigned node)
+{
+    const auto &nodes = cpu::info().numa_nodes;
+    const bool exists = std::any_of(
+        nodes.begin(), nodes.end(),
+        [node](const cpu::numa_node &n) { return n.id == node; }
+    );
+    if (!exists) { return false; }
+
+    constexpr unsigned bits = sizeof(unsigned long) * CHAR_BIT;
+    std::vector<unsigned long> mask(node / bits + 1);
+    mask[node / bits] |= 1ul << (node % bits);
+
+    // Kernel reads maxnode - 1 bits
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1) == 0) { return true; }
+
+    // Kernel without NUMA has only node 0 anyway
+    return errno == ENOSYS && node == 0;
+}
+
+} // namespace os::thread
+// End of src/linux/thread.cpp
+// =========================
+
+#elif IS_OS_WINDOWS
+// src/windows/thread.cpp
+// =========================
+#include "thread.hpp"
+
+#include "macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <Windows.h>
+
+namespace os::thread
+{
+    // Allow current thread to run only on specified CPUs
+    bool pin(const cpu::cpu_set &cpus)
+    {
+        if (cpus.empty()) { return false; }
+
+        // Thread may run only in single processor group of 64 CPUs
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = static_cast<WORD>(cpus.front() / 64);
+        for (unsigned c : cpus)
+        {
+            if (c / 64 != affinity.Group) { return false; }
+            affinity.Mask |= KAFFINITY{ 1 } << (c % 64);
+        }
+
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+    }
+
+    // Change scheduling class of current thread
+    bool set_priority(priority p)
+    {
+        int value = THREAD_PRIORITY_NORMAL;
+        switch (p)
+        {
+        case priority::idle:     value = THREAD_PRIORITY_IDLE; break;
+        case priority::low:      value = THREAD_PRIORITY_BELOW_NORMAL; break;
+        case priority::normal:   value = THREAD_PRIORITY_NORMAL; break;
+        case priority::high:     value = THREAD_PRIORITY_HIGHEST; break;
+        case priority::realtime: value = THREAD_PRIORITY_TIME_CRITICAL; break;
+        }
+
+        return SetThreadPriority(GetCurrentThread(), value) != 0;
+    }
+
+    // Prefer CPUs and memory of NUMA node for current thread
+    bool set_numa_preferred(unsigned node)
+    {
+        GROUP_AFFINITY affinity = {};
+        if (node > 0xFFFF || !GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) || affinity.Mask == 0)
+        {
+            return false;
+        }
+
+        // Memory is allocated on node of the processor, that thread runs on
+        PROCESSOR_NUMBER ideal = {};
+        ideal.Group = affinity.Group;
+        while (!(affinity.Mask & (KAFFINITY{ 1 } << ideal.Number))) { ++ideal.Number; }
+
+        return SetThreadIdealProcessorEx(GetCurrentThread(), &ideal, nullptr) != 0;
+    }
+}
+// End of src/windows/thread.cpp
+// =========================
+
+#elif IS_OS_MACOS
+// src/macos/thread.cpp
+// =========================
+#include "thread.hpp"
+
+#include "macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+
+namespace os::thread
+{
+
+// Hint scheduler to run current thread near threads with the same first CPU
+bool pin(const cpu::cpu_set &cpus)
+{
+    if (cpus.empty()) { return false; }
+
+    // Tag 0 is THREAD_AFFINITY_TAG_NULL
+    thread_affinity_policy_data_t policy = { static_cast<integer_t>(cpus.front() + 1) };
+    return thread_policy_set(
+        pthread_mach_thread_np(pthread_self()),
+        THREAD_AFFINITY_POLICY,
+        reinterpret_cast<thread_policy_t>(&policy),
+        THREAD_AFFINITY_POLICY_COUNT
+    ) == KERN_SUCCESS;
+}
+
+// Change QoS class of current thread
+bool set_priority(priority p)
+{
+    qos_class_t qos = QOS_CLASS_DEFAULT;
+    switch (p)
+    {
+    case priority::idle:     qos = QOS_CLASS_BACKGROUND; break;
+    case priority::low:      qos = QOS_CLASS_UTILITY; break;
+    case priority::normal:   qos = QOS_CLASS_DEFAULT; break;
+    case priority::high:     qos = QOS_CLASS_USER_INITIATED; break;
+    case priority::realtime: qos = QOS_CLASS_USER_INTERACTIVE; break;
+    }
+
+    return pthread_set_qos_class_self_np(qos, 0) == 0;
+}
+
+// There is only node 0
+bool set_numa_preferred(unsigned node) { return node == 0; }
+
+} // namespace os::thread
+// End of src/macos/thread.cpp
+// =========================
+
+#endif // IS_OS_*
+
+#endif // LIBOS_IMPLEMENTATION
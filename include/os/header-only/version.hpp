@@ -26,7 +26,8 @@
  *  Semantic versioning. Header-only
  */
 
-#pragma once
+#ifndef LIBOS_HEADER_ONLY_VERSION_HPP
+#define LIBOS_HEADER_ONLY_VERSION_HPP
 
 #include <string>
 #include <string_view>
@@ -82,10 +83,10 @@ struct version
     /// Check if version is less
     constexpr bool operator< (const version &rhs) const noexcept
     {
-        if (major < rhs.major) { return true; }
-        if (minor < rhs.minor) { return true; }
-        if (patch < rhs.patch) { return true; }
-        return false;
+        // Minor and patch matter only if higher fields are equal
+        if (major != rhs.major) { return major < rhs.major; }
+        if (minor != rhs.minor) { return minor < rhs.minor; }
+        return patch < rhs.patch;
     }
     /// Check if version is less or equal
     constexpr bool operator<=(const version &rhs) const noexcept
@@ -107,4 +108,6 @@ struct version
                std::to_string(minor) + "." +
                std::to_string(patch);
     }
-};
\ No newline at end of file
+};
+
+#endif // LIBOS_HEADER_ONLY_VERSION_HPP
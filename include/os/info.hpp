@@ -29,6 +29,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 #include "os/macros.h"
 #include "os/version.hpp"
@@ -69,14 +70,14 @@ constexpr type_t type() noexcept
  * @returns
  *  - Linux:
  *      - Distributive's name (e.g. `"Ubuntu"`)
- *      - `"Linux"`, if `/etc/os-release` not found
+ *      - `"Linux"`, if neither `/etc/os-release` nor `/usr/lib/os-release` has it
  *  - MacOS: `"macOS"`
  *  - Windows: `"Windows"`
  */
-std::string name();
+std::string_view name();
 
 /// Get OS name with version
-std::string pretty_name();
+std::string_view pretty_name();
 
 /**
  * @brief Get OS codename
@@ -86,13 +87,13 @@ std::string pretty_name();
  *  - MacOS: codename
  *  - Windows: `""`
  */
-std::string codename();
+std::string_view codename();
 
 /// Get OS major, minor and patch version as integers
 ::version version();
 
 /// Get OS version as string
-std::string version_string();
+std::string_view version_string();
 
 /// Full OS info
 struct info_t
@@ -115,7 +116,13 @@ struct info_t
  * @brief Get full OS info
  * @details
  *  Obtaining OS info is very expensive.
- *  Hence, it's statically allocated and read exactly once.
+ *  Hence, it's statically allocated and read exactly once,
+ *  even if several threads call it at the same time.
+ *  Other cached getters (e.g. os::kernel::info(), os::cpu::info(), os::clock::calibration())
+ *  are initialized the same way.
+ *
+ *  String accessors return views into this info, so they don't allocate.
+ *  Views stay valid until the end of program.
  *
  * @return const info_t& Ref to OS info
  */
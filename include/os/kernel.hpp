@@ -28,7 +28,9 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 #include "os/version.hpp"
 
@@ -43,13 +45,13 @@ namespace os::kernel
  *  - MacOS: `"Darwin"`
  *  - Windows: `"Windows NT"`
  */
-std::string name();
+std::string_view name();
 
 /// Get OS Kernel major, minor and patch version as integers
 ::version version();
 
 /// Get OS Kernel version as string
-std::string version_string();
+std::string_view version_string();
 
 /// Full OS Kernel info
 struct info_t
@@ -66,10 +68,72 @@ struct info_t
  * @brief Get full OS Kernel info
  * @details
  *  Obtaining OS Kernel info is very expensive.
- *  Hence, it's statically allocated and read exactly once.
+ *  Hence, it's statically allocated and read exactly once,
+ *  even if several threads call it at the same time.
+ *
+ *  String accessors return views into this info, so they don't allocate.
+ *  Views stay valid until the end of program.
  *
  * @return const info_t& Ref to OS Kernel info
  */
 const info_t & info();
 
+/// Capability of OS Kernel, that can't be told reliably by version
+enum class feature : unsigned
+{
+    /// Linux: `io_uring_setup()` works (it may be disabled by sysctl or seccomp)
+    io_uring,
+    /// Linux: `EPOLLEXCLUSIVE` flag of `epoll_ctl()`
+    epoll_exclusive,
+    /// Linux: `futex_waitv()`
+    futex_waitv,
+    /// Linux: `memfd_create()`
+    memfd_create,
+    /// Linux: `pidfd_open()`
+    pidfd_open,
+    /// Windows: IoRing API (`CreateIoRing()`)
+    io_ring,
+    /// Windows: `WaitOnAddress()`. MacOS: `os_sync_wait_on_address()`
+    wait_on_address,
+    /// CPU counter ticks at constant rate, so it may be used as clock.
+    /// x86: `cpuid` reports invariant TSC (or Linux uses TSC as clocksource). ARM64: always
+    invariant_tsc
+};
+
+/// Set of OS Kernel features
+struct features_t
+{
+    /// Bit `1 << feature` is set for every available feature
+    std::uint64_t bits = 0;
+
+    /// Get bit of feature
+    static constexpr std::uint64_t bit(feature f) noexcept
+    {
+        return std::uint64_t{1} << static_cast<unsigned>(f);
+    }
+
+    /// Check if feature is available
+    constexpr bool has(feature f) const noexcept { return (bits & bit(f)) != 0; }
+
+    /// Mark feature as available
+    constexpr void add(feature f) noexcept { bits |= bit(f); }
+};
+
+/**
+ * @brief Get available OS Kernel features
+ *
+ * @details
+ *  Every feature is probed once with actual cheap call, not guessed by version,
+ *  even if several threads call it at the same time.
+ *  Then check is a single bit test:
+ *  @code{.cpp}
+ *  if (os::kernel::features().has(os::kernel::feature::io_uring)) { ... }
+ *  @endcode
+ *
+ *  Features of other OS are never available.
+ *
+ * @return const features_t& Ref to set of available features
+ */
+const features_t & features();
+
 } // namespace os::kernel
\ No newline at end of file
@@ -28,9 +28,27 @@
 
 #pragma once
 
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "os/macros.h"
+#include "os/span.hpp"
+#include "os/thread.hpp"
 
 namespace os::keyboard
 {
@@ -340,40 +358,395 @@ enum class vk
 #endif
 };
 
-/// Combination of keys
-struct combination
+} // namespace os::keyboard
+
+namespace os::detail
+{
+
+/// Count set bits in a 64-bit word
+constexpr unsigned popcount(std::uint64_t word) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_popcountll(word));
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return static_cast<unsigned>((word * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/// Count trailing zero bits in a non-zero 64-bit word
+constexpr unsigned countr_zero(std::uint64_t word) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(word));
+#else
+    return popcount((word & (~word + 1)) - 1);
+#endif
+}
+
+/**
+ * @brief Number of dense key indexes
+ *
+ * @details
+ *  - Linux: keysyms `0x0000-0x00FF` (Latin-1) and `0xFF00-0xFFFF` (function keys)
+ *  - Windows and macOS: virtual key codes `0x00-0xFF`
+ */
+constexpr std::size_t key_index_count = IS_OS_LINUX ? 512 : 256;
+
+/// Index, returned for virtual keys, that can't be represented densely
+constexpr std::size_t no_key_index = key_index_count;
+
+/// Get dense index of virtual key
+constexpr std::size_t key_index(keyboard::vk key) noexcept
+{
+    const auto value = static_cast<unsigned>(key);
+    if (value <= 0xFF) { return value; }
+#if IS_OS_LINUX
+    if ((value >> 8) == 0xFF) { return 0x100 | (value & 0xFF); }
+#endif
+    return no_key_index;
+}
+
+/// Get virtual key by its dense index
+constexpr keyboard::vk key_at(std::size_t index) noexcept
+{
+#if IS_OS_LINUX
+    if (index >= 0x100) { return static_cast<keyboard::vk>(0xFF00 | (index & 0xFF)); }
+#endif
+    return static_cast<keyboard::vk>(index);
+}
+
+/// Key, that types character on current keyboard layout
+struct typed_key
+{
+    /// Platform-specific key code
+    std::uint16_t code = 0;
+    /// Platform-specific mask of modifiers to hold
+    std::uint16_t modifiers = 0;
+    /// `false` for characters, missing in layout
+    bool          found = false;
+};
+
+/**
+ * @brief Lookup table from character to key, that types it
+ *
+ * @details
+ *  First code points are stored densely, the rest are kept
+ *  in a sorted array.
+ */
+class char_table
+{
+public:
+    /// Number of densely stored code points
+    static constexpr char32_t dense_size = 0x800;
+
+    /// Remove all characters
+    void clear()
+    {
+        std::fill(std::begin(dense), std::end(dense), typed_key{});
+        sparse.clear();
+    }
+
+    /// Add key of character, unless it already has one
+    void insert(char32_t c, std::uint16_t code, std::uint16_t modifiers)
+    {
+        const typed_key key { code, modifiers, true };
+        if (c < dense_size)
+        {
+            if (!dense[c].found) { dense[c] = key; }
+            return;
+        }
+
+        auto it = lower_bound(sparse, c);
+        if (it == sparse.end() || it->first != c) { sparse.insert(it, { c, key }); }
+    }
+
+    /// Get key of character or `nullptr`, if it's missing in layout
+    const typed_key * find(char32_t c) const
+    {
+        if (c < dense_size) { return dense[c].found ? &dense[c] : nullptr; }
+
+        auto it = lower_bound(sparse, c);
+        return it != sparse.end() && it->first == c ? &it->second : nullptr;
+    }
+
+private:
+    using sparse_entry = std::pair<char32_t, typed_key>;
+
+    // First entry with code point not less than c
+    template <typename Entries>
+    static auto lower_bound(Entries &entries, char32_t c) -> decltype(entries.begin())
+    {
+        return std::lower_bound(
+            entries.begin(), entries.end(), c,
+            [](const sparse_entry &entry, char32_t c) { return entry.first < c; }
+        );
+    }
+
+    typed_key                 dense[dense_size] = {};
+    std::vector<sparse_entry> sparse;
+};
+
+/// Platform-specific builder of keyboard layout tables
+class layout_builder;
+
+/// Raise priority of current thread for time-critical work (if possible)
+void raise_thread_priority() noexcept;
+
+/// Sleep until deadline with the best precision available
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline) noexcept;
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+/**
+ * @brief Combination of keys
+ *
+ * @details
+ *  Keys are stored in a fixed-size bitset, indexed by detail::key_index().
+ *  Combinations never allocate and may be used in `constexpr` context.
+ *
+ * @note Virtual keys, that have no dense index, are ignored.
+ */
+class combination
 {
-    /// Array of virtual keys
-    std::unordered_set<vk> keys;
+public:
+    /// Max number of keys in combination
+    static constexpr std::size_t capacity = detail::key_index_count;
 
-    /// Make combination from virtual keys
-    combination(vk key) : keys({key}) {}
+    /// Forward iterator over keys of combination
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = vk;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const vk *;
+        using reference         = vk;
+
+        /// Get current key
+        constexpr vk operator*() const noexcept { return detail::key_at(index); }
+
+        /// Go to the next key
+        constexpr iterator & operator++() noexcept
+        {
+            index = combo->next_index(index + 1);
+            return *this;
+        }
+        /// Go to the next key
+        constexpr iterator operator++(int) noexcept
+        {
+            iterator it = *this;
+            ++*this;
+            return it;
+        }
+
+        /// Check iterators for equality
+        constexpr bool operator==(const iterator &rhs) const noexcept { return index == rhs.index; }
+        /// Check iterators for inequality
+        constexpr bool operator!=(const iterator &rhs) const noexcept { return index != rhs.index; }
+
+    private:
+        friend class combination;
+
+        constexpr iterator(const combination *combo, std::size_t index) noexcept
+            : combo(combo), index(index) {}
+
+        const combination *combo = nullptr;
+        std::size_t        index = capacity;
+    };
+
+    /// Make empty combination
+    constexpr combination() noexcept = default;
+    /// Make combination from virtual key
+    constexpr combination(vk key) noexcept { insert(key); }
     /// Make combination from list of virtual keys
-    combination(std::initializer_list<vk> keys = {}) : keys(keys) {}
+    constexpr combination(std::initializer_list<vk> keys) noexcept
+    {
+        for (vk key : keys) { insert(key); }
+    }
+
+    /// Add key to combination
+    constexpr void insert(vk key) noexcept
+    {
+        const std::size_t i = detail::key_index(key);
+        if (i == detail::no_key_index) { return; }
+        words[i / 64] |= std::uint64_t{1} << (i % 64);
+    }
+    /// Remove key from combination
+    constexpr void erase(vk key) noexcept
+    {
+        const std::size_t i = detail::key_index(key);
+        if (i == detail::no_key_index) { return; }
+        words[i / 64] &= ~(std::uint64_t{1} << (i % 64));
+    }
+    /// Remove all keys from combination
+    constexpr void clear() noexcept
+    {
+        for (auto &word : words) { word = 0; }
+    }
+
+    /// Check if key is in combination
+    constexpr bool contains(vk key) const noexcept
+    {
+        const std::size_t i = detail::key_index(key);
+        if (i == detail::no_key_index) { return false; }
+        return (words[i / 64] >> (i % 64)) & 1;
+    }
+    /// Check if every key of other combination is in this one
+    constexpr bool contains(const combination &combo) const noexcept
+    {
+        for (std::size_t i = 0; i < word_count; ++i)
+        {
+            if ((combo.words[i] & ~words[i]) != 0) { return false; }
+        }
+        return true;
+    }
+    /// Check if combinations have at least one common key
+    constexpr bool intersects(const combination &combo) const noexcept
+    {
+        for (std::size_t i = 0; i < word_count; ++i)
+        {
+            if ((combo.words[i] & words[i]) != 0) { return true; }
+        }
+        return false;
+    }
+
+    /// Get number of keys in combination
+    constexpr std::size_t size() const noexcept
+    {
+        std::size_t n = 0;
+        for (auto word : words) { n += detail::popcount(word); }
+        return n;
+    }
+    /// Check if combination has no keys
+    constexpr bool empty() const noexcept
+    {
+        for (auto word : words)
+        {
+            if (word != 0) { return false; }
+        }
+        return true;
+    }
+
+    /// Get iterator to the first key
+    constexpr iterator begin() const noexcept { return iterator(this, next_index(0)); }
+    /// Get iterator past the last key
+    constexpr iterator end() const noexcept { return iterator(this, capacity); }
 
     /// Append a combination
-    combination & operator+=(const combination &combo)
+    constexpr combination & operator+=(const combination &combo) noexcept
+    {
+        for (std::size_t i = 0; i < word_count; ++i) { words[i] |= combo.words[i]; }
+        return *this;
+    }
+    /// Remove keys of other combination
+    constexpr combination & operator-=(const combination &combo) noexcept
     {
-        keys.insert(combo.keys.begin(), combo.keys.end());
+        for (std::size_t i = 0; i < word_count; ++i) { words[i] &= ~combo.words[i]; }
         return *this;
     }
 
     /// Concatinate 2 combinations
-    combination operator+(const combination &combo) const
+    friend constexpr combination operator+(combination lhs, const combination &rhs) noexcept
+    {
+        return lhs += rhs;
+    }
+    /// Get keys of first combination, that are not in the second one
+    friend constexpr combination operator-(combination lhs, const combination &rhs) noexcept
+    {
+        return lhs -= rhs;
+    }
+
+    /// Check combinations for equality
+    friend constexpr bool operator==(const combination &lhs, const combination &rhs) noexcept
+    {
+        for (std::size_t i = 0; i < word_count; ++i)
+        {
+            if (lhs.words[i] != rhs.words[i]) { return false; }
+        }
+        return true;
+    }
+    /// Check combinations for inequality
+    friend constexpr bool operator!=(const combination &lhs, const combination &rhs) noexcept
     {
-        combination res = *this;
-        return res += combo;
+        return !(lhs == rhs);
     }
+
+private:
+    static constexpr std::size_t word_count = capacity / 64;
+
+    /// Get first index of key in combination, starting from @p from
+    constexpr std::size_t next_index(std::size_t from) const noexcept
+    {
+        for (std::size_t i = from / 64; i < word_count; ++i)
+        {
+            std::uint64_t word = words[i];
+            if (i == from / 64) { word &= ~std::uint64_t{0} << (from % 64); }
+            if (word != 0) { return i * 64 + detail::countr_zero(word); }
+        }
+        return capacity;
+    }
+
+    std::uint64_t words[word_count] = {};
 };
 
 /// Make a combination from 2 virtual keys
-inline combination operator+(vk lhs, vk rhs) { return combination{{lhs, rhs}}; }
+constexpr combination operator+(vk lhs, vk rhs) noexcept { return combination{lhs, rhs}; }
 
 /// Check if every key in combination is pressed
 bool is_pressed(const combination &combo);
 /// Get combination of all pressed keys on a keyboard
 combination pressed_keys();
 
+/**
+ * @brief Snapshot of keyboard state
+ *
+ * @details
+ *  Captured once by snapshot().
+ *  All queries are answered from memory, without calls to OS.
+ */
+class state
+{
+public:
+    /// Make state with no keys pressed
+    constexpr state() noexcept = default;
+    /// Make state with given keys pressed
+    constexpr explicit state(const combination &pressed) noexcept : keys(pressed) {}
+
+    /// Check if every key in combination was pressed
+    constexpr bool is_pressed(const combination &combo) const noexcept { return keys.contains(combo); }
+    /// Get combination of all pressed keys
+    constexpr const combination & pressed_keys() const noexcept { return keys; }
+
+    /// Get keys, that are pressed now, but weren't pressed in previous state
+    constexpr combination pressed_since(const state &prev) const noexcept { return keys - prev.keys; }
+    /// Get keys, that were pressed in previous state, but aren't pressed now
+    constexpr combination released_since(const state &prev) const noexcept { return prev.keys - keys; }
+
+    /// Check states for equality
+    constexpr bool operator==(const state &rhs) const noexcept { return keys == rhs.keys; }
+    /// Check states for inequality
+    constexpr bool operator!=(const state &rhs) const noexcept { return keys != rhs.keys; }
+
+private:
+    combination keys;
+};
+
+/**
+ * @brief Capture state of the whole keyboard at once
+ *
+ * @details
+ *  - Linux: single `XQueryKeymap`
+ *  - Windows: single `GetKeyboardState`
+ *  - MacOS: values of keyboard HID elements
+ */
+state snapshot();
+
 /// Press combination of keys (until release())
 void press(const combination &combo);
 /// Release combination of keys
@@ -381,4 +754,1512 @@ void release(const combination &combo);
 /// press() and release() combination of keys
 inline void click(const combination &combo) { press(combo); release(combo); }
 
+/// Single key press or release
+struct key_event
+{
+    /// Virtual key
+    vk   key;
+    /// `true` for press, `false` for release
+    bool is_down = true;
+};
+
+/**
+ * @brief Send sequence of key events at once
+ *
+ * @details
+ *  Events are submitted in order with a single OS call per batch:
+ *  - Linux: one `XFlush` after all `XTestFakeKeyEvent`
+ *  - Windows: one `SendInput`
+ *  - MacOS: one reused `CGEvent` for all keys
+ *
+ * @note On macOS modifiers are applied as flags to the keys, that follow them in the batch.
+ */
+void send(span<const key_event> events);
+/// Send list of key events at once
+inline void send(std::initializer_list<key_event> events)
+{
+    send(span<const key_event>(events.begin(), events.size()));
+}
+
+/**
+ * @brief Type text, using current keyboard layout
+ *
+ * @details
+ *  Every character is mapped to a key and modifiers of the active layout
+ *  with a lookup table, built once per layout. The whole text is sent
+ *  as a single batch of key events.
+ *
+ * @note Characters, missing in layout, are sent as Unicode input on Windows and macOS
+ *  and skipped on Linux.
+ */
+void type(std::u32string_view text);
+
+/**
+ * @brief Cached tables of keyboard layout
+ *
+ * @details
+ *  Tables are built once per layout and rebuilt lazily, after OS reports a change:
+ *  - Linux: XKB `XkbNewKeyboardNotify`, `XkbMapNotify` and group changes
+ *  - Windows: change of `HKL`, used by foreground window
+ *  - macOS: `kTISNotifySelectedKeyboardInputSourceChanged`
+ *
+ *  Layout objects are immutable, so lookups are O(1), thread-safe and don't query OS.
+ *  Hold the returned pointer to keep using the same tables.
+ */
+class layout
+{
+public:
+    /// Get layout, that is active now
+    static std::shared_ptr<const layout> current();
+
+    /// Get platform key code of virtual key (0, if none)
+    std::uint16_t code_of(vk key) const noexcept
+    {
+        const std::size_t i = detail::key_index(key);
+        return i == detail::no_key_index ? 0 : codes[i];
+    }
+
+    /// Get virtual key of platform key code
+    vk key_of(std::uint16_t code) const noexcept
+    {
+        return code < std::size(keys) ? keys[code] : vk{};
+    }
+
+    /// Get key and modifiers, that type character (`nullptr`, if it's missing in layout)
+    const detail::typed_key * find(char32_t c) const { return chars.find(c); }
+
+    /// Get key code, that holds modifier with index (0, if none)
+    std::uint16_t modifier_key(unsigned index) const noexcept
+    {
+        return index < std::size(modifier_keys) ? modifier_keys[index] : 0;
+    }
+
+    /// Number of layouts, loaded before this one
+    std::uint64_t generation() const noexcept { return number; }
+
+private:
+    friend class detail::layout_builder;
+
+    std::uint16_t      codes[detail::key_index_count] = {};
+    vk                 keys[256] = {};
+    detail::char_table chars;
+    std::uint16_t      modifier_keys[8] = {};
+    std::uint64_t      number = 0;
+};
+
+/**
+ * @brief Listener of keyboard events
+ *
+ * @details
+ *  Events are pushed by OS as soon as they happen, no polling is involved:
+ *  - Linux: XRecord extension of X server
+ *  - Windows: `WH_KEYBOARD_LL` hook
+ *  - MacOS: input value callback of HID manager
+ *
+ *  Events are either passed to callback on listener's own thread,
+ *  or queued until next_event() is called.
+ *
+ *  Events come from current_backend() of the thread, that makes listener.
+ *
+ * @note Events start to arrive when listener is constructed and stop when it's destroyed.
+ */
+class listener
+{
+public:
+    /// Key press or release with time when it happened
+    struct event : key_event
+    {
+        /// Time of event
+        std::chrono::steady_clock::time_point time;
+    };
+
+    /// Function to be called on each event
+    using callback = std::function<void(const event &)>;
+
+    /// Start listening and queue events for next_event()
+    listener();
+    /**
+     * @brief Start listening and pass events to callback
+     *
+     * @warning Callback is called on listener's thread.
+     */
+    explicit listener(callback on_event);
+
+    listener(const listener &) = delete;
+    listener(listener &&) = delete;
+    void operator=(const listener &) = delete;
+    void operator=(listener &&) = delete;
+
+    /// Stop listening
+    ~listener();
+
+    /**
+     * @brief Check if OS delivers events to this listener
+     *
+     * @note Listener may be inactive, if there is no access to keyboard events
+     *  (e.g. XRecord is not supported by X server).
+     */
+    bool active() const noexcept;
+
+    /**
+     * @brief Wait for next queued event
+     *
+     * @warning Blocks forever, if listener is not active() or has callback.
+     */
+    event next_event()
+    {
+        std::unique_lock lock(mutex);
+        ready.wait(lock, [this] { return !events.empty(); });
+        return pop();
+    }
+
+    /// Wait for next queued event no longer than timeout
+    template <class Rep, class Period>
+    std::optional<event> next_event(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock lock(mutex);
+        if (!ready.wait_for(lock, timeout, [this] { return !events.empty(); }))
+        {
+            return std::nullopt;
+        }
+        return pop();
+    }
+
+public:
+    /**
+     * @brief Source of listener's events
+     *
+     * @details Made by backend::listen() and owned by listener until it's destroyed.
+     */
+    class source
+    {
+    public:
+        /// Make source of events for listener
+        explicit source(listener &owner) noexcept : owner(owner) {}
+
+        source(const source &) = delete;
+        source(source &&) = delete;
+        void operator=(const source &) = delete;
+        void operator=(source &&) = delete;
+
+        /// Stop delivering events
+        virtual ~source() = default;
+
+        /// Check if events are delivered to listener
+        virtual bool active() const noexcept = 0;
+
+    protected:
+        /// Pass event to listener
+        void deliver(const event &e) { owner.push(e); }
+
+    private:
+        listener &owner;
+    };
+
+private:
+    // Called by source on each event
+    void push(const event &e)
+    {
+        if (on_event) { on_event(e); return; }
+
+        {
+            std::lock_guard lock(mutex);
+            events.push_back(e);
+        }
+        ready.notify_one();
+    }
+
+    event pop()
+    {
+        event e = events.front();
+        events.pop_front();
+        return e;
+    }
+
+    callback                on_event;
+    std::mutex              mutex;
+    std::condition_variable ready;
+    std::deque<event>       events;
+
+    std::unique_ptr<source> origin;
+};
+
+} // namespace os::keyboard
+
+namespace os::mouse
+{
+
+/// Mouse buttons
+enum class button : std::uint8_t
+{
+    left,
+    right,
+    middle,
+    /// Side button, that usually means "back" (X1)
+    back,
+    /// Side button, that usually means "forward" (X2)
+    forward
+};
+
+/// Number of mouse buttons
+constexpr std::size_t button_count = 5;
+
+/// Point on screen in pixels. Origin is the top left corner of the main screen
+struct point
+{
+    int x = 0;
+    int y = 0;
+
+    constexpr bool operator==(const point &rhs) const noexcept { return x == rhs.x && y == rhs.y; }
+    constexpr bool operator!=(const point &rhs) const noexcept { return !(*this == rhs); }
+};
+
+/// Kind of mouse event
+enum class action : std::uint8_t
+{
+    /// Move cursor to absolute position (x, y)
+    move_to,
+    /// Move cursor by offset (x, y)
+    move_by,
+    /// Press button
+    press,
+    /// Release button
+    release,
+    /// Scroll by (x, y) wheel clicks. Positive values scroll right and up
+    scroll
+};
+
+/// Single mouse event
+struct event
+{
+    /// Kind of event
+    action       kind = action::move_by;
+    /// Position, offset or scroll amount, depending on kind
+    int          x = 0;
+    /// Position, offset or scroll amount, depending on kind
+    int          y = 0;
+    /// Button to press or release
+    mouse::button button = mouse::button::left;
+
+    /// Make move to absolute position
+    static constexpr event moved_to(point p) noexcept { return event{action::move_to, p.x, p.y}; }
+    /// Make move by offset
+    static constexpr event moved_by(int dx, int dy) noexcept { return event{action::move_by, dx, dy}; }
+    /// Make press of button
+    static constexpr event pressed(mouse::button b) noexcept { return event{action::press, 0, 0, b}; }
+    /// Make release of button
+    static constexpr event released(mouse::button b) noexcept { return event{action::release, 0, 0, b}; }
+    /// Make scroll by wheel clicks
+    static constexpr event scrolled(int dx, int dy) noexcept { return event{action::scroll, dx, dy}; }
+};
+
+} // namespace os::mouse
+
+namespace os::keyboard
+{
+
+/**
+ * @brief Implementation of keyboard and mouse functions
+ *
+ * @details
+ *  Every function of os::keyboard and os::mouse, as well as listener, async_injector and players,
+ *  is forwarded to current_backend(). It's native_backend() by default:
+ *  - Linux: XTest and XRecord or uinput and evdev
+ *  - Windows: `SendInput` and `WH_KEYBOARD_LL` hook
+ *  - MacOS: `CGEvent` and HID manager
+ *
+ *  Implement this interface to run keyboard code without OS
+ *  and install it with backend_scope.
+ */
+class backend
+{
+public:
+    backend() = default;
+
+    backend(const backend &) = delete;
+    backend(backend &&) = delete;
+    void operator=(const backend &) = delete;
+    void operator=(backend &&) = delete;
+
+    virtual ~backend() = default;
+
+    /// Check if every key in combination is pressed
+    virtual bool is_pressed(const combination &combo) { return pressed_keys().contains(combo); }
+    /// Get combination of all pressed keys
+    virtual combination pressed_keys() = 0;
+    /// Capture state of the whole keyboard at once
+    virtual state snapshot() { return state(pressed_keys()); }
+
+    /// Press or release all keys of combination at once
+    virtual void send(const combination &combo, bool is_down) = 0;
+    /// Send sequence of key events at once
+    virtual void send(span<const key_event> events) = 0;
+    /// Type text, using current layout
+    virtual void type(std::u32string_view text) = 0;
+
+    /// Get layout, that is active now
+    virtual std::shared_ptr<const layout> current_layout() = 0;
+    /// Open connections and load layout tables ahead of first use (see os::prefetch())
+    virtual void warm_up() { current_layout(); }
+
+    /// Start delivering events to listener
+    virtual std::unique_ptr<listener::source> listen(listener &owner) = 0;
+
+    /// Get position of mouse cursor (backends without mouse return origin)
+    virtual mouse::point mouse_position() { return {}; }
+    /// Send sequence of mouse events at once (backends without mouse ignore them)
+    virtual void send_mouse(span<const mouse::event> events) { (void)events; }
+    /// Check if send_mouse() moves cursor to absolute position on mouse::action::move_to
+    virtual bool absolute_mouse_moves() const noexcept { return true; }
+};
+
+/// Get backend, that calls OS
+backend & native_backend();
+
 } // namespace os::keyboard
+
+namespace os::detail
+{
+
+/// Backend, installed on current thread (`nullptr` for native one)
+keyboard::backend *& thread_backend() noexcept;
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+/// Get backend, used by keyboard functions on current thread
+inline backend & current_backend()
+{
+    backend *installed = detail::thread_backend();
+    return installed ? *installed : native_backend();
+}
+
+/**
+ * @brief Use backend on current thread until the end of scope
+ *
+ * @details
+ *  Scopes may be nested. Other threads are not affected,
+ *  so tests with different backends may run in parallel.
+ *
+ * @warning Backend must outlive the scope.
+ */
+class backend_scope
+{
+public:
+    /// Install backend on current thread
+    explicit backend_scope(backend &installed) noexcept
+        : previous(std::exchange(detail::thread_backend(), &installed)) {}
+
+    backend_scope(const backend_scope &) = delete;
+    backend_scope(backend_scope &&) = delete;
+    void operator=(const backend_scope &) = delete;
+    void operator=(backend_scope &&) = delete;
+
+    /// Restore previous backend
+    ~backend_scope() { detail::thread_backend() = previous; }
+
+private:
+    backend *previous;
+};
+
+/**
+ * @brief Deterministic in-memory backend
+ *
+ * @details
+ *  Nothing is sent to OS:
+ *  - Key state is kept in lock-free bitmap
+ *  - Every event is recorded into ring of fixed capacity and passed to listeners of this mock
+ *  - Layout is empty, so type() sends US keys for ASCII letters, digits, spaces, tabs and newlines
+ *    and skips other characters
+ *  - Mouse position, buttons and total scroll are kept in atomics, mouse events are only counted
+ *
+ *  Injection doesn't allocate or lock, unless there are listeners.
+ *
+ * @warning Callbacks of listeners must not send events to the same mock.
+ */
+class mock_backend : public backend
+{
+public:
+    /**
+     * @brief Make mock with no keys pressed
+     *
+     * @param capacity Size of ring of recorded events (rounded up to power of 2)
+     */
+    explicit mock_backend(std::size_t capacity = 1024)
+    {
+        std::size_t size = 1;
+        while (size < capacity) { size *= 2; }
+
+        mask = size - 1;
+        ring = std::make_unique<std::atomic<std::uint64_t>[]>(size);
+    }
+
+    combination pressed_keys() override
+    {
+        combination combo;
+        for (std::size_t w = 0; w < std::size(bits); ++w)
+        {
+            // Visit only pressed keys
+            for (std::uint64_t word = bits[w].load(std::memory_order_acquire); word != 0; word &= word - 1)
+            {
+                combo.insert(detail::key_at(w * 64 + detail::countr_zero(word)));
+            }
+        }
+        return combo;
+    }
+
+    void send(const combination &combo, bool is_down) override
+    {
+        for (vk key : combo) { record(key_event{key, is_down}); }
+    }
+
+    void send(span<const key_event> events) override
+    {
+        for (const auto &event : events) { record(event); }
+    }
+
+    void type(std::u32string_view text) override
+    {
+        for (char32_t c : text)
+        {
+            vk key{};
+            bool shift = false;
+            if (!ascii_key(c, key, shift)) { continue; }
+
+            if (shift) { record(key_event{vk::Shift, true}); }
+            record(key_event{key, true});
+            record(key_event{key, false});
+            if (shift) { record(key_event{vk::Shift, false}); }
+        }
+    }
+
+    std::shared_ptr<const layout> current_layout() override { return empty; }
+
+    std::unique_ptr<listener::source> listen(listener &owner) override
+    {
+        return std::make_unique<mock_source>(*this, owner);
+    }
+
+    mouse::point mouse_position() override
+    {
+        return mouse::point{cursor_x.load(std::memory_order_acquire), cursor_y.load(std::memory_order_acquire)};
+    }
+
+    void send_mouse(span<const mouse::event> events) override
+    {
+        for (const auto &event : events)
+        {
+            const unsigned bit = 1u << static_cast<unsigned>(event.button);
+            switch (event.kind)
+            {
+            case mouse::action::move_to:
+                cursor_x.store(event.x, std::memory_order_release);
+                cursor_y.store(event.y, std::memory_order_release);
+                break;
+            case mouse::action::move_by:
+                cursor_x.fetch_add(event.x, std::memory_order_acq_rel);
+                cursor_y.fetch_add(event.y, std::memory_order_acq_rel);
+                break;
+            case mouse::action::press: buttons.fetch_or(bit, std::memory_order_acq_rel); break;
+            case mouse::action::release: buttons.fetch_and(~bit, std::memory_order_acq_rel); break;
+            case mouse::action::scroll:
+                scroll_x.fetch_add(event.x, std::memory_order_acq_rel);
+                scroll_y.fetch_add(event.y, std::memory_order_acq_rel);
+                break;
+            }
+        }
+        mouse_count.fetch_add(events.size(), std::memory_order_acq_rel);
+        mouse_batches.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    /// Get number of events, recorded since construction or clear()
+    std::uint64_t recorded_count() const noexcept { return count.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Get the last recorded events, oldest first
+     *
+     * @details Returns no more events, than capacity of ring.
+     *
+     * @note Call it, when no events are sent concurrently, to get consistent result.
+     */
+    std::vector<key_event> recorded() const
+    {
+        const std::uint64_t end = recorded_count();
+        const std::uint64_t begin = end > mask + 1 ? end - (mask + 1) : 0;
+
+        std::vector<key_event> events;
+        events.reserve(static_cast<std::size_t>(end - begin));
+        for (std::uint64_t i = begin; i < end; ++i)
+        {
+            const std::uint64_t packed = ring[i & mask].load(std::memory_order_relaxed);
+            events.push_back(key_event{static_cast<vk>(packed >> 1), (packed & 1) != 0});
+        }
+        return events;
+    }
+
+    /// Check if mouse button is pressed
+    bool button_pressed(mouse::button b) const noexcept
+    {
+        return (buttons.load(std::memory_order_acquire) >> static_cast<unsigned>(b)) & 1;
+    }
+
+    /// Get total scroll in wheel clicks
+    mouse::point scrolled() const noexcept
+    {
+        return mouse::point{scroll_x.load(std::memory_order_acquire), scroll_y.load(std::memory_order_acquire)};
+    }
+
+    /// Get number of mouse events, sent since construction or clear()
+    std::uint64_t mouse_recorded_count() const noexcept { return mouse_count.load(std::memory_order_acquire); }
+
+    /// Get number of send_mouse() calls since construction or clear() (one per flush of real backend)
+    std::uint64_t mouse_batch_count() const noexcept { return mouse_batches.load(std::memory_order_acquire); }
+
+    /// Release every key and button, move cursor to origin without events and forget recorded ones
+    void clear() noexcept
+    {
+        for (auto &word : bits) { word.store(0, std::memory_order_relaxed); }
+        count.store(0, std::memory_order_release);
+
+        cursor_x.store(0, std::memory_order_relaxed);
+        cursor_y.store(0, std::memory_order_relaxed);
+        buttons.store(0, std::memory_order_relaxed);
+        scroll_x.store(0, std::memory_order_relaxed);
+        scroll_y.store(0, std::memory_order_relaxed);
+        mouse_count.store(0, std::memory_order_relaxed);
+        mouse_batches.store(0, std::memory_order_release);
+    }
+
+private:
+    // Listener's source, fed by mock synchronously
+    class mock_source : public listener::source
+    {
+    public:
+        mock_source(mock_backend &mock, listener &owner) : source(owner), mock(mock)
+        {
+            std::lock_guard lock(mock.mutex);
+            mock.sources.push_back(this);
+            mock.listening.store(true);
+        }
+
+        ~mock_source() override
+        {
+            std::lock_guard lock(mock.mutex);
+            mock.sources.erase(std::find(mock.sources.begin(), mock.sources.end(), this));
+            mock.listening.store(!mock.sources.empty());
+        }
+
+        bool active() const noexcept override { return true; }
+
+        void push(const listener::event &e) { deliver(e); }
+
+    private:
+        mock_backend &mock;
+    };
+
+    // Get US key for ASCII character
+    static bool ascii_key(char32_t c, vk &key, bool &shift) noexcept
+    {
+        constexpr vk letters[] = {
+            vk::A, vk::B, vk::C, vk::D, vk::E, vk::F, vk::G, vk::H, vk::I, vk::J, vk::K, vk::L, vk::M,
+            vk::N, vk::O, vk::P, vk::Q, vk::R, vk::S, vk::T, vk::U, vk::V, vk::W, vk::X, vk::Y, vk::Z,
+        };
+        constexpr vk digits[] = {
+            vk::Key_0, vk::Key_1, vk::Key_2, vk::Key_3, vk::Key_4,
+            vk::Key_5, vk::Key_6, vk::Key_7, vk::Key_8, vk::Key_9,
+        };
+
+        shift = c >= U'A' && c <= U'Z';
+        if (c >= U'a' && c <= U'z') { key = letters[c - U'a']; return true; }
+        if (shift) { key = letters[c - U'A']; return true; }
+        if (c >= U'0' && c <= U'9') { key = digits[c - U'0']; return true; }
+        switch (c)
+        {
+        case U' ': key = vk::Space; return true;
+        case U'\t': key = vk::Tab; return true;
+        case U'\n': key = vk::Return; return true;
+        default: return false;
+        }
+    }
+
+    void record(const key_event &event)
+    {
+        const std::size_t i = detail::key_index(event.key);
+        if (i != detail::no_key_index)
+        {
+            const std::uint64_t bit = std::uint64_t{1} << (i % 64);
+            if (event.is_down) { bits[i / 64].fetch_or(bit, std::memory_order_acq_rel); }
+            else { bits[i / 64].fetch_and(~bit, std::memory_order_acq_rel); }
+        }
+
+        const std::uint64_t pos = count.fetch_add(1, std::memory_order_acq_rel);
+        ring[pos & mask].store(
+            (static_cast<std::uint64_t>(event.key) << 1) | (event.is_down ? 1 : 0),
+            std::memory_order_relaxed
+        );
+
+        if (!listening.load()) { return; }
+
+        listener::event e;
+        e.key = event.key;
+        e.is_down = event.is_down;
+        e.time = std::chrono::steady_clock::now();
+
+        std::lock_guard lock(mutex);
+        for (mock_source *s : sources) { s->push(e); }
+    }
+
+    std::atomic<std::uint64_t> bits[detail::key_index_count / 64] = {};
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> ring;
+    std::uint64_t                                 mask = 0;
+    std::atomic<std::uint64_t>                    count{0};
+
+    std::atomic<bool>          listening{false};
+    std::mutex                 mutex;
+    std::vector<mock_source *> sources;
+
+    std::atomic<int>           cursor_x{0};
+    std::atomic<int>           cursor_y{0};
+    std::atomic<unsigned>      buttons{0};
+    std::atomic<int>           scroll_x{0};
+    std::atomic<int>           scroll_y{0};
+    std::atomic<std::uint64_t> mouse_count{0};
+    std::atomic<std::uint64_t> mouse_batches{0};
+
+    std::shared_ptr<const layout> empty = std::make_shared<const layout>();
+};
+
+/**
+ * @brief Asynchronous injector of key events
+ *
+ * @details
+ *  Events are put into bounded lock-free multi-producer single-consumer ring
+ *  and sent by injector's own thread.
+ *  Everything, that has been accumulated since the last batch,
+ *  is sent at once with single send(), so bursts take fewer round trips to OS.
+ *
+ *  Every event gets a sequence number. Events of a single thread are sent in order.
+ *  Use wait() to make sure, that event was sent.
+ */
+class async_injector
+{
+public:
+    /// Sequence number of event (0 means no event)
+    using sequence = std::uint64_t;
+
+    /**
+     * @brief Start injector's thread
+     *
+     * @param capacity Size of ring (rounded up to power of 2)
+     * @param affinity CPUs for injector's thread (empty means any CPU)
+     *
+     * @note Events are sent to current_backend() of the thread, that makes injector.
+     */
+    explicit async_injector(std::size_t capacity = 1024, cpu::cpu_set affinity = {})
+        : target(current_backend()), affinity(std::move(affinity))
+    {
+        std::size_t size = 1;
+        while (size < capacity) { size *= 2; }
+
+        mask = size - 1;
+        slots = std::make_unique<slot[]>(size);
+        for (std::size_t i = 0; i < size; ++i) { slots[i].seq.store(i, std::memory_order_relaxed); }
+        batch.reserve(size);
+
+        worker = std::thread([this] { run(); });
+    }
+
+    async_injector(const async_injector &) = delete;
+    async_injector(async_injector &&) = delete;
+    void operator=(const async_injector &) = delete;
+    void operator=(async_injector &&) = delete;
+
+    /// Send remaining events and stop injector's thread
+    ~async_injector()
+    {
+        stopping.store(true);
+        wake();
+        worker.join();
+    }
+
+    /**
+     * @brief Queue single event
+     *
+     * @details Doesn't block, unless ring is full.
+     *
+     * @return Sequence number of event
+     */
+    sequence submit(const key_event &event)
+    {
+        std::uint64_t pos = tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            slot &s = slots[pos & mask];
+            const std::uint64_t seq = s.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::int64_t>(seq - pos);
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            }
+            else if (diff < 0)
+            {
+                // Ring is full. Wait for injector's thread
+                std::this_thread::yield();
+                pos = tail.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot &s = slots[pos & mask];
+        s.event = event;
+        // Sequentially consistent with the check of injector's thread before sleep
+        s.seq.store(pos + 1);
+        if (sleeping.load()) { wake(); }
+        return pos + 1;
+    }
+
+    /// Queue events. Returns sequence number of the last one
+    sequence submit(span<const key_event> events)
+    {
+        sequence last = 0;
+        for (const auto &event : events) { last = submit(event); }
+        return last;
+    }
+
+    /// Queue press of combination (until release()). Returns sequence number of the last event
+    sequence press(const combination &combo)
+    {
+        sequence last = 0;
+        for (vk key : combo) { last = submit(key_event{key, true}); }
+        return last;
+    }
+    /// Queue release of combination. Returns sequence number of the last event
+    sequence release(const combination &combo)
+    {
+        sequence last = 0;
+        for (vk key : combo) { last = submit(key_event{key, false}); }
+        return last;
+    }
+    /// Queue press() and release() of combination. Returns sequence number of the last event
+    sequence click(const combination &combo)
+    {
+        press(combo);
+        return release(combo);
+    }
+
+    /// Block until event with given sequence number (and every event before) is sent
+    void wait(sequence seq)
+    {
+        if (sent.load(std::memory_order_acquire) >= seq) { return; }
+
+        std::unique_lock lock(mutex);
+        done.wait(lock, [this, seq] { return sent.load(std::memory_order_acquire) >= seq; });
+    }
+
+    /// Block until every queued event is sent
+    void flush() { wait(tail.load()); }
+
+private:
+    struct slot
+    {
+        std::atomic<std::uint64_t> seq{0};
+        key_event                  event{};
+    };
+
+    void wake()
+    {
+        // Lock guarantees, that injector's thread is either awake or waiting
+        { std::lock_guard lock(mutex); }
+        ready.notify_one();
+    }
+
+    // Take every published event from the ring
+    void drain()
+    {
+        batch.clear();
+        while (true)
+        {
+            slot &s = slots[head & mask];
+            if (s.seq.load(std::memory_order_acquire) != head + 1) { break; }
+
+            batch.push_back(s.event);
+            s.seq.store(head + mask + 1, std::memory_order_release);
+            ++head;
+        }
+    }
+
+    void run()
+    {
+        if (!affinity.empty()) { thread::pin(affinity); }
+
+        while (true)
+        {
+            drain();
+            if (!batch.empty())
+            {
+                target.send(span<const key_event>(batch.data(), batch.size()));
+                sent.store(head, std::memory_order_release);
+                { std::lock_guard lock(mutex); }
+                done.notify_all();
+                continue;
+            }
+
+            if (stopping.load()) { break; }
+
+            std::unique_lock lock(mutex);
+            sleeping.store(true);
+            ready.wait(lock, [this]
+            {
+                return stopping.load() || slots[head & mask].seq.load() == head + 1;
+            });
+            sleeping.store(false);
+        }
+    }
+
+    std::unique_ptr<slot[]> slots;
+    std::uint64_t           mask = 0;
+
+    alignas(64) std::atomic<std::uint64_t> tail{0}; // Next position for producers
+    alignas(64) std::uint64_t              head = 0; // Next position for injector's thread
+    alignas(64) std::atomic<std::uint64_t> sent{0};  // Sequence number of the last sent event
+
+    std::atomic<bool>       sleeping{false};
+    std::atomic<bool>       stopping{false};
+    std::mutex              mutex;
+    std::condition_variable ready;
+    std::condition_variable done;
+
+    backend               &target;
+    cpu::cpu_set           affinity;
+    std::vector<key_event> batch;
+    std::thread            worker;
+};
+
+/**
+ * @brief Player of timed key events
+ *
+ * @details
+ *  Events are sent on player's own thread with raised priority.
+ *  Thread sleeps until absolute deadline of each event
+ *  and spins for the last moment to reduce jitter.
+ *  Events with the same time are sent as a single batch.
+ *
+ *  Difference between actual and scheduled time is measured for every event,
+ *  so bad runs may be rejected.
+ */
+class player
+{
+public:
+    /// Key event with time since start of playback
+    struct event : key_event
+    {
+        /// Time since start of playback
+        std::chrono::nanoseconds time{0};
+    };
+
+    /**
+     * @brief Prepare playback of events
+     *
+     * @param events Events, sorted by time
+     * @param spin     Time to spin before each deadline instead of sleeping
+     * @param affinity CPUs for player's thread (empty means any CPU)
+     *
+     * @note Events are sent to current_backend() of the thread, that makes player.
+     */
+    explicit player(
+        span<const event> events,
+        std::chrono::nanoseconds spin = std::chrono::microseconds(500),
+        cpu::cpu_set affinity = {}
+    )
+        : events(events.begin(), events.end()), spin(spin), scheduling_errors(events.size()),
+          target(current_backend()), affinity(std::move(affinity)) {}
+
+    player(const player &) = delete;
+    player(player &&) = delete;
+    void operator=(const player &) = delete;
+    void operator=(player &&) = delete;
+
+    /// Wait for the end of playback
+    ~player() { wait(); }
+
+    /// Start playback on player's own thread. Time is counted from the moment thread is ready
+    void start()
+    {
+        if (worker.joinable()) { return; }
+        done.store(false);
+        worker = std::thread([this] { run(); });
+    }
+
+    /// Block until every event is sent
+    void wait()
+    {
+        if (worker.joinable()) { worker.join(); }
+    }
+
+    /// Check if every event was sent
+    bool finished() const noexcept { return done.load(); }
+
+    /**
+     * @brief Get scheduling error of every event
+     *
+     * @details Positive error means, that event was sent late.
+     *
+     * @warning Valid only after playback is finished().
+     */
+    const std::vector<std::chrono::nanoseconds> & errors() const noexcept { return scheduling_errors; }
+
+    /// Get max absolute scheduling error
+    std::chrono::nanoseconds max_error() const noexcept
+    {
+        std::chrono::nanoseconds max{0};
+        for (auto error : scheduling_errors)
+        {
+            if (error < -max || error > max) { max = error < error.zero() ? -error : error; }
+        }
+        return max;
+    }
+
+private:
+    void run()
+    {
+        if (!affinity.empty()) { thread::pin(affinity); }
+        detail::raise_thread_priority();
+
+        std::vector<key_event> batch;
+        batch.reserve(events.size());
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < events.size();)
+        {
+            const auto deadline = start + events[i].time;
+
+            // Collect events with the same time
+            std::size_t end = i;
+            batch.clear();
+            while (end < events.size() && events[end].time == events[i].time)
+            {
+                batch.push_back(events[end]);
+                ++end;
+            }
+
+            detail::precise_sleep_until(deadline - spin);
+            auto now = std::chrono::steady_clock::now();
+            while (now < deadline) { now = std::chrono::steady_clock::now(); }
+
+            target.send(span<const key_event>(batch.data(), batch.size()));
+
+            for (; i < end; ++i) { scheduling_errors[i] = now - deadline; }
+        }
+
+        done.store(true);
+    }
+
+    std::vector<event>                    events;
+    std::chrono::nanoseconds              spin;
+    std::vector<std::chrono::nanoseconds> scheduling_errors;
+    backend                              &target;
+    cpu::cpu_set                          affinity;
+
+    std::atomic<bool> done{false};
+    std::thread       worker;
+};
+
+} // namespace os::keyboard
+
+namespace os::detail
+{
+
+/**
+ * @brief Listener, that passes its events to every subscribed wait
+ *
+ * @details Listener of native backend is made on first wait and kept until exit,
+ *  so waiting in a loop doesn't connect to OS each time.
+ */
+class shared_listener
+{
+public:
+    /// Events, queued for one wait
+    struct subscription
+    {
+        std::deque<keyboard::listener::event> events;
+    };
+
+    /// Start listening with current_backend()
+    shared_listener() : events([this](const keyboard::listener::event &e) { push(e); }) {}
+
+    /// Get listener of native backend
+    static shared_listener & native()
+    {
+        static shared_listener l;
+        return l;
+    }
+
+    /// Check if OS delivers events to listener
+    bool active() const noexcept { return events.active(); }
+
+    /// Start queueing events for subscription
+    void subscribe(subscription &s)
+    {
+        std::lock_guard lock(mutex);
+        subscriptions.push_back(&s);
+    }
+
+    /// Stop queueing events for subscription
+    void unsubscribe(subscription &s)
+    {
+        std::lock_guard lock(mutex);
+        subscriptions.erase(std::find(subscriptions.begin(), subscriptions.end(), &s));
+    }
+
+    /**
+     * @brief Wait for next event of subscription
+     *
+     * @param deadline Time to stop waiting at (nullptr to wait forever)
+     *
+     * @return Event or `std::nullopt` on timeout
+     */
+    std::optional<keyboard::listener::event> next_event(
+        subscription &s,
+        const std::chrono::steady_clock::time_point *deadline
+    )
+    {
+        std::unique_lock lock(mutex);
+        auto queued = [&s] { return !s.events.empty(); };
+        if (!deadline) { ready.wait(lock, queued); }
+        else if (!ready.wait_until(lock, *deadline, queued)) { return std::nullopt; }
+
+        keyboard::listener::event e = s.events.front();
+        s.events.pop_front();
+        return e;
+    }
+
+private:
+    // Called on listener's thread
+    void push(const keyboard::listener::event &e)
+    {
+        {
+            std::lock_guard lock(mutex);
+            for (auto *s : subscriptions) { s->events.push_back(e); }
+        }
+        ready.notify_all();
+    }
+
+    std::mutex                  mutex;
+    std::condition_variable     ready;
+    std::vector<subscription *> subscriptions;
+
+    // Last, so it stops before other members are destroyed
+    keyboard::listener events;
+};
+
+/**
+ * @brief Wait until any of combinations is fully pressed or released
+ *
+ * @details Sleeps on listener, shared with other waits on the same backend.
+ *  If listener isn't active (e.g. XRecord is missing or evdev is unreadable),
+ *  keys are polled with pressed_keys() every 10ms instead.
+ *
+ * @param combos Combinations to wait for
+ * @param released Wait for release instead of press
+ * @param deadline Time to stop waiting at (nullptr to wait forever)
+ *
+ * @return Index of the first matching combination or `std::nullopt` on timeout
+ */
+inline std::optional<std::size_t> wait_for_keys(
+    span<const keyboard::combination> combos,
+    bool released,
+    const std::chrono::steady_clock::time_point *deadline
+)
+{
+    auto match = [&](const keyboard::combination &held) -> std::optional<std::size_t>
+    {
+        for (std::size_t i = 0; i < combos.size(); ++i)
+        {
+            if (released ? !held.intersects(combos[i]) : held.contains(combos[i])) { return i; }
+        }
+        return std::nullopt;
+    };
+
+    // Other backends (e.g. mock) get listener just for this wait
+    std::optional<shared_listener> own;
+    shared_listener &events = &keyboard::current_backend() == &keyboard::native_backend()
+        ? shared_listener::native()
+        : own.emplace();
+
+    if (!events.active())
+    {
+        while (true)
+        {
+            if (auto i = match(keyboard::pressed_keys())) { return i; }
+            if (deadline && std::chrono::steady_clock::now() >= *deadline) { return std::nullopt; }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    // Subscribe before snapshot, so no event is lost
+    shared_listener::subscription queue;
+    events.subscribe(queue);
+    struct unsubscribe_on_exit
+    {
+        shared_listener &events;
+        shared_listener::subscription &queue;
+        ~unsubscribe_on_exit() { events.unsubscribe(queue); }
+    } guard { events, queue };
+
+    const auto since = std::chrono::steady_clock::now();
+    keyboard::combination held = keyboard::snapshot().pressed_keys();
+
+    while (true)
+    {
+        if (auto i = match(held)) { return i; }
+
+        const auto e = events.next_event(queue, deadline);
+        if (!e) { return std::nullopt; }
+
+        // Already taken into account by snapshot
+        if (e->time < since) { continue; }
+
+        if (e->is_down) { held.insert(e->key); } else { held.erase(e->key); }
+    }
+}
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+/**
+ * @brief Sleep until every key in combination is pressed
+ *
+ * @details Uses listener, shared by waits of the process, so no CPU time is spent while waiting.
+ *  The first wait on native backend connects to OS (e.g. XRecord on X11) and keeps the connection.
+ *  If listener is not active(), keys are polled every 10ms instead.
+ *
+ * @return `true`, when keys are pressed
+ */
+inline bool wait_for(const combination &combo)
+{
+    return detail::wait_for_keys(span<const combination>(&combo, 1), false, nullptr).has_value();
+}
+
+/**
+ * @brief Sleep until every key in combination is pressed, but no longer than timeout
+ *
+ * @details Keys are polled every 10ms, if listener is not active().
+ *
+ * @return `false` on timeout
+ */
+template <class Rep, class Period>
+bool wait_for(const combination &combo, const std::chrono::duration<Rep, Period> &timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    return detail::wait_for_keys(span<const combination>(&combo, 1), false, &deadline).has_value();
+}
+
+/**
+ * @brief Sleep until no key in combination is pressed, but no longer than timeout
+ *
+ * @details Keys are polled every 10ms, if listener is not active().
+ *
+ * @return `false` on timeout
+ */
+template <class Rep, class Period>
+bool wait_for_release(const combination &combo, const std::chrono::duration<Rep, Period> &timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    return detail::wait_for_keys(span<const combination>(&combo, 1), true, &deadline).has_value();
+}
+
+/// Sleep until no key in combination is pressed (always returns `true`)
+inline bool wait_for_release(const combination &combo)
+{
+    return detail::wait_for_keys(span<const combination>(&combo, 1), true, nullptr).has_value();
+}
+
+/**
+ * @brief Sleep until any of combinations is fully pressed
+ *
+ * @return Index of pressed combination
+ */
+inline std::optional<std::size_t> wait_for_any(span<const combination> combos)
+{
+    return detail::wait_for_keys(combos, false, nullptr);
+}
+
+/**
+ * @brief Sleep until any of combinations is fully pressed, but no longer than timeout
+ *
+ * @return Index of pressed combination or `std::nullopt` on timeout
+ */
+template <class Rep, class Period>
+std::optional<std::size_t> wait_for_any(span<const combination> combos, const std::chrono::duration<Rep, Period> &timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    return detail::wait_for_keys(combos, false, &deadline);
+}
+
+/// Operation of native backend, measured by stats()
+enum class operation
+{
+    /// Read state of keys (`XQueryKeymap`, `EVIOCGKEY`, `GetAsyncKeyState`, `GetKeyboardState`)
+    query_keymap,
+    /// Pass single key event to OS (`XTestFakeKeyEvent`, `CGEventPost`). uinput events are written at flush
+    fake_key_event,
+    /// Submit buffered events (`XFlush`, `write` to uinput, `SendInput`)
+    flush,
+    /// Fetch value of HID element or input event (`IOHIDDeviceGetValue`, evdev `read`)
+    hid_value_fetch,
+};
+
+/// Number of measured operations
+constexpr std::size_t operation_count = 4;
+
+/**
+ * @brief Counters of single operation
+ *
+ * @details
+ *  Latencies are put into log-scaled buckets:
+ *  bucket `0` counts calls shorter than 1 ns and bucket `i` counts calls
+ *  of `[2^(i-1), 2^i)` ns. The last bucket also counts longer calls.
+ */
+struct operation_stats
+{
+    /// Number of latency buckets
+    static constexpr std::size_t bucket_count = 40;
+
+    /// Number of calls
+    std::uint64_t calls = 0;
+    /// Total time of calls in nanoseconds
+    std::uint64_t total_ns = 0;
+    /// Longest call in nanoseconds
+    std::uint64_t max_ns = 0;
+    /// Histogram of latencies
+    std::uint64_t buckets[bucket_count] = {};
+};
+
+/// Counters of every operation
+struct stats_t
+{
+    /// Counters, indexed by operation
+    operation_stats operations[operation_count] = {};
+
+    /// Get counters of operation
+    constexpr const operation_stats & operator[](operation op) const noexcept
+    {
+        return operations[static_cast<std::size_t>(op)];
+    }
+};
+
+/// Check if library was built with `LIBOS_KEYBOARD_STATS`
+constexpr bool stats_enabled() noexcept
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Get counters of native backend, summed over all threads
+ *
+ * @details
+ *  Every thread counts its own calls with relaxed atomics,
+ *  so measuring doesn't add contention between threads.
+ *
+ * @note Without `LIBOS_KEYBOARD_STATS` nothing is measured and counters are always zero.
+ */
+stats_t stats();
+
+/// Reset counters of every thread
+void reset_stats();
+
+} // namespace os::keyboard
+
+namespace os::detail
+{
+
+/// Get number of bits, needed to represent value
+constexpr unsigned bit_width(std::uint64_t word) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return word == 0 ? 0 : 64 - static_cast<unsigned>(__builtin_clzll(word));
+#else
+    unsigned width = 0;
+    while (word != 0) { word >>= 1; ++width; }
+    return width;
+#endif
+}
+
+#ifdef LIBOS_KEYBOARD_STATS
+/// Counters of single thread
+struct stats_block
+{
+    /// Counters of single operation
+    struct counters
+    {
+        std::atomic<std::uint64_t> calls{0};
+        std::atomic<std::uint64_t> total_ns{0};
+        std::atomic<std::uint64_t> max_ns{0};
+        std::atomic<std::uint64_t> buckets[keyboard::operation_stats::bucket_count] = {};
+    };
+
+    counters operations[keyboard::operation_count];
+
+    /**
+     * @brief Count call of operation
+     *
+     * @note Counters are updated atomically, because clear() may zero them from another thread.
+     *  Only owning thread writes otherwise, so they aren't contended
+     */
+    void record(keyboard::operation op, std::uint64_t ns) noexcept
+    {
+        auto &c = operations[static_cast<std::size_t>(op)];
+        const std::size_t bucket = std::min<std::size_t>(bit_width(ns), std::size(c.buckets) - 1);
+
+        c.calls.fetch_add(1, std::memory_order_relaxed);
+        c.total_ns.fetch_add(ns, std::memory_order_relaxed);
+        std::uint64_t max = c.max_ns.load(std::memory_order_relaxed);
+        while (ns > max && !c.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+        c.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Add counters to result
+    void add_to(keyboard::stats_t &result) const noexcept
+    {
+        for (std::size_t op = 0; op < keyboard::operation_count; ++op)
+        {
+            const auto &c = operations[op];
+            auto &r = result.operations[op];
+            r.calls += c.calls.load(std::memory_order_relaxed);
+            r.total_ns += c.total_ns.load(std::memory_order_relaxed);
+            r.max_ns = std::max(r.max_ns, c.max_ns.load(std::memory_order_relaxed));
+            for (std::size_t b = 0; b < std::size(c.buckets); ++b)
+            {
+                r.buckets[b] += c.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Set every counter to zero
+    void clear() noexcept
+    {
+        for (auto &c : operations)
+        {
+            c.calls.store(0, std::memory_order_relaxed);
+            c.total_ns.store(0, std::memory_order_relaxed);
+            c.max_ns.store(0, std::memory_order_relaxed);
+            for (auto &bucket : c.buckets) { bucket.store(0, std::memory_order_relaxed); }
+        }
+    }
+};
+
+/// Counters of every thread
+class stats_registry
+{
+public:
+    /// Get registry of the library
+    static stats_registry & get()
+    {
+        static stats_registry registry;
+        return registry;
+    }
+
+    /// Get counters of current thread
+    static stats_block & local()
+    {
+        // Counters are registered on the first call of thread and merged on its exit
+        thread_local const attached block(get());
+        return *block.counters;
+    }
+
+    /// Sum counters of every thread
+    keyboard::stats_t collect()
+    {
+        std::lock_guard lock(mutex);
+        keyboard::stats_t result = retired;
+        for (const auto &block : blocks) { block->add_to(result); }
+        return result;
+    }
+
+    /// Reset counters of every thread
+    void clear()
+    {
+        std::lock_guard lock(mutex);
+        retired = {};
+        for (auto &block : blocks) { block->clear(); }
+    }
+
+private:
+    // Registration of thread's counters
+    struct attached
+    {
+        explicit attached(stats_registry &registry) : registry(registry), counters(registry.attach()) {}
+        ~attached() { registry.detach(counters); }
+
+        stats_registry &registry;
+        stats_block    *counters;
+    };
+
+    stats_block * attach()
+    {
+        std::lock_guard lock(mutex);
+        blocks.push_back(std::make_unique<stats_block>());
+        return blocks.back().get();
+    }
+
+    void detach(stats_block *block)
+    {
+        std::lock_guard lock(mutex);
+        block->add_to(retired);
+        blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](const auto &b) { return b.get() == block; }));
+    }
+
+    std::mutex                                mutex;
+    std::vector<std::unique_ptr<stats_block>> blocks;
+    keyboard::stats_t                         retired; // Counters of exited threads
+};
+
+/// Measure operation until the end of scope
+class stats_timer
+{
+public:
+    /// Start measuring
+    explicit stats_timer(keyboard::operation op) noexcept
+        : op(op), start(std::chrono::steady_clock::now()) {}
+
+    stats_timer(const stats_timer &) = delete;
+    stats_timer(stats_timer &&) = delete;
+    void operator=(const stats_timer &) = delete;
+    void operator=(stats_timer &&) = delete;
+
+    /// Count operation
+    ~stats_timer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        stats_registry::local().record(
+            op, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())
+        );
+    }
+
+private:
+    keyboard::operation                   op;
+    std::chrono::steady_clock::time_point start;
+};
+#else
+/// Does nothing without `LIBOS_KEYBOARD_STATS`
+class stats_timer
+{
+public:
+    constexpr explicit stats_timer(keyboard::operation) noexcept {}
+};
+#endif // LIBOS_KEYBOARD_STATS
+
+} // namespace os::detail
\ No newline at end of file
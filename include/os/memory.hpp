@@ -0,0 +1,99 @@
+// Memory info
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/memory.hpp
+ *  Functions to get memory info
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace os::memory
+{
+
+/// Facts about memory, that don't change while program runs
+struct info_t
+{
+    /// Size of regular page in bytes
+    std::size_t page_size = 0;
+
+    /// Supported sizes of huge (large) pages in bytes, in ascending order
+    std::vector<std::size_t> huge_page_sizes;
+    /// Program may allocate huge pages explicitly
+    bool huge_pages_available = false;
+    /// OS backs suitable allocations with huge pages automatically (Linux THP)
+    bool transparent_huge_pages = false;
+
+    /// Total physical memory in bytes
+    std::uint64_t total = 0;
+};
+
+/// Memory figures, that change all the time. Fields are 0, if OS didn't report them
+struct snapshot_t
+{
+    /// Physical memory in bytes, that may be given to programs without swapping
+    std::uint64_t available = 0;
+    /// Physical memory of this process in bytes (resident set size)
+    std::uint64_t resident = 0;
+    /// Max resident set size of this process in bytes
+    std::uint64_t peak_resident = 0;
+};
+
+/// Get size of regular page in bytes
+std::size_t page_size();
+
+/// Get total physical memory in bytes
+std::uint64_t total();
+
+/**
+ * @brief Get facts about memory
+ *
+ * @details
+ *  Facts are read once, even if several threads call it at the same time:
+ *  - Linux: `sysconf`, `sysinfo` and `/sys/kernel/mm`.
+ *    Huge pages are available, if pool of `/sys/kernel/mm/hugepages` isn't empty
+ *  - Windows: `GetSystemInfo`, `GetLargePageMinimum` and `GlobalMemoryStatusEx`.
+ *    Large pages are available, if process has `SeLockMemoryPrivilege`
+ *  - MacOS: `sysctl hw.memsize`. 2MB superpages are available on x86_64 only
+ *
+ * @return const info_t& Ref to memory facts
+ */
+const info_t & info();
+
+/**
+ * @brief Sample current memory figures
+ *
+ * @details
+ *  Doesn't allocate, so it may be called at high rate (e.g. 1 kHz):
+ *  - Linux: `MemAvailable` of `/proc/meminfo` (`sysinfo` on old kernels),
+ *    `/proc/self/statm` and `getrusage`
+ *  - Windows: `GlobalMemoryStatusEx` and `GetProcessMemoryInfo`
+ *  - MacOS: `host_statistics64` and `task_info`
+ */
+snapshot_t snapshot() noexcept;
+
+} // namespace os::memory
\ No newline at end of file
@@ -0,0 +1,237 @@
+// Mouse input
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/mouse.hpp
+ *  Functions to query and emulate mouse
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+#include "os/keyboard.hpp"
+
+namespace os::mouse
+{
+
+/**
+ * @brief Get position of mouse cursor
+ *
+ * @details
+ *  - Linux: `XQueryPointer`. uinput backend can't read position and returns origin
+ *  - Windows: `GetCursorPos`
+ *  - MacOS: location of `CGEventCreate(nullptr)`
+ */
+point position();
+
+/**
+ * @brief Send sequence of mouse events at once
+ *
+ * @details
+ *  Events go through the same backend as keyboard, with a single OS call per batch:
+ *  - Linux: one `XFlush` after all `XTestFake*Event` on the connection, shared with keyboard,
+ *    or one uinput report. uinput has relative motion only, so it skips move_to
+ *  - Windows: one `SendInput` with `INPUT_MOUSE`
+ *  - MacOS: `CGEventCreateMouseEvent` and `CGEventCreateScrollWheelEvent` for every event
+ *
+ * @note On Windows relative moves are affected by pointer acceleration.
+ */
+void send(span<const event> events);
+/// Send list of mouse events at once
+inline void send(std::initializer_list<event> events)
+{
+    send(span<const event>(events.begin(), events.size()));
+}
+
+/// Move cursor to absolute position
+void move_to(point p);
+/// Move cursor by offset
+void move_by(int dx, int dy);
+
+/// Press button (until release())
+void press(button b = button::left);
+/// Release button
+void release(button b = button::left);
+/// press() and release() button with a single batch
+void click(button b = button::left);
+
+/// Scroll by wheel clicks. Positive values scroll up and right
+void scroll(int dy, int dx = 0);
+
+/**
+ * @brief Merge consecutive motion and scroll events
+ *
+ * @details
+ *  Moves and scrolls between button events are replaced with a single event
+ *  with the same final position, so the whole path costs one OS event:
+ *  - move_to replaces the previous move
+ *  - move_by is added to the previous move, that stays absolute or relative
+ *  - consecutive scrolls are summed
+ *
+ *  Backends without absolute moves (e.g. uinput) skip move_to,
+ *  so for them relative and absolute moves are never merged with each other.
+ *
+ * @param events   Events to merge
+ * @param merged   Output. It's cleared first, so buffer may be reused without allocations
+ * @param absolute Backend supports move_to (see keyboard::backend::absolute_mouse_moves())
+ */
+inline void coalesce(span<const event> events, std::vector<event> &merged, bool absolute = true)
+{
+    merged.clear();
+    for (const auto &e : events)
+    {
+        if (!merged.empty())
+        {
+            event &last = merged.back();
+            const bool moves = absolute
+                ? last.kind == action::move_to || last.kind == action::move_by
+                : last.kind == e.kind;
+
+            if (moves && e.kind == action::move_to) { last = e; continue; }
+            if (moves && e.kind == action::move_by) { last.x += e.x; last.y += e.y; continue; }
+            if (last.kind == action::scroll && e.kind == action::scroll) { last.x += e.x; last.y += e.y; continue; }
+        }
+        merged.push_back(e);
+    }
+}
+
+/**
+ * @brief Player of timed mouse path
+ *
+ * @details
+ *  Events are grouped into frames by time.
+ *  Every frame is coalesce()d and sent as a single batch at time of its last event,
+ *  so intermediate motion costs nothing and there is one flush per frame.
+ *  Events are sent on player's own thread with raised priority.
+ */
+class player
+{
+public:
+    /// Mouse event with time since start of playback
+    struct event : mouse::event
+    {
+        /// Time since start of playback
+        std::chrono::nanoseconds time{0};
+    };
+
+    /**
+     * @brief Prepare playback of events
+     *
+     * @param events   Events, sorted by time
+     * @param frame    Duration of frame (e.g. refresh period of screen)
+     * @param affinity CPUs for player's thread (empty means any CPU)
+     *
+     * @note Events are sent to keyboard::current_backend() of the thread, that makes player.
+     */
+    explicit player(
+        span<const event> events,
+        std::chrono::nanoseconds frame = std::chrono::microseconds(16667),
+        cpu::cpu_set affinity = {}
+    )
+        : events(events.begin(), events.end()),
+          frame(frame > frame.zero() ? frame : std::chrono::nanoseconds(1)),
+          target(keyboard::current_backend()), affinity(std::move(affinity)) {}
+
+    player(const player &) = delete;
+    player(player &&) = delete;
+    void operator=(const player &) = delete;
+    void operator=(player &&) = delete;
+
+    /// Wait for the end of playback
+    ~player() { wait(); }
+
+    /// Start playback on player's own thread. Time is counted from the moment thread is ready
+    void start()
+    {
+        if (worker.joinable()) { return; }
+        done.store(false);
+        sent_frames.store(0);
+        worker = std::thread([this] { run(); });
+    }
+
+    /// Block until every event is sent
+    void wait()
+    {
+        if (worker.joinable()) { worker.join(); }
+    }
+
+    /// Check if every event was sent
+    bool finished() const noexcept { return done.load(); }
+
+    /// Get number of batches, sent so far
+    std::size_t frames() const noexcept { return sent_frames.load(); }
+
+private:
+    void run()
+    {
+        if (!affinity.empty()) { thread::pin(affinity); }
+        detail::raise_thread_priority();
+
+        std::vector<mouse::event> raw;
+        std::vector<mouse::event> merged;
+        raw.reserve(events.size());
+        merged.reserve(events.size());
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < events.size();)
+        {
+            // Collect events of the same frame
+            const auto index = events[i].time / frame;
+            raw.clear();
+            std::size_t end = i;
+            while (end < events.size() && events[end].time / frame == index)
+            {
+                raw.push_back(events[end]);
+                ++end;
+            }
+
+            coalesce(span<const mouse::event>(raw.data(), raw.size()), merged, target.absolute_mouse_moves());
+
+            detail::precise_sleep_until(start + events[end - 1].time);
+            target.send_mouse(span<const mouse::event>(merged.data(), merged.size()));
+            sent_frames.fetch_add(1);
+
+            i = end;
+        }
+
+        done.store(true);
+    }
+
+    std::vector<event>       events;
+    std::chrono::nanoseconds frame;
+    keyboard::backend       &target;
+    cpu::cpu_set             affinity;
+
+    std::atomic<bool>        done{false};
+    std::atomic<std::size_t> sent_frames{0};
+    std::thread              worker;
+};
+
+} // namespace os::mouse
\ No newline at end of file
@@ -30,8 +30,17 @@
 
 #include "os/macros.h"
 #include "os/version.hpp"
+#include "os/span.hpp"
 
+#include "os/clock.hpp"
+#include "os/cpu.hpp"
 #include "os/info.hpp"
 #include "os/kernel.hpp"
 #include "os/keyboard.hpp"
-#include "os/libos.hpp"
\ No newline at end of file
+#include "os/libos.hpp"
+#include "os/memory.hpp"
+#include "os/mouse.hpp"
+#include "os/prefetch.hpp"
+#include "os/process.hpp"
+#include "os/recording.hpp"
+#include "os/thread.hpp"
\ No newline at end of file
@@ -0,0 +1,105 @@
+// Background warm-up of lazy subsystems
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/** @file os/prefetch.hpp
+ *  Background warm-up of lazy subsystems
+ */
+
+#pragma once
+
+#include <thread>
+#include <vector>
+
+#include "os/clock.hpp"
+#include "os/info.hpp"
+#include "os/kernel.hpp"
+#include "os/keyboard.hpp"
+
+namespace os
+{
+
+/**
+ * @brief Handle of background warm-up, started by prefetch()
+ *
+ * @details Destructor waits until warm-up is finished.
+ */
+class prefetch_handle
+{
+public:
+    prefetch_handle(const prefetch_handle &) = delete;
+    prefetch_handle(prefetch_handle &&) = delete;
+    void operator=(const prefetch_handle &) = delete;
+    void operator=(prefetch_handle &&) = delete;
+
+    /// Wait until every subsystem is initialized
+    ~prefetch_handle() { wait(); }
+
+    /// Block until every subsystem is initialized
+    void wait()
+    {
+        for (auto &worker : workers)
+        {
+            if (worker.joinable()) { worker.join(); }
+        }
+    }
+
+private:
+    friend prefetch_handle prefetch();
+
+    // Start initialization of every subsystem on its own thread
+    prefetch_handle()
+    {
+        workers.reserve(4);
+        workers.emplace_back([] { os::info(); });
+        workers.emplace_back([] { os::kernel::info(); });
+        // Probes kernel features and measures rate of CPU counter for 10ms
+        workers.emplace_back([] { os::clock::calibration(); });
+        // Connects to X server, opens uinput or HID manager and loads layout tables
+        workers.emplace_back([] { keyboard::native_backend().warm_up(); });
+    }
+
+    std::vector<std::thread> workers;
+};
+
+/**
+ * @brief Initialize lazy subsystems in background
+ *
+ * @details
+ *  Subsystems are initialized in parallel, each on its own thread:
+ *  - OS info (os::info())
+ *  - OS Kernel info (os::kernel::info())
+ *  - OS Kernel features and calibration of fast clock (os::clock::calibration())
+ *  - Native keyboard backend with tables of current layout:
+ *    X display connection, that the first thread to use keyboard gets,
+ *    or uinput device on Linux, HID manager on macOS
+ *
+ *  Call it at process start, so the first real use doesn't pay for initialization.
+ *  Functions are safe to call while warm-up is running: they wait for the same one-time initialization.
+ *
+ * @return Handle to wait for warm-up
+ */
+inline prefetch_handle prefetch() { return prefetch_handle(); }
+
+} // namespace os
\ No newline at end of file
@@ -0,0 +1,115 @@
+// Process usage
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/process.hpp
+ *  Functions to get resource usage of current process
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace os::process
+{
+
+/// Resource usage of process since its start. Fields are 0, if OS doesn't report them
+struct usage_t
+{
+    /// CPU time in user mode
+    std::chrono::nanoseconds user_time{0};
+    /// CPU time in kernel mode
+    std::chrono::nanoseconds system_time{0};
+
+    /// Context switches, because process waited (e.g. for I/O)
+    std::uint64_t voluntary_switches = 0;
+    /// Context switches, because scheduler preempted process
+    std::uint64_t involuntary_switches = 0;
+
+    /// Page faults, that required I/O
+    std::uint64_t major_faults = 0;
+    /// Page faults, that were served without I/O
+    std::uint64_t minor_faults = 0;
+
+    /// Bytes read
+    std::uint64_t read_bytes = 0;
+    /// Bytes written
+    std::uint64_t write_bytes = 0;
+
+    /// Get total CPU time
+    constexpr std::chrono::nanoseconds cpu_time() const noexcept { return user_time + system_time; }
+
+    /// Get usage between two samples
+    constexpr usage_t operator-(const usage_t &rhs) const noexcept
+    {
+        usage_t delta;
+        delta.user_time = user_time - rhs.user_time;
+        delta.system_time = system_time - rhs.system_time;
+        delta.voluntary_switches = voluntary_switches - rhs.voluntary_switches;
+        delta.involuntary_switches = involuntary_switches - rhs.involuntary_switches;
+        delta.major_faults = major_faults - rhs.major_faults;
+        delta.minor_faults = minor_faults - rhs.minor_faults;
+        delta.read_bytes = read_bytes - rhs.read_bytes;
+        delta.write_bytes = write_bytes - rhs.write_bytes;
+        return delta;
+    }
+
+    /// Add usage of another period (e.g. to sum up deltas)
+    constexpr usage_t & operator+=(const usage_t &rhs) noexcept
+    {
+        user_time += rhs.user_time;
+        system_time += rhs.system_time;
+        voluntary_switches += rhs.voluntary_switches;
+        involuntary_switches += rhs.involuntary_switches;
+        major_faults += rhs.major_faults;
+        minor_faults += rhs.minor_faults;
+        read_bytes += rhs.read_bytes;
+        write_bytes += rhs.write_bytes;
+        return *this;
+    }
+};
+
+/**
+ * @brief Sample resource usage of current process
+ *
+ * @details
+ *  Doesn't allocate, so it may be called for every request:
+ *  - Linux: `getrusage` and `rchar`/`wchar` of `/proc/self/io` (bytes of every read and write call)
+ *  - Windows: `GetProcessTimes`, `GetProcessMemoryInfo` and `GetProcessIoCounters`
+ *    (bytes of every read and write call). There are no context switches or major faults,
+ *    every page fault is counted as minor
+ *  - MacOS: `getrusage` and `proc_pid_rusage` (bytes of disk I/O)
+ *
+ * @code{.cpp}
+ * const auto start = os::process::usage();
+ * handle(request);
+ * const auto cost = os::process::usage() - start;
+ * @endcode
+ */
+usage_t usage() noexcept;
+
+/// Get sum of usages
+constexpr usage_t operator+(usage_t lhs, const usage_t &rhs) noexcept { return lhs += rhs; }
+
+} // namespace os::process
\ No newline at end of file
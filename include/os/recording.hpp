@@ -0,0 +1,501 @@
+// Recording and replay of keyboard events
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/recording.hpp
+ *  Recording and replay of keyboard events
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+
+#include "os/macros.h"
+#include "os/keyboard.hpp"
+
+namespace os::keyboard
+{
+
+/**
+ * @brief Platform-neutral key identifier
+ *
+ * @details
+ *  USB HID usage ID of the key on Keyboard/Keypad page (`0x07`).
+ *  `0` means, that key has no portable identifier.
+ */
+using portable_key = std::uint16_t;
+
+/**
+ * @brief Get portable identifier of virtual key
+ *
+ * @return USB HID usage ID or `0`, if key has no portable identifier
+ */
+constexpr portable_key to_portable(vk key) noexcept
+{
+    switch (key)
+    {
+        /* Letters */
+        case vk::A: return 0x04; case vk::B: return 0x05; case vk::C: return 0x06;
+        case vk::D: return 0x07; case vk::E: return 0x08; case vk::F: return 0x09;
+        case vk::G: return 0x0A; case vk::H: return 0x0B; case vk::I: return 0x0C;
+        case vk::J: return 0x0D; case vk::K: return 0x0E; case vk::L: return 0x0F;
+        case vk::M: return 0x10; case vk::N: return 0x11; case vk::O: return 0x12;
+        case vk::P: return 0x13; case vk::Q: return 0x14; case vk::R: return 0x15;
+        case vk::S: return 0x16; case vk::T: return 0x17; case vk::U: return 0x18;
+        case vk::V: return 0x19; case vk::W: return 0x1A; case vk::X: return 0x1B;
+        case vk::Y: return 0x1C; case vk::Z: return 0x1D;
+
+        /* Digits */
+        case vk::Key_1: return 0x1E; case vk::Key_2: return 0x1F; case vk::Key_3: return 0x20;
+        case vk::Key_4: return 0x21; case vk::Key_5: return 0x22; case vk::Key_6: return 0x23;
+        case vk::Key_7: return 0x24; case vk::Key_8: return 0x25; case vk::Key_9: return 0x26;
+        case vk::Key_0: return 0x27;
+
+        /* TTY function keys */
+        case vk::Return: return 0x28;
+        case vk::Escape: return 0x29;
+        case vk::Tab:    return 0x2B;
+        case vk::Space:  return 0x2C;
+#if IS_OS_MACOS
+        case vk::Delete: return 0x2A; // Backspace on Mac keyboards
+#else
+        case vk::Backspace: return 0x2A;
+        case vk::Delete:    return 0x4C;
+#endif
+
+        /* Other symbols */
+#if IS_OS_MACOS
+        case vk::Minus:     return 0x2D;
+        case vk::Equal:     return 0x2E;
+        case vk::Bracket_L: return 0x2F;
+        case vk::Bracket_R: return 0x30;
+        case vk::Backslash: return 0x31;
+        case vk::Semicolon: return 0x33;
+        case vk::Quote:     return 0x34;
+        case vk::Grave:     return 0x35;
+        case vk::Comma:     return 0x36;
+        case vk::Period:    return 0x37;
+        case vk::Slash:     return 0x38;
+        case vk::Section:   return 0x64;
+#endif
+
+        /* Modifiers */
+        case vk::Caps_Lock: return 0x39;
+        case vk::Control_L: return 0xE0;
+        case vk::Shift_L:   return 0xE1;
+        case vk::Alt_L:     return 0xE2;
+        case vk::Control_R: return 0xE4;
+        case vk::Shift_R:   return 0xE5;
+        case vk::Alt_R:     return 0xE6;
+#if IS_OS_LINUX
+        case vk::Super_L:   return 0xE3;
+        case vk::Super_R:   return 0xE7;
+#elif IS_OS_WINDOWS
+        case vk::Win_L:     return 0xE3;
+        case vk::Win_R:     return 0xE7;
+#elif IS_OS_MACOS
+        case vk::Command_L: return 0xE3;
+        case vk::Command_R: return 0xE7;
+#endif
+
+        /* Function keys */
+        case vk::F1:  return 0x3A; case vk::F2:  return 0x3B; case vk::F3:  return 0x3C;
+        case vk::F4:  return 0x3D; case vk::F5:  return 0x3E; case vk::F6:  return 0x3F;
+        case vk::F7:  return 0x40; case vk::F8:  return 0x41; case vk::F9:  return 0x42;
+        case vk::F10: return 0x43; case vk::F11: return 0x44; case vk::F12: return 0x45;
+
+        /* Navigation */
+#if IS_OS_MACOS
+        case vk::Help:      return 0x49; // Insert on PC keyboards
+        case vk::Home:      return 0x4A;
+        case vk::Page_Up:   return 0x4B;
+        case vk::End:       return 0x4D;
+        case vk::Page_Down: return 0x4E;
+#endif
+
+        /* Arrows */
+        case vk::Right: return 0x4F;
+        case vk::Left:  return 0x50;
+        case vk::Down:  return 0x51;
+        case vk::Up:    return 0x52;
+
+        /* Numpad */
+        case vk::Num_1: return 0x59; case vk::Num_2: return 0x5A; case vk::Num_3: return 0x5B;
+        case vk::Num_4: return 0x5C; case vk::Num_5: return 0x5D; case vk::Num_6: return 0x5E;
+        case vk::Num_7: return 0x5F; case vk::Num_8: return 0x60; case vk::Num_9: return 0x61;
+        case vk::Num_0: return 0x62;
+#if IS_OS_MACOS
+        case vk::Num_Clear:    return 0x53;
+        case vk::Num_Divide:   return 0x54;
+        case vk::Num_Multiply: return 0x55;
+        case vk::Num_Minus:    return 0x56;
+        case vk::Num_Plus:     return 0x57;
+        case vk::Num_Decimal:  return 0x63;
+        case vk::Num_Equals:   return 0x67;
+
+        /* Control keys */
+        case vk::Mute:        return 0x7F;
+        case vk::Volume_Up:   return 0x80;
+        case vk::Volume_Down: return 0x81;
+#endif
+
+        default: break;
+    }
+
+    // Keys, that have no name in vk
+    switch (static_cast<unsigned>(key))
+    {
+#if IS_OS_LINUX
+        case '-':    return 0x2D;
+        case '=':    return 0x2E;
+        case '[':    return 0x2F;
+        case ']':    return 0x30;
+        case '\\':   return 0x31;
+        case ';':    return 0x33;
+        case '\'':   return 0x34;
+        case '`':    return 0x35;
+        case ',':    return 0x36;
+        case '.':    return 0x37;
+        case '/':    return 0x38;
+        case 0xFF63: return 0x49; // XK_Insert
+        case 0xFF50: return 0x4A; // XK_Home
+        case 0xFF55: return 0x4B; // XK_Page_Up
+        case 0xFF57: return 0x4D; // XK_End
+        case 0xFF56: return 0x4E; // XK_Page_Down
+#elif IS_OS_WINDOWS
+        case 0xBD: return 0x2D; // VK_OEM_MINUS
+        case 0xBB: return 0x2E; // VK_OEM_PLUS
+        case 0xDB: return 0x2F; // VK_OEM_4
+        case 0xDD: return 0x30; // VK_OEM_6
+        case 0xDC: return 0x31; // VK_OEM_5
+        case 0xBA: return 0x33; // VK_OEM_1
+        case 0xDE: return 0x34; // VK_OEM_7
+        case 0xC0: return 0x35; // VK_OEM_3
+        case 0xBC: return 0x36; // VK_OEM_COMMA
+        case 0xBE: return 0x37; // VK_OEM_PERIOD
+        case 0xBF: return 0x38; // VK_OEM_2
+        case 0x2D: return 0x49; // VK_INSERT
+        case 0x24: return 0x4A; // VK_HOME
+        case 0x21: return 0x4B; // VK_PRIOR
+        case 0x23: return 0x4D; // VK_END
+        case 0x22: return 0x4E; // VK_NEXT
+#endif
+        default: return 0;
+    }
+}
+
+} // namespace os::keyboard
+
+namespace os::detail
+{
+
+/// Table of virtual keys by portable identifiers (dense key index + 1, 0 if none)
+constexpr std::array<std::uint16_t, 256> portable_keys = []
+{
+    std::array<std::uint16_t, 256> table{};
+    for (std::size_t i = 0; i < key_index_count; ++i)
+    {
+        const keyboard::portable_key id = keyboard::to_portable(key_at(i));
+        if (id != 0 && id < table.size() && table[id] == 0)
+        {
+            table[id] = static_cast<std::uint16_t>(i + 1);
+        }
+    }
+    return table;
+}();
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+/// Get virtual key by portable identifier (if there is such key on current OS)
+constexpr std::optional<vk> from_portable(portable_key id) noexcept
+{
+    if (id >= detail::portable_keys.size() || detail::portable_keys[id] == 0) { return std::nullopt; }
+    return detail::key_at(detail::portable_keys[id] - 1);
+}
+
+} // namespace os::keyboard
+
+namespace os::detail
+{
+
+/// Read-only memory mapping of the whole file
+class mapped_file
+{
+public:
+    /// Map file (empty mapping on failure)
+    explicit mapped_file(const std::string &path);
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file(mapped_file &&) = delete;
+    void operator=(const mapped_file &) = delete;
+    void operator=(mapped_file &&) = delete;
+
+    /// Unmap file
+    ~mapped_file();
+
+    /// Get mapped bytes
+    const unsigned char * data() const noexcept { return bytes; }
+    /// Get number of mapped bytes
+    std::size_t size() const noexcept { return length; }
+
+private:
+    const unsigned char *bytes  = nullptr;
+    std::size_t          length = 0;
+#if IS_OS_WINDOWS
+    void *file    = nullptr; // HANDLE
+    void *mapping = nullptr; // HANDLE
+#endif
+};
+
+/// Magic bytes and format version at the beginning of recording
+constexpr unsigned char recording_signature[] = { 'L', 'O', 'S', 'K', 1 };
+
+/// Write unsigned LEB128 varint
+inline void write_varint(std::FILE *file, std::uint64_t value)
+{
+    unsigned char buffer[10];
+    std::size_t n = 0;
+    do
+    {
+        unsigned char byte = value & 0x7F;
+        value >>= 7;
+        if (value != 0) { byte |= 0x80; }
+        buffer[n++] = byte;
+    } while (value != 0);
+    std::fwrite(buffer, 1, n, file);
+}
+
+/// Read unsigned LEB128 varint. Returns false on truncated or too long value
+inline bool read_varint(const unsigned char *&it, const unsigned char *end, std::uint64_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; it != end && shift < 64; shift += 7)
+    {
+        const unsigned char byte = *it++;
+        value |= std::uint64_t{byte & 0x7Fu} << shift;
+        if (!(byte & 0x80)) { return true; }
+    }
+    return false;
+}
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+/**
+ * @brief Writer of key events to compact binary file
+ *
+ * @details
+ *  File starts with signature `"LOSK"` and format version byte.
+ *  Each event is a pair of LEB128 varints:
+ *  - microseconds since previous event
+ *  - `portable_key << 1 | is_down`
+ *
+ *  Keys without portable identifier are skipped.
+ *  Files are the same on every OS.
+ *
+ *  Usage with listener:
+ *  @code
+ *  recorder rec("session.keys");
+ *  listener l([&rec](const listener::event &e) { rec.write(e); });
+ *  @endcode
+ */
+class recorder
+{
+public:
+    /// Create (or truncate) file and write signature
+    explicit recorder(const std::string &path) : file(std::fopen(path.c_str(), "wb"))
+    {
+        if (file) { std::fwrite(detail::recording_signature, 1, sizeof(detail::recording_signature), file); }
+    }
+
+    recorder(const recorder &) = delete;
+    recorder(recorder &&) = delete;
+    void operator=(const recorder &) = delete;
+    void operator=(recorder &&) = delete;
+
+    /// Flush and close file
+    ~recorder()
+    {
+        if (file) { std::fclose(file); }
+    }
+
+    /// Check if file is opened
+    bool valid() const noexcept { return file != nullptr; }
+
+    /// Write event, that happened at given time
+    void write(const key_event &event, std::chrono::steady_clock::time_point time)
+    {
+        const portable_key id = to_portable(event.key);
+        if (!file || id == 0) { return; }
+
+        const auto delta = last ? time - *last : std::chrono::steady_clock::duration::zero();
+        const auto us = std::max<std::int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(delta).count(), 0);
+        // Advance by encoded delta only, so truncation errors don't accumulate
+        if (last) { *last += std::chrono::microseconds(us); } else { last = time; }
+
+        detail::write_varint(file, static_cast<std::uint64_t>(us));
+        detail::write_varint(file, std::uint64_t{id} << 1 | (event.is_down ? 1 : 0));
+    }
+    /// Write event from listener
+    void write(const listener::event &event) { write(event, event.time); }
+
+    /// Flush buffered events to file
+    void flush()
+    {
+        if (file) { std::fflush(file); }
+    }
+
+private:
+    std::FILE *file = nullptr;
+    std::optional<std::chrono::steady_clock::time_point> last;
+};
+
+/**
+ * @brief Memory-mapped recording of key events
+ *
+ * @details
+ *  Events are decoded lazily during iteration, nothing is loaded in advance.
+ *  Time of each event is counted from the first one,
+ *  so events may be passed to player as is.
+ *  Keys, that don't exist on current OS, are skipped.
+ */
+class recording
+{
+public:
+    /// Forward iterator over recorded events
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = player::event;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const player::event *;
+        using reference         = const player::event &;
+
+        /// Get current event
+        reference operator*() const noexcept { return current; }
+        /// Access current event
+        pointer operator->() const noexcept { return &current; }
+
+        /// Go to the next event
+        iterator & operator++() noexcept
+        {
+            decode();
+            return *this;
+        }
+        /// Go to the next event
+        iterator operator++(int) noexcept
+        {
+            iterator it = *this;
+            ++*this;
+            return it;
+        }
+
+        /// Check iterators for equality
+        bool operator==(const iterator &rhs) const noexcept { return it == rhs.it; }
+        /// Check iterators for inequality
+        bool operator!=(const iterator &rhs) const noexcept { return it != rhs.it; }
+
+    private:
+        friend class recording;
+
+        iterator(const unsigned char *begin, const unsigned char *end) noexcept
+            : it(begin), next(begin), end(end)
+        {
+            decode();
+        }
+
+        // Decode event at next position. Malformed tail is treated as end
+        void decode() noexcept
+        {
+            while (true)
+            {
+                it = next;
+                if (it == end) { return; }
+
+                std::uint64_t delta = 0, key = 0;
+                if (!detail::read_varint(next, end, delta) || !detail::read_varint(next, end, key))
+                {
+                    it = next = end;
+                    return;
+                }
+
+                current.time += std::chrono::microseconds(delta);
+                if (auto vk = from_portable(static_cast<portable_key>(key >> 1)))
+                {
+                    current.key = *vk;
+                    current.is_down = key & 1;
+                    return;
+                }
+            }
+        }
+
+        const unsigned char *it   = nullptr; // Position of current event
+        const unsigned char *next = nullptr; // Position of next event
+        const unsigned char *end  = nullptr;
+        player::event        current{};
+    };
+
+    /// Map recording file
+    explicit recording(const std::string &path) : file(path) {}
+
+    /// Check if file is mapped and has correct signature
+    bool valid() const noexcept
+    {
+        if (file.size() < sizeof(detail::recording_signature)) { return false; }
+        for (std::size_t i = 0; i < sizeof(detail::recording_signature); ++i)
+        {
+            if (file.data()[i] != detail::recording_signature[i]) { return false; }
+        }
+        return true;
+    }
+
+    /// Get iterator to the first event
+    iterator begin() const noexcept
+    {
+        if (!valid()) { return end(); }
+        return iterator(file.data() + sizeof(detail::recording_signature), file.data() + file.size());
+    }
+    /// Get iterator past the last event
+    iterator end() const noexcept
+    {
+        const unsigned char *last = file.data() + file.size();
+        return iterator(last, last);
+    }
+
+private:
+    detail::mapped_file file;
+};
+
+} // namespace os::keyboard
@@ -0,0 +1,101 @@
+// Thread scheduling
+
+// This file is part of LibOS.
+
+// Copyright (c) 2021 Gavrilikhin Daniil
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/** @file os/thread.hpp
+ *  Functions to control scheduling of current thread
+ */
+
+#pragma once
+
+#include "os/cpu.hpp"
+
+namespace os::thread
+{
+
+/// Scheduling class of thread
+enum class priority
+{
+    /// Runs only when CPU has nothing else to do
+    idle,
+    /// Below normal threads
+    low,
+    /// Default priority
+    normal,
+    /// Above normal threads
+    high,
+    /// Time-critical work. Preempts normal threads
+    realtime
+};
+
+/**
+ * @brief Allow current thread to run only on specified CPUs
+ *
+ * @details
+ *  - Linux: `pthread_setaffinity_np`
+ *  - Windows: `SetThreadGroupAffinity`. Every CPU must be in the same processor group
+ *  - MacOS: `thread_policy_set` with `THREAD_AFFINITY_POLICY`.
+ *    Affinity is only a hint: threads with the same first CPU share a tag
+ *    and are scheduled on cores with shared L2 cache.
+ *    Not supported on Apple Silicon
+ *
+ * @param cpus Indexes of logical CPUs, as in cpu::info()
+ *
+ * @return true on success, false if set is empty or OS refused it
+ */
+bool pin(const cpu::cpu_set &cpus);
+
+/**
+ * @brief Change scheduling class of current thread
+ *
+ * @details
+ *  - Linux: `sched_setscheduler` with `SCHED_IDLE`, `SCHED_OTHER` or `SCHED_FIFO`.
+ *    Nice value of `SCHED_OTHER` is 10 for low, 0 for normal and -10 for high
+ *  - Windows: `SetThreadPriority` from `THREAD_PRIORITY_IDLE` to `THREAD_PRIORITY_TIME_CRITICAL`
+ *  - MacOS: QoS class from `QOS_CLASS_BACKGROUND` to `QOS_CLASS_USER_INTERACTIVE`
+ *
+ * @note On Linux high and realtime require `CAP_SYS_NICE` (or `RLIMIT_NICE`/`RLIMIT_RTPRIO`).
+ *
+ * @return true on success, false if OS refused it
+ */
+bool set_priority(priority p);
+
+/**
+ * @brief Prefer memory and CPUs of NUMA node for current thread
+ *
+ * @details
+ *  - Linux: `set_mempolicy` with `MPOL_PREFERRED`. Memory is allocated on node, while it has free pages
+ *  - Windows: `SetThreadIdealProcessorEx` to the first CPU of node,
+ *    so scheduler and allocator prefer the node
+ *  - MacOS: there is only node 0, so there is nothing to do
+ *
+ * @note Preference doesn't restrict CPUs.
+ *       Use `pin(cpu::info().numa_nodes[i].cpus)` to keep thread on the node.
+ *
+ * @param node Id of node, as in cpu::info().numa_nodes
+ *
+ * @return true on success, false if there is no such node or OS refused it
+ */
+bool set_numa_preferred(unsigned node);
+
+} // namespace os::thread
\ No newline at end of file
@@ -82,10 +82,10 @@ struct version
     /// Check if version is less
     constexpr bool operator< (const version &rhs) const noexcept
     {
-        if (major < rhs.major) { return true; }
-        if (minor < rhs.minor) { return true; }
-        if (patch < rhs.patch) { return true; }
-        return false;
+        // Minor and patch matter only if higher fields are equal
+        if (major != rhs.major) { return major < rhs.major; }
+        if (minor != rhs.minor) { return minor < rhs.minor; }
+        return patch < rhs.patch;
     }
     /// Check if version is less or equal
     constexpr bool operator<=(const version &rhs) const noexcept
@@ -0,0 +1,93 @@
+#include "os/clock.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <utility>
+
+#include <time.h>
+
+#include "os/kernel.hpp"
+
+namespace os::detail
+{
+
+#if defined(__x86_64__) || defined(__i386__)
+// Read ticks and raw time as close together as possible
+std::pair<std::uint64_t, clock::raw::time_point> sample_clock() noexcept
+{
+    std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+    std::pair<std::uint64_t, clock::raw::time_point> sample;
+    for (int i = 0; i < 8; ++i)
+    {
+        const std::uint64_t before = clock::ticks();
+        const auto now = clock::raw::now();
+        const std::uint64_t after = clock::ticks();
+        if (after - before < best)
+        {
+            best = after - before;
+            sample = { before + best / 2, now };
+        }
+    }
+    return sample;
+}
+#endif
+
+// Find relation between ticks and raw clock
+clock::calibration_t calibrate_clock() noexcept
+{
+    clock::calibration_t c;
+    if (!kernel::features().has(kernel::feature::invariant_tsc)) { return c; }
+
+#if defined(__x86_64__) || defined(__i386__)
+    const auto start = sample_clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const auto end = sample_clock();
+    if (end.first <= start.first) { return c; }
+
+    c.ns_per_tick = static_cast<double>((end.second - start.second).count()) /
+                    static_cast<double>(end.first - start.first);
+    c.base_ticks = end.first;
+    c.base_time = end.second;
+    c.tsc = true;
+#elif defined(__aarch64__)
+    std::uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    if (frequency == 0) { return c; }
+
+    c.ns_per_tick = 1e9 / static_cast<double>(frequency);
+    c.base_ticks = clock::ticks();
+    c.base_time = clock::raw::now();
+    c.tsc = true;
+#endif
+
+    return c;
+}
+
+} // namespace os::detail
+
+namespace os::clock
+{
+
+// Get current time of raw monotonic clock
+raw::time_point raw::now() noexcept
+{
+    timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return time_point(duration(static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec));
+}
+
+// Get relation between ticks and raw clock
+const calibration_t & calibration() noexcept
+{
+    // Init calibration only once.
+    static const calibration_t c = detail::calibrate_clock();
+    return c;
+}
+
+} // namespace os::clock
\ No newline at end of file
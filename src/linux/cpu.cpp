@@ -0,0 +1,196 @@
+#include "os/cpu.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <dirent.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Read first line of sysfs file ("" on error)
+std::string read_sysfs_line(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// Parse unsigned number at the start of text
+unsigned parse_sysfs_number(std::string_view &text)
+{
+    unsigned value = 0;
+    while (!text.empty() && '0' <= text.front() && text.front() <= '9')
+    {
+        value = value * 10 + static_cast<unsigned>(text.front() - '0');
+        text.remove_prefix(1);
+    }
+    return value;
+}
+
+// Parse list of CPUs in sysfs format (e.g. "0-3,8,10-11")
+cpu::cpu_set parse_cpu_list(std::string_view text)
+{
+    cpu::cpu_set cpus;
+    while (!text.empty() && '0' <= text.front() && text.front() <= '9')
+    {
+        const unsigned first = parse_sysfs_number(text);
+        unsigned last = first;
+        if (!text.empty() && text.front() == '-')
+        {
+            text.remove_prefix(1);
+            last = parse_sysfs_number(text);
+        }
+        for (unsigned c = first; c <= last; ++c) { cpus.push_back(c); }
+
+        if (text.empty() || text.front() != ',') { break; }
+        text.remove_prefix(1);
+    }
+    return cpus;
+}
+
+// Parse size of cache in sysfs format (e.g. "32K")
+std::size_t parse_cache_size(std::string_view text)
+{
+    std::size_t size = parse_sysfs_number(text);
+    if (!text.empty())
+    {
+        switch (text.front())
+        {
+        case 'K': size <<= 10; break;
+        case 'M': size <<= 20; break;
+        case 'G': size <<= 30; break;
+        }
+    }
+    return size;
+}
+
+// Read CPU topology
+cpu::info_t read_cpu_info()
+{
+    cpu::info_t i;
+
+    const std::string root = "/sys/devices/system/cpu/";
+
+    cpu::cpu_set online = parse_cpu_list(read_sysfs_line(root + "online"));
+    if (online.empty())
+    {
+        const long count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long c = 0; c < count; ++c) { online.push_back(static_cast<unsigned>(c)); }
+    }
+    i.logical_cores = static_cast<unsigned>(online.size());
+
+    std::vector<unsigned> packages;
+    for (unsigned c : online)
+    {
+        const std::string topology = root + "cpu" + std::to_string(c) + "/topology/";
+
+        cpu::cpu_set siblings = parse_cpu_list(read_sysfs_line(topology + "thread_siblings_list"));
+        if (siblings.empty()) { siblings.push_back(c); }
+        if (std::find(i.siblings.begin(), i.siblings.end(), siblings) == i.siblings.end())
+        {
+            i.siblings.push_back(std::move(siblings));
+        }
+
+        const std::string package = read_sysfs_line(topology + "physical_package_id");
+        std::string_view digits = package;
+        const unsigned id = parse_sysfs_number(digits);
+        if (std::find(packages.begin(), packages.end(), id) == packages.end()) { packages.push_back(id); }
+    }
+    i.physical_cores = static_cast<unsigned>(i.siblings.size());
+    i.packages = static_cast<unsigned>(packages.size());
+
+    // Caches of the first online CPU
+    if (!online.empty())
+    {
+        const std::string caches = root + "cpu" + std::to_string(online.front()) + "/cache/index";
+        for (unsigned index = 0; ; ++index)
+        {
+            const std::string cache = caches + std::to_string(index) + "/";
+            const std::string level = read_sysfs_line(cache + "level");
+            if (level.empty()) { break; }
+
+            const std::string type = read_sysfs_line(cache + "type");
+
+            cpu::cache_t *target = nullptr;
+            if (level == "1" && type == "Data") { target = &i.l1d; }
+            else if (level == "1" && type == "Instruction") { target = &i.l1i; }
+            else if (level == "2") { target = &i.l2; }
+            else if (level == "3") { target = &i.l3; }
+            if (!target) { continue; }
+
+            target->size = parse_cache_size(read_sysfs_line(cache + "size"));
+            const std::string line_size = read_sysfs_line(cache + "coherency_line_size");
+            std::string_view digits = line_size;
+            target->line_size = parse_sysfs_number(digits);
+        }
+    }
+
+    if (i.l1d.line_size == 0)
+    {
+        const long line_size = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+        i.l1d.line_size = line_size > 0 ? static_cast<std::size_t>(line_size) : 0;
+    }
+
+    // NUMA nodes are directories "node<N>"
+    if (DIR *nodes = opendir("/sys/devices/system/node"))
+    {
+        while (const dirent *entry = readdir(nodes))
+        {
+            std::string_view name = entry->d_name;
+            if (name.substr(0, 4) != "node" || name.size() == 4) { continue; }
+            name.remove_prefix(4);
+
+            cpu::numa_node node;
+            node.id = parse_sysfs_number(name);
+            if (!name.empty()) { continue; }
+
+            node.cpus = parse_cpu_list(
+                read_sysfs_line("/sys/devices/system/node/" + std::string(entry->d_name) + "/cpulist")
+            );
+            i.numa_nodes.push_back(std::move(node));
+        }
+        closedir(nodes);
+
+        std::sort(
+            i.numa_nodes.begin(), i.numa_nodes.end(),
+            [](const cpu::numa_node &lhs, const cpu::numa_node &rhs) { return lhs.id < rhs.id; }
+        );
+    }
+    if (i.numa_nodes.empty()) { i.numa_nodes.push_back(cpu::numa_node{0, online}); }
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os::cpu
+{
+
+// Number of logical CPUs
+unsigned logical_cores() { return info().logical_cores; }
+
+// Number of physical cores
+unsigned physical_cores() { return info().physical_cores; }
+
+// Size of cache line
+std::size_t cache_line_size() { return info().l1d.line_size; }
+
+// Get CPU topology
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_cpu_info();
+    return i;
+}
+
+} // namespace os::cpu
\ No newline at end of file
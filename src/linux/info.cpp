@@ -5,90 +5,175 @@
     #error "This code is for Linux only!"
 #endif
 
-#include <fstream>
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <string_view>
 
+#include <fcntl.h>
 #include <sys/utsname.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Read file with a single read() into buffer. Returns number of bytes read
+std::size_t read_file(const char *path, char *buffer, std::size_t size)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { return 0; }
+
+    ssize_t count = 0;
+    while ((count = ::read(fd, buffer, size)) < 0 && errno == EINTR) {}
+    close(fd);
+
+    return count > 0 ? static_cast<std::size_t>(count) : 0;
+}
+
+// Decode shell-style value of os-release with quotes and backslash escapes
+void unquote(std::string_view raw, std::string &out)
+{
+    // Most values need no decoding
+    if (raw.find_first_of("\"'\\") == std::string_view::npos)
+    {
+        out.assign(raw);
+        return;
+    }
+
+    out.clear();
+    out.reserve(raw.size());
+
+    char quote = 0;
+    for (std::size_t k = 0; k < raw.size(); ++k)
+    {
+        const char c = raw[k];
+
+        // Everything is literal inside single quotes
+        if (quote == '\'')
+        {
+            if (c == '\'') { quote = 0; } else { out += c; }
+            continue;
+        }
+
+        if (c == '\\' && k + 1 < raw.size())
+        {
+            const char next = raw[k + 1];
+            // Inside double quotes backslash escapes only $ ` " and itself
+            if (quote == '"' && next != '$' && next != '`' && next != '"' && next != '\\')
+            {
+                out += c;
+                continue;
+            }
+            out += next;
+            ++k;
+            continue;
+        }
+
+        if (quote == '"')
+        {
+            if (c == '"') { quote = 0; } else { out += c; }
+        }
+        else if (c == '"' || c == '\'') { quote = c; }
+        else { out += c; }
+    }
+}
+
+// Parse os-release assignments, that are needed for info
+void parse_os_release(std::string_view text, os::info_t &i)
+{
+    std::string version_id;
+
+    while (!text.empty())
+    {
+        const std::size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+        // Skip indentation, trailing whitespace, empty lines and comments
+        const std::size_t first = line.find_first_not_of(" \t");
+        if (first == std::string_view::npos || line[first] == '#') { continue; }
+        line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+
+        const std::size_t eq = line.find('=');
+        if (eq == std::string_view::npos) { continue; }
+
+        const std::string_view key = line.substr(0, eq);
+        const std::string_view value = line.substr(eq + 1);
+
+        if (key == "NAME") { unquote(value, i.name); }
+        else if (key == "VERSION") { unquote(value, i.version_string); }
+        else if (key == "PRETTY_NAME") { unquote(value, i.pretty_name); }
+        else if (key == "VERSION_ID") { unquote(value, version_id); }
+        else if (key == "VERSION_CODENAME") { unquote(value, i.codename); }
+    }
+
+    i.version = ::version{version_id};
+
+    // Defaults of os-release specification
+    if (i.name.empty()) { i.name = "Linux"; }
+    if (i.pretty_name.empty()) { i.pretty_name = "Linux"; }
+}
+
+// Read OS info
+os::info_t read_info()
+{
+    os::info_t i;
+
+    i.type = type();
+
+    // os-release is small, so it fits into stack buffer and is read at once
+    char buffer[8192];
+    std::size_t size = read_file("/etc/os-release", buffer, sizeof(buffer));
+    if (size == 0) { size = read_file("/usr/lib/os-release", buffer, sizeof(buffer)); }
+
+    if (size > 0)
+    {
+        std::string_view text(buffer, size);
+        // Drop incomplete line of a file, that doesn't fit
+        if (size == sizeof(buffer)) { text = text.substr(0, text.rfind('\n') + 1); }
+
+        parse_os_release(text, i);
+    }
+    else
+    {
+        utsname utsname; uname(&utsname);
+        i.name = "Linux";
+        i.version = ::version{utsname.release};
+        i.version_string = utsname.release;
+
+        i.codename = "";
+        i.pretty_name = i.name + " " + i.version_string;
+    }
+
+    return i;
+}
+
+} // namespace os::detail
+
 namespace os
 {
 
 // Name of OS without version
-std::string name() { return info().name; }
+std::string_view name() { return info().name; }
 
 // Name of OS + version
-std::string pretty_name() { return info().pretty_name; }
+std::string_view pretty_name() { return info().pretty_name; }
 
 // Codename of OS (if present)
-std::string codename() { return info().codename; }
+std::string_view codename() { return info().codename; }
 
 // Major, minor and patch of OS
 ::version version() { return info().version; }
 
 // Version [+ some additional data]
-std::string version_string() { return info().version_string; }
+std::string_view version_string() { return info().version_string; }
 
 // Get whole OS info
 const info_t & info()
 {
-    static info_t i;
-
     // Reading from file is expensive.
     // Init info only once.
-    if (static bool init = true; init)
-    {
-        i.type = type();
-
-        std::ifstream os_release("/etc/os-release");
-        if (os_release)
-        {
-            std::string key, value;
-            auto get_entry = [&os_release, &key, &value]() -> bool
-            {
-                std::getline(os_release, key, '=');
-                std::getline(os_release, value, '\n');
-                return os_release.good();
-            };
-            while (get_entry())
-            {
-                if (key == "NAME")
-                {
-                    // Remove ""
-                    i.name = value.substr(1, value.size() - 2);
-                }
-                else if (key == "VERSION")
-                {
-                    // Remove ""
-                    i.version_string = value.substr(1, value.size() - 2);
-                }
-                else if (key == "PRETTY_NAME")
-                {
-                    // Remove ""
-                    i.pretty_name = value.substr(1, value.size() - 2);
-                }
-                else if (key == "VERSION_ID")
-                {
-                    // Remove ""
-                    i.version = ::version{value.substr(1, value.size() - 2)};
-                }
-                else if (key == "VERSION_CODENAME")
-                {
-                    i.codename = value;
-                }
-            }
-        }
-        else
-        {
-            utsname utsname; uname(&utsname);
-            i.name = "Linux";
-            i.version = ::version{utsname.release};
-            i.version_string = utsname.release;
-
-            i.codename = "";
-            i.pretty_name = i.name + " " + i.version_string;
-        }
-
-        init = false;
-    }
-
+    static const info_t i = detail::read_info();
     return i;
 }
 
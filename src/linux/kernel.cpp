@@ -5,36 +5,141 @@
     #error "This code is for Linux only!"
 #endif
 
+#include <cerrno>
+#include <ctime>
+#include <fstream>
+#include <string>
+
+#include <linux/memfd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <sys/utsname.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+    #include <linux/io_uring.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <cpuid.h>
+#endif
+
+namespace os::detail
+{
+
+// Read OS kernel info
+os::kernel::info_t read_kernel_info()
+{
+    os::kernel::info_t i;
+
+    utsname utsname; uname(&utsname);
+    i.name = os::kernel::name();
+    i.version = ::version{utsname.release};
+    i.version_string = utsname.release;
+
+    return i;
+}
+
+// Check if syscall returned file descriptor and close it
+bool returned_fd(long fd)
+{
+    if (fd < 0) { return false; }
+    close(static_cast<int>(fd));
+    return true;
+}
+
+// Probe OS kernel features with actual calls
+os::kernel::features_t probe_kernel_features()
+{
+    using os::kernel::feature;
+
+    os::kernel::features_t f;
+
+#if defined(SYS_io_uring_setup) && __has_include(<linux/io_uring.h>)
+    io_uring_params params = {};
+    if (returned_fd(syscall(SYS_io_uring_setup, 1, &params))) { f.add(feature::io_uring); }
+#endif
+
+    // Kernels, that know EPOLLEXCLUSIVE, refuse it in EPOLL_CTL_MOD.
+    // Older ones silently ignore it
+    const int epoll = epoll_create1(EPOLL_CLOEXEC);
+    const int event = eventfd(0, EFD_CLOEXEC);
+    if (epoll >= 0 && event >= 0)
+    {
+        epoll_event e = {};
+        e.events = EPOLLIN;
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, event, &e) == 0)
+        {
+            e.events = EPOLLIN | EPOLLEXCLUSIVE;
+            if (epoll_ctl(epoll, EPOLL_CTL_MOD, event, &e) != 0 && errno == EINVAL) { f.add(feature::epoll_exclusive); }
+        }
+    }
+    if (event >= 0) { close(event); }
+    if (epoll >= 0) { close(epoll); }
+
+#if defined(SYS_futex_waitv)
+    // Empty list of futexes is invalid, missing syscall gives ENOSYS
+    if (syscall(SYS_futex_waitv, nullptr, 0, 0, nullptr, CLOCK_MONOTONIC) != 0 && errno == EINVAL)
+    {
+        f.add(feature::futex_waitv);
+    }
+#endif
+
+#if defined(SYS_memfd_create)
+    if (returned_fd(syscall(SYS_memfd_create, "libos", MFD_CLOEXEC))) { f.add(feature::memfd_create); }
+#endif
+
+#if defined(SYS_pidfd_open)
+    if (returned_fd(syscall(SYS_pidfd_open, getpid(), 0))) { f.add(feature::pidfd_open); }
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+    // Virtual machines often hide CPUID bit, while kernel has checked TSC itself
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    const bool invariant = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+
+    std::ifstream clocksource("/sys/devices/system/clocksource/clocksource0/current_clocksource");
+    std::string source;
+    clocksource >> source;
+
+    if (invariant || source == "tsc") { f.add(feature::invariant_tsc); }
+#elif defined(__aarch64__)
+    // Generic timer has fixed frequency
+    f.add(feature::invariant_tsc);
+#endif
+
+    return f;
+}
+
+} // namespace os::detail
 
 namespace os::kernel
 {
 
 // Get name of OS kernel
-std::string name() { return "Linux"; }
+std::string_view name() { return "Linux"; }
 
 // Get major, minor and patch of OS kernel
 ::version version() { return info().version; }
 
 // Get version [+ additional data] of OS kernel
-std::string version_string() { return info().version_string; }
+std::string_view version_string() { return info().version_string; }
 
 // Get OS kernel info
 const info_t & info()
 {
-    static info_t i;
-
-    if (static bool init = true; init)
-    {
-        utsname utsname; uname(&utsname);
-        i.name = os::kernel::name();
-        i.version = ::version{utsname.release};
-        i.version_string = utsname.release;
-
-        init = false;
-    }
-
+    // Init info only once.
+    static const info_t i = detail::read_kernel_info();
     return i;
 }
 
+// Get available OS kernel features
+const features_t & features()
+{
+    // Init features only once.
+    static const features_t f = detail::probe_kernel_features();
+    return f;
+}
+
 } // namespace os::kernel
\ No newline at end of file
@@ -5,121 +5,1396 @@
     #error "This code is for Linux only!"
 #endif
 
-#include <X11/Xlib.h>
-#include <X11/keysym.h>
-#include <X11/extensions/XTest.h>
+#ifndef LIBOS_NO_X11
+    #include <X11/Xlib.h>
+    #include <X11/XKBlib.h>
+    #include <X11/Xutil.h>
+    #include <X11/keysym.h>
+    #include <X11/extensions/XTest.h>
+    #include <X11/extensions/record.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+// Number of X connections, shared by threads
+#ifndef LIBOS_X11_CONNECTIONS
+    #define LIBOS_X11_CONNECTIONS 8
+#endif
 
 namespace os::detail
 {
 
+// Raise priority of current thread for time-critical work (if possible)
+void raise_thread_priority() noexcept
+{
+    // Lowest real-time priority is still above any normal thread.
+    // Fails without CAP_SYS_NICE, then priority stays the same
+    sched_param param = {};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+// Sleep until deadline with the best precision available
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline) noexcept
+{
+    // steady_clock is CLOCK_MONOTONIC, so deadline may be used as is
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    if (ns <= 0) { return; }
+
+    timespec ts;
+    ts.tv_sec  = ns / 1'000'000'000;
+    ts.tv_nsec = ns % 1'000'000'000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+}
+
+#ifndef LIBOS_NO_X11
+// Get character, typed by keysym (0, if none)
+constexpr char32_t keysym_to_char32(KeySym sym) noexcept
+{
+    // Latin-1 keysyms are the same as code points
+    if ((sym >= 0x20 && sym <= 0x7E) || (sym >= 0xA0 && sym <= 0xFF)) { return static_cast<char32_t>(sym); }
+    // Directly encoded Unicode keysyms
+    if ((sym & 0xFF000000) == 0x01000000) { return static_cast<char32_t>(sym & 0x00FFFFFF); }
+
+    switch (sym)
+    {
+        case XK_Return:                 return U'\n';
+        case XK_Tab:                    return U'\t';
+        case XK_KP_Space:               return U' ';
+        // Cyrillic letters, missing in KOI8 order below
+        case XK_Cyrillic_io:            return 0x0451;
+        case XK_Cyrillic_IO:            return 0x0401;
+        case XK_Ukrainian_ghe_with_upturn: return 0x0491;
+        case XK_Ukrainian_GHE_WITH_UPTURN: return 0x0490;
+        case XK_numerosign:             return 0x2116;
+        // Greek sigma and final sigma are swapped relative to Unicode
+        case XK_Greek_SIGMA:            return 0x03A3;
+        case XK_Greek_sigma:            return 0x03C3;
+        case XK_Greek_finalsmallsigma:  return 0x03C2;
+        default: break;
+    }
+
+    // Serbian, Macedonian, Ukrainian and Belarusian letters
+    if (sym >= 0x6A1 && sym <= 0x6AF) { return static_cast<char32_t>((sym <= 0x6A2 ? 0x0451 : 0x0450) + (sym - 0x6A0)); }
+    if (sym >= 0x6B1 && sym <= 0x6BF) { return static_cast<char32_t>((sym <= 0x6B2 ? 0x0401 : 0x0400) + (sym - 0x6B0)); }
+    // Russian letters in KOI8 order
+    if (sym >= 0x6C0 && sym <= 0x6FF)
+    {
+        constexpr char16_t koi8[] = u"юабцдефгхийклмнопярстужвьызшэщчъ";
+        const char32_t lower = koi8[(sym - 0x6C0) % 32];
+        return sym < 0x6E0 ? lower : lower - 0x20;
+    }
+    // Greek letters
+    if (sym >= 0x7C1 && sym <= 0x7D9) { return static_cast<char32_t>(0x0391 + (sym - 0x7C1)); }
+    if (sym >= 0x7E1 && sym <= 0x7F9) { return static_cast<char32_t>(0x03B1 + (sym - 0x7E1)); }
+    return 0;
+}
+#endif
+
+// Get evdev key code of keysym on US keyboard (0, if none)
+constexpr std::uint16_t evdev_code(unsigned sym) noexcept
+{
+    constexpr std::uint16_t letters[] =
+    {
+        KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I,
+        KEY_J, KEY_K, KEY_L, KEY_M, KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R,
+        KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+    };
+    constexpr std::uint16_t keypad[] =
+    {
+        KEY_KP0, KEY_KP1, KEY_KP2, KEY_KP3, KEY_KP4,
+        KEY_KP5, KEY_KP6, KEY_KP7, KEY_KP8, KEY_KP9
+    };
+
+    if (sym >= 'A' && sym <= 'Z') { return letters[sym - 'A']; }
+    if (sym >= 'a' && sym <= 'z') { return letters[sym - 'a']; }
+    if (sym >= '1' && sym <= '9') { return static_cast<std::uint16_t>(KEY_1 + (sym - '1')); }
+    if (sym >= 0xFFB0 && sym <= 0xFFB9) { return keypad[sym - 0xFFB0]; }
+    // F1-F10 are consecutive
+    if (sym >= 0xFFBE && sym <= 0xFFC7) { return static_cast<std::uint16_t>(KEY_F1 + (sym - 0xFFBE)); }
+
+    switch (sym)
+    {
+        case '0':    return KEY_0;
+        case ' ':    return KEY_SPACE;
+        case '-':    return KEY_MINUS;
+        case '=':    return KEY_EQUAL;
+        case '[':    return KEY_LEFTBRACE;
+        case ']':    return KEY_RIGHTBRACE;
+        case '\\':   return KEY_BACKSLASH;
+        case ';':    return KEY_SEMICOLON;
+        case '\'':   return KEY_APOSTROPHE;
+        case '`':    return KEY_GRAVE;
+        case ',':    return KEY_COMMA;
+        case '.':    return KEY_DOT;
+        case '/':    return KEY_SLASH;
+
+        case 0xFF08: return KEY_BACKSPACE;
+        case 0xFF09: return KEY_TAB;
+        case 0xFF0D: return KEY_ENTER;
+        case 0xFF13: return KEY_PAUSE;
+        case 0xFF14: return KEY_SCROLLLOCK;
+        case 0xFF1B: return KEY_ESC;
+        case 0xFF50: return KEY_HOME;
+        case 0xFF51: return KEY_LEFT;
+        case 0xFF52: return KEY_UP;
+        case 0xFF53: return KEY_RIGHT;
+        case 0xFF54: return KEY_DOWN;
+        case 0xFF55: return KEY_PAGEUP;
+        case 0xFF56: return KEY_PAGEDOWN;
+        case 0xFF57: return KEY_END;
+        case 0xFF61: return KEY_SYSRQ;
+        case 0xFF63: return KEY_INSERT;
+        case 0xFF67: return KEY_COMPOSE;
+        case 0xFF7F: return KEY_NUMLOCK;
+        case 0xFF8D: return KEY_KPENTER;
+        case 0xFFAA: return KEY_KPASTERISK;
+        case 0xFFAB: return KEY_KPPLUS;
+        case 0xFFAD: return KEY_KPMINUS;
+        case 0xFFAE: return KEY_KPDOT;
+        case 0xFFAF: return KEY_KPSLASH;
+        case 0xFFC8: return KEY_F11;
+        case 0xFFC9: return KEY_F12;
+        case 0xFFE1: return KEY_LEFTSHIFT;
+        case 0xFFE2: return KEY_RIGHTSHIFT;
+        case 0xFFE3: return KEY_LEFTCTRL;
+        case 0xFFE4: return KEY_RIGHTCTRL;
+        case 0xFFE5: return KEY_CAPSLOCK;
+        case 0xFFE9: return KEY_LEFTALT;
+        case 0xFFEA: return KEY_RIGHTALT;
+        case 0xFFEB: return KEY_LEFTMETA;
+        case 0xFFEC: return KEY_RIGHTMETA;
+        case 0xFFFF: return KEY_DELETE;
+        default:     return 0;
+    }
+}
+
+// Get unshifted character of US keyboard, that types c with Shift (0, if none)
+constexpr char32_t us_unshifted(char32_t c) noexcept
+{
+    constexpr char pairs[][2] =
+    {
+        { '!', '1' }, { '@', '2' }, { '#', '3' }, { '$', '4' }, { '%', '5' },
+        { '^', '6' }, { '&', '7' }, { '*', '8' }, { '(', '9' }, { ')', '0' },
+        { '_', '-' }, { '+', '=' }, { '{', '[' }, { '}', ']' }, { '|', '\\' },
+        { ':', ';' }, { '"', '\'' }, { '~', '`' }, { '<', ',' }, { '>', '.' },
+        { '?', '/' }
+    };
+
+    if (c >= 'A' && c <= 'Z') { return c; }
+    for (const auto &pair : pairs)
+    {
+        if (c == static_cast<char32_t>(pair[0])) { return static_cast<char32_t>(pair[1]); }
+    }
+    return 0;
+}
+
+// Builds layout tables
+class layout_builder
+{
+public:
+    // Build tables of US keyboard for evdev key codes.
+    // Modifier 1 is Shift, like ShiftMask of X
+    static std::shared_ptr<keyboard::layout> build_evdev()
+    {
+        auto result = make();
+
+        for (std::size_t i = 0; i < key_index_count; ++i)
+        {
+            const keyboard::vk key = key_at(i);
+            const std::uint16_t code = evdev_code(static_cast<unsigned>(key));
+            if (code == 0) { continue; }
+
+            result->codes[i] = code;
+            // Uppercase letters come first, like keysyms from X
+            if (code < std::size(result->keys) && result->keys[code] == keyboard::vk{})
+            {
+                result->keys[code] = key;
+            }
+        }
+
+        result->modifier_keys[0] = KEY_LEFTSHIFT;
+
+        result->chars.insert(U'\n', KEY_ENTER, 0);
+        result->chars.insert(U'\t', KEY_TAB, 0);
+        for (char32_t c = 0x20; c < 0x7F; ++c)
+        {
+            if (const char32_t base = us_unshifted(c))
+            {
+                result->chars.insert(c, evdev_code(base), 1);
+            }
+            else if (const std::uint16_t code = evdev_code(c))
+            {
+                result->chars.insert(c, code, 0);
+            }
+        }
+        return result;
+    }
+
+#ifndef LIBOS_NO_X11
+    // Build tables with a few requests to X server
+    static std::shared_ptr<keyboard::layout> build(Display *display)
+    {
+        auto result = make();
+        if (!display) { return result; }
+
+        load_keys(display, *result);
+        load_chars(display, *result);
+        return result;
+    }
+#endif
+
+private:
+    // Create empty layout with next generation number
+    static std::shared_ptr<keyboard::layout> make()
+    {
+        static std::atomic<std::uint64_t> loaded { 0 };
+
+        auto result = std::make_shared<keyboard::layout>();
+        result->number = loaded++;
+        return result;
+    }
+
+#ifndef LIBOS_NO_X11
+    // Build keysym -> keycode and keycode -> keysym tables
+    // with a single request to X server
+    static void load_keys(Display *display, keyboard::layout &result)
+    {
+        int min_keycode = 0, max_keycode = 0;
+        XDisplayKeycodes(display, &min_keycode, &max_keycode);
+
+        int per_keycode = 0;
+        KeySym *mapping = XGetKeyboardMapping(
+            display,
+            min_keycode,
+            max_keycode - min_keycode + 1,
+            &per_keycode
+        );
+        if (!mapping) { return; }
+
+        auto at = [&](int code, int column) -> KeySym
+        {
+            KeySym sym = mapping[(code - min_keycode) * per_keycode + column];
+            // Lowercase-only entry means the same key for uppercase
+            if (sym == NoSymbol && column == 1 && per_keycode > 1)
+            {
+                KeySym lower, upper;
+                XConvertCase(mapping[(code - min_keycode) * per_keycode], &lower, &upper);
+                sym = upper;
+            }
+            return sym;
+        };
+
+        // Same order as XKeysymToKeycode: lower columns first, then lower keycodes
+        for (int column = 0; column < per_keycode; ++column)
+        {
+            for (int code = min_keycode; code <= max_keycode; ++code)
+            {
+                const std::size_t i = key_index(static_cast<keyboard::vk>(at(code, column)));
+                if (i != no_key_index && result.codes[i] == 0)
+                {
+                    result.codes[i] = static_cast<KeyCode>(code);
+                }
+            }
+        }
+
+        for (int code = min_keycode; code <= max_keycode; ++code)
+        {
+            // Our letters are uppercase keysyms
+            KeySym lower, upper;
+            XConvertCase(at(code, 0), &lower, &upper);
+            result.keys[code] = static_cast<keyboard::vk>(upper);
+        }
+
+        XFree(mapping);
+    }
+
+    // Get modifiers, that select level of key type (nullopt if none)
+    static std::optional<unsigned> level_modifiers(const XkbKeyTypeRec &type, int level)
+    {
+        if (level == 0) { return 0u; }
+
+        std::optional<unsigned> modifiers;
+        for (int i = 0; i < type.map_count; ++i)
+        {
+            const XkbKTMapEntryRec &entry = type.map[i];
+            if (!entry.active || entry.level != level) { continue; }
+            // Prefer entries without Caps Lock
+            if (!(entry.mods.mask & LockMask)) { return entry.mods.mask; }
+            if (!modifiers) { modifiers = entry.mods.mask; }
+        }
+        return modifiers;
+    }
+
+    // Build character -> (keycode, modifiers) table for active group
+    // of XKB keyboard map
+    static void load_chars(Display *display, keyboard::layout &result)
+    {
+        XkbDescPtr xkb = XkbGetMap(
+            display,
+            XkbKeyTypesMask | XkbKeySymsMask | XkbModifierMapMask,
+            XkbUseCoreKbd
+        );
+        if (!xkb) { return; }
+
+        XkbStateRec state;
+        const unsigned group = XkbGetState(display, XkbUseCoreKbd, &state) == Success ? state.group : 0;
+
+        // First key of every real modifier
+        int max_levels = 0;
+        for (int code = xkb->min_key_code; code <= xkb->max_key_code; ++code)
+        {
+            for (unsigned index = 0; index < 8; ++index)
+            {
+                if ((xkb->map->modmap[code] & (1u << index)) && result.modifier_keys[index] == 0)
+                {
+                    result.modifier_keys[index] = static_cast<KeyCode>(code);
+                }
+            }
+            max_levels = std::max(max_levels, static_cast<int>(XkbKeyGroupsWidth(xkb, code)));
+        }
+
+        // Lower levels first, then lower keycodes
+        for (int level = 0; level < max_levels; ++level)
+        {
+            for (int code = xkb->min_key_code; code <= xkb->max_key_code; ++code)
+            {
+                const int groups = XkbKeyNumGroups(xkb, code);
+                if (groups == 0) { continue; }
+
+                const unsigned g = group % groups;
+                const XkbKeyTypeRec &type = *XkbKeyKeyType(xkb, code, g);
+                if (level >= type.num_levels) { continue; }
+
+                const auto modifiers = level_modifiers(type, level);
+                if (!modifiers) { continue; }
+
+                // Every modifier must have a key to hold
+                bool holdable = true;
+                for (unsigned index = 0; index < 8; ++index)
+                {
+                    holdable = holdable && (!(*modifiers & (1u << index)) || result.modifier_keys[index] != 0);
+                }
+                if (!holdable) { continue; }
+
+                const char32_t c = keysym_to_char32(XkbKeySymEntry(xkb, code, level, g));
+                if (c != 0) { result.chars.insert(c, static_cast<std::uint16_t>(code), *modifiers); }
+            }
+        }
+
+        XkbFreeKeyboard(xkb, 0, True);
+    }
+#endif
+};
+
+// Type text with layout, passing key codes of presses and releases to emit
+template <typename Emit>
+void type_codes(const keyboard::layout &layout, std::u32string_view text, Emit &&emit)
+{
+    // Press and release modifiers only when they change between characters
+    unsigned held = 0;
+    auto hold = [&](unsigned modifiers)
+    {
+        for (unsigned index = 0; index < 8; ++index)
+        {
+            const unsigned mask = 1u << index;
+            if ((held ^ modifiers) & mask)
+            {
+                emit(layout.modifier_key(index), (modifiers & mask) != 0);
+            }
+        }
+        held = modifiers;
+    };
+
+    for (char32_t c : text)
+    {
+        const auto *key = layout.find(c == U'\r' ? U'\n' : c);
+        if (!key) { continue; }
+
+        hold(key->modifiers);
+        emit(key->code, true);
+        emit(key->code, false);
+    }
+    hold(0);
+}
+
+#ifndef LIBOS_NO_X11
+class display_handler;
+
+// Exclusive access to display connection, that is bound to current thread
+class display_lock
+{
+public:
+    display_lock(std::unique_lock<std::mutex> lock, display_handler &handler)
+        : lock(std::move(lock)), handler(handler) {}
+
+    display_handler * operator->() const { return &handler; }
+    display_handler & operator*() const { return handler; }
+
+private:
+    std::unique_lock<std::mutex> lock;
+    display_handler             &handler;
+};
+
 // RAII wrapper for X Server's Display
 class display_handler
 {
 public:
-    static display_handler & get()
+    // Get connection of current thread.
+    //
+    // Xlib connections are not thread-safe without XInitThreads,
+    // so threads are bound round-robin to a small pool of connections,
+    // each guarded by its own mutex. Threads share a connection only
+    // when there are more of them, than connections.
+    static display_lock get()
+    {
+        thread_local slot &bound = pool()[next().fetch_add(1, std::memory_order_relaxed) % LIBOS_X11_CONNECTIONS];
+        return bound.open();
+    }
+
+    // Open connection, that the next thread will be bound to, and load its layout.
+    // Other connections are opened only by threads, that use them
+    static void warm_next()
     {
-        static display_handler handler { XOpenDisplay(nullptr) };
-        return handler;
+        pool()[next().load(std::memory_order_relaxed) % LIBOS_X11_CONNECTIONS].open();
     }
 
     Display * native() const { return display; }
 
+    // Get tables of current layout
+    const keyboard::layout & mapping() const { return *loaded; }
+
+    // Get tables of current layout, that stay alive after layout change
+    std::shared_ptr<const keyboard::layout> shared_mapping() const { return loaded; }
+
+    // Get keycode of virtual key
+    KeyCode keycode(keyboard::vk key) const
+    {
+        // Not in table. Fallback to linear search in Xlib
+        if (key_index(key) == no_key_index)
+        {
+            return XKeysymToKeycode(display, static_cast<KeySym>(key));
+        }
+        return static_cast<KeyCode>(loaded->code_of(key));
+    }
+
+    // Get virtual key of keycode (NoSymbol if none)
+    KeySym keysym(KeyCode code) const { return static_cast<KeySym>(loaded->key_of(code)); }
+
+    // Get combination of keys, pressed in keymap from XQueryKeymap
+    keyboard::combination keys_of(const char (&keymap)[32]) const
+    {
+        keyboard::combination combo;
+        for (std::size_t w = 0; w < 4; ++w)
+        {
+            std::uint64_t word = 0;
+            for (std::size_t b = 0; b < 8; ++b)
+            {
+                word |= std::uint64_t{static_cast<unsigned char>(keymap[8*w + b])} << (8*b);
+            }
+
+            // Visit only pressed keys
+            for (; word != 0; word &= word - 1)
+            {
+                KeySym sym = keysym(static_cast<KeyCode>(64*w + countr_zero(word)));
+                if (sym != NoSymbol) { combo.insert(static_cast<keyboard::vk>(sym)); }
+            }
+        }
+        return combo;
+    }
+
+    // Reload layout, if keyboard mapping or XKB group has changed.
+    //
+    // Doesn't make any requests to X server:
+    // notifications are delivered to every client, that selected them,
+    // and read along with replies to other requests or from the socket,
+    // if it has data.
+    void update_mapping()
+    {
+        if (!display) { return; }
+
+        bool changed = false;
+        while (XEventsQueued(display, QueuedAfterReading) > 0)
+        {
+            XEvent event;
+            XNextEvent(display, &event);
+            if (event.type == MappingNotify)
+            {
+                XRefreshKeyboardMapping(&event.xmapping);
+                changed = changed || event.xmapping.request == MappingKeyboard;
+            }
+            else if (xkb_event != 0 && event.type == xkb_event)
+            {
+                const auto &xkb = reinterpret_cast<const XkbEvent &>(event);
+                changed = changed
+                    || xkb.any.xkb_type == XkbNewKeyboardNotify
+                    || xkb.any.xkb_type == XkbMapNotify
+                    || (xkb.any.xkb_type == XkbStateNotify && (xkb.state.changed & XkbGroupStateMask));
+            }
+        }
+        if (changed) { loaded = layout_builder::build(display); }
+    }
+
     display_handler(const display_handler &) = delete;
     display_handler(display_handler &&) = delete;
     void operator=(const display_handler &) = delete;
     void operator=(display_handler &&) = delete;
 
-    ~display_handler() { XCloseDisplay(display); }
+    ~display_handler() { if (display) { XCloseDisplay(display); } }
 
 private:
-    display_handler(Display *display) : display(display) {}
+    // Owns connection, that tracks layout of its events
+    friend class xrecord_listener;
+
+    // Connection of the pool, guarded by its own mutex
+    struct slot
+    {
+        std::mutex                       mutex;
+        std::unique_ptr<display_handler> handler;
+
+        // Lock connection. It's opened on first use
+        display_lock open()
+        {
+            std::unique_lock lock(mutex);
+            if (!handler) { handler.reset(new display_handler(XOpenDisplay(nullptr))); }
+            return display_lock(std::move(lock), *handler);
+        }
+    };
+
+    // Index of slot for the next thread to bind to
+    static std::atomic<unsigned> & next()
+    {
+        static std::atomic<unsigned> index { 0 };
+        return index;
+    }
+
+    static slot (&pool())[LIBOS_X11_CONNECTIONS]
+    {
+        static slot slots[LIBOS_X11_CONNECTIONS];
+        return slots;
+    }
+
+    display_handler(Display *display) : display(display)
+    {
+        select_layout_events();
+        loaded = layout_builder::build(display);
+    }
+
+    // Ask X server to notify about keyboard and layout group changes
+    void select_layout_events()
+    {
+        int opcode = 0, error = 0;
+        int major = XkbMajorVersion, minor = XkbMinorVersion;
+        if (!display || !XkbQueryExtension(display, &opcode, &xkb_event, &error, &major, &minor))
+        {
+            xkb_event = 0;
+            return;
+        }
+
+        XkbSelectEvents(
+            display, XkbUseCoreKbd,
+            XkbNewKeyboardNotifyMask | XkbMapNotifyMask,
+            XkbNewKeyboardNotifyMask | XkbMapNotifyMask
+        );
+        XkbSelectEventDetails(
+            display, XkbUseCoreKbd, XkbStateNotify,
+            XkbGroupStateMask, XkbGroupStateMask
+        );
+    }
 
     Display *display = nullptr;
+    // Type of XKB events (0 if extension is missing)
+    int      xkb_event = 0;
+
+    std::shared_ptr<const keyboard::layout> loaded;
 };
 
-} // namespace os::detail
+// Listener, based on XRecord extension
+class xrecord_listener : public keyboard::listener::source
+{
+public:
+    xrecord_listener(keyboard::listener &owner) : source(owner)
+    {
+        // Control connection tracks layout of the listener, so events don't lock pool
+        control = XOpenDisplay(nullptr);
+        if (!control) { return; }
+        layout.reset(new display_handler(control));
 
-namespace os::keyboard
+        data = XOpenDisplay(nullptr);
+        if (!data) { return; }
+
+        int major = 0, minor = 0;
+        if (!XRecordQueryVersion(control, &major, &minor)) { return; }
+
+        XRecordRange *range = XRecordAllocRange();
+        if (!range) { return; }
+        range->device_events.first = KeyPress;
+        range->device_events.last  = KeyRelease;
+
+        XRecordClientSpec clients = XRecordAllClients;
+        context = XRecordCreateContext(control, 0, &clients, 1, &range, 1);
+        XFree(range);
+        if (!context) { return; }
+
+        // Context must exist on server before data connection uses it
+        XSync(control, False);
+
+        thread = std::thread(
+            [this] { XRecordEnableContext(data, context, &xrecord_listener::intercept, reinterpret_cast<XPointer>(this)); }
+        );
+    }
+
+    bool active() const noexcept override { return thread.joinable(); }
+
+    ~xrecord_listener() override
+    {
+        if (thread.joinable())
+        {
+            {
+                std::lock_guard lock(control_mutex);
+                XRecordDisableContext(control, context);
+                XSync(control, False);
+            }
+            thread.join();
+        }
+        if (context) { XRecordFreeContext(control, context); }
+        if (data) { XCloseDisplay(data); }
+        // Closes control connection
+        layout.reset();
+    }
+
+private:
+    static void intercept(XPointer closure, XRecordInterceptData *recorded)
+    {
+        auto *self = reinterpret_cast<xrecord_listener *>(closure);
+
+        if (recorded->category == XRecordFromServer && recorded->data_len > 0)
+        {
+            // Raw xEvent: type, then keycode
+            const int     type = recorded->data[0] & 0x7F;
+            const KeyCode code = recorded->data[1];
+            const KeySym  sym  = self->keysym(code);
+            if ((type == KeyPress || type == KeyRelease) && sym != NoSymbol)
+            {
+                keyboard::listener::event e;
+                e.key = static_cast<keyboard::vk>(sym);
+                e.is_down = type == KeyPress;
+                e.time = std::chrono::steady_clock::now();
+                self->deliver(e);
+            }
+        }
+
+        XRecordFreeData(recorded);
+    }
+
+    // Translate keycode with layout, reloaded if it has changed
+    KeySym keysym(KeyCode code)
+    {
+        std::lock_guard lock(control_mutex);
+        layout->update_mapping();
+        return layout->keysym(code);
+    }
+
+    Display                         *control = nullptr;
+    Display                         *data    = nullptr;
+    XRecordContext                   context = 0;
+    std::unique_ptr<display_handler> layout;
+    // Guards control connection, used by listener's thread and destructor
+    std::mutex                       control_mutex;
+    std::thread                      thread;
+};
+
+// Read state of keys from X server
+void query_keymap(Display *display, char keys[32])
 {
+    stats_timer timer(keyboard::operation::query_keymap);
+    XQueryKeymap(display, keys);
+}
 
-// Check if every key in combination is pressed
-bool is_pressed(const combination &combo)
+// Buffer fake key event of XTest
+void fake_key_event(Display *display, KeyCode code, bool is_down)
 {
-    auto &&h = os::detail::display_handler::get();
+    stats_timer timer(keyboard::operation::fake_key_event);
+    XTestFakeKeyEvent(display, code, is_down, 0);
+}
 
-    char keys_return[32];
-    XQueryKeymap(h.native(), keys_return);
+// Send buffered requests to X server
+void flush(Display *display)
+{
+    stats_timer timer(keyboard::operation::flush);
+    XFlush(display);
+}
 
-    for (const auto &key : combo.keys)
+// Buffer fake click of X button (wheel is buttons 4-7)
+void fake_button_click(Display *display, unsigned button, int clicks)
+{
+    for (int i = 0; i < clicks; ++i)
     {
-        KeyCode kc = XKeysymToKeycode(h.native(), static_cast<KeySym>(key));
-        // Key not pressed
-        if (!(keys_return[kc / 8] & (1 << (kc % 8)))) { return false; }
+        XTestFakeButtonEvent(display, button, True, 0);
+        XTestFakeButtonEvent(display, button, False, 0);
     }
+}
 
-    return true;
+// Get X button of mouse button
+constexpr unsigned x11_button(mouse::button b)
+{
+    constexpr unsigned buttons[mouse::button_count] = { Button1, Button3, Button2, 8, 9 };
+    return buttons[static_cast<std::size_t>(b)];
 }
 
-// Get combination of all pressed keys on a keyboard
-combination pressed_keys()
+// Keyboard and mouse functions, implemented with XTest
+class x11_backend : public keyboard::backend
 {
-    combination combo;
+public:
+    bool is_pressed(const keyboard::combination &combo) override
+    {
+        auto h = display_handler::get();
+
+        char keys_return[32];
+        query_keymap(h->native(), keys_return);
+        h->update_mapping();
+
+        for (const auto &key : combo)
+        {
+            KeyCode kc = h->keycode(key);
+            // Key not pressed
+            if (!(keys_return[kc / 8] & (1 << (kc % 8)))) { return false; }
+        }
+
+        return true;
+    }
+
+    keyboard::combination pressed_keys() override
+    {
+        auto h = display_handler::get();
+
+        char keys_return[32];
+        query_keymap(h->native(), keys_return);
+        h->update_mapping();
+
+        // Keycodes are translated to keysyms, so result is comparable with vk
+        return h->keys_of(keys_return);
+    }
+
+    void send(const keyboard::combination &combo, bool is_down) override
+    {
+        auto h = display_handler::get();
+        h->update_mapping();
+
+        // Our vk values same as KeySym for linux
+        for (const auto &key : combo) { fake_key_event(h->native(), h->keycode(key), is_down); }
+        flush(h->native());
+    }
+
+    void send(span<const keyboard::key_event> events) override
+    {
+        auto h = display_handler::get();
+        h->update_mapping();
+
+        // Requests are buffered by Xlib until flush
+        for (const auto &event : events) { fake_key_event(h->native(), h->keycode(event.key), event.is_down); }
+        flush(h->native());
+    }
+
+    void type(std::u32string_view text) override
+    {
+        auto h = display_handler::get();
+        h->update_mapping();
+
+        Display *display = h->native();
+        if (!display) { return; }
+
+        // Requests are buffered by Xlib until flush
+        type_codes(h->mapping(), text, [display](std::uint16_t code, bool is_down)
+        {
+            fake_key_event(display, code, is_down);
+        });
+        flush(display);
+    }
+
+    std::shared_ptr<const keyboard::layout> current_layout() override
+    {
+        auto h = display_handler::get();
+        h->update_mapping();
+        return h->shared_mapping();
+    }
+
+    void warm_up() override { display_handler::warm_next(); }
+
+    std::unique_ptr<keyboard::listener::source> listen(keyboard::listener &owner) override
+    {
+        return std::make_unique<xrecord_listener>(owner);
+    }
 
-    auto &&h = os::detail::display_handler::get();
+    mouse::point mouse_position() override
+    {
+        auto h = display_handler::get();
+        Display *display = h->native();
+        if (!display) { return {}; }
 
-    char keys_return[32];
-    XQueryKeymap(h.native(), keys_return);
+        Window root, child;
+        int root_x = 0, root_y = 0, x = 0, y = 0;
+        unsigned mask = 0;
+        XQueryPointer(display, DefaultRootWindow(display), &root, &child, &root_x, &root_y, &x, &y, &mask);
+        return mouse::point{root_x, root_y};
+    }
 
-    /* Check all 256 virtual keys */
-    for (size_t m = 0; m < 32; ++m)
+    void send_mouse(span<const mouse::event> events) override
     {
-        // Check every bit
-        for (size_t n = 0; n < 8; ++n)
+        auto h = display_handler::get();
+        Display *display = h->native();
+        if (!display) { return; }
+
+        // Requests are buffered by Xlib until flush
+        for (const auto &event : events)
         {
-            // Key is pressed
-            if (keys_return[m] & (1 << n)) { combo += static_cast<vk>(8*m + n); }
+            switch (event.kind)
+            {
+            case mouse::action::move_to: XTestFakeMotionEvent(display, -1, event.x, event.y, 0); break;
+            case mouse::action::move_by: XTestFakeRelativeMotionEvent(display, event.x, event.y, 0); break;
+            case mouse::action::press: XTestFakeButtonEvent(display, x11_button(event.button), True, 0); break;
+            case mouse::action::release: XTestFakeButtonEvent(display, x11_button(event.button), False, 0); break;
+            case mouse::action::scroll:
+                fake_button_click(display, event.y > 0 ? Button4 : Button5, event.y > 0 ? event.y : -event.y);
+                fake_button_click(display, event.x > 0 ? 7 : 6, event.x > 0 ? event.x : -event.x);
+                break;
+            }
         }
+        flush(display);
     }
+};
+#endif // LIBOS_NO_X11
+
+// Open every evdev device, that looks like a keyboard, except one named `skip` (e.g. "event3")
+std::vector<int> open_keyboards(std::string_view skip = {})
+{
+    std::vector<int> fds;
+
+    DIR *dir = opendir("/dev/input");
+    if (!dir) { return fds; }
 
-    return combo;
+    while (const dirent *entry = readdir(dir))
+    {
+        if (std::strncmp(entry->d_name, "event", 5) != 0 || entry->d_name == skip) { continue; }
+
+        const std::string path = std::string("/dev/input/") + entry->d_name;
+        const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) { continue; }
+
+        // Keyboards have at least letters and space
+        unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1] = {};
+        auto has = [&keys](unsigned code)
+        {
+            return (keys[code / (8 * sizeof(unsigned long))] >> (code % (8 * sizeof(unsigned long)))) & 1;
+        };
+        if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0 || !has(KEY_A) || !has(KEY_SPACE))
+        {
+            close(fd);
+            continue;
+        }
+        fds.push_back(fd);
+    }
+
+    closedir(dir);
+    return fds;
 }
 
-// Press combination of keys (until release)
-void press(const combination &combo)
+// Virtual keyboard, created with uinput
+class uinput_device
 {
-    auto &&h = os::detail::display_handler::get();
+public:
+    static uinput_device & get()
+    {
+        static uinput_device device;
+        return device;
+    }
+
+    // Check if device was created
+    bool valid() const noexcept { return fd >= 0; }
 
-    for (const auto &key : combo.keys)
+    // Get name of evdev node of device (e.g. "event3") or "" if it's unknown
+    std::string node() const
     {
-        XTestFakeKeyEvent(
-            h.native(), // Display *
-            XKeysymToKeycode(
-                h.native(), // Display *
-                static_cast<KeySym>(key) // Our vk values same as KeySym for linux
-            ),
-            true, // is_press
-            0     // delay
-        );
+        char sysname[64] = {};
+        if (!valid() || ioctl(fd, UI_GET_SYSNAME(sizeof(sysname) - 1), sysname) < 0) { return {}; }
+
+        // Node is registered synchronously, only its permissions are set by udev later
+        std::string name;
+        if (DIR *dir = opendir((std::string("/sys/devices/virtual/input/") + sysname).c_str()))
+        {
+            while (const dirent *entry = readdir(dir))
+            {
+                if (std::strncmp(entry->d_name, "event", 5) == 0) { name = entry->d_name; break; }
+            }
+            closedir(dir);
+        }
+        return name;
     }
-}
 
-// Release combination of keys
-void release(const combination &combo)
+    // Add key event to group of current thread
+    void key(std::uint16_t code, bool is_down)
+    {
+        if (code == 0) { return; }
+
+        add(make_event(EV_KEY, code, is_down ? 1 : 0));
+    }
+
+    // Add relative motion event to group of current thread
+    void motion(std::uint16_t code, std::int32_t value)
+    {
+        if (value == 0) { return; }
+
+        add(make_event(EV_REL, code, value));
+    }
+
+    // Terminate current report of group, so next events are applied after it
+    void separate()
+    {
+        auto &group = events();
+        if (!group.empty() && group.back().type != EV_SYN) { group.push_back(make_event(EV_SYN, SYN_REPORT, 0)); }
+    }
+
+    // Terminate group of current thread with SYN_REPORT and write all its reports at once
+    void report()
+    {
+        separate();
+        auto &group = events();
+        if (group.empty()) { return; }
+
+        if (valid())
+        {
+            stats_timer timer(keyboard::operation::flush);
+            // uinput processes whole write under its own lock
+            while (::write(fd, group.data(), group.size() * sizeof(input_event)) < 0 && errno == EINTR) {}
+        }
+        group.clear();
+    }
+
+    uinput_device(const uinput_device &) = delete;
+    uinput_device(uinput_device &&) = delete;
+    void operator=(const uinput_device &) = delete;
+    void operator=(uinput_device &&) = delete;
+
+    ~uinput_device()
+    {
+        if (!valid()) { return; }
+        ioctl(fd, UI_DEV_DESTROY);
+        close(fd);
+    }
+
+private:
+    uinput_device()
+    {
+        fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) { return; }
+
+        ioctl(fd, UI_SET_EVBIT, EV_KEY);
+        ioctl(fd, UI_SET_EVBIT, EV_SYN);
+        // Every key of a regular keyboard
+        for (int code = KEY_ESC; code <= KEY_MICMUTE; ++code) { ioctl(fd, UI_SET_KEYBIT, code); }
+
+        // Buttons and wheels of a regular mouse
+        for (int code = BTN_LEFT; code <= BTN_EXTRA; ++code) { ioctl(fd, UI_SET_KEYBIT, code); }
+        ioctl(fd, UI_SET_EVBIT, EV_REL);
+        for (int code : { REL_X, REL_Y, REL_WHEEL, REL_HWHEEL }) { ioctl(fd, UI_SET_RELBIT, code); }
+
+        uinput_setup setup = {};
+        setup.id.bustype = BUS_VIRTUAL;
+        std::strncpy(setup.name, "LibOS virtual keyboard", UINPUT_MAX_NAME_SIZE - 1);
+
+        if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    // Add event to group. Reports are applied at once,
+    // so code, that already changed in the current report, starts a new one (e.g. press and release)
+    void add(const input_event &event)
+    {
+        auto &group = events();
+        for (auto it = group.rbegin(); it != group.rend() && it->type != EV_SYN; ++it)
+        {
+            if (it->type == event.type && it->code == event.code)
+            {
+                group.push_back(make_event(EV_SYN, SYN_REPORT, 0));
+                break;
+            }
+        }
+        group.push_back(event);
+    }
+
+    static input_event make_event(std::uint16_t type, std::uint16_t code, std::int32_t value)
+    {
+        input_event event = {};
+        event.type = type;
+        event.code = code;
+        event.value = value;
+        return event;
+    }
+
+    // Reusable group, so injection doesn't allocate after warm up
+    static std::vector<input_event> & events()
+    {
+        thread_local std::vector<input_event> group;
+        return group;
+    }
+
+    int fd = -1;
+};
+
+// Listener, reading keyboards from evdev
+class evdev_listener : public keyboard::listener::source
 {
-    auto &&h = os::detail::display_handler::get();
+public:
+    evdev_listener(keyboard::listener &owner, std::shared_ptr<const keyboard::layout> layout)
+        : source(owner), layout(std::move(layout)), fds(open_keyboards())
+    {
+        if (fds.empty() || pipe2(stop, O_CLOEXEC) != 0) { return; }
+        thread = std::thread([this] { run(); });
+    }
+
+    bool active() const noexcept override { return thread.joinable(); }
 
-    for (const auto &key : combo.keys)
+    ~evdev_listener() override
     {
-        XTestFakeKeyEvent(
-            h.native(), // Display *
-            XKeysymToKeycode(
-                h.native(), // Display *
-                static_cast<KeySym>(key) // Our vk values same as KeySym for linux
-            ),
-            false, // is_press
-            0     // delay
-        );
+        if (thread.joinable())
+        {
+            const char wake = 0;
+            while (::write(stop[1], &wake, 1) < 0 && errno == EINTR) {}
+            thread.join();
+        }
+        for (int fd : stop) { if (fd >= 0) { close(fd); } }
+        for (int fd : fds) { close(fd); }
     }
+
+private:
+    void run()
+    {
+        std::vector<pollfd> polls;
+        polls.push_back({ stop[0], POLLIN, 0 });
+        for (int fd : fds) { polls.push_back({ fd, POLLIN, 0 }); }
+
+        input_event events[64];
+        while (true)
+        {
+            if (poll(polls.data(), polls.size(), -1) < 0)
+            {
+                if (errno == EINTR) { continue; }
+                return;
+            }
+            if (polls[0].revents) { return; }
+
+            for (std::size_t i = 1; i < polls.size(); ++i)
+            {
+                if (!(polls[i].revents & POLLIN)) { continue; }
+
+                ssize_t size = 0;
+                {
+                    stats_timer timer(keyboard::operation::hid_value_fetch);
+                    size = read(polls[i].fd, events, sizeof(events));
+                }
+                if (size <= 0) { continue; }
+
+                for (std::size_t j = 0; j < size / sizeof(input_event); ++j)
+                {
+                    // Value 2 is autorepeat
+                    const input_event &event = events[j];
+                    if (event.type != EV_KEY || event.value > 1) { continue; }
+
+                    const keyboard::vk key = layout->key_of(event.code);
+                    if (key == keyboard::vk{}) { continue; }
+
+                    keyboard::listener::event e;
+                    e.key = key;
+                    e.is_down = event.value == 1;
+                    e.time = std::chrono::steady_clock::now();
+                    deliver(e);
+                }
+            }
+        }
+    }
+
+    std::shared_ptr<const keyboard::layout> layout;
+    std::vector<int>                        fds;
+    int                                     stop[2] = { -1, -1 };
+    std::thread                             thread;
+};
+
+// Keyboard functions, implemented with uinput and evdev.
+// Works without X server, e.g. headless or under Wayland.
+//
+// Requires write access to /dev/uinput and read access to /dev/input/event*
+// (e.g. membership in "input" group), otherwise keys are neither injected nor seen
+class uinput_backend : public keyboard::backend
+{
+public:
+    uinput_backend()
+        : mapping(layout_builder::build_evdev()),
+          virtual_node(uinput_device::get().node()),
+          keyboards(open_keyboards(virtual_node))
+    {
+        // udev sets permissions of new node asynchronously, so give it a moment
+        for (int attempt = 0; attempt < 50 && !virtual_node.empty() && !open_virtual_keyboard(); ++attempt)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    keyboard::combination pressed_keys() override
+    {
+        unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1] = {};
+        {
+            std::lock_guard lock(mutex);
+            stats_timer timer(keyboard::operation::query_keymap);
+
+            // Injected keys are seen only on virtual keyboard
+            const auto now = std::chrono::steady_clock::now();
+            if (virtual_keyboard < 0 && now >= next_attempt)
+            {
+                next_attempt = now + std::chrono::milliseconds(100);
+                open_virtual_keyboard();
+            }
+            auto read_state = [&keys](int fd)
+            {
+                unsigned long state[std::size(keys)] = {};
+                if (ioctl(fd, EVIOCGKEY(sizeof(state)), state) < 0) { return; }
+                for (std::size_t i = 0; i < std::size(keys); ++i) { keys[i] |= state[i]; }
+            };
+            for (int fd : keyboards) { read_state(fd); }
+            if (virtual_keyboard >= 0) { read_state(virtual_keyboard); }
+        }
+
+        keyboard::combination combo;
+        constexpr std::size_t bits = 8 * sizeof(unsigned long);
+        for (std::size_t w = 0; w < std::size(keys); ++w)
+        {
+            // Visit only pressed keys
+            for (unsigned long word = keys[w]; word != 0; word &= word - 1)
+            {
+                const auto code = static_cast<std::uint16_t>(w * bits + countr_zero(word));
+                const keyboard::vk key = mapping->key_of(code);
+                if (key != keyboard::vk{}) { combo.insert(key); }
+            }
+        }
+        return combo;
+    }
+
+    void send(const keyboard::combination &combo, bool is_down) override
+    {
+        auto &device = uinput_device::get();
+        for (const auto &key : combo) { device.key(mapping->code_of(key), is_down); }
+        device.report();
+    }
+
+    void send(span<const keyboard::key_event> events) override
+    {
+        // Whole sequence is a single write(), split into reports only when key repeats
+        auto &device = uinput_device::get();
+        for (const auto &event : events) { device.key(mapping->code_of(event.key), event.is_down); }
+        device.report();
+    }
+
+    void type(std::u32string_view text) override
+    {
+        auto &device = uinput_device::get();
+        type_codes(*mapping, text, [&device](std::uint16_t code, bool is_down) { device.key(code, is_down); });
+        device.report();
+    }
+
+    std::shared_ptr<const keyboard::layout> current_layout() override { return mapping; }
+
+    std::unique_ptr<keyboard::listener::source> listen(keyboard::listener &owner) override
+    {
+        return std::make_unique<evdev_listener>(owner, mapping);
+    }
+
+    // Virtual device has relative axes only, so move_to is skipped
+    bool absolute_mouse_moves() const noexcept override { return false; }
+
+    void send_mouse(span<const mouse::event> events) override
+    {
+        constexpr std::uint16_t buttons[mouse::button_count] = { BTN_LEFT, BTN_RIGHT, BTN_MIDDLE, BTN_SIDE, BTN_EXTRA };
+
+        // Whole sequence is a single write(). Buttons and motion go to separate reports,
+        // so a click lands where the cursor was moved to before it
+        auto &device = uinput_device::get();
+        bool button_report = false;
+        for (const auto &event : events)
+        {
+            if (event.kind == mouse::action::move_to) { continue; }
+
+            const bool is_button = event.kind == mouse::action::press || event.kind == mouse::action::release;
+            if (is_button != button_report) { device.separate(); }
+            button_report = is_button;
+
+            const std::uint16_t button = buttons[static_cast<std::size_t>(event.button)];
+            switch (event.kind)
+            {
+            case mouse::action::move_to: break;
+            case mouse::action::move_by: device.motion(REL_X, event.x); device.motion(REL_Y, event.y); break;
+            case mouse::action::press: device.key(button, true); break;
+            case mouse::action::release: device.key(button, false); break;
+            case mouse::action::scroll: device.motion(REL_HWHEEL, event.x); device.motion(REL_WHEEL, event.y); break;
+            }
+        }
+        device.report();
+    }
+
+    ~uinput_backend() override
+    {
+        for (int fd : keyboards) { close(fd); }
+        if (virtual_keyboard >= 0) { close(virtual_keyboard); }
+    }
+
+private:
+    // Try to open evdev node of virtual keyboard
+    bool open_virtual_keyboard()
+    {
+        if (virtual_keyboard < 0 && !virtual_node.empty())
+        {
+            virtual_keyboard = open(("/dev/input/" + virtual_node).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        }
+        return virtual_keyboard >= 0;
+    }
+
+    std::shared_ptr<const keyboard::layout> mapping;
+    std::mutex                              mutex;
+    std::string                             virtual_node;
+    std::vector<int>                        keyboards;
+    int                                     virtual_keyboard = -1;
+    std::chrono::steady_clock::time_point   next_attempt;
+};
+
+// Check if uinput backend should be used.
+//
+// LIBOS_KEYBOARD_BACKEND environment variable selects "uinput" or "x11".
+// Otherwise X11 is used, when there is an X display (including XWayland)
+bool use_uinput()
+{
+#ifdef LIBOS_NO_X11
+    return true;
+#else
+    static const bool selected = []
+    {
+        if (const char *name = std::getenv("LIBOS_KEYBOARD_BACKEND"))
+        {
+            if (std::strcmp(name, "uinput") == 0) { return true; }
+            if (std::strcmp(name, "x11") == 0) { return false; }
+        }
+        return !std::getenv("DISPLAY");
+    }();
+    return selected;
+#endif
+}
+
+// Backend, installed on current thread
+keyboard::backend *& thread_backend() noexcept
+{
+    thread_local keyboard::backend *installed = nullptr;
+    return installed;
+}
+
+} // namespace os::detail
+
+namespace os::keyboard
+{
+
+// Get backend, that calls OS. Selected once per process
+backend & native_backend()
+{
+    static const std::unique_ptr<backend> selected = []() -> std::unique_ptr<backend>
+    {
+#ifndef LIBOS_NO_X11
+        // Without access to /dev/uinput fall back to XTest, if there is an X display
+        if (!detail::use_uinput() || (!detail::uinput_device::get().valid() && std::getenv("DISPLAY")))
+        {
+            return std::make_unique<detail::x11_backend>();
+        }
+#endif
+        return std::make_unique<detail::uinput_backend>();
+    }();
+    return *selected;
+}
+
+// Check if every key in combination is pressed
+bool is_pressed(const combination &combo) { return current_backend().is_pressed(combo); }
+
+// Get combination of all pressed keys on a keyboard
+combination pressed_keys() { return current_backend().pressed_keys(); }
+
+// Capture state of the whole keyboard at once
+state snapshot() { return current_backend().snapshot(); }
+
+// Press combination of keys (until release)
+void press(const combination &combo) { current_backend().send(combo, true); }
+
+// Release combination of keys
+void release(const combination &combo) { current_backend().send(combo, false); }
+
+// Send sequence of key events at once
+void send(span<const key_event> events) { current_backend().send(events); }
+
+// Get layout, that is active now
+std::shared_ptr<const layout> layout::current() { return current_backend().current_layout(); }
+
+// Type text, using current keyboard layout
+void type(std::u32string_view text) { current_backend().type(text); }
+
+// Start listening and queue events
+listener::listener() : origin(current_backend().listen(*this)) {}
+
+// Start listening and pass events to callback
+listener::listener(callback on_event)
+    : on_event(std::move(on_event)), origin(current_backend().listen(*this)) {}
+
+// Stop listening
+listener::~listener() { origin.reset(); }
+
+// Check if OS delivers events to listener
+bool listener::active() const noexcept { return origin->active(); }
+
+// Get counters of native backend
+stats_t stats()
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    return detail::stats_registry::get().collect();
+#else
+    return {};
+#endif
+}
+
+// Reset counters of every thread
+void reset_stats()
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    detail::stats_registry::get().clear();
+#endif
 }
 
 } // namespace os::keyboard
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "os/memory.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Parse unsigned number after leading spaces
+std::uint64_t parse_memory_number(std::string_view &text)
+{
+    while (!text.empty() && text.front() == ' ') { text.remove_prefix(1); }
+
+    std::uint64_t value = 0;
+    while (!text.empty() && '0' <= text.front() && text.front() <= '9')
+    {
+        value = value * 10 + static_cast<std::uint64_t>(text.front() - '0');
+        text.remove_prefix(1);
+    }
+    return value;
+}
+
+// Read start of procfs file into buffer without allocations (empty on error)
+std::string_view read_proc_prefix(int fd, char *buffer, std::size_t size)
+{
+    if (fd < 0) { return {}; }
+
+    const ssize_t length = pread(fd, buffer, size, 0);
+    return length > 0 ? std::string_view(buffer, static_cast<std::size_t>(length)) : std::string_view{};
+}
+
+// Read facts about memory
+memory::info_t read_memory_info()
+{
+    memory::info_t i;
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    i.page_size = page_size > 0 ? static_cast<std::size_t>(page_size) : 0;
+
+    struct sysinfo system = {};
+    if (sysinfo(&system) == 0) { i.total = std::uint64_t{system.totalram} * system.mem_unit; }
+
+    // Pools of huge pages are directories "hugepages-<size>kB"
+    const std::string root = "/sys/kernel/mm/hugepages/";
+    if (DIR *pools = opendir(root.c_str()))
+    {
+        while (const dirent *entry = readdir(pools))
+        {
+            std::string_view name = entry->d_name;
+            if (name.substr(0, 10) != "hugepages-") { continue; }
+            name.remove_prefix(10);
+
+            const std::uint64_t size = parse_memory_number(name);
+            if (size == 0 || name != "kB") { continue; }
+            i.huge_page_sizes.push_back(static_cast<std::size_t>(size << 10));
+
+            std::ifstream pages(root + entry->d_name + "/nr_hugepages");
+            std::uint64_t count = 0;
+            if (pages >> count && count > 0) { i.huge_pages_available = true; }
+        }
+        closedir(pools);
+
+        std::sort(i.huge_page_sizes.begin(), i.huge_page_sizes.end());
+    }
+
+    // Mode in use is in brackets, e.g. "always [madvise] never"
+    std::ifstream thp("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string modes;
+    std::getline(thp, modes);
+    i.transparent_huge_pages = !modes.empty() && modes.find("[never]") == std::string::npos;
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os::memory
+{
+
+// Get size of regular page in bytes
+std::size_t page_size() { return info().page_size; }
+
+// Get total physical memory in bytes
+std::uint64_t total() { return info().total; }
+
+// Get facts about memory
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_memory_info();
+    return i;
+}
+
+// Sample current memory figures
+snapshot_t snapshot() noexcept
+{
+    snapshot_t s;
+
+    // File is generated anew on every read, so it's opened only once.
+    // MemAvailable is near the start of it
+    static const int meminfo = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    char buffer[512];
+    std::string_view text = detail::read_proc_prefix(meminfo, buffer, sizeof(buffer));
+    if (const auto pos = text.find("MemAvailable:"); pos != std::string_view::npos)
+    {
+        text.remove_prefix(pos + 13);
+        s.available = detail::parse_memory_number(text) << 10;
+    }
+    else
+    {
+        // Kernels before 3.14 don't estimate available memory
+        struct sysinfo system = {};
+        if (sysinfo(&system) == 0)
+        {
+            s.available = (std::uint64_t{system.freeram} + system.bufferram) * system.mem_unit;
+        }
+    }
+
+    // Opened per call: cached descriptor would point to parent after fork()
+    const int statm = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    text = detail::read_proc_prefix(statm, buffer, sizeof(buffer));
+    if (statm >= 0) { close(statm); }
+
+    // Resident pages are the second number
+    detail::parse_memory_number(text);
+    s.resident = detail::parse_memory_number(text) * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) { s.peak_resident = static_cast<std::uint64_t>(usage.ru_maxrss) << 10; }
+
+    return s;
+}
+
+} // namespace os::memory
\ No newline at end of file
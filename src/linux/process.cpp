@@ -0,0 +1,81 @@
+#include "os/process.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Get value of "<name>: <number>" line of /proc file (0, if missing)
+std::uint64_t parse_proc_field(std::string_view text, std::string_view name)
+{
+    const auto pos = text.find(name);
+    if (pos == std::string_view::npos) { return 0; }
+    text.remove_prefix(pos + name.size());
+
+    while (!text.empty() && (text.front() == ':' || text.front() == ' ')) { text.remove_prefix(1); }
+
+    std::uint64_t value = 0;
+    while (!text.empty() && '0' <= text.front() && text.front() <= '9')
+    {
+        value = value * 10 + static_cast<std::uint64_t>(text.front() - '0');
+        text.remove_prefix(1);
+    }
+    return value;
+}
+
+// Convert timeval to nanoseconds
+std::chrono::nanoseconds to_nanoseconds(const timeval &time)
+{
+    return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+}
+
+} // namespace os::detail
+
+namespace os::process
+{
+
+// Sample resource usage of current process
+usage_t usage() noexcept
+{
+    usage_t u;
+
+    rusage r = {};
+    if (getrusage(RUSAGE_SELF, &r) == 0)
+    {
+        u.user_time = detail::to_nanoseconds(r.ru_utime);
+        u.system_time = detail::to_nanoseconds(r.ru_stime);
+        u.voluntary_switches = static_cast<std::uint64_t>(r.ru_nvcsw);
+        u.involuntary_switches = static_cast<std::uint64_t>(r.ru_nivcsw);
+        u.major_faults = static_cast<std::uint64_t>(r.ru_majflt);
+        u.minor_faults = static_cast<std::uint64_t>(r.ru_minflt);
+    }
+
+    // Read at once without iostreams: file is less than 200 bytes
+    const int io = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    if (io >= 0)
+    {
+        char buffer[256];
+        const ssize_t length = read(io, buffer, sizeof(buffer));
+        close(io);
+
+        if (length > 0)
+        {
+            const std::string_view text(buffer, static_cast<std::size_t>(length));
+            u.read_bytes = detail::parse_proc_field(text, "rchar");
+            u.write_bytes = detail::parse_proc_field(text, "wchar");
+        }
+    }
+
+    return u;
+}
+
+} // namespace os::process
\ No newline at end of file
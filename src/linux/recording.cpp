@@ -0,0 +1,46 @@
+#include "os/recording.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Map file
+mapped_file::mapped_file(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return; }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *ptr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED)
+        {
+            // Recording is read once from start to end
+            madvise(ptr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+
+            bytes = static_cast<const unsigned char *>(ptr);
+            length = static_cast<std::size_t>(st.st_size);
+        }
+    }
+
+    // Mapping stays valid after file is closed
+    close(fd);
+}
+
+// Unmap file
+mapped_file::~mapped_file()
+{
+    if (bytes) { munmap(const_cast<unsigned char *>(bytes), length); }
+}
+
+} // namespace os::detail
\ No newline at end of file
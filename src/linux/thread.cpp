@@ -0,0 +1,87 @@
+#include "os/thread.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_LINUX
+    #error "This code is for Linux only!"
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace os::thread
+{
+
+// Allow current thread to run only on specified CPUs
+bool pin(const cpu::cpu_set &cpus)
+{
+    if (cpus.empty()) { return false; }
+
+    // Set is allocated dynamically to support more than CPU_SETSIZE CPUs
+    const unsigned count = *std::max_element(cpus.begin(), cpus.end()) + 1;
+    cpu_set_t *set = CPU_ALLOC(count);
+    if (!set) { return false; }
+
+    const std::size_t size = CPU_ALLOC_SIZE(count);
+    CPU_ZERO_S(size, set);
+    for (unsigned c : cpus) { CPU_SET_S(c, size, set); }
+
+    const bool pinned = pthread_setaffinity_np(pthread_self(), size, set) == 0;
+    CPU_FREE(set);
+    return pinned;
+}
+
+// Change scheduling class of current thread
+bool set_priority(priority p)
+{
+    // Pid 0 means calling thread
+    sched_param param = {};
+    switch (p)
+    {
+    case priority::idle:
+        return sched_setscheduler(0, SCHED_IDLE, &param) == 0;
+    case priority::realtime:
+        // Lowest real-time priority is still above any normal thread
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        return sched_setscheduler(0, SCHED_FIFO, &param) == 0;
+    default:
+        break;
+    }
+
+    if (sched_setscheduler(0, SCHED_OTHER, &param) != 0) { return false; }
+
+    // Nice value is per thread on Linux
+    const int nice = p == priority::low ? 10 : p == priority::high ? -10 : 0;
+    return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) == 0;
+}
+
+// Prefer memory of NUMA node for current thread
+bool set_numa_preferred(unsigned node)
+{
+    const auto &nodes = cpu::info().numa_nodes;
+    const bool exists = std::any_of(
+        nodes.begin(), nodes.end(),
+        [node](const cpu::numa_node &n) { return n.id == node; }
+    );
+    if (!exists) { return false; }
+
+    constexpr unsigned bits = sizeof(unsigned long) * CHAR_BIT;
+    std::vector<unsigned long> mask(node / bits + 1);
+    mask[node / bits] |= 1ul << (node % bits);
+
+    // Kernel reads maxnode - 1 bits
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1) == 0) { return true; }
+
+    // Kernel without NUMA has only node 0 anyway
+    return errno == ENOSYS && node == 0;
+}
+
+} // namespace os::thread
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "os/cpu.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+#include <sys/sysctl.h>
+#include <sys/types.h>
+
+namespace os::detail
+{
+
+// Read integer value of sysctl (0, if missing)
+std::uint64_t sysctl_number(const char *name)
+{
+    std::uint64_t value = 0;
+    std::size_t size = sizeof(value);
+    if (sysctlbyname(name, &value, &size, nullptr, 0) != 0) { return 0; }
+
+    // Some values are 32-bit
+    if (size == sizeof(std::uint32_t))
+    {
+        std::uint32_t narrow = 0;
+        std::memcpy(&narrow, &value, sizeof(narrow));
+        return narrow;
+    }
+    return value;
+}
+
+// Read CPU topology
+cpu::info_t read_cpu_info()
+{
+    cpu::info_t i;
+
+    i.logical_cores = static_cast<unsigned>(sysctl_number("hw.logicalcpu"));
+    i.physical_cores = static_cast<unsigned>(sysctl_number("hw.physicalcpu"));
+    i.packages = static_cast<unsigned>(sysctl_number("hw.packages"));
+    if (i.physical_cores == 0) { i.physical_cores = i.logical_cores; }
+
+    // There is no API for siblings. Threads of a core have adjacent numbers
+    const unsigned threads = i.physical_cores ? i.logical_cores / i.physical_cores : 1;
+    for (unsigned core = 0; core < i.physical_cores; ++core)
+    {
+        cpu::cpu_set siblings;
+        for (unsigned t = 0; t < threads; ++t) { siblings.push_back(core * threads + t); }
+        i.siblings.push_back(std::move(siblings));
+    }
+
+    const std::size_t line_size = sysctl_number("hw.cachelinesize");
+    i.l1d = cpu::cache_t{ sysctl_number("hw.l1dcachesize"), line_size };
+    i.l1i = cpu::cache_t{ sysctl_number("hw.l1icachesize"), line_size };
+    i.l2 = cpu::cache_t{ sysctl_number("hw.l2cachesize"), line_size };
+    i.l3 = cpu::cache_t{ sysctl_number("hw.l3cachesize"), line_size };
+    if (i.l3.size == 0) { i.l3.line_size = 0; }
+
+    // macOS has no NUMA
+    cpu::numa_node node;
+    for (unsigned c = 0; c < i.logical_cores; ++c) { node.cpus.push_back(c); }
+    i.numa_nodes.push_back(std::move(node));
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os::cpu
+{
+
+// Number of logical CPUs
+unsigned logical_cores() { return info().logical_cores; }
+
+// Number of physical cores
+unsigned physical_cores() { return info().physical_cores; }
+
+// Size of cache line
+std::size_t cache_line_size() { return info().l1d.line_size; }
+
+// Get CPU topology
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_cpu_info();
+    return i;
+}
+
+} // namespace os::cpu
\ No newline at end of file
@@ -5,36 +5,90 @@
     #error "This code is for macOS only!"
 #endif
 
+#include <cerrno>
+#include <cstdint>
+
+#include <dlfcn.h>
 #include <sys/utsname.h>
 
+#if defined(__x86_64__)
+    #include <cpuid.h>
+#endif
+
+namespace os::detail
+{
+
+// Read OS kernel info
+os::kernel::info_t read_kernel_info()
+{
+    os::kernel::info_t i;
+
+    utsname utsname; uname(&utsname);
+    i.name = name();
+    i.version = ::version{utsname.release};
+    i.version_string = utsname.release;
+
+    return i;
+}
+
+// Probe OS kernel features with actual calls
+os::kernel::features_t probe_kernel_features()
+{
+    using os::kernel::feature;
+
+    os::kernel::features_t f;
+
+    // macOS 14.4+. Looked up at runtime to load on older versions.
+    // Differing value makes it return immediately, unless kernel lacks support
+    using wait_on_address_t = int (*)(void *, std::uint64_t, std::size_t, std::uint32_t);
+    if (const auto wait = reinterpret_cast<wait_on_address_t>(dlsym(RTLD_DEFAULT, "os_sync_wait_on_address")))
+    {
+        std::uint32_t value = 0;
+        if (wait(&value, 1, sizeof(value), 0) >= 0 || (errno != ENOSYS && errno != ENOTSUP))
+        {
+            f.add(feature::wait_on_address);
+        }
+    }
+
+#if defined(__x86_64__)
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8))) { f.add(feature::invariant_tsc); }
+#elif defined(__aarch64__)
+    // Generic timer has fixed frequency
+    f.add(feature::invariant_tsc);
+#endif
+
+    return f;
+}
+
+} // namespace os::detail
+
 namespace os::kernel
 {
 
 // Get name of OS kernel
-std::string name() { return "Darwin"; }
+std::string_view name() { return "Darwin"; }
 
 // Get major, minor and patch of OS kernel
 ::version version() { return info().version; }
 
 // Get version [+ additional data] of OS kernel
-std::string version_string() { return info().version_string; }
+std::string_view version_string() { return info().version_string; }
 
 // Get OS kernel info
 const info_t & info()
 {
-    static info_t i;
-
-    if (static bool init = true; init)
-    {
-        utsname utsname; uname(&utsname);
-        i.name = name();
-        i.version = ::version{utsname.release};
-        i.version_string = utsname.release;
-
-        init = false;
-    }
-
+    // Init info only once.
+    static const info_t i = detail::read_kernel_info();
     return i;
 }
 
+// Get available OS kernel features
+const features_t & features()
+{
+    // Init features only once.
+    static const features_t f = detail::probe_kernel_features();
+    return f;
+}
+
 } // namespace os::kernel
\ No newline at end of file
@@ -6,64 +6,347 @@
 #endif
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include <Carbon/Carbon.h>
 #include <IOKit/hid/IOHIDDevice.h>
 #include <IOKit/hid/IOHIDManager.h>
+#include <mach/mach_time.h>
+#include <pthread.h>
+#include <pthread/qos.h>
 
 namespace os::detail
 {
 
-CGEventFlags extract_modifiers(os::keyboard::combination &combo)
+// Raise priority of current thread for time-critical work (if possible)
+void raise_thread_priority() noexcept
+{
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+}
+
+// Sleep until deadline with the best precision available
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline) noexcept
+{
+    const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        deadline - std::chrono::steady_clock::now()
+    ).count();
+    if (remaining <= 0) { return; }
+
+    static const mach_timebase_info_data_t timebase = []
+    {
+        mach_timebase_info_data_t info;
+        mach_timebase_info(&info);
+        return info;
+    }();
+
+    const uint64_t ticks = static_cast<uint64_t>(remaining) * timebase.denom / timebase.numer;
+    mach_wait_until(mach_absolute_time() + ticks);
+}
+
+// Get event flag of modifier key or 0, if key is not a modifier
+constexpr CGEventFlags modifier_flag(os::keyboard::vk key)
 {
     using os::keyboard::vk;
 
-    CGEventFlags flags = 0;
+    switch (key)
+    {
+        case vk::Function:  return kCGEventFlagMaskSecondaryFn;
+        case vk::Shift_L:
+        case vk::Shift_R:   return kCGEventFlagMaskShift;
+        case vk::Option_L:
+        case vk::Option_R:  return kCGEventFlagMaskAlternate;
+        case vk::Command_L:
+        case vk::Command_R: return kCGEventFlagMaskCommand;
+        case vk::Control_L:
+        case vk::Control_R: return kCGEventFlagMaskControl;
+        default:            return 0;
+    }
+}
 
-    auto try_extract = [&flags, &combo](vk modifier, CGEventFlags mask)
+// Event flag of every key, indexed by key_index()
+constexpr auto modifier_masks = []
+{
+    std::array<CGEventFlags, key_index_count> masks{};
+    for (std::size_t index = 0; index < key_index_count; ++index)
     {
-        auto it = combo.keys.find(modifier); 
-        if (it != combo.keys.end())
+        masks[index] = modifier_flag(key_at(index));
+    }
+    return masks;
+}();
+
+// Get event flag of modifier key or 0, if key is not a modifier (table lookup)
+constexpr CGEventFlags modifier_mask(os::keyboard::vk key)
+{
+    std::size_t index = key_index(key);
+    return index == no_key_index ? 0 : modifier_masks[index];
+}
+
+// Keyboard events created once per keycode and reused for every post
+class event_cache
+{
+public:
+    static event_cache & get()
+    {
+        static event_cache cache;
+        return cache;
+    }
+
+    // Post keyboard event for key with modifier flags and flags of held modifiers
+    void post(CGKeyCode key, bool is_down, CGEventFlags flags)
+    {
+        if (key >= std::size(events)) { return; }
+
+        std::lock_guard lock(mutex);
+
+        CGEventRef &event = events[key];
+        if (!event) { event = CGEventCreateKeyboardEvent(source, key, true); }
+        if (!event) { return; }
+
+        CGEventSetType(event, is_down ? kCGEventKeyDown : kCGEventKeyUp);
+        CGEventSetFlags(event, flags | held);
+
+        stats_timer timer(keyboard::operation::fake_key_event);
+        CGEventPost(kCGHIDEventTap, event);
+    }
+
+    // Press or release modifier key with flag.
+    // It stays held between calls, so its flag is applied to every following event
+    void post_modifier(CGKeyCode key, bool is_down, CGEventFlags flag)
+    {
+        if (key >= std::size(events)) { return; }
+
+        std::lock_guard lock(mutex);
+
+        held_flags[key] = is_down ? flag : 0;
+        held = 0;
+        for (CGEventFlags f : held_flags) { held |= f; }
+
+        CGEventRef &event = events[key];
+        if (!event) { event = CGEventCreateKeyboardEvent(source, key, true); }
+        if (!event) { return; }
+
+        CGEventSetType(event, kCGEventFlagsChanged);
+        CGEventSetFlags(event, held);
+
+        stats_timer timer(keyboard::operation::fake_key_event);
+        CGEventPost(kCGHIDEventTap, event);
+    }
+
+    // Post press and release of text, that has no key on layout
+    void post_unicode(const UniChar *units, UniCharCount count)
+    {
+        std::lock_guard lock(mutex);
+
+        if (!unicode_event) { unicode_event = CGEventCreateKeyboardEvent(source, 0, true); }
+        if (!unicode_event) { return; }
+
+        CGEventSetFlags(unicode_event, held);
+        CGEventKeyboardSetUnicodeString(unicode_event, count, units);
+        CGEventSetType(unicode_event, kCGEventKeyDown);
         {
-            flags |= mask;
-            combo.keys.erase(it);
+            stats_timer timer(keyboard::operation::fake_key_event);
+            CGEventPost(kCGHIDEventTap, unicode_event);
         }
-    };
+        CGEventSetType(unicode_event, kCGEventKeyUp);
+        {
+            stats_timer timer(keyboard::operation::fake_key_event);
+            CGEventPost(kCGHIDEventTap, unicode_event);
+        }
+    }
 
-    try_extract(vk::Function, kCGEventFlagMaskSecondaryFn);
+    event_cache(const event_cache &) = delete;
+    event_cache(event_cache &&) = delete;
+    event_cache & operator=(const event_cache &) = delete;
+    event_cache & operator=(event_cache &&) = delete;
 
-    try_extract(vk::Shift_L, kCGEventFlagMaskShift);
-    try_extract(vk::Shift_R, kCGEventFlagMaskShift);
-    try_extract(vk::Option_L, kCGEventFlagMaskAlternate);
-    try_extract(vk::Option_R, kCGEventFlagMaskAlternate);
-    try_extract(vk::Command_L, kCGEventFlagMaskCommand);
-    try_extract(vk::Command_R, kCGEventFlagMaskCommand);
-    try_extract(vk::Control_L, kCGEventFlagMaskControl);
-    try_extract(vk::Control_R, kCGEventFlagMaskControl);
+private:
+    CGEventSourceRef source = nullptr;
+    CGEventRef       events[256] = {};
+    CGEventRef       unicode_event = nullptr;
+    // Flags of modifiers, held by injected events, indexed by keycode
+    CGEventFlags     held_flags[256] = {};
+    CGEventFlags     held = 0;
+    std::mutex       mutex;
 
-    return flags;
-}
+    event_cache() : source(CGEventSourceCreate(kCGEventSourceStateHIDSystemState)) {}
+
+    ~event_cache()
+    {
+        for (CGEventRef event : events)
+        {
+            if (event) { CFRelease(event); }
+        }
+        if (unicode_event) { CFRelease(unicode_event); }
+        if (source) { CFRelease(source); }
+    }
+};
 
-void send_key_events(const os::keyboard::combination &combo, bool is_down)
+// Get virtual key of letter, that depends on keyboard localization
+bool localizedKeys(UniChar c, keyboard::vk &vk)
 {
-    os::keyboard::combination no_modifiers = combo;
-    CGEventFlags flags = extract_modifiers(no_modifiers);
+    if ('a' <= c && c <= 'z')
+    {
+        c = std::toupper(c);
+    }
+
+    #define CASE_LETTER(LETTER)        \
+        case #LETTER[0]:               \
+            vk = keyboard::vk::LETTER; \
+            break; 
 
-    for (auto key : no_modifiers.keys)
+    switch (c)
     {
-        CGEventRef event = CGEventCreateKeyboardEvent(
-            nullptr, 
-            static_cast<CGKeyCode>(key), 
-            is_down
-        );
-        CGEventSetFlags(event, flags);
-        CGEventPost(kCGHIDEventTap, event);
-        CFRelease(event);
+        CASE_LETTER(A);
+        CASE_LETTER(B);
+        CASE_LETTER(C);
+        CASE_LETTER(D);
+        CASE_LETTER(E);
+        CASE_LETTER(F);
+        CASE_LETTER(G);
+        CASE_LETTER(H);
+        CASE_LETTER(I);
+        CASE_LETTER(J);
+        CASE_LETTER(K);
+        CASE_LETTER(L);
+        CASE_LETTER(M);
+        CASE_LETTER(N);
+        CASE_LETTER(O);
+        CASE_LETTER(P);
+        CASE_LETTER(Q);
+        CASE_LETTER(R);
+        CASE_LETTER(S);
+        CASE_LETTER(T);
+        CASE_LETTER(U);
+        CASE_LETTER(V);
+        CASE_LETTER(W);
+        CASE_LETTER(X);
+        CASE_LETTER(Y);
+        CASE_LETTER(Z);
+
+        default: return false;
     }
+
+    return true;
 }
 
+// Builds layout tables with UCKeyTranslate
+class layout_builder
+{
+public:
+    // Build tables of current keyboard input source
+    static std::shared_ptr<keyboard::layout> build()
+    {
+        static std::uint64_t loaded = 0;
+
+        auto result = std::make_shared<keyboard::layout>();
+        result->number = loaded++;
+
+        // Virtual keys are the same as virtual codes, unless localized
+        for (std::size_t i = 0; i < key_index_count; ++i)
+        {
+            result->codes[i] = static_cast<std::uint16_t>(i);
+        }
+        for (unsigned code = 0; code < 256; ++code)
+        {
+            result->keys[code] = static_cast<keyboard::vk>(code);
+        }
+
+        // Modifiers are applied as flags, but keys are kept for completeness
+        result->modifier_keys[0] = kVK_Shift;
+        result->modifier_keys[1] = kVK_Option;
+
+        TISInputSourceRef tis = TISCopyCurrentKeyboardLayoutInputSource();
+        if (!tis) { return result; }
+
+        CFDataRef layout_data = static_cast<CFDataRef>(
+            TISGetInputSourceProperty(tis, kTISPropertyUnicodeKeyLayoutData)
+        );
+        if (layout_data)
+        {
+            const auto *layout = reinterpret_cast<const UCKeyboardLayout *>(CFDataGetBytePtr(layout_data));
+            load_keys(layout, *result);
+            load_chars(layout, *result);
+        }
+
+        // Layout data is owned by input source
+        CFRelease(tis);
+        return result;
+    }
+
+private:
+    // Resolve localized virtual keys of letters
+    static void load_keys(const UCKeyboardLayout *layout, keyboard::layout &result)
+    {
+        for (UInt16 code = 0; code < 128; ++code)
+        {
+            UInt32       dead_key_state = 0;
+            UniCharCount length = 0;
+            UniChar      units[4];
+
+            // Command selects letters, used for shortcuts on non-latin layouts
+            OSStatus error = UCKeyTranslate(
+                layout, code, kUCKeyActionDown, cmdKey >> 8, LMGetKbdType(),
+                kUCKeyTranslateNoDeadKeysBit, &dead_key_state, std::size(units), &length, units
+            );
+
+            keyboard::vk vk;
+            if (error != noErr || length == 0 || !localizedKeys(units[0], vk)) { continue; }
+
+            result.keys[code] = vk;
+            result.codes[key_index(vk)] = code;
+        }
+    }
+
+    // Build character -> (virtual code, modifiers) table.
+    // Modifiers are 1 for Shift and 2 for Option
+    static void load_chars(const UCKeyboardLayout *layout, keyboard::layout &result)
+    {
+        // Lower levels first: none, Shift, Option, Shift + Option
+        for (std::uint16_t modifiers = 0; modifiers < 4; ++modifiers)
+        {
+            const UInt32 state = (
+                ((modifiers & 1) ? shiftKey : 0) | ((modifiers & 2) ? optionKey : 0)
+            ) >> 8;
+
+            for (UInt16 code = 0; code < 128; ++code)
+            {
+                UInt32       dead_key_state = 0;
+                UniCharCount length = 0;
+                UniChar      units[4];
+
+                OSStatus error = UCKeyTranslate(
+                    layout, code, kUCKeyActionDown, state, LMGetKbdType(),
+                    0, &dead_key_state, std::size(units), &length, units
+                );
+                // Dead keys type nothing by themselves
+                if (error != noErr || dead_key_state != 0) { continue; }
+
+                char32_t c = 0;
+                if (length == 1) { c = units[0]; }
+                else if (length == 2 && (units[0] & 0xFC00) == 0xD800 && (units[1] & 0xFC00) == 0xDC00)
+                {
+                    c = 0x10000 + ((char32_t(units[0]) - 0xD800) << 10) + (char32_t(units[1]) - 0xDC00);
+                }
+                if (c < 0x20 && c != U'\t' && c != U'\r') { continue; }
+
+                result.chars.insert(c, code, modifiers);
+            }
+        }
+    }
+};
+
+class hid_listener;
+
 class HIDInputManager
 {
 public:
@@ -73,68 +356,187 @@ public:
         return input;
     }
 
-    bool is_pressed(const os::keyboard::combination &combo) const
+    // Check if every key in combination is pressed (reads cached state only)
+    bool is_pressed(const os::keyboard::combination &combo)
     {
-        return std::all_of(
-            combo.keys.begin(), combo.keys.end(), 
-            [this](const auto &vk)
-            {
-                IOHIDValueRef value = 0;
-
-                IOHIDDeviceRef device = IOHIDElementGetDevice(keys.at(vk));
-                IOHIDDeviceGetValue(device, keys.at(vk), &value);
-
-                return IOHIDValueGetIntegerValue(value) == 1;
-            }
-        );
+        return pressed_keys().contains(combo);
     }
 
-    os::keyboard::combination pressed_keys() const
+    // Combination of all pressed keys (reads cached state only).
+    // Keycodes are translated with current layout, so keys, held across layout switch, are reported correctly
+    os::keyboard::combination pressed_keys()
     {
+        const auto mapping = current_layout();
+
         keyboard::combination combo;
-        for (const auto &[vk, key] : keys)
+        for (std::size_t w = 0; w < std::size(pressed); ++w)
         {
-            if (is_pressed(vk)) 
+            std::uint64_t bits = pressed[w].load(std::memory_order_acquire);
+            while (bits != 0)
             {
-                combo += vk;
+                const auto code = static_cast<std::uint16_t>(w * 64 + detail::countr_zero(bits));
+                const keyboard::vk key = mapping->key_of(code);
+                if (key != keyboard::vk{}) { combo.insert(key); }
+                bits &= bits - 1;
             }
         }
         return combo;
     }
 
-private:
-    CFDataRef               layout_data; // Layout data
-    const UCKeyboardLayout *layout;      // Current keyboard layout
-    IOHIDManagerRef         manager;                    
+    // Check if HID manager was opened
+    bool active() const noexcept { return opened; }
 
-    std::unordered_map<keyboard::vk, IOHIDElementRef> keys;
+    // Get tables of current layout, rebuilding them after layout change
+    std::shared_ptr<const keyboard::layout> current_layout()
+    {
+        std::lock_guard lock(layout_mutex);
+        if (layout_changed.exchange(false)) { loaded = layout_builder::build(); }
+        return loaded;
+    }
 
-    HIDInputManager() 
+    // Start delivering input values to listener
+    void subscribe(hid_listener *listener)
     {
-        // Get the current keyboard layout
-        TISInputSourceRef tis = TISCopyCurrentKeyboardLayoutInputSource();
-        layout_data = static_cast<CFDataRef>(
-            TISGetInputSourceProperty(tis, kTISPropertyUnicodeKeyLayoutData)
-        );
+        std::lock_guard lock(listeners_mutex);
+        listeners.push_back(listener);
+    }
 
-        if (!layout_data) { return; }
+    // Stop delivering input values to listener.
+    // Waits for delivery in progress, unless called from listener's callback
+    void unsubscribe(hid_listener *listener)
+    {
+        std::lock_guard delivery(delivery_mutex);
+        std::lock_guard lock(listeners_mutex);
+        listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+    }
 
-        // Keep a reference for ourself
-        CFRetain(layout_data);
-        // The TIS is no more needed
-        CFRelease(tis);
+private:
+    IOHIDManagerRef         manager = nullptr;
+    bool                    opened = false;
+
+    std::unordered_map<keyboard::vk, IOHIDElementRef> keys;
+
+    // Tables of current layout. Marked as changed by input source notification
+    std::mutex                              layout_mutex;
+    std::atomic<bool>                       layout_changed { false };
+    std::shared_ptr<const keyboard::layout> loaded;
+
+    // Thread to receive input values
+    std::thread                     run_loop_thread;
+    CFRunLoopRef                    run_loop = nullptr;
+    std::mutex                  listeners_mutex;
+    std::vector<hid_listener *> listeners;
+    // Held while events are delivered. Recursive, so callbacks may make and destroy listeners
+    std::recursive_mutex        delivery_mutex;
+    std::vector<hid_listener *> delivering;
 
-        layout = reinterpret_cast<const UCKeyboardLayout *>(CFDataGetBytePtr(layout_data));
+    // Pressed keys, indexed by virtual keycode and updated on run loop thread
+    std::atomic<std::uint64_t> pressed[2] = {};
 
+    HIDInputManager() : loaded(layout_builder::build())
+    {
         // Create an HID Manager reference
         manager = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
         // Open the HID Manager reference
         IOReturn openStatus = IOHIDManagerOpen(manager, kIOHIDOptionsTypeNone);
+        opened = openStatus == kIOReturnSuccess;
+
+        if (opened)
+        {
+            // Initialize the keyboard
+            init_keyboard();
+            // Take keys that are already held, then keep them up to date
+            load_pressed();
+        }
+        // Layout notifications are delivered even without HID access
+        start_run_loop();
+    }
+
+    // Read current value of every key once
+    void load_pressed()
+    {
+        for (const auto &[vk, key] : keys)
+        {
+            IOHIDValueRef value = nullptr;
+            IOHIDDeviceRef device = IOHIDElementGetDevice(key);
+            IOReturn fetched = kIOReturnError;
+            {
+                stats_timer timer(keyboard::operation::hid_value_fetch);
+                fetched = IOHIDDeviceGetValue(device, key, &value);
+            }
+            if (fetched != kIOReturnSuccess || !value) { continue; }
+            set_pressed(usage_to_virtual_code(IOHIDElementGetUsage(key)), IOHIDValueGetIntegerValue(value) != 0);
+        }
+    }
+
+    // Update cached state of single key
+    void set_pressed(UInt8 virtual_code, bool is_down) noexcept
+    {
+        const std::size_t index = virtual_code;
+        if (index >= 64 * std::size(pressed)) { return; }
+
+        std::uint64_t bit = std::uint64_t(1) << (index % 64);
+        if (is_down) { pressed[index / 64].fetch_or(bit, std::memory_order_release); }
+        else         { pressed[index / 64].fetch_and(~bit, std::memory_order_release); }
+    }
+
+    // Schedule HID manager and layout notifications on their own run loop (only once)
+    void start_run_loop()
+    {
+        if (run_loop_thread.joinable()) { return; }
+
+        std::promise<CFRunLoopRef> started;
+        auto result = started.get_future();
+        run_loop_thread = std::thread(
+            [this, &started]()
+            {
+                CFRunLoopRef loop = CFRunLoopGetCurrent();
+
+                // Run loop exits immediately without sources
+                CFRunLoopSourceContext context = {};
+                context.perform = [](void *) {};
+                CFRunLoopSourceRef keep_alive = CFRunLoopSourceCreate(kCFAllocatorDefault, 0, &context);
+                CFRunLoopAddSource(loop, keep_alive, kCFRunLoopDefaultMode);
+
+                CFNotificationCenterAddObserver(
+                    CFNotificationCenterGetDistributedCenter(),
+                    this,
+                    &HIDInputManager::on_layout_changed,
+                    kTISNotifySelectedKeyboardInputSourceChanged,
+                    nullptr,
+                    CFNotificationSuspensionBehaviorDeliverImmediately
+                );
+
+                if (opened)
+                {
+                    IOHIDManagerRegisterInputValueCallback(manager, &HIDInputManager::on_value, this);
+                    IOHIDManagerScheduleWithRunLoop(manager, loop, kCFRunLoopDefaultMode);
+                }
+                started.set_value(loop);
+
+                CFRunLoopRun();
+
+                if (opened)
+                {
+                    IOHIDManagerUnscheduleFromRunLoop(manager, loop, kCFRunLoopDefaultMode);
+                }
+                CFNotificationCenterRemoveEveryObserver(CFNotificationCenterGetDistributedCenter(), this);
+                CFRunLoopRemoveSource(loop, keep_alive, kCFRunLoopDefaultMode);
+                CFRelease(keep_alive);
+            }
+        );
+        run_loop = result.get();
+    }
 
-        if (openStatus != kIOReturnSuccess) { return; }
+    // Called on run loop thread for every changed HID element
+    static void on_value(void *context, IOReturn result, void *sender, IOHIDValueRef value);
 
-        // Initialize the keyboard
-        init_keyboard();
+    // Called when user selects another keyboard input source
+    static void on_layout_changed(
+        CFNotificationCenterRef, void *observer, CFNotificationName, const void *, CFDictionaryRef
+    )
+    {
+        static_cast<HIDInputManager *>(observer)->layout_changed.store(true);
     }
 
     CFDictionaryRef copy_devices_mask(UInt32 page, UInt32 usage)
@@ -251,60 +653,13 @@ private:
 
         if (virtual_code == 0xff) { return; }
 
-        // Now translate the virtual code to Unicode according to
-        // the current keyboard layout
-
-        UInt32       deadKeyState = 0;
-        // Unicode string length is usually less or equal to 4
-        UniCharCount maxStringLength = 4;
-        UniCharCount actualStringLength = 0;
-        UniChar      unicodeString[maxStringLength];
-
-        OSStatus     error;
-
-        error = 
-            UCKeyTranslate(
-                layout,                      // current layout
-                virtual_code,                // our key
-                kUCKeyActionDown,            // or kUCKeyActionUp ?
-                0x100,                       // no modifiers
-                LMGetKbdType(),              // keyboard's type
-                kUCKeyTranslateNoDeadKeysBit,// some sort of option
-                &deadKeyState,               // unused stuff
-                maxStringLength,             // our memory limit
-                &actualStringLength,         // length of what we get
-                unicodeString
-            ); 
-
-        if (error == noErr)
-        {
-            // Translation went fine
+        // Localized virtual key according to the current keyboard layout
+        keyboard::vk vk = loaded->key_of(virtual_code);
 
-
-            bool found = false;
-            keyboard::vk vk;
-
-            // First we look if the key down is from a list of characters
-            // that depend on keyboard localization
-            if (actualStringLength > 0)
-            {
-                found = localizedKeys(unicodeString[0], vk);
-            }
-
-            // The key is not a localized one so we try to find a
-            // corresponding code through virtual key code
-            if (not found)
-            {
-                vk = static_cast<keyboard::vk>(virtual_code);
-            }
-
-            // Ok, everything went fine. Now we have a unique
-            // corresponding sf::Keyboard::Key to one IOHIDElementRef
-            keys[vk] = key;
-
-            // And don't forget to keep the reference alive for our usage
-            CFRetain(keys[vk]);
-        }
+        // Keep the reference alive for our usage
+        if (keys.count(vk)) { CFRelease(keys[vk]); }
+        keys[vk] = key;
+        CFRetain(key);
     }
 
     UInt8 usage_to_virtual_code(UInt32 usage)
@@ -427,90 +782,329 @@ private:
         }
     }
 
-    bool localizedKeys(UniChar c, keyboard::vk &vk)
+    ~HIDInputManager()
     {
-        if ('a' <= c && c <= 'z')
+        if (run_loop_thread.joinable())
         {
-            c = std::toupper(c);
+            CFRunLoopStop(run_loop);
+            run_loop_thread.join();
         }
 
-        #define CASE_LETTER(LETTER)        \
-            case #LETTER[0]:               \
-                vk = keyboard::vk::LETTER; \
-                break; 
+        if (manager)
+        {
+            CFRelease(manager);
+        }
 
-        switch (c)
+        for (auto &[vk, key] : keys)
         {
-            CASE_LETTER(A);
-            CASE_LETTER(B);
-            CASE_LETTER(C);
-            CASE_LETTER(D);
-            CASE_LETTER(E);
-            CASE_LETTER(F);
-            CASE_LETTER(G);
-            CASE_LETTER(H);
-            CASE_LETTER(I);
-            CASE_LETTER(J);
-            CASE_LETTER(K);
-            CASE_LETTER(L);
-            CASE_LETTER(M);
-            CASE_LETTER(N);
-            CASE_LETTER(O);
-            CASE_LETTER(P);
-            CASE_LETTER(Q);
-            CASE_LETTER(R);
-            CASE_LETTER(S);
-            CASE_LETTER(T);
-            CASE_LETTER(U);
-            CASE_LETTER(V);
-            CASE_LETTER(W);
-            CASE_LETTER(X);
-            CASE_LETTER(Y);
-            CASE_LETTER(Z);
-
-            default: return false;
+            CFRelease(key);
         }
+    }
+};
 
-        return true;
+// Source of listener's events, based on HID manager's input value callback
+class hid_listener : public keyboard::listener::source
+{
+public:
+    hid_listener(keyboard::listener &owner) : source(owner)
+    {
+        HIDInputManager::get().subscribe(this);
     }
 
-    ~HIDInputManager()
+    bool active() const noexcept override { return HIDInputManager::get().active(); }
+
+    // Pass event to listener
+    void push(const keyboard::listener::event &e) { deliver(e); }
+
+    ~hid_listener() override { HIDInputManager::get().unsubscribe(this); }
+};
+
+void HIDInputManager::on_value(void *context, IOReturn result, void *sender, IOHIDValueRef value)
+{
+    auto *self = static_cast<HIDInputManager *>(context);
+
+    IOHIDElementRef element = IOHIDValueGetElement(value);
+    if (IOHIDElementGetUsagePage(element) != kHIDPage_KeyboardOrKeypad) { return; }
+
+    UInt8 virtual_code = self->usage_to_virtual_code(IOHIDElementGetUsage(element));
+    if (virtual_code == 0xff) { return; }
+
+    keyboard::listener::event e;
+    e.key = self->current_layout()->key_of(virtual_code);
+    e.is_down = IOHIDValueGetIntegerValue(value) != 0;
+    e.time = std::chrono::steady_clock::now();
+
+    self->set_pressed(virtual_code, e.is_down);
+
+    // Callbacks are called outside listeners_mutex, so they may subscribe and unsubscribe
+    std::lock_guard delivery(self->delivery_mutex);
+    {
+        std::lock_guard lock(self->listeners_mutex);
+        self->delivering = self->listeners;
+    }
+    for (auto *listener : self->delivering)
     {
-        if (layout_data)
         {
-            CFRelease(layout_data);
+            // Skip listeners, destroyed by previous callbacks
+            std::lock_guard lock(self->listeners_mutex);
+            if (std::find(self->listeners.begin(), self->listeners.end(), listener) == self->listeners.end()) { continue; }
         }
+        listener->push(e);
+    }
+}
 
-        // Do not release m_layout! It is owned by m_layoutData.
+// Post mouse event and release it
+void post_mouse_event(CGEventRef event)
+{
+    if (!event) { return; }
+    {
+        stats_timer timer(keyboard::operation::fake_key_event);
+        CGEventPost(kCGHIDEventTap, event);
+    }
+    CFRelease(event);
+}
 
-        if (manager)
+// Get current location of cursor
+CGPoint cursor_location()
+{
+    CGPoint location = {};
+    if (CGEventRef event = CGEventCreate(nullptr))
+    {
+        location = CGEventGetLocation(event);
+        CFRelease(event);
+    }
+    return location;
+}
+
+// Keyboard functions, implemented with CGEvent and HID manager
+class quartz_backend : public keyboard::backend
+{
+public:
+    bool is_pressed(const keyboard::combination &combo) override { return HIDInputManager::get().is_pressed(combo); }
+
+    keyboard::combination pressed_keys() override { return HIDInputManager::get().pressed_keys(); }
+
+    // Modifiers are pressed before and released after other keys of combination
+    void send(const keyboard::combination &combo, bool is_down) override
+    {
+        const auto mapping = current_layout();
+        auto &events = event_cache::get();
+
+        auto post_modifiers = [&]
         {
-            CFRelease(manager);
+            for (auto key : combo)
+            {
+                if (CGEventFlags flag = modifier_mask(key); flag != 0) { events.post_modifier(mapping->code_of(key), is_down, flag); }
+            }
+        };
+
+        if (is_down) { post_modifiers(); }
+        for (auto key : combo)
+        {
+            if (modifier_mask(key) == 0) { events.post(mapping->code_of(key), is_down, 0); }
         }
+        if (!is_down) { post_modifiers(); }
+    }
 
-        for (auto &[vk, key] : keys)
+    // Modifiers stay held across calls, so sequence may be split into several batches
+    void send(span<const keyboard::key_event> events) override
+    {
+        const auto mapping = current_layout();
+        auto &cache = event_cache::get();
+
+        for (const auto &event : events)
         {
-            CFRelease(key);
+            const CGKeyCode code = mapping->code_of(event.key);
+            if (CGEventFlags flag = modifier_mask(event.key); flag != 0) { cache.post_modifier(code, event.is_down, flag); }
+            else { cache.post(code, event.is_down, 0); }
         }
     }
+
+    void type(std::u32string_view text) override
+    {
+        const auto mapping = current_layout();
+        auto &events = event_cache::get();
+
+        for (char32_t c : text)
+        {
+            if (c == U'\n') { c = U'\r'; }
+
+            if (const auto *key = mapping->find(c))
+            {
+                CGEventFlags flags = 0;
+                if (key->modifiers & 1) { flags |= kCGEventFlagMaskShift; }
+                if (key->modifiers & 2) { flags |= kCGEventFlagMaskAlternate; }
+
+                events.post(key->code, true, flags);
+                events.post(key->code, false, flags);
+                continue;
+            }
+
+            // Missing in layout: send as UTF-16 code units
+            UniChar units[2] = { static_cast<UniChar>(c), 0 };
+            UniCharCount count = 1;
+            if (c > 0xFFFF)
+            {
+                units[0] = static_cast<UniChar>(0xD800 + ((c - 0x10000) >> 10));
+                units[1] = static_cast<UniChar>(0xDC00 + ((c - 0x10000) & 0x3FF));
+                count = 2;
+            }
+            events.post_unicode(units, count);
+        }
+    }
+
+    std::shared_ptr<const keyboard::layout> current_layout() override { return HIDInputManager::get().current_layout(); }
+
+    std::unique_ptr<keyboard::listener::source> listen(keyboard::listener &owner) override
+    {
+        return std::make_unique<hid_listener>(owner);
+    }
+
+    mouse::point mouse_position() override
+    {
+        const CGPoint location = cursor_location();
+        return mouse::point{ static_cast<int>(location.x), static_cast<int>(location.y) };
+    }
+
+    void send_mouse(span<const mouse::event> events) override
+    {
+        constexpr CGMouseButton buttons[mouse::button_count] = {
+            kCGMouseButtonLeft, kCGMouseButtonRight, kCGMouseButtonCenter,
+            static_cast<CGMouseButton>(3), static_cast<CGMouseButton>(4)
+        };
+
+        // Quartz has no relative moves, so position is tracked through the batch
+        CGPoint location = cursor_location();
+        for (const auto &event : events)
+        {
+            const auto b = static_cast<std::size_t>(event.button);
+            switch (event.kind)
+            {
+            case mouse::action::move_to:
+            case mouse::action::move_by:
+            {
+                const CGFloat dx = event.kind == mouse::action::move_by ? event.x : event.x - location.x;
+                const CGFloat dy = event.kind == mouse::action::move_by ? event.y : event.y - location.y;
+                location.x += dx;
+                location.y += dy;
+
+                // Motion with held button is a drag
+                const unsigned held = buttons_down.load();
+                CGEventType type = kCGEventMouseMoved;
+                CGMouseButton button = kCGMouseButtonLeft;
+                if (held & 1) { type = kCGEventLeftMouseDragged; }
+                else if (held & 2) { type = kCGEventRightMouseDragged; button = kCGMouseButtonRight; }
+                else if (held != 0) { type = kCGEventOtherMouseDragged; button = kCGMouseButtonCenter; }
+
+                CGEventRef motion = CGEventCreateMouseEvent(nullptr, type, location, button);
+                if (motion)
+                {
+                    CGEventSetIntegerValueField(motion, kCGMouseEventDeltaX, static_cast<int64_t>(dx));
+                    CGEventSetIntegerValueField(motion, kCGMouseEventDeltaY, static_cast<int64_t>(dy));
+                }
+                post_mouse_event(motion);
+                break;
+            }
+            case mouse::action::press:
+            case mouse::action::release:
+            {
+                const bool is_down = event.kind == mouse::action::press;
+                if (is_down) { buttons_down.fetch_or(1u << b); } else { buttons_down.fetch_and(~(1u << b)); }
+
+                CGEventType type = is_down ? kCGEventOtherMouseDown : kCGEventOtherMouseUp;
+                if (event.button == mouse::button::left) { type = is_down ? kCGEventLeftMouseDown : kCGEventLeftMouseUp; }
+                if (event.button == mouse::button::right) { type = is_down ? kCGEventRightMouseDown : kCGEventRightMouseUp; }
+
+                CGEventRef click = CGEventCreateMouseEvent(nullptr, type, location, buttons[b]);
+                if (click) { CGEventSetIntegerValueField(click, kCGMouseEventClickState, 1); }
+                post_mouse_event(click);
+                break;
+            }
+            case mouse::action::scroll:
+                post_mouse_event(CGEventCreateScrollWheelEvent(nullptr, kCGScrollEventUnitLine, 2, event.y, event.x));
+                break;
+            }
+        }
+    }
+
+private:
+    // Buttons, pressed through this backend, so motion is sent as drag
+    std::atomic<unsigned> buttons_down{0};
 };
 
+// Backend, installed on current thread
+keyboard::backend *& thread_backend() noexcept
+{
+    thread_local keyboard::backend *installed = nullptr;
+    return installed;
+}
+
 } // namespace os::detail
 
 
 namespace os::keyboard
 {
 
+// Get backend, that calls OS
+backend & native_backend()
+{
+    static detail::quartz_backend native;
+    return native;
+}
+
 // Check if every key in combination is pressed
-bool is_pressed(const combination &combo) { return detail::HIDInputManager::get().is_pressed(combo); }
+bool is_pressed(const combination &combo) { return current_backend().is_pressed(combo); }
 
 // Get combination of all pressed keys on a keyboard
-combination pressed_keys() { return detail::HIDInputManager::get().pressed_keys(); }
+combination pressed_keys() { return current_backend().pressed_keys(); }
+
+// Capture state of the whole keyboard at once
+state snapshot() { return current_backend().snapshot(); }
 
 // Press combination of keys (until release)
-void press(const combination &combo) { detail::send_key_events(combo, true); }
+void press(const combination &combo) { current_backend().send(combo, true); }
 
 // Release combination of keys
-void release(const combination &combo) { detail::send_key_events(combo, false); }
+void release(const combination &combo) { current_backend().send(combo, false); }
+
+// Send sequence of key events at once
+void send(span<const key_event> events) { current_backend().send(events); }
+
+// Get layout, that is active now
+std::shared_ptr<const layout> layout::current() { return current_backend().current_layout(); }
+
+// Type text, using current keyboard layout
+void type(std::u32string_view text) { current_backend().type(text); }
+
+// Start listening and queue events
+listener::listener() : origin(current_backend().listen(*this)) {}
+
+// Start listening and pass events to callback
+listener::listener(callback on_event)
+    : on_event(std::move(on_event)), origin(current_backend().listen(*this)) {}
+
+// Stop listening
+listener::~listener() { origin.reset(); }
+
+// Check if OS delivers events to listener
+bool listener::active() const noexcept { return origin->active(); }
+
+// Get counters of native backend
+stats_t stats()
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    return detail::stats_registry::get().collect();
+#else
+    return {};
+#endif
+}
+
+// Reset counters of every thread
+void reset_stats()
+{
+#ifdef LIBOS_KEYBOARD_STATS
+    detail::stats_registry::get().clear();
+#endif
+}
 
 } // namespace os::keyboard
\ No newline at end of file
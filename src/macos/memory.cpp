@@ -0,0 +1,82 @@
+#include "os/memory.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <mach/mach.h>
+#include <sys/sysctl.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Read facts about memory
+memory::info_t read_memory_info()
+{
+    memory::info_t i;
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    i.page_size = page_size > 0 ? static_cast<std::size_t>(page_size) : 0;
+
+#if defined(__x86_64__)
+    // Allocated with VM_FLAGS_SUPERPAGE_SIZE_2MB
+    i.huge_page_sizes.push_back(std::size_t{2} << 20);
+    i.huge_pages_available = true;
+#endif
+
+    std::uint64_t total = 0;
+    std::size_t size = sizeof(total);
+    if (sysctlbyname("hw.memsize", &total, &size, nullptr, 0) == 0) { i.total = total; }
+
+    return i;
+}
+
+} // namespace os::detail
+
+namespace os::memory
+{
+
+// Get size of regular page in bytes
+std::size_t page_size() { return info().page_size; }
+
+// Get total physical memory in bytes
+std::uint64_t total() { return info().total; }
+
+// Get facts about memory
+const info_t & info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_memory_info();
+    return i;
+}
+
+// Sample current memory figures
+snapshot_t snapshot() noexcept
+{
+    snapshot_t s;
+
+    // mach_host_self() adds reference to port on every call
+    static const mach_port_t host = mach_host_self();
+
+    vm_statistics64_data_t vm = {};
+    mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+    if (host_statistics64(host, HOST_VM_INFO64, reinterpret_cast<host_info64_t>(&vm), &count) == KERN_SUCCESS)
+    {
+        // Inactive pages are reclaimed without swapping
+        s.available = (std::uint64_t{vm.free_count} + vm.inactive_count) * vm_page_size;
+    }
+
+    mach_task_basic_info_data_t task = {};
+    count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&task), &count) == KERN_SUCCESS)
+    {
+        s.resident = task.resident_size;
+        s.peak_resident = task.resident_size_max;
+    }
+
+    return s;
+}
+
+} // namespace os::memory
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "os/process.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <libproc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace os::detail
+{
+
+// Convert timeval to nanoseconds
+std::chrono::nanoseconds to_nanoseconds(const timeval &time)
+{
+    return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+}
+
+} // namespace os::detail
+
+namespace os::process
+{
+
+// Sample resource usage of current process
+usage_t usage() noexcept
+{
+    usage_t u;
+
+    // Times of proc_pid_rusage are in Mach ticks on Apple Silicon, so they're taken from here
+    rusage r = {};
+    if (getrusage(RUSAGE_SELF, &r) == 0)
+    {
+        u.user_time = detail::to_nanoseconds(r.ru_utime);
+        u.system_time = detail::to_nanoseconds(r.ru_stime);
+        u.voluntary_switches = static_cast<std::uint64_t>(r.ru_nvcsw);
+        u.involuntary_switches = static_cast<std::uint64_t>(r.ru_nivcsw);
+        u.major_faults = static_cast<std::uint64_t>(r.ru_majflt);
+        u.minor_faults = static_cast<std::uint64_t>(r.ru_minflt);
+    }
+
+    rusage_info_v2 info = {};
+    if (proc_pid_rusage(getpid(), RUSAGE_INFO_V2, reinterpret_cast<rusage_info_t *>(&info)) == 0)
+    {
+        u.read_bytes = info.ri_diskio_bytesread;
+        u.write_bytes = info.ri_diskio_byteswritten;
+    }
+
+    return u;
+}
+
+} // namespace os::process
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "os/thread.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_MACOS
+    #error "This code is for macOS only!"
+#endif
+
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+
+namespace os::thread
+{
+
+// Hint scheduler to run current thread near threads with the same first CPU
+bool pin(const cpu::cpu_set &cpus)
+{
+    if (cpus.empty()) { return false; }
+
+    // Tag 0 is THREAD_AFFINITY_TAG_NULL
+    thread_affinity_policy_data_t policy = { static_cast<integer_t>(cpus.front() + 1) };
+    return thread_policy_set(
+        pthread_mach_thread_np(pthread_self()),
+        THREAD_AFFINITY_POLICY,
+        reinterpret_cast<thread_policy_t>(&policy),
+        THREAD_AFFINITY_POLICY_COUNT
+    ) == KERN_SUCCESS;
+}
+
+// Change QoS class of current thread
+bool set_priority(priority p)
+{
+    qos_class_t qos = QOS_CLASS_DEFAULT;
+    switch (p)
+    {
+    case priority::idle:     qos = QOS_CLASS_BACKGROUND; break;
+    case priority::low:      qos = QOS_CLASS_UTILITY; break;
+    case priority::normal:   qos = QOS_CLASS_DEFAULT; break;
+    case priority::high:     qos = QOS_CLASS_USER_INITIATED; break;
+    case priority::realtime: qos = QOS_CLASS_USER_INTERACTIVE; break;
+    }
+
+    return pthread_set_qos_class_self_np(qos, 0) == 0;
+}
+
+// There is only node 0
+bool set_numa_preferred(unsigned node) { return node == 0; }
+
+} // namespace os::thread
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "os/clock.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <utility>
+
+#include <Windows.h>
+
+#include "os/kernel.hpp"
+
+namespace os::detail
+{
+#if defined(_M_X64) || defined(_M_IX86)
+    // Read ticks and raw time as close together as possible
+    std::pair<std::uint64_t, clock::raw::time_point> sample_clock() noexcept
+    {
+        std::uint64_t best = (std::numeric_limits<std::uint64_t>::max)();
+        std::pair<std::uint64_t, clock::raw::time_point> sample;
+        for (int i = 0; i < 8; ++i)
+        {
+            const std::uint64_t before = clock::ticks();
+            const auto now = clock::raw::now();
+            const std::uint64_t after = clock::ticks();
+            if (after - before < best)
+            {
+                best = after - before;
+                sample = { before + best / 2, now };
+            }
+        }
+        return sample;
+    }
+#endif
+
+    // Find relation between ticks and raw clock
+    clock::calibration_t calibrate_clock() noexcept
+    {
+        clock::calibration_t c;
+        if (!kernel::features().has(kernel::feature::invariant_tsc)) { return c; }
+
+#if defined(_M_X64) || defined(_M_IX86)
+        const auto start = sample_clock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        const auto end = sample_clock();
+        if (end.first <= start.first) { return c; }
+
+        c.ns_per_tick = static_cast<double>((end.second - start.second).count()) /
+                        static_cast<double>(end.first - start.first);
+        c.base_ticks = end.first;
+        c.base_time = end.second;
+        c.tsc = true;
+#endif
+
+        return c;
+    }
+}
+
+namespace os::clock
+{
+    // Get current time of raw monotonic clock
+    raw::time_point raw::now() noexcept
+    {
+        static const std::int64_t frequency = []
+        {
+            LARGE_INTEGER f;
+            QueryPerformanceFrequency(&f);
+            return f.QuadPart;
+        }();
+
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+
+        // Split to avoid overflow of counter * 10^9
+        const std::int64_t seconds = counter.QuadPart / frequency;
+        const std::int64_t rest = counter.QuadPart % frequency;
+        return time_point(duration(seconds * 1000000000 + rest * 1000000000 / frequency));
+    }
+
+    // Get relation between ticks and raw clock
+    const calibration_t & calibration() noexcept
+    {
+        // Init calibration only once.
+        static const calibration_t c = detail::calibrate_clock();
+        return c;
+    }
+}
\ No newline at end of file
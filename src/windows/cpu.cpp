@@ -0,0 +1,130 @@
+#include "os/cpu.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <algorithm>
+#include <memory>
+
+#include <Windows.h>
+
+namespace os::detail
+{
+    // Append logical CPUs of group affinity to set
+    void append_cpus(const GROUP_AFFINITY &affinity, cpu::cpu_set &cpus)
+    {
+        for (unsigned bit = 0; bit < 8 * sizeof(KAFFINITY); ++bit)
+        {
+            if (affinity.Mask & (KAFFINITY{ 1 } << bit))
+            {
+                cpus.push_back(affinity.Group * 64u + bit);
+            }
+        }
+    }
+
+    // Read CPU topology
+    cpu::info_t read_cpu_info()
+    {
+        cpu::info_t i;
+
+        DWORD length = 0;
+        GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+        if (length == 0) { return i; }
+
+        auto buffer = std::make_unique<BYTE[]>(length);
+        if (!GetLogicalProcessorInformationEx(
+                RelationAll,
+                reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.get()),
+                &length
+            ))
+        {
+            return i;
+        }
+
+        // Records have different sizes
+        for (DWORD offset = 0; offset < length;)
+        {
+            const auto &record = *reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.get() + offset);
+            offset += record.Size;
+
+            switch (record.Relationship)
+            {
+            case RelationProcessorCore:
+            {
+                cpu::cpu_set siblings;
+                for (WORD g = 0; g < record.Processor.GroupCount; ++g)
+                {
+                    append_cpus(record.Processor.GroupMask[g], siblings);
+                }
+                i.logical_cores += static_cast<unsigned>(siblings.size());
+                i.siblings.push_back(std::move(siblings));
+                break;
+            }
+            case RelationProcessorPackage:
+                ++i.packages;
+                break;
+            case RelationCache:
+            {
+                const CACHE_RELATIONSHIP &cache = record.Cache;
+
+                cpu::cache_t *target = nullptr;
+                if (cache.Level == 1 && cache.Type == CacheData) { target = &i.l1d; }
+                else if (cache.Level == 1 && cache.Type == CacheInstruction) { target = &i.l1i; }
+                else if (cache.Level == 2) { target = &i.l2; }
+                else if (cache.Level == 3) { target = &i.l3; }
+
+                // Every core has its own record of the same cache
+                if (target && target->size == 0)
+                {
+                    target->size = cache.CacheSize;
+                    target->line_size = cache.LineSize;
+                }
+                break;
+            }
+            case RelationNumaNode:
+            {
+                cpu::numa_node node;
+                node.id = record.NumaNode.NodeNumber;
+                append_cpus(record.NumaNode.GroupMask, node.cpus);
+                i.numa_nodes.push_back(std::move(node));
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        i.physical_cores = static_cast<unsigned>(i.siblings.size());
+
+        std::sort(i.siblings.begin(), i.siblings.end());
+        std::sort(
+            i.numa_nodes.begin(), i.numa_nodes.end(),
+            [](const cpu::numa_node &lhs, const cpu::numa_node &rhs) { return lhs.id < rhs.id; }
+        );
+        return i;
+    }
+}
+
+namespace os::cpu
+{
+
+    // Number of logical CPUs
+    unsigned logical_cores() { return info().logical_cores; }
+
+    // Number of physical cores
+    unsigned physical_cores() { return info().physical_cores; }
+
+    // Size of cache line
+    std::size_t cache_line_size() { return info().l1d.line_size; }
+
+    // Get CPU topology
+    const info_t& info()
+    {
+        // Init info only once.
+        static const info_t i = detail::read_cpu_info();
+        return i;
+    }
+
+}
\ No newline at end of file
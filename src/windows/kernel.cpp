@@ -5,41 +5,107 @@
     #error "This code is for Windows only!"
 #endif
 
-namespace os::kernel
+#include <Windows.h>
+
+#if defined(_M_X64) || defined(_M_IX86)
+    #include <intrin.h>
+#endif
+
+namespace os::detail
 {
 
-// Get name of OS kernel
-std::string name() { return "Windows NT"; }
+// Read OS kernel info
+os::kernel::info_t read_kernel_info()
+{
+    os::kernel::info_t i;
 
-// Get major, minor and patch of OS kernel
-::version version() { return info().version; }
+    i.name = name();
 
-// Get version [+ additional data] of OS kernel
-std::string version_string() { return info().version_string; }
+    // KUSER_SHARED_DATA address.
+    // Offsets are taken from http://terminus.rewolf.pl/terminus/structures/ntdll/_KUSER_SHARED_DATA_x64.html
+    constexpr uintptr_t data_adress = uintptr_t{ 0x7ffe0000 };
+    const uint32_t major = *reinterpret_cast<const uint32_t*>(data_adress + 0x26c);
+    const uint32_t minor = *reinterpret_cast<const uint32_t*>(data_adress + 0x270);
+    const uint32_t patch = *reinterpret_cast<const uint32_t*>(data_adress + 0x260);
 
-// Get OS kernel info
-const info_t& info()
+    i.version = ::version{ major, minor, patch };
+    i.version_string = i.version.str();
+
+    return i;
+}
+
+// Probe OS kernel features with actual calls
+os::kernel::features_t probe_kernel_features()
 {
-    static info_t i;
+    using os::kernel::feature;
 
-    if (static bool init = true; init)
+    os::kernel::features_t f;
+
+#if defined(_M_X64) || defined(_M_IX86)
+    int registers[4] = {};
+    __cpuid(registers, 0x80000000);
+    if (static_cast<unsigned>(registers[0]) >= 0x80000007u)
     {
-        i.name = name();
+        __cpuid(registers, 0x80000007);
+        if (registers[3] & (1 << 8)) { f.add(feature::invariant_tsc); }
+    }
+#elif defined(_M_ARM64)
+    // Generic timer has fixed frequency
+    f.add(feature::invariant_tsc);
+#endif
 
-        // KUSER_SHARED_DATA address.
-        // Offsets are taken from http://terminus.rewolf.pl/terminus/structures/ntdll/_KUSER_SHARED_DATA_x64.html
-        constexpr uintptr_t data_adress = uintptr_t{ 0x7ffe0000 };
-        const uint32_t major = *reinterpret_cast<const uint32_t*>(data_adress + 0x26c);
-        const uint32_t minor = *reinterpret_cast<const uint32_t*>(data_adress + 0x270);
-        const uint32_t patch = *reinterpret_cast<const uint32_t*>(data_adress + 0x260);
+    // Functions are looked up at runtime to load on older Windows
+    const HMODULE kernelbase = GetModuleHandleW(L"KernelBase.dll");
+    if (!kernelbase) { return f; }
 
-        i.version = ::version{ major, minor, patch };
-        i.version_string = i.version.str();
+    // Windows 11+. Capabilities are 4 32-bit fields
+    using query_capabilities_t = HRESULT (WINAPI *)(void *);
+    if (const auto query = reinterpret_cast<query_capabilities_t>(GetProcAddress(kernelbase, "QueryIoRingCapabilities")))
+    {
+        UINT32 capabilities[4] = {};
+        if (SUCCEEDED(query(capabilities))) { f.add(feature::io_ring); }
+    }
 
-        init = false;
+    // Windows 8+. Differing values make it return immediately
+    using wait_on_address_t = BOOL (WINAPI *)(volatile VOID *, PVOID, SIZE_T, DWORD);
+    if (const auto wait = reinterpret_cast<wait_on_address_t>(GetProcAddress(kernelbase, "WaitOnAddress")))
+    {
+        volatile LONG value = 0;
+        LONG compare = 1;
+        if (wait(&value, &compare, sizeof(value), 0)) { f.add(feature::wait_on_address); }
     }
 
+    return f;
+}
+
+} // namespace os::detail
+
+namespace os::kernel
+{
+
+// Get name of OS kernel
+std::string_view name() { return "Windows NT"; }
+
+// Get major, minor and patch of OS kernel
+::version version() { return info().version; }
+
+// Get version [+ additional data] of OS kernel
+std::string_view version_string() { return info().version_string; }
+
+// Get OS kernel info
+const info_t& info()
+{
+    // Init info only once.
+    static const info_t i = detail::read_kernel_info();
     return i;
 }
 
+// Get available OS kernel features
+const features_t& features()
+{
+    // Init features only once.
+    static const features_t f = detail::probe_kernel_features();
+    return f;
+}
+
 } // namespace os::kernel
\ No newline at end of file
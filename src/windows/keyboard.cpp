@@ -5,66 +5,528 @@
     #error "This code is for Windows only!"
 #endif
 
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <Windows.h>
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+    #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 namespace os::detail
 {
-    void send_inputs(const keyboard::combination &combo, bool is_down)
+    // Raise priority of current thread for time-critical work (if possible)
+    void raise_thread_priority() noexcept
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    }
+
+    // Sleep until deadline with the best precision available
+    void precise_sleep_until(std::chrono::steady_clock::time_point deadline) noexcept
     {
-        std::vector<INPUT> inputs(combo.keys.size());
-        size_t i = 0;
-        for (auto key : combo.keys)
+        // High resolution timers are available since Windows 10, version 1803
+        thread_local HANDLE timer = CreateWaitableTimerExW(
+            nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS
+        );
+
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= remaining.zero()) { return; }
+
+        if (!timer)
         {
-            auto& in = inputs[i];
+            std::this_thread::sleep_until(deadline);
+            return;
+        }
 
-            in.type = INPUT_KEYBOARD;
-            in.ki.wVk = static_cast<int>(key);
-            if (!is_down) 
-            {
-                in.ki.dwFlags = KEYEVENTF_KEYUP;
-            }
+        // Negative value means relative time in 100 nanoseconds intervals
+        LARGE_INTEGER due;
+        due.QuadPart = -std::chrono::duration_cast<std::chrono::duration<LONGLONG, std::ratio<1, 10'000'000>>>(remaining).count();
+        if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE))
+        {
+            WaitForSingleObject(timer, INFINITE);
+        }
+    }
+
+    // Reusable buffer of inputs, so injection doesn't allocate after warm up
+    std::vector<INPUT> & input_buffer()
+    {
+        thread_local std::vector<INPUT> inputs;
+        inputs.clear();
+        return inputs;
+    }
 
-            i++;
+    INPUT make_input(keyboard::vk key, bool is_down)
+    {
+        INPUT in = {};
+        in.type = INPUT_KEYBOARD;
+        in.ki.wVk = static_cast<int>(key);
+        if (!is_down)
+        {
+            in.ki.dwFlags = KEYEVENTF_KEYUP;
         }
-        SendInput(inputs.size(), inputs.data(), sizeof(INPUT));
+        return in;
     }
-}
 
-namespace os::keyboard
-{
+    // Input of mouse with raw fields
+    INPUT make_mouse_input(DWORD flags, LONG dx = 0, LONG dy = 0, DWORD data = 0)
+    {
+        INPUT in = {};
+        in.type = INPUT_MOUSE;
+        in.mi.dx = dx;
+        in.mi.dy = dy;
+        in.mi.mouseData = data;
+        in.mi.dwFlags = flags;
+        return in;
+    }
 
-    // Check if every key in combination is pressed
-    bool is_pressed(const combination& combo)
+    // Get input of mouse event
+    INPUT make_mouse_input(const mouse::event &event)
     {
-        for (const auto& key : combo.keys)
+        // Flags of press and release of every button
+        constexpr DWORD downs[mouse::button_count] = {
+            MOUSEEVENTF_LEFTDOWN, MOUSEEVENTF_RIGHTDOWN, MOUSEEVENTF_MIDDLEDOWN, MOUSEEVENTF_XDOWN, MOUSEEVENTF_XDOWN
+        };
+        constexpr DWORD ups[mouse::button_count] = {
+            MOUSEEVENTF_LEFTUP, MOUSEEVENTF_RIGHTUP, MOUSEEVENTF_MIDDLEUP, MOUSEEVENTF_XUP, MOUSEEVENTF_XUP
+        };
+
+        const auto b = static_cast<std::size_t>(event.button);
+        const DWORD x_button = event.button == mouse::button::back ? XBUTTON1 :
+                               event.button == mouse::button::forward ? XBUTTON2 : 0;
+
+        switch (event.kind)
         {
-            short state = GetAsyncKeyState(static_cast<int>(key));
-            // If the most significant bit of 2 bytes is not set, the key isn't pressed
-            if (!(state & (1 << 15))) { return false; };
+        case mouse::action::move_to:
+        {
+            // Absolute coordinates are normalized to 0..65535 over the whole virtual desktop
+            const int left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+            const int top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+            const int width = (std::max)(GetSystemMetrics(SM_CXVIRTUALSCREEN) - 1, 1);
+            const int height = (std::max)(GetSystemMetrics(SM_CYVIRTUALSCREEN) - 1, 1);
+            return make_mouse_input(
+                MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK,
+                static_cast<LONG>((event.x - left) * 65535LL / width),
+                static_cast<LONG>((event.y - top) * 65535LL / height)
+            );
+        }
+        case mouse::action::move_by: return make_mouse_input(MOUSEEVENTF_MOVE, event.x, event.y);
+        case mouse::action::press: return make_mouse_input(downs[b], 0, 0, x_button);
+        case mouse::action::release: return make_mouse_input(ups[b], 0, 0, x_button);
+        case mouse::action::scroll: break;
         }
-        return true;
+        return INPUT{};
     }
 
-    // Get combination of all pressed keys on a keyboard
-    combination pressed_keys()
+    // Send every buffered input with a single call
+    void submit_inputs(std::vector<INPUT> &inputs)
     {
-        combination combo;
+        stats_timer timer(keyboard::operation::flush);
+        SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+    }
+
+    // Input of UTF-16 code unit, that doesn't need a key on layout
+    INPUT make_unicode_input(wchar_t unit, bool is_down)
+    {
+        INPUT in = {};
+        in.type = INPUT_KEYBOARD;
+        in.ki.wScan = unit;
+        in.ki.dwFlags = KEYEVENTF_UNICODE;
+        if (!is_down)
+        {
+            in.ki.dwFlags |= KEYEVENTF_KEYUP;
+        }
+        return in;
+    }
+
+    // Builds layout tables with VkKeyScanExW
+    class layout_builder
+    {
+    public:
+        // Build tables of keyboard layout
+        static std::shared_ptr<keyboard::layout> build(HKL hkl)
+        {
+            static std::uint64_t loaded = 0;
+
+            auto result = std::make_shared<keyboard::layout>();
+            result->number = loaded++;
+
+            // Virtual keys are the same as key codes
+            for (std::size_t i = 0; i < key_index_count; ++i)
+            {
+                result->codes[i] = static_cast<std::uint16_t>(i);
+            }
+            for (unsigned code = 0; code < 256; ++code)
+            {
+                result->keys[code] = static_cast<keyboard::vk>(code);
+            }
+
+            // Modifiers are bits of VkKeyScanExW shift state
+            result->modifier_keys[0] = VK_SHIFT;
+            result->modifier_keys[1] = VK_CONTROL;
+            result->modifier_keys[2] = VK_MENU;
+
+            insert(*result, hkl, U'\t');
+            insert(*result, hkl, U'\r');
+            for (char32_t c = 0x20; c < char_table::dense_size; ++c)
+            {
+                insert(*result, hkl, c);
+            }
+            // General punctuation and currency symbols (e.g. euro sign)
+            for (char32_t c = 0x2000; c < 0x20D0; ++c)
+            {
+                insert(*result, hkl, c);
+            }
+            return result;
+        }
+
+    private:
+        static void insert(keyboard::layout &result, HKL hkl, char32_t c)
+        {
+            const SHORT scan = VkKeyScanExW(static_cast<WCHAR>(c), hkl);
+            if (scan == -1) { return; }
+
+            // Only Shift, Ctrl and Alt states may be held
+            const unsigned shift_state = HIBYTE(scan);
+            if (shift_state & ~7u) { return; }
+
+            result.chars.insert(c, LOBYTE(scan), static_cast<std::uint16_t>(shift_state));
+        }
+    };
+
+    // Source of listener's events, based on low-level keyboard hook.
+    //
+    // Hook procedure is called on the thread, that installed the hook,
+    // so every listener has its own thread with message loop.
+    class hook_listener : public keyboard::listener::source
+    {
+    public:
+        hook_listener(keyboard::listener& owner) : source(owner)
+        {
+            std::promise<bool> installed;
+            auto result = installed.get_future();
+            thread = std::thread(
+                [this, &installed]()
+                {
+                    current = this;
+                    thread_id = GetCurrentThreadId();
+
+                    // Force creation of message queue before anyone can post WM_QUIT
+                    MSG msg;
+                    PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+
+                    HHOOK hook = SetWindowsHookExW(WH_KEYBOARD_LL, &hook_listener::hook_proc, GetModuleHandleW(nullptr), 0);
+                    installed.set_value(hook != nullptr);
+                    if (!hook) { return; }
+
+                    while (GetMessageW(&msg, nullptr, 0, 0) > 0) {}
+
+                    UnhookWindowsHookEx(hook);
+                }
+            );
+            hooked = result.get();
+        }
+
+        bool active() const noexcept override { return hooked; }
+
+        ~hook_listener() override
+        {
+            if (hooked) { PostThreadMessageW(thread_id, WM_QUIT, 0, 0); }
+            thread.join();
+        }
+
+    private:
+        static LRESULT CALLBACK hook_proc(int code, WPARAM wparam, LPARAM lparam)
+        {
+            if (code == HC_ACTION)
+            {
+                const auto* info = reinterpret_cast<const KBDLLHOOKSTRUCT*>(lparam);
+
+                keyboard::listener::event e;
+                e.key = static_cast<keyboard::vk>(info->vkCode);
+                e.is_down = (wparam == WM_KEYDOWN || wparam == WM_SYSKEYDOWN);
+                e.time = std::chrono::steady_clock::now();
+                current->deliver(e);
+            }
+            return CallNextHookEx(nullptr, code, wparam, lparam);
+        }
+
+        // Listener of hook's thread
+        static thread_local hook_listener* current;
+
+        std::thread thread;
+        DWORD       thread_id = 0;
+        bool        hooked = false;
+    };
+
+    thread_local hook_listener* hook_listener::current = nullptr;
+
+    // Keyboard functions, implemented with SendInput and low-level hook
+    class win32_backend : public keyboard::backend
+    {
+    public:
+        bool is_pressed(const keyboard::combination& combo) override
+        {
+            stats_timer timer(keyboard::operation::query_keymap);
+            for (const auto& key : combo)
+            {
+                short state = GetAsyncKeyState(static_cast<int>(key));
+                // If the most significant bit of 2 bytes is not set, the key isn't pressed
+                if (!(state & (1 << 15))) { return false; };
+            }
+            return true;
+        }
+
+        keyboard::combination pressed_keys() override
+        {
+            keyboard::combination combo;
+            stats_timer timer(keyboard::operation::query_keymap);
+
+            // Go through every virtual key
+            for (int key = 0; key < 256; ++key)
+            {
+                short state = GetAsyncKeyState(key);
+                // If the most significant bit of 2 bytes set, the key is pressed
+                if (state & (1 << 15)) { combo.insert(static_cast<keyboard::vk>(key)); };
+            }
+
+            return combo;
+        }
+
+        keyboard::state snapshot() override
+        {
+            // Synchronize thread's keyboard state with the async one,
+            // otherwise it's updated only by thread's message loop
+            GetKeyState(0);
+
+            BYTE keys[256];
+            bool queried = false;
+            {
+                stats_timer timer(keyboard::operation::query_keymap);
+                queried = GetKeyboardState(keys) != FALSE;
+            }
+            if (!queried) { return keyboard::state(pressed_keys()); }
+
+            keyboard::combination combo;
+            for (int key = 0; key < 256; ++key)
+            {
+                // If the high-order bit is set, the key is pressed
+                if (keys[key] & 0x80) { combo.insert(static_cast<keyboard::vk>(key)); }
+            }
+            return keyboard::state(combo);
+        }
+
+        void send(const keyboard::combination& combo, bool is_down) override
+        {
+            auto &inputs = input_buffer();
+            for (auto key : combo)
+            {
+                inputs.push_back(make_input(key, is_down));
+            }
+            submit_inputs(inputs);
+        }
+
+        void send(span<const keyboard::key_event> events) override
+        {
+            auto &inputs = input_buffer();
+            for (const auto& event : events)
+            {
+                inputs.push_back(make_input(event.key, event.is_down));
+            }
+            submit_inputs(inputs);
+        }
 
-        // Go through every virtual key
-        for (int key = 0; key < 256; ++key)
+        // Layout is per-thread on Windows and WM_INPUTLANGCHANGE is only sent
+        // to windows of that thread, so foreground window's HKL is compared instead.
+        std::shared_ptr<const keyboard::layout> current_layout() override
         {
-            short state = GetAsyncKeyState(key);
-            // If the most significant bit of 2 bytes set, the key is pressed
-            if (state & (1 << 15)) { combo += static_cast<vk>(key); };
+            HKL hkl = GetKeyboardLayout(GetWindowThreadProcessId(GetForegroundWindow(), nullptr));
+
+            std::lock_guard lock(mutex);
+            if (!cached || hkl != loaded)
+            {
+                cached = layout_builder::build(hkl);
+                loaded = hkl;
+            }
+            return cached;
+        }
+
+        void type(std::u32string_view text) override
+        {
+            const auto mapping = current_layout();
+
+            auto &inputs = input_buffer();
+
+            // Press and release modifiers only when they change between characters
+            unsigned held = 0;
+            auto hold = [&](unsigned state)
+            {
+                for (unsigned index = 0; index < 3; ++index)
+                {
+                    const unsigned mask = 1u << index;
+                    if ((held ^ state) & mask)
+                    {
+                        inputs.push_back(make_input(static_cast<keyboard::vk>(mapping->modifier_key(index)), (state & mask) != 0));
+                    }
+                }
+                held = state;
+            };
+
+            for (char32_t c : text)
+            {
+                if (c == U'\n') { c = U'\r'; }
+
+                if (const auto *key = mapping->find(c))
+                {
+                    hold(key->modifiers);
+                    inputs.push_back(make_input(static_cast<keyboard::vk>(key->code), true));
+                    inputs.push_back(make_input(static_cast<keyboard::vk>(key->code), false));
+                    continue;
+                }
+
+                // Missing in layout: send as UTF-16 code units
+                hold(0);
+                wchar_t units[2];
+                std::size_t count = 1;
+                if (c > 0xFFFF)
+                {
+                    units[0] = static_cast<wchar_t>(0xD800 + ((c - 0x10000) >> 10));
+                    units[1] = static_cast<wchar_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+                    count = 2;
+                }
+                else
+                {
+                    units[0] = static_cast<wchar_t>(c);
+                }
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    inputs.push_back(make_unicode_input(units[i], true));
+                    inputs.push_back(make_unicode_input(units[i], false));
+                }
+            }
+            hold(0);
+
+            submit_inputs(inputs);
         }
 
-        return combo;
+        std::unique_ptr<keyboard::listener::source> listen(keyboard::listener& owner) override
+        {
+            return std::make_unique<hook_listener>(owner);
+        }
+
+        mouse::point mouse_position() override
+        {
+            POINT p = {};
+            if (!GetCursorPos(&p)) { return {}; }
+            return mouse::point{ p.x, p.y };
+        }
+
+        void send_mouse(span<const mouse::event> events) override
+        {
+            auto &inputs = input_buffer();
+            for (const auto& event : events)
+            {
+                if (event.kind != mouse::action::scroll)
+                {
+                    inputs.push_back(make_mouse_input(event));
+                    continue;
+                }
+
+                // Wheel data is signed, one click is WHEEL_DELTA
+                if (event.y != 0)
+                {
+                    inputs.push_back(make_mouse_input(MOUSEEVENTF_WHEEL, 0, 0, static_cast<DWORD>(event.y * WHEEL_DELTA)));
+                }
+                if (event.x != 0)
+                {
+                    inputs.push_back(make_mouse_input(MOUSEEVENTF_HWHEEL, 0, 0, static_cast<DWORD>(event.x * WHEEL_DELTA)));
+                }
+            }
+            submit_inputs(inputs);
+        }
+
+    private:
+        std::mutex                              mutex;
+        HKL                                     loaded = nullptr;
+        std::shared_ptr<const keyboard::layout> cached;
+    };
+
+    // Backend, installed on current thread
+    keyboard::backend *& thread_backend() noexcept
+    {
+        thread_local keyboard::backend *installed = nullptr;
+        return installed;
+    }
+}
+
+namespace os::keyboard
+{
+
+    // Get backend, that calls OS
+    backend & native_backend()
+    {
+        static detail::win32_backend native;
+        return native;
     }
 
+    // Check if every key in combination is pressed
+    bool is_pressed(const combination& combo) { return current_backend().is_pressed(combo); }
+
+    // Get combination of all pressed keys on a keyboard
+    combination pressed_keys() { return current_backend().pressed_keys(); }
+
+    // Capture state of the whole keyboard at once
+    state snapshot() { return current_backend().snapshot(); }
+
     // Press combination of keys (until release)
-    void press(const combination& combo) { detail::send_inputs(combo, true); }
+    void press(const combination& combo) { current_backend().send(combo, true); }
 
     // Release combination of keys
-    void release(const combination& combo) { detail::send_inputs(combo, false); }
+    void release(const combination& combo) { current_backend().send(combo, false); }
+
+    // Send sequence of key events at once
+    void send(span<const key_event> events) { current_backend().send(events); }
+
+    // Get layout, that is active now
+    std::shared_ptr<const layout> layout::current() { return current_backend().current_layout(); }
+
+    // Type text, using current keyboard layout
+    void type(std::u32string_view text) { current_backend().type(text); }
+
+    // Start listening and queue events
+    listener::listener() : origin(current_backend().listen(*this)) {}
+
+    // Start listening and pass events to callback
+    listener::listener(callback on_event)
+        : on_event(std::move(on_event)), origin(current_backend().listen(*this)) {}
+
+    // Stop listening
+    listener::~listener() { origin.reset(); }
+
+    // Check if OS delivers events to listener
+    bool listener::active() const noexcept { return origin->active(); }
+
+    // Get counters of native backend
+    stats_t stats()
+    {
+#ifdef LIBOS_KEYBOARD_STATS
+        return detail::stats_registry::get().collect();
+#else
+        return {};
+#endif
+    }
+
+    // Reset counters of every thread
+    void reset_stats()
+    {
+#ifdef LIBOS_KEYBOARD_STATS
+        detail::stats_registry::get().clear();
+#endif
+    }
 
 } // namespace os::keyboard
\ No newline at end of file
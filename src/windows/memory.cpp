@@ -0,0 +1,104 @@
+#include "os/memory.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <memory>
+
+#include <Windows.h>
+#include <Psapi.h>
+
+namespace os::detail
+{
+    // Check if process token has privilege, required for large pages
+    bool has_lock_memory_privilege()
+    {
+        LUID lock_memory = {};
+        if (!LookupPrivilegeValueW(nullptr, L"SeLockMemoryPrivilege", &lock_memory)) { return false; }
+
+        HANDLE token = nullptr;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) { return false; }
+
+        bool found = false;
+        DWORD length = 0;
+        GetTokenInformation(token, TokenPrivileges, nullptr, 0, &length);
+        if (length > 0)
+        {
+            auto buffer = std::make_unique<BYTE[]>(length);
+            if (GetTokenInformation(token, TokenPrivileges, buffer.get(), length, &length))
+            {
+                const auto &privileges = *reinterpret_cast<const TOKEN_PRIVILEGES *>(buffer.get());
+                for (DWORD p = 0; p < privileges.PrivilegeCount; ++p)
+                {
+                    const LUID &luid = privileges.Privileges[p].Luid;
+                    if (luid.LowPart == lock_memory.LowPart && luid.HighPart == lock_memory.HighPart) { found = true; }
+                }
+            }
+        }
+
+        CloseHandle(token);
+        return found;
+    }
+
+    // Read facts about memory
+    memory::info_t read_memory_info()
+    {
+        memory::info_t i;
+
+        SYSTEM_INFO system = {};
+        GetSystemInfo(&system);
+        i.page_size = system.dwPageSize;
+
+        if (const SIZE_T large = GetLargePageMinimum())
+        {
+            i.huge_page_sizes.push_back(large);
+            i.huge_pages_available = has_lock_memory_privilege();
+        }
+
+        MEMORYSTATUSEX status = {};
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status)) { i.total = status.ullTotalPhys; }
+
+        return i;
+    }
+}
+
+namespace os::memory
+{
+    // Get size of regular page in bytes
+    std::size_t page_size() { return info().page_size; }
+
+    // Get total physical memory in bytes
+    std::uint64_t total() { return info().total; }
+
+    // Get facts about memory
+    const info_t & info()
+    {
+        // Init info only once.
+        static const info_t i = detail::read_memory_info();
+        return i;
+    }
+
+    // Sample current memory figures
+    snapshot_t snapshot() noexcept
+    {
+        snapshot_t s;
+
+        MEMORYSTATUSEX status = {};
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status)) { s.available = status.ullAvailPhys; }
+
+        // K32 version is in kernel32, so there is no need to link psapi
+        PROCESS_MEMORY_COUNTERS counters = {};
+        counters.cb = sizeof(counters);
+        if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            s.resident = counters.WorkingSetSize;
+            s.peak_resident = counters.PeakWorkingSetSize;
+        }
+
+        return s;
+    }
+}
\ No newline at end of file
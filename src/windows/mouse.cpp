@@ -0,0 +1,33 @@
+#include "os/mouse.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+namespace os::mouse
+{
+    // Get position of mouse cursor
+    point position() { return keyboard::current_backend().mouse_position(); }
+
+    // Send sequence of mouse events at once
+    void send(span<const event> events) { keyboard::current_backend().send_mouse(events); }
+
+    // Move cursor to absolute position
+    void move_to(point p) { send({ event::moved_to(p) }); }
+
+    // Move cursor by offset
+    void move_by(int dx, int dy) { send({ event::moved_by(dx, dy) }); }
+
+    // Press button (until release)
+    void press(button b) { send({ event::pressed(b) }); }
+
+    // Release button
+    void release(button b) { send({ event::released(b) }); }
+
+    // Press and release button with a single batch
+    void click(button b) { send({ event::pressed(b), event::released(b) }); }
+
+    // Scroll by wheel clicks
+    void scroll(int dy, int dx) { send({ event::scrolled(dx, dy) }); }
+}
\ No newline at end of file
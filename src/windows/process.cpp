@@ -0,0 +1,55 @@
+#include "os/process.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <Windows.h>
+#include <Psapi.h>
+
+namespace os::detail
+{
+    // Convert FILETIME interval to nanoseconds
+    std::chrono::nanoseconds to_nanoseconds(const FILETIME &time)
+    {
+        // FILETIME counts 100ns intervals
+        const std::uint64_t intervals = (std::uint64_t{ time.dwHighDateTime } << 32) | time.dwLowDateTime;
+        return std::chrono::nanoseconds(static_cast<std::int64_t>(intervals * 100));
+    }
+}
+
+namespace os::process
+{
+    // Sample resource usage of current process
+    usage_t usage() noexcept
+    {
+        usage_t u;
+
+        const HANDLE process = GetCurrentProcess();
+
+        FILETIME creation, exit, kernel, user;
+        if (GetProcessTimes(process, &creation, &exit, &kernel, &user))
+        {
+            u.user_time = detail::to_nanoseconds(user);
+            u.system_time = detail::to_nanoseconds(kernel);
+        }
+
+        // K32 version is in kernel32, so there is no need to link psapi
+        PROCESS_MEMORY_COUNTERS counters = {};
+        counters.cb = sizeof(counters);
+        if (K32GetProcessMemoryInfo(process, &counters, sizeof(counters)))
+        {
+            u.minor_faults = counters.PageFaultCount;
+        }
+
+        IO_COUNTERS io = {};
+        if (GetProcessIoCounters(process, &io))
+        {
+            u.read_bytes = io.ReadTransferCount;
+            u.write_bytes = io.WriteTransferCount;
+        }
+
+        return u;
+    }
+}
\ No newline at end of file
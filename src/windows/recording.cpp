@@ -0,0 +1,42 @@
+#include "os/recording.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <Windows.h>
+
+namespace os::detail
+{
+    // Map file
+    mapped_file::mapped_file(const std::string& path)
+    {
+        HANDLE h = CreateFileA(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+        );
+        if (h == INVALID_HANDLE_VALUE) { return; }
+        file = h;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(h, &size) || size.QuadPart == 0) { return; }
+
+        mapping = CreateFileMappingA(h, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) { return; }
+
+        const void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!ptr) { return; }
+
+        bytes = static_cast<const unsigned char*>(ptr);
+        length = static_cast<std::size_t>(size.QuadPart);
+    }
+
+    // Unmap file
+    mapped_file::~mapped_file()
+    {
+        if (bytes) { UnmapViewOfFile(bytes); }
+        if (mapping) { CloseHandle(mapping); }
+        if (file) { CloseHandle(file); }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "os/thread.hpp"
+
+#include "os/macros.h"
+#if !IS_OS_WINDOWS
+    #error "This code is for Windows only!"
+#endif
+
+#include <Windows.h>
+
+namespace os::thread
+{
+    // Allow current thread to run only on specified CPUs
+    bool pin(const cpu::cpu_set &cpus)
+    {
+        if (cpus.empty()) { return false; }
+
+        // Thread may run only in single processor group of 64 CPUs
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = static_cast<WORD>(cpus.front() / 64);
+        for (unsigned c : cpus)
+        {
+            if (c / 64 != affinity.Group) { return false; }
+            affinity.Mask |= KAFFINITY{ 1 } << (c % 64);
+        }
+
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+    }
+
+    // Change scheduling class of current thread
+    bool set_priority(priority p)
+    {
+        int value = THREAD_PRIORITY_NORMAL;
+        switch (p)
+        {
+        case priority::idle:     value = THREAD_PRIORITY_IDLE; break;
+        case priority::low:      value = THREAD_PRIORITY_BELOW_NORMAL; break;
+        case priority::normal:   value = THREAD_PRIORITY_NORMAL; break;
+        case priority::high:     value = THREAD_PRIORITY_HIGHEST; break;
+        case priority::realtime: value = THREAD_PRIORITY_TIME_CRITICAL; break;
+        }
+
+        return SetThreadPriority(GetCurrentThread(), value) != 0;
+    }
+
+    // Prefer CPUs and memory of NUMA node for current thread
+    bool set_numa_preferred(unsigned node)
+    {
+        GROUP_AFFINITY affinity = {};
+        if (node > 0xFFFF || !GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) || affinity.Mask == 0)
+        {
+            return false;
+        }
+
+        // Memory is allocated on node of the processor, that thread runs on
+        PROCESSOR_NUMBER ideal = {};
+        ideal.Group = affinity.Group;
+        while (!(affinity.Mask & (KAFFINITY{ 1 } << ideal.Number))) { ++ideal.Number; }
+
+        return SetThreadIdealProcessorEx(GetCurrentThread(), &ideal, nullptr) != 0;
+    }
+}
\ No newline at end of file